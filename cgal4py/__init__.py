@@ -34,8 +34,12 @@ def triangulate(pts, left_edge=None, right_edge=None, periodic=False,
         right_edge (np.ndarray of float64, optional): (m,) upper limits on
             the domain. If None, this is set to np.max(pts, axis=0).
             Defaults to None.
-        periodic (bool optional): If True, the domain is assumed to be
-            periodic at its left and right edges. Defaults to False.
+        periodic (bool or str, optional): If True, the domain is assumed to
+            be periodic at its left and right edges. If 'ghost', a serial
+            periodic triangulation is emulated with periodic images of the
+            points near the edges (see
+            :class:`cgal4py.delaunay.GhostPeriodicDelaunay`). In parallel,
+            'ghost' is the same as True. Defaults to False.
         use_double (bool, optional): If True, the triangulation is forced to
             use 64bit integers reguardless of if there are too many points for
             32bit. Otherwise 32bit integers are used so long as the number of
@@ -113,8 +117,12 @@ def voronoi_volumes(pts, left_edge=None, right_edge=None, periodic=False,
         right_edge (np.ndarray of float64, optional): (m,) upper limits on
             the domain. If None, this is set to np.max(pts, axis=0).
             Defaults to None.
-        periodic (bool optional): If True, the domain is assumed to be
-            periodic at its left and right edges. Defaults to False.
+        periodic (bool or str, optional): If True, the domain is assumed to
+            be periodic at its left and right edges. If 'ghost', a serial
+            periodic triangulation is emulated with periodic images of the
+            points near the edges (see
+            :class:`cgal4py.delaunay.GhostPeriodicDelaunay`). In parallel,
+            'ghost' is the same as True. Defaults to False.
         use_double (bool, optional): If True, the triangulation is forced to
             use 64bit integers reguardless of if there are too many points for
             32bit. Otherwise 32bit integers are used so long as the number of
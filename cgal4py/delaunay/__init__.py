@@ -16,6 +16,8 @@ from cgal4py.delaunay import delaunay2
 from cgal4py.delaunay import delaunay3
 from cgal4py.delaunay.delaunay2 import Delaunay2
 from cgal4py.delaunay.delaunay3 import Delaunay3
+from cgal4py.delaunay.mapped_delaunay3 import MappedDelaunay3
+from cgal4py.delaunay.ghost_delaunay import GhostPeriodicDelaunay
 from cgal4py.delaunay.periodic_delaunay2 import is_valid as is_valid_P2
 from cgal4py.delaunay.periodic_delaunay3 import is_valid as is_valid_P3
 from cgal4py.delaunay import parallel_delaunayD
@@ -49,6 +51,10 @@ elif 'boost' in os.listdir(os.path.join(_drive, 'usr', 'include')):
     _include_dirs.append(os.path.join(_drive, 'usr', 'include', 'boost'))
 else:
     raise Exception("boost is not installed.")
+# TBB is optional and allows 3D triangulations to insert points on multiple
+# threads
+_use_tbb = (('tbb' in os.listdir(_include_dir)) or
+            ('tbb' in os.listdir(os.path.join(_drive, 'usr', 'include'))))
 
 _delaunay_dir = os.path.dirname(os.path.realpath(__file__))
 
@@ -403,7 +409,7 @@ def _make_ext(dim, periodic=False, bit64=False, parallel=False,
     if generated:
         extra_compile_args = []
         extra_link_args = []
-        include_dirs = _include_dirs#[]
+        include_dirs = list(_include_dirs)
         if bit64:
             includes = [
                 _delaunay_filename('pyx', dim, periodic=periodic,
@@ -448,6 +454,12 @@ def _make_ext(dim, periodic=False, bit64=False, parallel=False,
             import cykdtree
             cykdtree_dir = os.path.dirname(cykdtree.__file__)
             include_dirs.append(cykdtree_dir)
+            # Tree files and routing tables used by the C++ MPI path
+            decomp_dir = os.path.join(os.path.dirname(_delaunay_dir),
+                                      'domain_decomp')
+            include_dirs.append(decomp_dir)
+            includes += [os.path.join(decomp_dir, 'c_kdtree_file.hpp'),
+                         os.path.join(decomp_dir, 'c_kdtree_route.hpp')]
             sources += [
                 _delaunay_filename('cpp', dim),
                 os.path.join(cykdtree_dir, "c_parallel_kdtree.cpp"),
@@ -462,10 +474,17 @@ def _make_ext(dim, periodic=False, bit64=False, parallel=False,
                                  parallel=parallel)
         is_new += _create_pyxdep_file(dep, includes=includes,
                                       overwrite=overwrite)
+        libraries = []
+        define_macros = []
+        if _use_tbb:
+            libraries.append('tbb')
+            define_macros.append(('CGAL_LINKED_WITH_TBB', '1'))
         is_new += _create_pyxbld_file(bld, sources=sources,
                                       extra_compile_args=extra_compile_args,
                                       extra_link_args=extra_link_args,
                                       include_dirs=include_dirs,
+                                      libraries=libraries,
+                                      define_macros=define_macros,
                                       overwrite=overwrite)
     if is_new:
         modname = _delaunay_filename('module', dim, periodic=periodic,
@@ -550,8 +569,12 @@ def Delaunay(pts, use_double=False, periodic=False,
             use 64bit integers reguardless of if there are too many points for
             32bit. Otherwise 32bit integers are used so long as the number of
             points is <=4294967295. Defaults to False.
-        periodic (bool optional): If True, the domain is assumed to be
-            periodic at its left and right edges. Defaults to False.
+        periodic (bool or str, optional): If True, the domain is assumed to
+            be periodic at its left and right edges. If 'ghost', the
+            periodic domain is emulated by adding periodic images of points
+            near the edges to a non-periodic triangulation (see
+            :class:`cgal4py.delaunay.GhostPeriodicDelaunay`). Defaults to
+            False.
         left_edge (np.ndarray of float64, optional): (m,) lower limits on
             the domain. If None, this is set to np.min(pts, axis=0).
             Defaults to None.
@@ -560,8 +583,10 @@ def Delaunay(pts, use_double=False, periodic=False,
             Defaults to None.
 
     Returns:
-        :class:`cgal4py.delaunay.Delaunay2` or
-            :class:`cgal4py.delaunay.Delaunay3`: 2D or 3D triangulation class.
+        :class:`cgal4py.delaunay.Delaunay2`,
+            :class:`cgal4py.delaunay.Delaunay3`, or
+            :class:`cgal4py.delaunay.GhostPeriodicDelaunay`: 2D or 3D
+            triangulation class.
 
     Raises:
         ValueError: If pts is not a 2D array.
@@ -599,6 +624,10 @@ def Delaunay(pts, use_double=False, periodic=False,
                 raise ValueError("right_edge must be a 1D array with " +
                                  "{} elements.".format(ndim))
         args = [left_edge, right_edge]
+    # Emulate periodic domain with ghost points
+    if periodic == 'ghost':
+        return GhostPeriodicDelaunay(pts, left_edge, right_edge,
+                                     use_double=use_double)
     # Initialize correct tessellation
     DelaunayClass = _get_Delaunay(ndim, periodic=periodic,
                                   bit64=use_double)
@@ -630,7 +659,8 @@ def VoronoiVolumes(pts, *args, **kwargs):
 
 
 __all__ = ["tools", "Delaunay", "VoronoiVolumes",
-           "delaunay2", "delaunay3", "Delaunay2", "Delaunay3"]
+           "delaunay2", "delaunay3", "Delaunay2", "Delaunay3",
+           "MappedDelaunay3", "GhostPeriodicDelaunay"]
 if is_valid_P2():
     __all__ += ["periodic_delaunay2", "PeriodicDelaunay2"]
 if is_valid_P3():
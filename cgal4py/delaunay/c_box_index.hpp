@@ -0,0 +1,299 @@
+// Engine used by the outgoing_points methods to find the vertices of cells
+// whose circumspheres intersect a set of neighboring boxes. Boxes are
+// binned on a uniform grid so each circumsphere is only tested against
+// nearby boxes. Vertices are deduplicated with a bitmap for each box.
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include "c_tools.hpp"
+#ifdef CGAL_LINKED_WITH_TBB
+#include <tbb/enumerable_thread_specific.h>
+#endif
+
+#ifndef CGAL4PY_BOX_INDEX_HPP
+#define CGAL4PY_BOX_INDEX_HPP
+
+class BoxIndex
+{
+ public:
+  uint32_t ndim;
+  uint64_t nbox;
+  const double *left_edges;
+  const double *right_edges;
+  std::vector<double> grid_le;
+  std::vector<double> grid_re;
+  std::vector<double> grid_width;
+  std::vector<uint64_t> grid_n;
+  // Boxes overlapping grid cell i are cell_boxes[cell_start[i]:cell_start[i+1]]
+  std::vector<uint64_t> cell_start;
+  std::vector<uint64_t> cell_boxes;
+
+  // Scratch space for queries so that they do not allocate. Each thread
+  // needs its own.
+  class Query
+  {
+  public:
+    std::vector<uint64_t> stamp;
+    uint64_t count = 0;
+    std::vector<uint64_t> lo, hi, idx;
+    std::vector<uint64_t> boxes;
+    Query(const BoxIndex &index) :
+      stamp(index.nbox, 0), lo(index.ndim), hi(index.ndim), idx(index.ndim) {}
+  };
+
+  BoxIndex(uint32_t ndim0, uint64_t nbox0, const double *le, const double *re) :
+    ndim(ndim0), nbox(nbox0), left_edges(le), right_edges(re),
+    grid_le(ndim0), grid_re(ndim0), grid_width(ndim0), grid_n(ndim0, 1)
+  {
+    uint32_t d;
+    uint64_t b, i, ncells = 1;
+    if (nbox == 0) {
+      cell_start.assign(2, 0);
+      return;
+    }
+    for (d = 0; d < ndim; d++) {
+      grid_le[d] = le[d];
+      grid_re[d] = re[d];
+      for (b = 1; b < nbox; b++) {
+        grid_le[d] = std::min(grid_le[d], le[ndim*b + d]);
+        grid_re[d] = std::max(grid_re[d], re[ndim*b + d]);
+      }
+    }
+    // About one grid cell per box
+    uint64_t n1 = (uint64_t)std::ceil(std::pow((double)nbox, 1.0/(double)ndim));
+    n1 = std::max((uint64_t)1, std::min(n1, (uint64_t)64));
+    for (d = 0; d < ndim; d++) {
+      if (grid_re[d] > grid_le[d])
+        grid_n[d] = n1;
+      grid_width[d] = (grid_re[d] - grid_le[d])/(double)grid_n[d];
+      if (grid_width[d] <= 0)
+        grid_width[d] = 1.0;
+      ncells *= grid_n[d];
+    }
+    // Count then fill the boxes in each grid cell
+    Query q(*this);
+    std::vector<uint64_t> count(ncells + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+      for (b = 0; b < nbox; b++) {
+        for (d = 0; d < ndim; d++) {
+          q.lo[d] = grid_index(d, le[ndim*b + d]);
+          q.hi[d] = grid_index(d, re[ndim*b + d]);
+        }
+        q.idx = q.lo;
+        do {
+          i = flat_index(q.idx);
+          if (pass == 0)
+            count[i + 1]++;
+          else
+            cell_boxes[cell_start[i] + (count[i]++)] = b;
+        } while (next_index(q));
+      }
+      if (pass == 0) {
+        for (i = 0; i < ncells; i++)
+          count[i + 1] += count[i];
+        cell_start = count;
+        cell_boxes.resize(count[ncells]);
+        std::fill(count.begin(), count.end(), 0);
+      }
+    }
+  }
+
+  uint64_t grid_index(uint32_t d, double x) const {
+    double f = std::floor((x - grid_le[d])/grid_width[d]);
+    if (f < 0)
+      return 0;
+    if (f >= (double)grid_n[d])
+      return grid_n[d] - 1;
+    return (uint64_t)f;
+  }
+  uint64_t flat_index(const std::vector<uint64_t> &idx) const {
+    uint64_t i = 0;
+    for (uint32_t d = 0; d < ndim; d++)
+      i = i*grid_n[d] + idx[d];
+    return i;
+  }
+  // Advance q.idx through the grid cells between q.lo and q.hi.
+  bool next_index(Query &q) const {
+    for (uint32_t d = ndim; d > 0; d--) {
+      if (q.idx[d-1] < q.hi[d-1]) {
+        q.idx[d-1]++;
+        return true;
+      }
+      q.idx[d-1] = q.lo[d-1];
+    }
+    return false;
+  }
+
+  bool intersect(const double *c, double r, uint64_t b) const {
+    const double *le = left_edges + ndim*b;
+    const double *re = right_edges + ndim*b;
+    for (uint32_t d = 0; d < ndim; d++) {
+      if (c[d] < le[d]) {
+        if ((c[d] + r) < le[d])
+          return false;
+      } else if (c[d] > re[d]) {
+        if ((c[d] - r) > re[d])
+          return false;
+      }
+    }
+    return true;
+  }
+
+  // Set q.boxes to the boxes that the sphere with center c and radius r
+  // intersects.
+  void query(const double *c, double r, Query &q) const {
+    uint32_t d;
+    uint64_t i, k, b;
+    q.boxes.clear();
+    if (nbox == 0)
+      return;
+    for (d = 0; d < ndim; d++) {
+      if (((c[d] + r) < grid_le[d]) || ((c[d] - r) > grid_re[d]))
+        return;
+      q.lo[d] = grid_index(d, c[d] - r);
+      q.hi[d] = grid_index(d, c[d] + r);
+    }
+    q.count++;
+    q.idx = q.lo;
+    do {
+      i = flat_index(q.idx);
+      for (k = cell_start[i]; k < cell_start[i+1]; k++) {
+        b = cell_boxes[k];
+        if (q.stamp[b] == q.count)
+          continue;
+        q.stamp[b] = q.count;
+        if (intersect(c, r, b))
+          q.boxes.push_back(b);
+      }
+    } while (next_index(q));
+  }
+};
+
+
+// Find the vertices of cells whose circumspheres intersect each box.
+//   sphere(cell, c, r) sets the center and radius of the circumsphere
+//     and returns false if the cell is infinite, in which case its
+//     vertices are sent to every box.
+//   verts(cell, buf) sets buf to the infos of the finite vertices.
+// The vertices for each box are returned in ascending order.
+template <typename Info, typename Cell, typename Sphere, typename Verts>
+std::vector<std::vector<Info>> outgoing_points_boxes(uint32_t ndim, uint64_t nbox,
+                                                     double *left_edges,
+                                                     double *right_edges,
+                                                     const std::vector<Cell> &cells,
+                                                     Sphere sphere, Verts verts,
+                                                     int nthreads = 1) {
+  typedef std::pair<uint64_t, uint64_t> Hit;
+  std::vector<std::vector<Info>> out(nbox);
+  if (nbox == 0)
+    return out;
+  BoxIndex index(ndim, nbox, left_edges, right_edges);
+  uint64_t ncells = cells.size();
+
+  // Boxes hit by each cell
+  struct Local {
+    std::vector<Hit> hits;
+    std::vector<uint64_t> infinite;
+  };
+#ifdef CGAL_LINKED_WITH_TBB
+  tbb::enumerable_thread_specific<Local> tls;
+#endif
+  Local serial;
+  auto find_hits = [&](Local &loc, uint64_t begin, uint64_t end) {
+    BoxIndex::Query q(index);
+    std::vector<double> c(ndim);
+    double r;
+    for (uint64_t i = begin; i < end; i++) {
+      if (!sphere(cells[i], &c[0], r)) {
+        loc.infinite.push_back(i);
+        continue;
+      }
+      index.query(&c[0], r, q);
+      for (std::vector<uint64_t>::iterator b = q.boxes.begin(); b != q.boxes.end(); b++)
+        loc.hits.push_back(Hit(*b, i));
+    }
+  };
+#ifdef CGAL_LINKED_WITH_TBB
+  if (nthreads > 1) {
+    parallel_for_ranges(ncells, nthreads, [&](uint64_t begin, uint64_t end) {
+      find_hits(tls.local(), begin, end);
+    });
+  } else
+#endif
+  find_hits(serial, 0, ncells);
+
+  // Group hits by box
+  std::vector<uint64_t> start(nbox + 1, 0);
+  std::vector<uint64_t> hit_cells;
+  std::vector<uint64_t> infinite;
+  std::vector<const Local*> all;
+  all.push_back(&serial);
+#ifdef CGAL_LINKED_WITH_TBB
+  for (typename tbb::enumerable_thread_specific<Local>::const_iterator it = tls.begin(); it != tls.end(); it++)
+    all.push_back(&(*it));
+#endif
+  uint64_t b, k;
+  for (k = 0; k < all.size(); k++) {
+    for (std::vector<Hit>::const_iterator h = all[k]->hits.begin(); h != all[k]->hits.end(); h++)
+      start[h->first + 1]++;
+    infinite.insert(infinite.end(), all[k]->infinite.begin(), all[k]->infinite.end());
+  }
+  for (b = 0; b < nbox; b++)
+    start[b + 1] += start[b];
+  hit_cells.resize(start[nbox]);
+  std::vector<uint64_t> fill(start.begin(), start.end() - 1);
+  for (k = 0; k < all.size(); k++) {
+    for (std::vector<Hit>::const_iterator h = all[k]->hits.begin(); h != all[k]->hits.end(); h++)
+      hit_cells[fill[h->first]++] = h->second;
+  }
+
+  // Collect the unique vertices for each box. A bitmap over the infos is
+  // used when it has no more words than there are hits, otherwise the hits
+  // are sorted, so sparse infos (e.g. global indices in a leaf) cost
+  // O(k log k) for k hits rather than O(max info).
+  parallel_for_ranges(nbox, nthreads, [&](uint64_t begin, uint64_t end) {
+    std::vector<uint64_t> bits;
+    std::vector<Info> buf;
+    std::vector<Info> hits;
+    for (uint64_t ib = begin; ib < end; ib++) {
+      uint64_t vmax = 0;
+      hits.clear();
+      for (int pass = 0; pass < 2; pass++) {
+        const uint64_t *ic = (pass == 0) ? hit_cells.data() + start[ib] : infinite.data();
+        uint64_t nc = (pass == 0) ? start[ib + 1] - start[ib] : infinite.size();
+        for (uint64_t j = 0; j < nc; j++) {
+          verts(cells[ic[j]], buf);
+          for (typename std::vector<Info>::iterator v = buf.begin(); v != buf.end(); v++)
+            vmax = std::max(vmax, (uint64_t)(*v));
+          hits.insert(hits.end(), buf.begin(), buf.end());
+        }
+      }
+      if (hits.empty())
+        continue;
+      uint64_t nwords = (vmax >> 6) + 1;
+      if (nwords > hits.size()) {
+        std::sort(hits.begin(), hits.end());
+        out[ib].assign(hits.begin(), std::unique(hits.begin(), hits.end()));
+        continue;
+      }
+      if (bits.size() < nwords)
+        bits.resize(nwords, 0);
+      for (typename std::vector<Info>::iterator v = hits.begin(); v != hits.end(); v++)
+        bits[((uint64_t)(*v)) >> 6] |= ((uint64_t)1) << (((uint64_t)(*v)) & 63);
+      for (uint64_t w = 0; w < nwords; w++) {
+        for (uint64_t j = 0; bits[w] != 0; j++) {
+          if (bits[w] & (((uint64_t)1) << j)) {
+            out[ib].push_back((Info)(64*w + j));
+            bits[w] &= ~(((uint64_t)1) << j);
+          }
+        }
+      }
+    }
+  });
+
+  return out;
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Index of each element in a container, in iteration order, looked up
+// from the element's address. CGAL's Compact_container stores elements in
+// a small number of large blocks, so the elements are split into runs that
+// are contiguous in memory and the index of an element is found from the
+// run that contains it without a hash map.
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+
+#ifndef CGAL4PY_CONTAINER_INDEX_HPP
+#define CGAL4PY_CONTAINER_INDEX_HPP
+
+class ContainerIndex
+{
+ public:
+  struct Run {
+    const char *start;
+    uint64_t size;
+    uint64_t first;
+  };
+  uint64_t stride;
+  uint64_t count = 0;
+  // Runs sorted by start address
+  std::vector<Run> runs;
+
+  template <typename Iterator>
+  ContainerIndex(Iterator begin, Iterator end) : stride(sizeof(*begin)) {
+    const char *prev = NULL;
+    const char *p;
+    for (Iterator it = begin; it != end; ++it, ++count) {
+      p = (const char*)(&(*it));
+      if ((prev != NULL) && (p == prev + stride)) {
+        runs.back().size++;
+      } else {
+        Run r = {p, 1, count};
+        runs.push_back(r);
+      }
+      prev = p;
+    }
+    std::sort(runs.begin(), runs.end(), [](const Run &a, const Run &b) {
+        return std::less<const char*>()(a.start, b.start);
+      });
+  }
+
+  // Index of the element at p, or count if p is not in the container.
+  uint64_t index_of(const char *p) const {
+    std::vector<Run>::const_iterator r;
+    r = std::upper_bound(runs.begin(), runs.end(), p,
+                         [](const char *x, const Run &a) {
+                           return std::less<const char*>()(x, a.start);
+                         });
+    if (r == runs.begin())
+      return count;
+    r--;
+    uint64_t off = (uint64_t)(p - r->start);
+    if ((off % stride) || ((off / stride) >= r->size))
+      return count;
+    return r->first + off / stride;
+  }
+  template <typename Handle>
+  uint64_t index(Handle h) const {
+    return index_of((const char*)(&(*h)));
+  }
+};
+
+#endif
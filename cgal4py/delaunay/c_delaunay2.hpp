@@ -12,6 +12,8 @@
 #include <algorithm>
 #include <limits>
 #include <stdint.h>
+#include "c_vertex_index.hpp"
+#include "c_box_index.hpp"
 #ifdef READTHEDOCS
 #define VALID 1
 #include "dummy_CGAL.hpp"
@@ -22,6 +24,9 @@
 #include <CGAL/Triangulation_vertex_base_with_info_2.h>
 #include <CGAL/squared_distance_2.h>
 #include <CGAL/Unique_hash_map.h>
+#include <CGAL/spatial_sort.h>
+#include <CGAL/Spatial_sort_traits_adapter_2.h>
+#include <CGAL/property_map.h>
 #endif
 
 typedef CGAL::Exact_predicates_inexact_constructions_kernel         K2;
@@ -145,29 +150,144 @@ public:
       j = 2*i;
       points.push_back( std::make_pair( Point(pts[j],pts[j+1]), val[i]) );
     }
+    if ((incremental_volumes && volume_cache_valid) || vertex_index.live()) {
+      insert_tracked(points);
+      return;
+    }
+    vertex_index.invalidate();
     T.insert( points.begin(),points.end() );
   }
-  void remove(Vertex v) { updated = true; T.remove(v._x); }
-  void clear() { updated = true; T.clear(); }
+  // Insert points one at a time in spatial order so that the vertices
+  // around each new vertex can be marked for area updates and the new
+  // vertices can be added to the vertex index.
+  void insert_tracked(std::vector< std::pair<Point,Info> > &points)
+  {
+    typedef CGAL::Spatial_sort_traits_adapter_2<K2,
+      CGAL::First_of_pair_property_map< std::pair<Point,Info> > > Sort_traits;
+    CGAL::spatial_sort(points.begin(), points.end(), Sort_traits());
+    Face_handle hint;
+    Vertex_handle v;
+    std::size_t nverts = T.number_of_vertices();
+    bool existed;
+    for (typename std::vector< std::pair<Point,Info> >::iterator it = points.begin(); it != points.end(); ++it) {
+      v = T.insert(it->first, hint);
+      existed = (T.number_of_vertices() == nverts);
+      nverts = T.number_of_vertices();
+      vertex_index.inserted(it->second, v, existed,
+                            existed ? v->info() : it->second);
+      v->info() = it->second;
+      hint = v->face();
+      mark_volumes(v);
+    }
+  }
+  void remove(Vertex v) {
+    updated = true;
+    vertex_index.erase(v._x->info());
+    mark_volumes_removed(v._x);
+    T.remove(v._x);
+  }
+  void clear() {
+    updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
+    T.clear();
+  }
 
   Vertex move(Vertex v, double *pos) {
     updated = true;
+    Info info = v._x->info();
     Point p = Point(pos[0], pos[1]);
-    return Vertex(T.move(v._x, p));
+    mark_volumes_removed(v._x);
+    Vertex_handle out = T.move(v._x, p);
+    moved_vertex_index(info, out);
+    mark_volumes(out);
+    return Vertex(out);
   }
   Vertex move_if_no_collision(Vertex v, double *pos) {
     updated = true;
+    Info info = v._x->info();
     Point p = Point(pos[0], pos[1]);
-    return Vertex(T.move_if_no_collision(v._x, p));
+    if (incremental_volumes && volume_cache_valid) {
+      // v is only removed if it does not collide
+      int li;
+      Locate_type lt = Locate_type(0);
+      Face_handle f = T.locate(p, lt, li, v._x->face());
+      if (lt == Delaunay::VERTEX)
+        return Vertex(f->vertex(li));
+    }
+    mark_volumes_removed(v._x);
+    Vertex_handle out = T.move_if_no_collision(v._x, p);
+    moved_vertex_index(info, out);
+    mark_volumes(out);
+    return Vertex(out);
   }
 
-  Vertex get_vertex(Info index) const {
+  // Opt-in cache of the Voronoi areas. While the cache is valid,
+  // operations that change the triangulation record the vertices whose
+  // cells they touch so that dual_areas only recomputes those.
+  bool incremental_volumes = false;
+  mutable bool volume_cache_valid = false;
+  mutable std::vector<double> volume_cache;
+  mutable std::set<Vertex_handle> volume_dirty;
+  void set_incremental_volumes(bool enable) {
+    incremental_volumes = enable;
+    volume_cache_valid = false;
+    volume_cache.clear();
+    volume_dirty.clear();
+  }
+  // Mark the areas of v and its neighbors for recomputation.
+  void mark_volumes(Vertex_handle v) {
+    if (!(incremental_volumes && volume_cache_valid) || T.is_infinite(v))
+      return;
+    volume_dirty.insert(v);
+    Vertex_circulator vc = T.incident_vertices(v), done(vc);
+    if (vc == 0)
+      return;
+    do {
+      Vertex_handle w = static_cast<Vertex_handle>(vc);
+      if (!T.is_infinite(w))
+        volume_dirty.insert(w);
+    } while (++vc != done);
+  }
+  void mark_volumes(Face_handle f) {
+    for (int i = 0; i < 3; i++)
+      mark_volumes(f->vertex(i));
+  }
+  // Mark the neighbors of a vertex that is about to be removed.
+  void mark_volumes_removed(Vertex_handle v) {
+    mark_volumes(v);
+    volume_dirty.erase(v);
+  }
+
+  // Lookup table from info to vertex (see c_vertex_index.hpp), kept up to
+  // date as vertices are added, removed, or moved while it is enabled.
+  mutable VertexIndex<Info, Vertex_handle> vertex_index;
+  template <typename F>
+  void visit_vertices(F f) const {
     Finite_vertices_iterator it = T.finite_vertices_begin();
     for ( ; it != T.finite_vertices_end(); it++) {
-      if (it->info() == index)
-    	return Vertex(static_cast<Vertex_handle>(it));
+      if (f(it->info(), static_cast<Vertex_handle>(it)))
+        return;
     }
-    return Vertex(T.infinite_vertex());
+  }
+  VertexVisitor<const Delaunay_with_info_2> vertex_visitor() const {
+    return VertexVisitor<const Delaunay_with_info_2>(this);
+  }
+  void set_vertex_index(bool enable) { vertex_index.enable(enable); }
+  void moved_vertex_index(Info info, Vertex_handle out) {
+    vertex_index.moved(info, out, out->info());
+  }
+
+  Vertex get_vertex(Info index) const {
+    Vertex_handle v = T.infinite_vertex();
+    vertex_index.find(index, vertex_visitor(), T.number_of_vertices(), v);
+    return Vertex(v);
+  }
+  std::vector<Vertex> get_vertices(Info *index, uint64_t n) const {
+    std::vector<Vertex_handle> v = vertex_index.find_many(
+        index, n, vertex_visitor(), T.number_of_vertices(),
+        T.infinite_vertex());
+    return std::vector<Vertex>(v.begin(), v.end());
   }
 
   Cell locate(double* pos, int& lt, int& li) const {
@@ -550,6 +670,35 @@ public:
   }
 
   void dual_areas(double* vols) const {
+    if (incremental_volumes) {
+      update_volume_cache();
+      for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++)
+        vols[it->info()] = volume_cache[it->info()];
+      return;
+    }
+    compute_dual_areas(vols);
+  }
+  // Recompute the cached areas of the vertices marked since the last
+  // update, or all of them if the cache is not valid.
+  void update_volume_cache() const {
+    if (volume_cache_valid) {
+      for (typename std::set<Vertex_handle>::iterator it = volume_dirty.begin(); it != volume_dirty.end(); it++) {
+        if ((std::size_t)((*it)->info()) >= volume_cache.size())
+          volume_cache.resize((std::size_t)((*it)->info()) + 1, -1.0);
+        volume_cache[(*it)->info()] = dual_area(Vertex(*it));
+      }
+    } else {
+      std::size_t nvols = 0;
+      for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++)
+        nvols = std::max(nvols, (std::size_t)(it->info()) + 1);
+      volume_cache.assign(nvols, -1.0);
+      if (nvols > 0)
+        compute_dual_areas(&volume_cache[0]);
+      volume_cache_valid = true;
+    }
+    volume_dirty.clear();
+  }
+  void compute_dual_areas(double* vols) const {
     Finite_vertices_iterator it = T.finite_vertices_begin();
     for ( ; it != T.finite_vertices_end(); it++) {
       vols[it->info()] = dual_area(Vertex(it));
@@ -594,21 +743,25 @@ public:
 
   bool flip(Cell x, int i) { 
     updated = true;
+    mark_volumes(x._x);
     T.flip(x._x, i); 
     return true;
   }
   bool flip(Edge x) {
     updated = true;
+    mark_volumes(x.cell()._x);
     T.flip(x.cell()._x, x.ind());
     return true;
   }
   // for completeness with 3D case
   void flip_flippable(Cell x, int i) { 
     updated = true;
+    mark_volumes(x._x);
     T.flip(x._x, i); 
   }
   void flip_flippable(Edge x) { 
     updated = true;
+    mark_volumes(x.cell()._x);
     T.flip(x.cell()._x, x.ind()); 
   }
 
@@ -760,6 +913,8 @@ public:
   void read_from_buffer(std::ifstream &is) {
 
     updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
 
     if (T.number_of_vertices() != 0) 
       T.clear();
@@ -1020,6 +1175,8 @@ public:
 		   I* faces, I* neighbors, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
 
     T.clear();
     if (T.number_of_vertices() != 0) 
@@ -1101,6 +1258,8 @@ public:
 			   I* faces, I* neighbors, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
 
     T.clear();
     if (T.number_of_vertices() != 0) 
@@ -1231,44 +1390,28 @@ public:
   std::vector<std::vector<Info>> outgoing_points(uint64_t nbox,
 						 double *left_edges, 
 						 double *right_edges) const {
-    std::vector<std::vector<Info>> out;
-    uint64_t b;
-    for (b = 0; b < nbox; b++) 
-      out.push_back(std::vector<Info>());
-
-    Vertex_handle v;
-    Point cc, p1;
-    double cr;
-    int i, iinf = 0;
-
-    for (All_faces_iterator it = T.all_faces_begin(); it != T.all_faces_end(); it++) {
-      if (T.is_infinite(it) == true) {
-	// Find index of infinite vertex
-	for (i = 0; i < 3; i++) {
-	  v = it->vertex(i);
-	  if (T.is_infinite(v)) {
-	    iinf = i;
-	    break;
-	  }
-	}
-	for (b = 0; b < nbox; b++)
-	  for (i = 1; i < 3; i++) out[b].push_back((it->vertex((iinf+i)%3))->info());
-      } else {
-        p1 = it->vertex(0)->point();
-        cc = T.circumcenter(it);
-        cr = std::sqrt(static_cast<double>(CGAL::squared_distance(p1, cc)));
-	for (b = 0; b < nbox; b++) {
-	  if (intersect_sph_box(&cc, cr, left_edges + 2*b, right_edges + 2*b))
-	    for (i = 0; i < 3; i++) out[b].push_back((it->vertex(i))->info());
-	}
-      }
-    }
-    for (b = 0; b < nbox; b++) {
-      std::sort( out[b].begin(), out[b].end() ); 
-      out[b].erase( std::unique( out[b].begin(), out[b].end() ), out[b].end() );
-    }
-
-    return out;
+    std::vector<Face_handle> faces;
+    faces.reserve(T.number_of_faces());
+    for (All_faces_iterator it = T.all_faces_begin(); it != T.all_faces_end(); it++)
+      faces.push_back(it);
+    return outgoing_points_boxes<Info>(
+        2, nbox, left_edges, right_edges, faces,
+        [this](const Face_handle &f, double *cc, double &cr) {
+          if (T.is_infinite(f))
+            return false;
+          Point p = T.circumcenter(f);
+          cc[0] = p.x();
+          cc[1] = p.y();
+          cr = std::sqrt(static_cast<double>(CGAL::squared_distance(f->vertex(0)->point(), p)));
+          return true;
+        },
+        [this](const Face_handle &f, std::vector<Info> &buf) {
+          buf.clear();
+          for (int i = 0; i < 3; i++) {
+            if (!T.is_infinite(f->vertex(i)))
+              buf.push_back(f->vertex(i)->info());
+          }
+        });
   }
 
   void boundary_points(double *left_edge, double *right_edge, bool periodic,
@@ -13,6 +13,11 @@
 #include <algorithm>
 #include <limits>
 #include <stdint.h>
+#include "c_tools.hpp"
+#include "c_vertex_index.hpp"
+#include "c_box_index.hpp"
+#include "c_dual_volume.hpp"
+#include "c_container_index.hpp"
 #ifdef READTHEDOCS
 #define VALID 1
 #include "dummy_CGAL.hpp"
@@ -29,6 +34,16 @@
 #include <CGAL/Triangulation_vertex_base_with_info_3.h>
 #include <CGAL/squared_distance_3.h>
 #include <CGAL/Unique_hash_map.h>
+#include <CGAL/spatial_sort.h>
+#include <CGAL/Spatial_sort_traits_adapter_3.h>
+#include <CGAL/hilbert_sort.h>
+#include <CGAL/property_map.h>
+#ifdef CGAL_LINKED_WITH_TBB
+#include <tbb/task_arena.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#endif
 #endif
 
 typedef CGAL::Exact_predicates_inexact_constructions_kernel            K3;
@@ -42,7 +57,16 @@ template <typename Info_>
 class Delaunay_with_info_3
 {
  public:
-  typedef CGAL::Delaunay_triangulation_3<K3, CGAL::Triangulation_data_structure_3<CGAL::Triangulation_vertex_base_with_info_3<Info_, K3>, Cb3>> Delaunay;
+  typedef CGAL::Triangulation_vertex_base_with_info_3<Info_, K3>      Vb;
+#ifdef CGAL_LINKED_WITH_TBB
+  // Concurrent containers allow insert to run on several threads when a
+  // lock data structure is provided (see insert_parallel). Without one,
+  // all operations are sequential.
+  typedef CGAL::Triangulation_data_structure_3<Vb, Cb3, CGAL::Parallel_tag> Tds;
+#else
+  typedef CGAL::Triangulation_data_structure_3<Vb, Cb3>                   Tds;
+#endif
+  typedef CGAL::Delaunay_triangulation_3<K3, Tds>      Delaunay;
   typedef typename Delaunay::Point                     Point;
   typedef typename Delaunay::Vertex_handle             Vertex_handle;
   typedef typename Delaunay::Edge                      Edge_handle;  // not really a handle, just for disambiguation
@@ -69,6 +93,8 @@ class Delaunay_with_info_3
   typedef Info_ Info;
   Delaunay T;
   bool updated = false;
+  // Number of threads used by insert. Ignored if CGAL is not linked with TBB.
+  int nthreads = 1;
   Delaunay_with_info_3() {};
   Delaunay_with_info_3(double *pts, Info *val, uint32_t n) { insert(pts, val, n); }
   bool is_valid() const { return T.is_valid(); }
@@ -123,29 +149,166 @@ class Delaunay_with_info_3
       j = 3*i;
       points.push_back( std::make_pair( Point(pts[j],pts[j+1],pts[j+2]), val[i]) );
     }
+    if ((incremental_volumes && volume_cache_valid) ||
+        (vertex_index.live() && (nthreads <= 1))) {
+      insert_tracked(points);
+      return;
+    }
+    vertex_index.invalidate();
+#ifdef CGAL_LINKED_WITH_TBB
+    if (nthreads > 1) {
+      insert_parallel(points);
+      return;
+    }
+#endif
     T.insert( points.begin(),points.end() );
   }
-  void remove(Vertex v) { updated = true; T.remove(v._x); }
-  void clear() { updated = true; T.clear(); }
+#ifdef CGAL_LINKED_WITH_TBB
+  // Insert on nthreads threads. Threads lock the regions they modify
+  // through a grid over the bounding box of the new and existing points.
+  void insert_parallel(std::vector< std::pair<Point,Info> > &points)
+  {
+    typedef typename Delaunay::Lock_data_structure Lock_data_structure;
+    if (points.empty())
+      return;
+    CGAL::Bbox_3 bbox = points[0].first.bbox();
+    for (typename std::vector< std::pair<Point,Info> >::iterator it = points.begin(); it != points.end(); ++it)
+      bbox = bbox + it->first.bbox();
+    for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); ++it)
+      bbox = bbox + it->point().bbox();
+    Lock_data_structure locks(bbox, 50);
+    T.set_lock_data_structure(&locks);
+    tbb::task_arena arena(nthreads);
+    arena.execute([&]() { T.insert( points.begin(),points.end() ); });
+    T.set_lock_data_structure(NULL);
+  }
+#endif
+  // Insert points one at a time in spatial order so that the vertices
+  // around each new vertex can be marked for volume updates and the new
+  // vertices can be added to the vertex index.
+  void insert_tracked(std::vector< std::pair<Point,Info> > &points)
+  {
+    typedef CGAL::Spatial_sort_traits_adapter_3<K3,
+      CGAL::First_of_pair_property_map< std::pair<Point,Info> > > Sort_traits;
+    CGAL::spatial_sort(points.begin(), points.end(), Sort_traits());
+    Cell_handle hint;
+    Vertex_handle v;
+    std::size_t nverts = T.number_of_vertices();
+    bool existed;
+    for (typename std::vector< std::pair<Point,Info> >::iterator it = points.begin(); it != points.end(); ++it) {
+      v = T.insert(it->first, hint);
+      existed = (T.number_of_vertices() == nverts);
+      nverts = T.number_of_vertices();
+      vertex_index.inserted(it->second, v, existed,
+                            existed ? v->info() : it->second);
+      v->info() = it->second;
+      hint = v->cell();
+      mark_volumes(v);
+    }
+  }
+  void remove(Vertex v) {
+    updated = true;
+    vertex_index.erase(v._x->info());
+    mark_volumes_removed(v._x);
+    T.remove(v._x);
+  }
+  void clear() {
+    updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
+    T.clear();
+  }
 
   Vertex move(Vertex v, double *pos) {
     updated = true;
+    Info info = v._x->info();
     Point p = Point(pos[0], pos[1], pos[2]);
-    return Vertex(T.move(v._x, p));
+    mark_volumes_removed(v._x);
+    Vertex_handle out = T.move(v._x, p);
+    moved_vertex_index(info, out);
+    mark_volumes(out);
+    return Vertex(out);
   }
   Vertex move_if_no_collision(Vertex v, double *pos) {
     updated = true;
+    Info info = v._x->info();
     Point p = Point(pos[0], pos[1], pos[2]);
-    return Vertex(T.move_if_no_collision(v._x, p));
+    if (incremental_volumes && volume_cache_valid) {
+      // v is only removed if it does not collide
+      int li, lj;
+      Locate_type lt = Locate_type(0);
+      Cell_handle c = T.locate(p, lt, li, lj, v._x->cell());
+      if (lt == Delaunay::VERTEX)
+        return Vertex(c->vertex(li));
+    }
+    mark_volumes_removed(v._x);
+    Vertex_handle out = T.move_if_no_collision(v._x, p);
+    moved_vertex_index(info, out);
+    mark_volumes(out);
+    return Vertex(out);
   }
 
-  Vertex get_vertex(Info index) const {
+  // Opt-in cache of the Voronoi volumes. While the cache is valid,
+  // operations that change the triangulation record the vertices whose
+  // cells they touch so that dual_volumes only recomputes those.
+  bool incremental_volumes = false;
+  mutable bool volume_cache_valid = false;
+  mutable std::vector<double> volume_cache;
+  mutable std::set<Vertex_handle> volume_dirty;
+  void set_incremental_volumes(bool enable) {
+    incremental_volumes = enable;
+    volume_cache_valid = false;
+    volume_cache.clear();
+    volume_dirty.clear();
+  }
+  // Mark the volumes of v and its neighbors for recomputation.
+  void mark_volumes(Vertex_handle v) {
+    if (!(incremental_volumes && volume_cache_valid) || T.is_infinite(v))
+      return;
+    std::vector<Vertex_handle> adj;
+    T.finite_adjacent_vertices(v, std::back_inserter(adj));
+    volume_dirty.insert(v);
+    volume_dirty.insert(adj.begin(), adj.end());
+  }
+  void mark_volumes(Cell_handle c) {
+    for (int i = 0; i < 4; i++)
+      mark_volumes(c->vertex(i));
+  }
+  // Mark the neighbors of a vertex that is about to be removed.
+  void mark_volumes_removed(Vertex_handle v) {
+    mark_volumes(v);
+    volume_dirty.erase(v);
+  }
+
+  // Lookup table from info to vertex (see c_vertex_index.hpp), kept up to
+  // date as vertices are added, removed, or moved while it is enabled.
+  mutable VertexIndex<Info, Vertex_handle> vertex_index;
+  template <typename F>
+  void visit_vertices(F f) const {
     Finite_vertices_iterator it = T.finite_vertices_begin();
     for ( ; it != T.finite_vertices_end(); it++) {
-      if (it->info() == index)
-        return Vertex(static_cast<Vertex_handle>(it));
+      if (f(it->info(), static_cast<Vertex_handle>(it)))
+        return;
     }
-    return Vertex(T.infinite_vertex());
+  }
+  VertexVisitor<const Delaunay_with_info_3> vertex_visitor() const {
+    return VertexVisitor<const Delaunay_with_info_3>(this);
+  }
+  void set_vertex_index(bool enable) { vertex_index.enable(enable); }
+  void moved_vertex_index(Info info, Vertex_handle out) {
+    vertex_index.moved(info, out, out->info());
+  }
+
+  Vertex get_vertex(Info index) const {
+    Vertex_handle v = T.infinite_vertex();
+    vertex_index.find(index, vertex_visitor(), T.number_of_vertices(), v);
+    return Vertex(v);
+  }
+  std::vector<Vertex> get_vertices(Info *index, uint64_t n) const {
+    std::vector<Vertex_handle> v = vertex_index.find_many(
+        index, n, vertex_visitor(), T.number_of_vertices(),
+        T.infinite_vertex());
+    return std::vector<Vertex>(v.begin(), v.end());
   }
 
   Cell locate(double* pos, int& lt, int& li, int& lj) const {
@@ -163,6 +326,48 @@ class Delaunay_with_info_3
     return out;
   }
 
+  // Order for a batch of queries along a Hilbert curve so that consecutive
+  // queries are close and each walk can start where the last one ended.
+  void hilbert_order(double* pos, uint64_t n, std::vector<Point> &points,
+                     std::vector<std::size_t> &order) const {
+    typedef CGAL::Spatial_sort_traits_adapter_3<K3,
+      typename CGAL::Pointer_property_map<Point>::type> Sort_traits;
+    uint64_t i;
+    points.reserve(n);
+    order.reserve(n);
+    for (i = 0; i < n; i++) {
+      points.push_back(Point(pos[3*i], pos[3*i+1], pos[3*i+2]));
+      order.push_back(i);
+    }
+    CGAL::hilbert_sort(order.begin(), order.end(),
+                       Sort_traits(CGAL::make_property_map(points)));
+  }
+  // Locate n points. For each point, cells receives the infos of the 4
+  // vertices of the containing cell (the maximum Info value for the
+  // infinite vertex) and lt, li, and lj are set as in locate.
+  void locate_many(double* pos, uint64_t n, Info* cells,
+                   int* lt, int* li, int* lj) const {
+    std::vector<Point> points;
+    std::vector<std::size_t> order;
+    hilbert_order(pos, n, points, order);
+    const Info idx_inf = std::numeric_limits<Info>::max();
+    parallel_for_ranges(order.size(), nthreads, [&](std::size_t begin, std::size_t end) {
+      Cell_handle c;
+      Locate_type lt_out = Locate_type(0);
+      for (std::size_t k = begin; k < end; k++) {
+        std::size_t i = order[k];
+        c = T.locate(points[i], lt_out, li[i], lj[i], c);
+        lt[i] = (int)lt_out;
+        for (int v = 0; v < 4; v++) {
+          if (T.is_infinite(c->vertex(v)))
+            cells[4*i+v] = idx_inf;
+          else
+            cells[4*i+v] = c->vertex(v)->info();
+        }
+      }
+    });
+  }
+
   template <typename Wrap, typename Wrap_handle>
   class wrap_insert_iterator
   {
@@ -619,6 +824,28 @@ class Delaunay_with_info_3
     Vertex out = Vertex(T.nearest_vertex(p));
     return out;
   }
+  // Find the info of the vertex nearest to each of n points (the maximum
+  // Info value if the triangulation is empty).
+  void nearest_vertex_many(double* pos, uint64_t n, Info* verts) const {
+    std::vector<Point> points;
+    std::vector<std::size_t> order;
+    hilbert_order(pos, n, points, order);
+    const Info idx_inf = std::numeric_limits<Info>::max();
+    parallel_for_ranges(order.size(), nthreads, [&](std::size_t begin, std::size_t end) {
+      Cell_handle c;
+      Vertex_handle v;
+      for (std::size_t k = begin; k < end; k++) {
+        std::size_t i = order[k];
+        v = T.nearest_vertex(points[i], c);
+        if (T.is_infinite(v)) {
+          verts[i] = idx_inf;
+        } else {
+          verts[i] = v->info();
+          c = v->cell();
+        }
+      }
+    });
+  }
 
   Facet mirror_facet(Facet x) const { return Facet(T.mirror_facet(x._x)); }
   int mirror_index(Cell x, int i) const { return T.mirror_index(x._x, i); }
@@ -663,11 +890,103 @@ class Delaunay_with_info_3
     return vol;
   }
 
+  // Add the part of the Voronoi cell of each vertex that lies within a
+  // finite cell to vols (see cell_dual_volumes_3 in c_dual_volume.hpp).
+  void add_cell_dual_volumes(Cell_handle c, double *vols) const {
+    double p[12];
+    double out[4] = {0.0, 0.0, 0.0, 0.0};
+    int i;
+    for (i = 0; i < 4; i++) {
+      const Point &q = c->vertex(i)->point();
+      p[3*i + 0] = q.x();
+      p[3*i + 1] = q.y();
+      p[3*i + 2] = q.z();
+    }
+    cell_dual_volumes_3(p, out);
+    for (i = 0; i < 4; i++)
+      vols[c->vertex(i)->info()] += out[i];
+  }
+
   void dual_volumes(double *vols) const {
-    for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++) {
-      vols[it->info()] = dual_volume(Vertex(it));
-    }    
+    if (incremental_volumes) {
+      update_volume_cache();
+      for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++)
+        vols[it->info()] = volume_cache[it->info()];
+      return;
+    }
+    compute_dual_volumes(vols);
   }
+  // Recompute the cached volumes of the vertices marked since the last
+  // update, or all of them if the cache is not valid.
+  void update_volume_cache() const {
+    if (volume_cache_valid) {
+      for (typename std::set<Vertex_handle>::iterator it = volume_dirty.begin(); it != volume_dirty.end(); it++) {
+        if ((std::size_t)((*it)->info()) >= volume_cache.size())
+          volume_cache.resize((std::size_t)((*it)->info()) + 1, -1.0);
+        volume_cache[(*it)->info()] = dual_volume(Vertex(*it));
+      }
+    } else {
+      std::size_t nvols = 0;
+      for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++)
+        nvols = std::max(nvols, (std::size_t)(it->info()) + 1);
+      volume_cache.assign(nvols, -1.0);
+      if (nvols > 0)
+        compute_dual_volumes(&volume_cache[0]);
+      volume_cache_valid = true;
+    }
+    volume_dirty.clear();
+  }
+  // Voronoi volumes from one pass over the finite cells. Vertices on the
+  // convex hull have unbounded cells and are assigned -1.
+  void compute_dual_volumes(double *vols) const {
+    for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++)
+      vols[it->info()] = 0.0;
+#ifdef CGAL_LINKED_WITH_TBB
+    if (nthreads > 1)
+      dual_volumes_parallel(vols);
+    else
+#endif
+    for (Finite_cells_iterator it = T.finite_cells_begin(); it != T.finite_cells_end(); it++)
+      add_cell_dual_volumes(it, vols);
+    for (All_cells_iterator it = T.all_cells_begin(); it != T.all_cells_end(); it++) {
+      if (!T.is_infinite(it))
+        continue;
+      for (int i = 0; i < 4; i++) {
+        if (!T.is_infinite(it->vertex(i)))
+          vols[it->vertex(i)->info()] = -1.0;
+      }
+    }
+  }
+#ifdef CGAL_LINKED_WITH_TBB
+  // Cells are split between nthreads threads that each sum into their own
+  // copy of the volumes.
+  void dual_volumes_parallel(double *vols) const {
+    std::vector<Cell_handle> cells;
+    cells.reserve(T.number_of_finite_cells());
+    for (Finite_cells_iterator it = T.finite_cells_begin(); it != T.finite_cells_end(); it++)
+      cells.push_back(it);
+    if (cells.empty())
+      return;
+    std::size_t nvols = 0;
+    for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++)
+      nvols = std::max(nvols, (std::size_t)(it->info()) + 1);
+    tbb::enumerable_thread_specific< std::vector<double> > local(std::vector<double>(nvols, 0.0));
+    tbb::task_arena arena(nthreads);
+    arena.execute([&]() {
+      tbb::parallel_for(tbb::blocked_range<std::size_t>(0, cells.size()),
+                        [&](const tbb::blocked_range<std::size_t> &r) {
+        double *acc = &(local.local()[0]);
+        for (std::size_t i = r.begin(); i != r.end(); i++)
+          add_cell_dual_volumes(cells[i], acc);
+      });
+    });
+    typename tbb::enumerable_thread_specific< std::vector<double> >::const_iterator lit;
+    for (lit = local.begin(); lit != local.end(); lit++) {
+      for (Finite_vertices_iterator it = T.finite_vertices_begin(); it != T.finite_vertices_end(); it++)
+        vols[it->info()] += (*lit)[it->info()];
+    }
+  }
+#endif
 
   bool is_boundary_cell(const Cell c) const {
     if (T.is_infinite(c._x))
@@ -705,14 +1024,14 @@ class Delaunay_with_info_3
     return out;
   }
 
-  bool flip(Cell x, int i, int j) { updated = true; return T.flip(x._x, i, j); }
-  bool flip(Edge x) { updated = true; return T.flip(x.cell()._x, x.ind1(), x.ind2()); }
-  bool flip(Cell x, int i) { updated = true; return T.flip(x._x, i); }
-  bool flip(Facet x) { updated = true; return T.flip(x.cell()._x, x.ind()); }
-  void flip_flippable(Cell x, int i, int j) { updated = true; T.flip_flippable(x._x, i, j); }
-  void flip_flippable(Edge x) { updated = true; T.flip_flippable(x.cell()._x, x.ind1(), x.ind2()); }
-  void flip_flippable(Cell x, int i) { updated = true; T.flip_flippable(x._x, i); }
-  void flip_flippable(Facet x) { updated = true; T.flip_flippable(x.cell()._x, x.ind()); }
+  bool flip(Cell x, int i, int j) { updated = true; mark_volumes(x._x); return T.flip(x._x, i, j); }
+  bool flip(Edge x) { updated = true; mark_volumes(x.cell()._x); return T.flip(x.cell()._x, x.ind1(), x.ind2()); }
+  bool flip(Cell x, int i) { updated = true; mark_volumes(x._x); return T.flip(x._x, i); }
+  bool flip(Facet x) { updated = true; mark_volumes(x.cell()._x); return T.flip(x.cell()._x, x.ind()); }
+  void flip_flippable(Cell x, int i, int j) { updated = true; mark_volumes(x._x); T.flip_flippable(x._x, i, j); }
+  void flip_flippable(Edge x) { updated = true; mark_volumes(x.cell()._x); T.flip_flippable(x.cell()._x, x.ind1(), x.ind2()); }
+  void flip_flippable(Cell x, int i) { updated = true; mark_volumes(x._x); T.flip_flippable(x._x, i); }
+  void flip_flippable(Facet x) { updated = true; mark_volumes(x.cell()._x); T.flip_flippable(x.cell()._x, x.ind()); }
 
   std::pair<std::vector<Cell>,std::vector<Facet>>
     find_conflicts(double* pos, Cell start) const {
@@ -804,69 +1123,75 @@ class Delaunay_with_info_3
   }
 
   void write_to_buffer(std::ofstream &os) const {
-    // Header
-    int n = static_cast<int>(T.number_of_vertices());
-    int m = static_cast<int>(T.tds().number_of_cells());
-    int d = static_cast<int>(T.dimension());
-    os.write((char*)&n, sizeof(int));
-    os.write((char*)&m, sizeof(int));
-    os.write((char*)&d, sizeof(int));
-    if (n==0) {
+    // Header. The first value is negative to distinguish this format from
+    // the older one, which wrote each element separately and started with
+    // the number of vertices.
+    int32_t format = -1;
+    int32_t d = static_cast<int32_t>(T.dimension());
+    uint64_t n = static_cast<uint64_t>(T.number_of_vertices());
+    uint64_t m = static_cast<uint64_t>(T.tds().number_of_cells());
+    uint32_t info_size = sizeof(Info);
+    uint32_t idx_size = sizeof(uint32_t);
+    if ((n >= std::numeric_limits<uint32_t>::max()) ||
+        (m >= std::numeric_limits<uint32_t>::max()))
+      idx_size = sizeof(uint64_t);
+    os.write((char*)&format, sizeof(int32_t));
+    os.write((char*)&d, sizeof(int32_t));
+    os.write((char*)&info_size, sizeof(uint32_t));
+    os.write((char*)&idx_size, sizeof(uint32_t));
+    os.write((char*)&n, sizeof(uint64_t));
+    os.write((char*)&m, sizeof(uint64_t));
+    if (n == 0)
       return;
+    if (idx_size == sizeof(uint32_t))
+      write_arrays<uint32_t>(os, n, m, d);
+    else
+      write_arrays<uint64_t>(os, n, m, d);
+  }
+
+  // Write positions, infos, cell vertices and cell neighbors as
+  // contiguous arrays. Finite vertices are numbered in container order and
+  // the infinite vertex is n. Cells are numbered in container order.
+  template <typename I>
+  void write_arrays(std::ofstream &os, uint64_t n, uint64_t m, int32_t d) const {
+    ContainerIndex V(T.tds().vertices_begin(), T.tds().vertices_end());
+    ContainerIndex C(T.tds().cells_begin(), T.tds().cells_end());
+    uint64_t inf = V.index(T.infinite_vertex());
+    uint64_t i, k;
+    int j, dim = d + 1;
+
+    std::vector<double> pos(3*n);
+    std::vector<Info> info(n);
+    i = 0;
+    for (All_vertices_iterator vit = T.tds().vertices_begin(); vit != T.tds().vertices_end(); ++vit) {
+      if (T.is_infinite(vit))
+        continue;
+      pos[3*i + 0] = static_cast<double>(vit->point().x());
+      pos[3*i + 1] = static_cast<double>(vit->point().y());
+      pos[3*i + 2] = static_cast<double>(vit->point().z());
+      info[i] = static_cast<Info>(vit->info());
+      i++;
     }
-    // printf("Wrote %d vertices, %d cells, for %d dimensions\n",n,m,d);
-    
-    Vertex_hash V;
-    Cell_hash C;
-    
-    // first (infinite) vertex 
-    int inum = 0;
-    Vertex_handle v = T.infinite_vertex();
-    if ( v != Vertex_handle()) {
-      V[v] = inum++;
-    }
-    
-    // other vertices
-    Info info;
-    double x, y, z;
-    for( All_vertices_iterator vit = T.tds().vertices_begin(); vit != T.tds().vertices_end() ; ++vit) {
-      if ( v != vit ) {
-	V[vit] = inum++;
-	info = static_cast<Info>(vit->info());
-	x = static_cast<double>(vit->point().x());
-	y = static_cast<double>(vit->point().y());
-	z = static_cast<double>(vit->point().z());
-	os.write((char*)&info, sizeof(Info));
-	os.write((char*)&x, sizeof(double));
-	os.write((char*)&y, sizeof(double));
-	os.write((char*)&z, sizeof(double));
-      }
-    }
-    // printf("%d nverts, %d inum\n",T.number_of_vertices(),inum);
-    
-    // vertices of the cells
-    inum = 0;
-    int dim = (d == -1 ? 1 :  d + 1);
-    int index;
-    for( Cell_iterator ib = T.tds().cells_begin(); 
-	 ib != T.tds().cells_end(); ++ib) {
-      C[ib] = inum++;
-      for(int j = 0; j < dim ; ++j) {
-	index = V[ib->vertex(j)];
-	os.write((char*)&index, sizeof(int));
-      }
-    }
-    // printf("%d ncells, %d inum\n",T.tds().number_of_cells(),inum);
-    
-    // neighbor pointers of the cells
-    for( Cell_iterator it = T.tds().cells_begin();
-	 it != T.tds().cells_end(); ++it) {
-      for(int j = 0; j < d+1; ++j){
-	index = C[it->neighbor(j)];
-	os.write((char*)&index, sizeof(int));
+
+    std::vector<I> verts(dim*m);
+    std::vector<I> neigh(dim*m);
+    i = 0;
+    for (All_cells_iterator cit = T.tds().cells_begin(); cit != T.tds().cells_end(); ++cit, ++i) {
+      for (j = 0; j < dim; j++) {
+        k = V.index(cit->vertex(j));
+        if (k == inf)
+          k = n;
+        else if (k > inf)
+          k--;
+        verts[dim*i + j] = static_cast<I>(k);
+        neigh[dim*i + j] = static_cast<I>(C.index(cit->neighbor(j)));
       }
     }
 
+    os.write((char*)pos.data(), pos.size()*sizeof(double));
+    os.write((char*)info.data(), info.size()*sizeof(Info));
+    os.write((char*)verts.data(), verts.size()*sizeof(I));
+    os.write((char*)neigh.data(), neigh.size()*sizeof(I));
   }
 
 
@@ -883,12 +1208,91 @@ class Delaunay_with_info_3
   void read_from_buffer(std::ifstream &is) {
     
     updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
     if (T.number_of_vertices() != 0)  
       T.clear();
     
     // header
-    int n, m, d;
-    is.read((char*)&n, sizeof(int));
+    int32_t format;
+    is.read((char*)&format, sizeof(int32_t));
+    if (format >= 0) {
+      read_elements(is, format);
+      return;
+    }
+    int32_t d;
+    uint32_t info_size, idx_size;
+    uint64_t n, m;
+    is.read((char*)&d, sizeof(int32_t));
+    is.read((char*)&info_size, sizeof(uint32_t));
+    is.read((char*)&idx_size, sizeof(uint32_t));
+    is.read((char*)&n, sizeof(uint64_t));
+    is.read((char*)&m, sizeof(uint64_t));
+    if (info_size != sizeof(Info)) {
+      std::cerr << "Error info is " << info_size << " bytes in the file, but "
+                << sizeof(Info) << " bytes in this triangulation" << std::endl;
+      return;
+    }
+
+    if (n==0) {
+      return;
+    }
+
+    if (idx_size == sizeof(uint32_t))
+      read_arrays<uint32_t>(is, n, m, d);
+    else
+      read_arrays<uint64_t>(is, n, m, d);
+  }
+
+  template <typename I>
+  void read_arrays(std::ifstream &is, uint64_t n, uint64_t m, int32_t d) {
+    uint64_t i;
+    int j, dim = d + 1;
+    std::vector<double> pos(3*n);
+    std::vector<Info> info(n);
+    std::vector<I> verts(dim*m);
+    std::vector<I> neigh(dim*m);
+    is.read((char*)pos.data(), pos.size()*sizeof(double));
+    is.read((char*)info.data(), info.size()*sizeof(Info));
+    is.read((char*)verts.data(), verts.size()*sizeof(I));
+    is.read((char*)neigh.data(), neigh.size()*sizeof(I));
+
+    T.tds().set_dimension(d);
+    All_cells_iterator to_delete = T.tds().cells_begin();
+
+    // vertices, with the infinite vertex last
+    std::vector<Vertex_handle> V(n+1);
+    for (i = 0; i < n; i++) {
+      V[i] = T.tds().create_vertex();
+      V[i]->point() = Point(pos[3*i], pos[3*i + 1], pos[3*i + 2]);
+      V[i]->info() = info[i];
+    }
+    V[n] = T.infinite_vertex();
+
+    // cells
+    std::vector<Cell_handle> C(m);
+    for (i = 0; i < m; i++) {
+      C[i] = T.tds().create_cell();
+      for (j = 0; j < dim; j++) {
+        C[i]->set_vertex(j, V[verts[dim*i + j]]);
+        V[verts[dim*i + j]]->set_cell(C[i]);
+      }
+    }
+    for (i = 0; i < m; i++) {
+      for (j = 0; j < dim; j++)
+        C[i]->set_neighbor(j, C[neigh[dim*i + j]]);
+    }
+
+    // delete flat cell
+    T.tds().delete_cell(to_delete);
+  }
+
+  // Read the format that wrote each element separately. n is the number of
+  // vertices, which has already been read from the header.
+  void read_elements(std::ifstream &is, int n) {
+    
+    // header
+    int m, d;
     is.read((char*)&m, sizeof(int));
     is.read((char*)&d, sizeof(int));
     
@@ -965,52 +1369,69 @@ class Delaunay_with_info_3
       return idx_inf;
     }
 
-    Vertex_hash V;
-    Cell_hash C;
-      
-    // first (infinite) vertex 
-    Vertex_handle vit;
-    int inum = 0;
+    // Vertices and cells are numbered in container order. The infinite
+    // vertex is skipped, so vertices after it are shifted down by one.
+    ContainerIndex V(T.tds().vertices_begin(), T.tds().vertices_end());
+    ContainerIndex C(T.tds().cells_begin(), T.tds().cells_end());
     Vertex_handle v = T.infinite_vertex();
-    V[v] = -1;
-    
-    // other vertices
+    uint64_t iv_inf = V.index(v), iv;
+
+    // finite vertices
+    int inum = 0;
     for( All_vertices_iterator vit = T.tds().vertices_begin(); vit != T.tds().vertices_end() ; ++vit) {
       if ( v != vit ) {
 	vert_pos[d*inum + 0] = static_cast<double>(vit->point().x());
 	vert_pos[d*inum + 1] = static_cast<double>(vit->point().y());
 	vert_pos[d*inum + 2] = static_cast<double>(vit->point().z());
 	vert_info[inum] = vit->info();
-	V[vit] = inum++;
+	inum++;
       }
     }
     
-    // vertices of the cells
+    // vertices and neighbors of the cells
     inum = 0;
-    for( Cell_iterator ib = T.tds().cells_begin(); 
+    for( All_cells_iterator ib = T.tds().cells_begin(); 
 	 ib != T.tds().cells_end(); ++ib) {
       for (int j = 0; j < dim ; ++j) {
-	vit = ib->vertex(j);
-	if ( v == vit )
+	iv = V.index(ib->vertex(j));
+	if ( iv == iv_inf )
 	  cells[dim*inum + j] = idx_inf;
 	else
-	  cells[dim*inum + j] = V[vit];
-      }
-      C[ib] = inum++;
-    }
-  
-    // neighbor pointers of the cells
-    inum = 0;
-    for( Cell_iterator it = T.tds().cells_begin();
-	 it != T.tds().cells_end(); ++it) {
-      for (int j = 0; j < d+1; ++j){
-	neighbors[(d+1)*inum + j] = C[it->neighbor(j)];
+	  cells[dim*inum + j] = static_cast<I>(iv < iv_inf ? iv : iv - 1);
       }
+      for (int j = 0; j < d+1; ++j)
+	neighbors[(d+1)*inum + j] = static_cast<I>(C.index(ib->neighbor(j)));
       inum++;
     }
     return idx_inf;
   }
 
+  // Same as serialize, but into vectors that are resized here so that the
+  // caller can take ownership of the memory without copying it.
+  template <typename I>
+  I serialize_vectors(int32_t &d, std::vector<double> &vert_pos,
+                      std::vector<Info> &vert_info,
+                      std::vector<I> &cells, std::vector<I> &neighbors) const
+  {
+    I n = static_cast<I>(T.number_of_vertices());
+    I m = static_cast<I>(T.tds().number_of_cells());
+    d = static_cast<int32_t>(T.dimension());
+    int dim = (d == -1 ? 1 :  d + 1);
+    if ((n == 0) || (m == 0)) {
+      vert_pos.clear();
+      vert_info.clear();
+      cells.clear();
+      neighbors.clear();
+      return std::numeric_limits<I>::max();
+    }
+    vert_pos.resize(3*(std::size_t)n);
+    vert_info.resize(n);
+    cells.resize(dim*(std::size_t)m);
+    neighbors.resize((d+1)*(std::size_t)m);
+    return serialize(n, m, d, vert_pos.data(), vert_info.data(),
+                     cells.data(), neighbors.data());
+  }
+
   template <typename I>
   Info serialize_idxinfo(I &n, I &m, int32_t &d,
 			 Info* cells, I* neighbors) const
@@ -1026,16 +1447,16 @@ class Delaunay_with_info_3
       return idx_inf;
     }
 
-    Cell_hash C;
+    // Cells are numbered in container order
+    ContainerIndex C(T.tds().cells_begin(), T.tds().cells_end());
       
     // first (infinite) vertex 
     Vertex_handle vit;
-    int inum = 0;
     Vertex_handle v = T.infinite_vertex();
     
-    // vertices of the cells
-    inum = 0;
-    for( Cell_iterator ib = T.tds().cells_begin(); 
+    // vertices and neighbors of the cells
+    int inum = 0;
+    for( All_cells_iterator ib = T.tds().cells_begin(); 
 	 ib != T.tds().cells_end(); ++ib) {
       for (int j = 0; j < dim ; ++j) {
 	vit = ib->vertex(j);
@@ -1044,16 +1465,8 @@ class Delaunay_with_info_3
 	else
 	  cells[dim*inum + j] = vit->info();
       }
-      C[ib] = inum++;
-    }
-  
-    // neighbor pointers of the cells
-    inum = 0;
-    for( Cell_iterator it = T.tds().cells_begin();
-	 it != T.tds().cells_end(); ++it) {
-      for (int j = 0; j < d+1; ++j){
-	neighbors[(d+1)*inum + j] = C[it->neighbor(j)];
-      }
+      for (int j = 0; j < d+1; ++j)
+	neighbors[(d+1)*inum + j] = static_cast<I>(C.index(ib->neighbor(j)));
       inum++;
     }
     return idx_inf;
@@ -1074,8 +1487,10 @@ class Delaunay_with_info_3
       return idx_inf;
     }
 
-    Cell_hash C;
-      
+    // Index of each included cell, by container order
+    ContainerIndex CI(T.tds().cells_begin(), T.tds().cells_end());
+    std::vector<I> C(m);
+
     // first (infinite) vertex 
     Vertex_handle vit;
     Vertex_handle v = T.infinite_vertex();
@@ -1108,9 +1523,9 @@ class Delaunay_with_info_3
 	  else
 	    cells[dim*inum + j] = idx[vit->info()];
 	}
-	C[ib] = inum++;
+	C[inum_tot] = inum++;
       } else {
-        C[ib] = idx_inf;
+        C[inum_tot] = idx_inf;
       }
       inum_tot++;
     }
@@ -1122,7 +1537,7 @@ class Delaunay_with_info_3
 	 it != T.tds().cells_end(); ++it) {
       if (include_cell[inum_tot]) {
 	for (int j = 0; j < d+1; ++j){
-	  neighbors[(d+1)*inum + j] = C[it->neighbor(j)];
+	  neighbors[(d+1)*inum + j] = C[CI.index(it->neighbor(j))];
 	}
 	inum++;
       }
@@ -1139,6 +1554,8 @@ class Delaunay_with_info_3
                    I* cells, I* neighbors, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
 
     if (T.number_of_vertices() != 0)  
       T.clear();
@@ -1200,6 +1617,8 @@ class Delaunay_with_info_3
 			   I* cells, I* neighbors, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
+    volume_cache_valid = false;
 
     if (T.number_of_vertices() != 0)  
       T.clear();
@@ -1288,6 +1707,57 @@ class Delaunay_with_info_3
     }
   }
 
+  // Circumcenters of all cells in the order used by serialize. Infinite
+  // cells have infinite coordinates.
+  void cell_circumcenters(double* out) const {
+    std::vector<Cell_handle> cells;
+    cells.reserve(T.number_of_cells());
+    for (All_cells_iterator it = T.all_cells_begin(); it != T.all_cells_end(); it++)
+      cells.push_back(it);
+    parallel_for_ranges(cells.size(), nthreads, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; i++)
+        circumcenter(Cell(cells[i]), out + 3*i);
+    });
+  }
+
+  // Infos of the vertices of each finite facet, in the order given by
+  // vertex_triple_index for the cell the facet is taken from.
+  void facet_info(Info* facets) const {
+    std::size_t i = 0;
+    for (Finite_facets_iterator it = T.finite_facets_begin(); it != T.finite_facets_end(); it++) {
+      for (int j = 0; j < 3; j++)
+        facets[3*i + j] = it->first->vertex(T.vertex_triple_index(it->second, j))->info();
+      i++;
+    }
+  }
+
+  // Adjacency of the finite vertices in compressed sparse row format. The
+  // infos of the vertices that share an edge with the vertex whose info is
+  // i are indices[indptr[i]:indptr[i+1]], in ascending order. indptr must
+  // have room for nverts+1 entries, where nverts is larger than every info,
+  // and indices for twice the number of finite edges.
+  void vertex_adjacency(uint64_t nverts, uint64_t* indptr, Info* indices) const {
+    Info i1, i2;
+    std::fill(indptr, indptr + nverts + 1, 0);
+    for (Finite_edges_iterator it = T.finite_edges_begin(); it != T.finite_edges_end(); it++) {
+      indptr[it->first->vertex(it->second)->info() + 1]++;
+      indptr[it->first->vertex(it->third)->info() + 1]++;
+    }
+    for (uint64_t i = 0; i < nverts; i++)
+      indptr[i + 1] += indptr[i];
+    std::vector<uint64_t> next(indptr, indptr + nverts);
+    for (Finite_edges_iterator it = T.finite_edges_begin(); it != T.finite_edges_end(); it++) {
+      i1 = it->first->vertex(it->second)->info();
+      i2 = it->first->vertex(it->third)->info();
+      indices[next[i1]++] = i2;
+      indices[next[i2]++] = i1;
+    }
+    parallel_for_ranges(nverts, nthreads, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; i++)
+        std::sort(indices + indptr[i], indices + indptr[i + 1]);
+    });
+  }
+
   bool intersect_sph_box(Point *c, double r, double *le, double *re) const {
     // x
     if (c->x() < le[0]) {
@@ -1319,44 +1789,29 @@ class Delaunay_with_info_3
   std::vector<std::vector<Info>> outgoing_points(uint64_t nbox,
                                                  double *left_edges,
                                                  double *right_edges) const {
-    std::vector<std::vector<Info>> out;
-    uint64_t b;
-    for (b = 0; b < nbox; b++)
-      out.push_back(std::vector<Info>());
-
-    Vertex_handle v;
-    Point cc, p1;
-    double cr;
-    int i, iinf = 0;
-
-    for (All_cells_iterator it = T.all_cells_begin(); it != T.all_cells_end(); it++) {
-      if (T.is_infinite(it) == true) {
-        // Find index of infinite vertex
-        for (i = 0; i < 4; i++) {
-          v = it->vertex(i);
-          if (T.is_infinite(v)) {
-            iinf = i;
-            break;
+    std::vector<Cell_handle> cells;
+    cells.reserve(T.number_of_cells());
+    for (All_cells_iterator it = T.all_cells_begin(); it != T.all_cells_end(); it++)
+      cells.push_back(it);
+    return outgoing_points_boxes<Info>(
+        3, nbox, left_edges, right_edges, cells,
+        [this](const Cell_handle &c, double *cc, double &cr) {
+          if (T.is_infinite(c))
+            return false;
+          const Point &p = c->circumcenter();
+          cc[0] = p.x();
+          cc[1] = p.y();
+          cc[2] = p.z();
+          cr = std::sqrt(static_cast<double>(CGAL::squared_distance(c->vertex(0)->point(), p)));
+          return true;
+        },
+        [this](const Cell_handle &c, std::vector<Info> &buf) {
+          buf.clear();
+          for (int i = 0; i < 4; i++) {
+            if (!T.is_infinite(c->vertex(i)))
+              buf.push_back(c->vertex(i)->info());
           }
-        }
-        for (b = 0; b < nbox; b++)
-          for (i = 1; i < 4; i++) out[b].push_back((it->vertex((iinf+i)%4))->info());
-      } else {
-        p1 = it->vertex(0)->point();
-	cc = it->circumcenter();
-        cr = std::sqrt(static_cast<double>(CGAL::squared_distance(p1, cc)));
-        for (b = 0; b < nbox; b++) {
-          if (intersect_sph_box(&cc, cr, left_edges + 3*b, right_edges + 3*b))
-            for (i = 0; i < 4; i++) out[b].push_back((it->vertex(i))->info());
-        }
-      }
-    }
-    for (b = 0; b < nbox; b++) {
-      std::sort( out[b].begin(), out[b].end() );
-      out[b].erase( std::unique( out[b].begin(), out[b].end() ), out[b].end() );
-    }
-
-    return out;
+        }, nthreads);
   }
 
   void boundary_points(double *left_edge, double *right_edge, bool periodic,
@@ -10,6 +10,8 @@
 #include <algorithm>
 #include <limits>
 #include <stdint.h>
+#include "c_vertex_index.hpp"
+#include "c_box_index.hpp"
 #ifdef READTHEDOCS
 #define VALID 1
 #include "dummy_CGAL.hpp"
@@ -24,6 +26,9 @@
 #include <CGAL/Triangulation_vertex.h>
 #include <CGAL/Unique_hash_map.h>
 #include <CGAL/Linear_algebraHd.h>
+#include <CGAL/spatial_sort.h>
+#include <CGAL/Spatial_sort_traits_adapter_d.h>
+#include <CGAL/property_map.h>
 #else
 #include "dummy_CGAL.hpp"
 #endif
@@ -142,37 +147,90 @@ public:
     return (Vertex_handle(p_v));
   }
 
-  Point pos2point(double* pos) const {
-    std::vector<double> vp;
-    for (uint32_t i = 0; i < D; i++)
-      vp.push_back(pos[i]);
-    return Point(vp.begin(), vp.end());
+  Point pos2point(const double* pos) const {
+    return Point(pos, pos + D);
   }
 
+  // Insert points in spatial (Hilbert) order, starting the search for each
+  // point from the cell of the vertex inserted before it.
   void insert(double *pts, Info *val, uint32_t n)
   {
     updated = true;
     uint32_t i;
+    std::vector< std::pair<Point,Info> > points;
+    points.reserve(n);
+    for (i = 0; i < n; i++)
+      points.push_back(std::make_pair(pos2point(pts+(D*i)), val[i]));
+    typedef CGAL::Spatial_sort_traits_adapter_d<K,
+      CGAL::First_of_pair_property_map< std::pair<Point,Info> > > Sort_traits;
+    CGAL::spatial_sort(points.begin(), points.end(), Sort_traits());
+    Cell_handle hint;
     Vertex_handle v;
+    std::size_t nverts = T.number_of_vertices();
+    bool existed;
+    for (typename std::vector< std::pair<Point,Info> >::iterator it = points.begin(); it != points.end(); ++it) {
+      v = T.insert(it->first, hint);
+      existed = (T.number_of_vertices() == nverts);
+      nverts = T.number_of_vertices();
+      vertex_index.inserted(it->second, v, existed,
+                            existed ? v->data() : it->second);
+      v->data() = it->second;
+      hint = v->full_cell();
+    }
+    v = T.infinite_vertex();
+    v->data() = std::numeric_limits<Info>::max();
+  }
+  // Insert points one at a time in the order given.
+  void insert_unsorted(double *pts, Info *val, uint32_t n)
+  {
+    updated = true;
+    uint32_t i;
+    Vertex_handle v;
+    std::size_t nverts = T.number_of_vertices();
+    bool existed;
     for (i = 0; i < n; i++) {
       v = T.insert(pos2point(pts+(D*i)));
+      existed = (T.number_of_vertices() == nverts);
+      nverts = T.number_of_vertices();
+      vertex_index.inserted(val[i], v, existed, existed ? v->data() : val[i]);
       v->data() = val[i];
     }
     v = T.infinite_vertex();
     v->data() = std::numeric_limits<Info>::max();
   }
-  void remove(Vertex v) { updated = true; T.remove(v._x); }
-  void clear() { updated = true; T.clear(); }
+  void remove(Vertex v) {
+    updated = true;
+    vertex_index.erase(v._x->data());
+    T.remove(v._x);
+  }
+  void clear() { updated = true; vertex_index.invalidate(); T.clear(); }
 
-  Vertex get_vertex(Info index) {
-    // Finite_vertex_const_iterator it = T.finite_vertices_begin();
+  // Lookup table from info to vertex (see c_vertex_index.hpp), kept up to
+  // date as vertices are added or removed while it is enabled.
+  mutable VertexIndex<Info, Vertex_handle> vertex_index;
+  template <typename F>
+  void visit_vertices(F f) {
     Finite_vertex_iterator it = T.finite_vertices_begin();
     for ( ; it != T.finite_vertices_end(); it++) {
-      if (it->data() == index)
-	return Vertex(it.base());
-	// return Vertex(non_const_handle(it.base()));
+      if (f(it->data(), it.base()))
+        return;
     }
-    return Vertex(T.infinite_vertex());
+  }
+  VertexVisitor<Delaunay_with_info_D> vertex_visitor() {
+    return VertexVisitor<Delaunay_with_info_D>(this);
+  }
+  void set_vertex_index(bool enable) { vertex_index.enable(enable); }
+
+  Vertex get_vertex(Info index) {
+    Vertex_handle v = T.infinite_vertex();
+    vertex_index.find(index, vertex_visitor(), T.number_of_vertices(), v);
+    return Vertex(v);
+  }
+  std::vector<Vertex> get_vertices(Info *index, uint64_t n) {
+    std::vector<Vertex_handle> v = vertex_index.find_many(
+        index, n, vertex_visitor(), T.number_of_vertices(),
+        T.infinite_vertex());
+    return std::vector<Vertex>(v.begin(), v.end());
   }
 
   Cell locate(double* pos, int& lt, Face &f, Facet &ft) const {
@@ -826,6 +884,7 @@ public:
   
   void read_from_buffer(std::ifstream &is) {
     updated = true;
+    vertex_index.invalidate();
 
     if (T.number_of_vertices() != 0)
       T.clear();
@@ -1089,6 +1148,7 @@ public:
                    I* cells, I* neighbors, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
 
     if (T.number_of_vertices() != 0)
       T.clear();
@@ -1165,6 +1225,7 @@ public:
                            I* cells, I* neighbors, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
 
     if (T.number_of_vertices() != 0)
       T.clear();
@@ -1274,47 +1335,29 @@ public:
   std::vector<std::vector<Info>> outgoing_points(uint64_t nbox,
                                                  double *left_edges,
                                                  double *right_edges) const {
-    std::vector<std::vector<Info>> out;
-    uint64_t b;
-    for (b = 0; b < nbox; b++)
-      out.push_back(std::vector<Info>());
-
-    Vertex_handle v;
-    Point cc, p1;
-    double cr;
-    int i, iinf = 0;
     int d = T.current_dimension();
-
-    for (Cell_const_iterator it = T.full_cells_begin(); it != T.full_cells_end(); it++) {
-      if (T.is_infinite(it) == true) {
-        // Find index of infinite vertex
-        for (i = 0; i < (d+1); i++) {
-          v = it->vertex(i);
-          if (T.is_infinite(v)) {
-            iinf = i;
-            break;
+    std::vector<Cell_const_iterator> cells;
+    for (Cell_const_iterator it = T.full_cells_begin(); it != T.full_cells_end(); it++)
+      cells.push_back(it);
+    return outgoing_points_boxes<Info>(
+        d, nbox, left_edges, right_edges, cells,
+        [this, d](const Cell_const_iterator &c, double *cc, double &cr) {
+          if (T.is_infinite(c))
+            return false;
+          Point p1 = c->vertex(0)->point();
+          Point p = c->circumcenter();
+          for (int i = 0; i < d; i++)
+            cc[i] = (double)(p[i]);
+          cr = std::sqrt(static_cast<double>(T.geom_traits().squared_distance_d_object()(p1, p)));
+          return true;
+        },
+        [this, d](const Cell_const_iterator &c, std::vector<Info> &buf) {
+          buf.clear();
+          for (int i = 0; i < (d+1); i++) {
+            if (!T.is_infinite(c->vertex(i)))
+              buf.push_back(c->vertex(i)->data());
           }
-        }
-        for (b = 0; b < nbox; b++)
-          for (i = 1; i < (d+1); i++) 
-  	    out[b].push_back((it->vertex((iinf+i) % (d+1)))->data());
-      } else {
-        p1 = it->vertex(0)->point();
-        cc = it->circumcenter();
-        cr = std::sqrt(static_cast<double>(T.geom_traits().squared_distance_d_object()(p1, cc)));
-        for (b = 0; b < nbox; b++) {
-          if (intersect_sph_box(cc, cr, left_edges + d*b, right_edges + d*b))
-            for (i = 0; i < (d+1); i++) 
-  	      out[b].push_back((it->vertex(i))->data());
-        }
-      }
-    }
-    for (b = 0; b < nbox; b++) {
-      std::sort( out[b].begin(), out[b].end() );
-      out[b].erase( std::unique( out[b].begin(), out[b].end() ), out[b].end() );
-    }
-
-    return out;
+        });
   }
   
 };
@@ -0,0 +1,158 @@
+// Contributions of a single cell to the dual (voronoi) volumes of its
+// vertices. Each cell is split into signed simplices with a vertex, an
+// edge midpoint, facet circumcenters and the cell circumcenter, so the
+// contributions only depend on the cell's own positions. Summed over all
+// of the cells incident to a vertex, they give the volume of its voronoi
+// cell, and summed over the vertices of a cell, they give its volume.
+// This makes them suited to periodic triangulations, where the positions
+// of a cell's vertices depend on the cell's offsets.
+#include <stdint.h>
+
+#ifndef CGAL4PY_DUAL_VOLUME_HPP
+#define CGAL4PY_DUAL_VOLUME_HPP
+
+// Circumcenter of the triangle (0, u, v) relative to its first vertex.
+inline void _dual_circumcenter_2(const double *u, const double *v, double *out) {
+  double uu, vv, den;
+  uu = u[0]*u[0] + u[1]*u[1];
+  vv = v[0]*v[0] + v[1]*v[1];
+  den = 2.0*(u[0]*v[1] - u[1]*v[0]);
+  out[0] = (v[1]*uu - u[1]*vv)/den;
+  out[1] = (u[0]*vv - v[0]*uu)/den;
+}
+
+// p holds the 3 vertices of a triangle as (x, y) pairs. Its circumcenter
+// is written to out[0:2].
+inline void cell_circumcenter_2(const double *p, double *out) {
+  double u[2], v[2];
+  int i;
+  for (i = 0; i < 2; i++) {
+    u[i] = p[2 + i] - p[i];
+    v[i] = p[4 + i] - p[i];
+  }
+  _dual_circumcenter_2(u, v, out);
+  for (i = 0; i < 2; i++)
+    out[i] += p[i];
+}
+
+// p holds the 3 vertices of a counter-clockwise triangle as (x, y) pairs.
+// The contribution to the area of each vertex is added to out[0:3].
+inline void cell_dual_areas_2(const double *p, double *out) {
+  double u[2], v[2], c[2], a;
+  int i, j;
+  for (i = 0; i < 2; i++) {
+    u[i] = p[2 + i] - p[i];
+    v[i] = p[4 + i] - p[i];
+  }
+  // Circumcenter relative to p[0]
+  _dual_circumcenter_2(u, v, c);
+  for (i = 0; i < 3; i++) {
+    j = (i + 1) % 3;
+    // Triangle from vertex i to the midpoint of edge (i, j) and the
+    // circumcenter. Its mirror image across the bisector belongs to j.
+    const double *pi = p + 2*i;
+    const double *pj = p + 2*j;
+    double m[2] = {0.5*(pj[0] - pi[0]), 0.5*(pj[1] - pi[1])};
+    double ci[2] = {c[0] + p[0] - pi[0], c[1] + p[1] - pi[1]};
+    a = 0.5*(m[0]*ci[1] - m[1]*ci[0]);
+    out[i] += a;
+    out[j] += a;
+  }
+}
+
+inline double _dual_det3(const double *a, const double *b, const double *c) {
+  return (a[0]*(b[1]*c[2] - b[2]*c[1]) +
+          a[1]*(b[2]*c[0] - b[0]*c[2]) +
+          a[2]*(b[0]*c[1] - b[1]*c[0]));
+}
+
+// Circumcenter of the triangle (0, u, v) relative to its first vertex.
+inline void _dual_facet_circumcenter(const double *u, const double *v, double *out) {
+  double n[3], w[3], uu, vv, nn;
+  int i;
+  n[0] = u[1]*v[2] - u[2]*v[1];
+  n[1] = u[2]*v[0] - u[0]*v[2];
+  n[2] = u[0]*v[1] - u[1]*v[0];
+  uu = u[0]*u[0] + u[1]*u[1] + u[2]*u[2];
+  vv = v[0]*v[0] + v[1]*v[1] + v[2]*v[2];
+  nn = n[0]*n[0] + n[1]*n[1] + n[2]*n[2];
+  for (i = 0; i < 3; i++)
+    w[i] = uu*v[i] - vv*u[i];
+  out[0] = (w[1]*n[2] - w[2]*n[1])/(2.0*nn);
+  out[1] = (w[2]*n[0] - w[0]*n[2])/(2.0*nn);
+  out[2] = (w[0]*n[1] - w[1]*n[0])/(2.0*nn);
+}
+
+// Circumcenter of the tetrahedron (0, u, v, w) relative to its first vertex.
+inline void _dual_circumcenter_3(const double *u, const double *v,
+                                 const double *w, double *out) {
+  double uu, vv, ww, den;
+  uu = u[0]*u[0] + u[1]*u[1] + u[2]*u[2];
+  vv = v[0]*v[0] + v[1]*v[1] + v[2]*v[2];
+  ww = w[0]*w[0] + w[1]*w[1] + w[2]*w[2];
+  den = 2.0*_dual_det3(u, v, w);
+  out[0] = (uu*(v[1]*w[2] - v[2]*w[1]) + vv*(w[1]*u[2] - w[2]*u[1]) +
+            ww*(u[1]*v[2] - u[2]*v[1]))/den;
+  out[1] = (uu*(v[2]*w[0] - v[0]*w[2]) + vv*(w[2]*u[0] - w[0]*u[2]) +
+            ww*(u[2]*v[0] - u[0]*v[2]))/den;
+  out[2] = (uu*(v[0]*w[1] - v[1]*w[0]) + vv*(w[0]*u[1] - w[1]*u[0]) +
+            ww*(u[0]*v[1] - u[1]*v[0]))/den;
+}
+
+// p holds the 4 vertices of a tetrahedron as (x, y, z) triples. Its
+// circumcenter is written to out[0:3].
+inline void cell_circumcenter_3(const double *p, double *out) {
+  double u[3], v[3], w[3];
+  int d;
+  for (d = 0; d < 3; d++) {
+    u[d] = p[3 + d] - p[d];
+    v[d] = p[6 + d] - p[d];
+    w[d] = p[9 + d] - p[d];
+  }
+  _dual_circumcenter_3(u, v, w, out);
+  for (d = 0; d < 3; d++)
+    out[d] += p[d];
+}
+
+// p holds the 4 vertices of a positively oriented tetrahedron as (x, y, z)
+// triples. The contribution to the volume of each vertex is added to
+// out[0:4].
+inline void cell_dual_volumes_3(const double *p, double *out) {
+  // Edges (i, j) with the other vertices (k, l) ordered so that (i, j, k, l)
+  // has the same orientation as (0, 1, 2, 3).
+  static const int edges[6][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2},
+                                  {1, 2, 0, 3}, {1, 3, 2, 0}, {2, 3, 0, 1}};
+  double u[3], v[3], w[3], c[3];
+  double e[4][3], m[3], ci[3], fk[3], fl[3], vol;
+  int d, x, i, j, k, l;
+  for (d = 0; d < 3; d++) {
+    u[d] = p[3 + d] - p[d];
+    v[d] = p[6 + d] - p[d];
+    w[d] = p[9 + d] - p[d];
+  }
+  // Circumcenter relative to p[0]
+  _dual_circumcenter_3(u, v, w, c);
+  for (x = 0; x < 6; x++) {
+    i = edges[x][0];
+    j = edges[x][1];
+    k = edges[x][2];
+    l = edges[x][3];
+    for (d = 0; d < 3; d++) {
+      e[j][d] = p[3*j + d] - p[3*i + d];
+      e[k][d] = p[3*k + d] - p[3*i + d];
+      e[l][d] = p[3*l + d] - p[3*i + d];
+      m[d] = 0.5*e[j][d];
+      ci[d] = c[d] + p[d] - p[3*i + d];
+    }
+    _dual_facet_circumcenter(e[j], e[k], fk);
+    _dual_facet_circumcenter(e[j], e[l], fl);
+    // Tetrahedra from vertex i to the midpoint of edge (i, j), the
+    // circumcenters of the facets on either side of the edge and the
+    // cell circumcenter. Their mirror images belong to j.
+    vol = (_dual_det3(m, fk, ci) + _dual_det3(m, ci, fl))/6.0;
+    out[i] += vol;
+    out[j] += vol;
+  }
+}
+
+#endif
@@ -8,8 +8,13 @@
 #include <exception>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <algorithm>
+#include <limits>
 // #include "c_kdtree.hpp"
 #include "c_parallel_kdtree.hpp"
+#include "c_kdtree_file.hpp"
+#include "c_kdtree_route.hpp"
 #include "c_tools.hpp"
 #include "c_delaunay2.hpp"
 #include "c_delaunay3.hpp"
@@ -56,6 +61,174 @@ void *my_realloc(void *in, size_t size, const char* msg = "") {
 
 
 
+// Split [0, n) into contiguous chunks and call func(start, stop) on each
+// from its own thread.
+template <typename Func>
+void parallel_chunks(uint64_t n, Func func) {
+  uint64_t nthreads = std::thread::hardware_concurrency();
+  if (nthreads < 1)
+    nthreads = 1;
+  if (nthreads > n)
+    nthreads = n;
+  if (nthreads <= 1) {
+    func((uint64_t)0, n);
+    return;
+  }
+  std::vector<std::thread> threads;
+  uint64_t chunk = n/nthreads + 1;
+  for (uint64_t start = 0; start < n; start += chunk)
+    threads.push_back(std::thread(func, start, std::min(n, start + chunk)));
+  for (std::vector<std::thread>::iterator it = threads.begin();
+       it != threads.end(); it++)
+    it->join();
+}
+
+// Permute the rows of pts so that row j holds the point at row idx[j]. If
+// in_place is true, no temporary copy of the points is made and the
+// permutation is applied serially by following its cycles.
+template <typename T>
+void permute_pts(T *pts, uint64_t *idx, uint64_t n, uint32_t ndim,
+		 bool in_place = false) {
+  size_t row = ndim*sizeof(T);
+  if (n == 0)
+    return;
+  if (in_place) {
+    std::vector<bool> done(n, false);
+    T *save = (T*)my_malloc(row);
+    uint64_t i, j, k;
+    for (i = 0; i < n; i++) {
+      if (done[i])
+	continue;
+      done[i] = true;
+      if (idx[i] == i)
+	continue;
+      memcpy(save, pts+ndim*i, row);
+      j = i;
+      for (k = idx[j]; k != i; k = idx[j]) {
+	memcpy(pts+ndim*j, pts+ndim*k, row);
+	done[k] = true;
+	j = k;
+      }
+      memcpy(pts+ndim*j, save, row);
+    }
+    free(save);
+  } else {
+    T *tmp = (T*)my_malloc(n*row);
+    parallel_chunks(n, [=](uint64_t start, uint64_t stop) {
+	for (uint64_t j = start; j < stop; j++)
+	  memcpy(tmp+ndim*j, pts+ndim*idx[j], row);
+      });
+    parallel_chunks(n, [=](uint64_t start, uint64_t stop) {
+	memcpy(pts+ndim*start, tmp+ndim*start, (stop-start)*row);
+      });
+    free(tmp);
+  }
+}
+
+// Undo permute_pts so that row idx[j] again holds the point at row j.
+template <typename T>
+void unpermute_pts(T *pts, uint64_t *idx, uint64_t n, uint32_t ndim,
+		   bool in_place = false) {
+  size_t row = ndim*sizeof(T);
+  if (n == 0)
+    return;
+  if (in_place) {
+    std::vector<bool> done(n, false);
+    T *carry = (T*)my_malloc(row);
+    T *swap = (T*)my_malloc(row);
+    uint64_t i, j;
+    for (i = 0; i < n; i++) {
+      if (done[i])
+	continue;
+      memcpy(carry, pts+ndim*i, row);
+      j = i;
+      do {
+	j = idx[j];
+	memcpy(swap, pts+ndim*j, row);
+	memcpy(pts+ndim*j, carry, row);
+	memcpy(carry, swap, row);
+	done[j] = true;
+      } while (j != i);
+    }
+    free(carry);
+    free(swap);
+  } else {
+    T *tmp = (T*)my_malloc(n*row);
+    parallel_chunks(n, [=](uint64_t start, uint64_t stop) {
+	for (uint64_t j = start; j < stop; j++)
+	  memcpy(tmp+ndim*idx[j], pts+ndim*j, row);
+      });
+    parallel_chunks(n, [=](uint64_t start, uint64_t stop) {
+	memcpy(pts+ndim*start, tmp+ndim*start, (stop-start)*row);
+      });
+    free(tmp);
+  }
+}
+
+// Points are triangulated and stored by leaves as double, but the caller's
+// points may be single precision (Coord = float). Points are then sent
+// between processes as Coord, which halves the volume of every transfer.
+// Only points taken from the caller's array are sent, so narrowing them
+// back to Coord is exact.
+template <typename Coord>
+MPI_Datatype mpi_coord_type();
+template <>
+inline MPI_Datatype mpi_coord_type<double>() { return MPI_DOUBLE; }
+template <>
+inline MPI_Datatype mpi_coord_type<float>() { return MPI_FLOAT; }
+
+// Copy of n coordinates as double, allocated with my_malloc. Double
+// coordinates are returned as is, so callers should compare pointers
+// before freeing the result.
+template <typename Coord>
+double *widen_pts(Coord *pts, uint64_t n) {
+  double *out = (double*)my_malloc(n*sizeof(double));
+  std::copy(pts, pts + n, out);
+  return out;
+}
+inline double *widen_pts(double *pts, uint64_t n) {
+  return pts;
+}
+
+// Copy of n double coordinates as Coord, allocated with my_malloc. As for
+// widen_pts, double coordinates are returned as is.
+template <typename Coord>
+Coord *narrow_pts(double *pts, uint64_t n) {
+  Coord *out = (Coord*)my_malloc(n*sizeof(Coord));
+  std::copy(pts, pts + n, out);
+  return out;
+}
+template <>
+inline double *narrow_pts<double>(double *pts, uint64_t n) {
+  return pts;
+}
+
+// Points of a leaf as double: the n rows of all_pts starting at start, or
+// if reordered is false, the rows idx[start:start+n]. Double points that
+// have been reordered into leaf order are shared and owns is set to false.
+// Otherwise owns is set to true and a copy allocated with my_malloc is
+// returned, so single precision points are widened one leaf at a time.
+template <typename Coord>
+double *leaf_pts(Coord *all_pts, uint64_t *idx, uint64_t start, uint64_t n,
+		 uint32_t ndim, bool reordered, bool &owns) {
+  double *out = (double*)my_malloc(ndim*n*sizeof(double));
+  uint64_t j, row;
+  for (j = 0; j < n; j++) {
+    row = reordered ? (start + j) : idx[start + j];
+    std::copy(all_pts + ndim*row, all_pts + ndim*(row + 1), out + ndim*j);
+  }
+  owns = true;
+  return out;
+}
+inline double *leaf_pts(double *all_pts, uint64_t *idx, uint64_t start,
+			uint64_t n, uint32_t ndim, bool reordered, bool &owns) {
+  if (reordered) {
+    owns = false;
+    return all_pts + ndim*start;
+  }
+  return leaf_pts<double>(all_pts, idx, start, n, ndim, reordered, owns);
+}
+
 void print_array_double(double *arr, int nrow, int ncol) {
   int i, j;
   printf("[\n");
@@ -336,15 +509,16 @@ public:
     }
   }
 
-  void dual_volumes(double *vols) {
+  // vols must hold nvols entries, enough for the largest vertex info.
+  void dual_volumes(double *vols, uint64_t nvols) {
     if (ndim == 2) {
       if (periodic)
-	((PeriodicDelaunay2*)T)->dual_areas(vols);
+	((PeriodicDelaunay2*)T)->dual_areas(vols, nvols);
       else
 	((Delaunay2*)T)->dual_areas(vols);
     } else if (ndim == 3) {
       if (periodic)
-	((PeriodicDelaunay3*)T)->dual_volumes(vols);
+	((PeriodicDelaunay3*)T)->dual_volumes(vols, nvols);
       else
 	((Delaunay3*)T)->dual_volumes(vols);
     } else if (ndim == D) {
@@ -359,15 +533,17 @@ public:
 };
 
 
-template <typename Info_>
+template <typename Info_, typename Coord_ = double>
 class CParallelLeaf
 {
 public:
   typedef Info_ Info;
+  typedef Coord_ Coord;
   typedef CGeneralDelaunay<Info> Delaunay;
   bool from_node;
   bool in_memory = false;
   bool tess_exists = false;
+  bool owns_pts = true;
   int size;
   int rank;
   char unique_str[MAXLEN_FILENAME];
@@ -391,6 +567,9 @@ public:
   std::set<uint32_t> *all_neigh;
   std::vector<std::set<uint32_t>> *lneigh;
   std::vector<std::set<uint32_t>> *rneigh;
+  // Whether each point was assigned to this leaf rather than received from
+  // a neighbor. This is kept in memory when the leaf is dumped.
+  std::vector<bool> owned;
   char OutputFile[MAXLEN_FILENAME];
 
   void begin_init(uint32_t nleaves0, uint32_t ndim0, const char *ustr) {
@@ -419,6 +598,7 @@ public:
 
   void end_init() {
     sprintf(OutputFile, "%s_leafoutput%u.dat", unique_str, id);
+    owned.assign(npts, true);
     in_memory = true;
   }
 
@@ -433,27 +613,29 @@ public:
   };
 
   CParallelLeaf(uint32_t nleaves0, uint32_t ndim0, const char *ustr,
-		KDTree* tree, int index) {
+		KDTree* tree, int index)
+    : CParallelLeaf(nleaves0, ndim0, ustr, tree, tree->all_pts, index) {}
+
+  // Leaf index of tree with its points taken from all_pts (see leaf_pts).
+  template <typename T>
+  CParallelLeaf(uint32_t nleaves0, uint32_t ndim0, const char *ustr,
+		KDTree* tree, T *all_pts, int index, bool reordered = false) {
     from_node = true;
     begin_init(nleaves0, ndim0, ustr);
     // Transfer leaf information
     Node* node = tree->leaves[index];
     uint64_t j;
     uint32_t k;
-    std::set<uint32_t>::iterator it;
     id = node->leafid;
     npts = node->children;
     idx = (Info*)my_malloc(npts*sizeof(Info));
-    pts = (double*)my_malloc(ndim*npts*sizeof(double));
     memcpy(le, node->left_edge, ndim*sizeof(double));
     memcpy(re, node->right_edge, ndim*sizeof(double));
     memcpy(domain_width, tree->domain_width, ndim*sizeof(double));
-    for (j = 0; j < npts; j++) {
+    for (j = 0; j < npts; j++)
       idx[j] = (Info)(tree->left_idx + node->left_idx + j);
-      for (k = 0; k < ndim; k++) {
-    	pts[ndim*j+k] = tree->all_pts[ndim*tree->all_idx[node->left_idx+j]+k];
-      }
-    }
+    pts = leaf_pts(all_pts, tree->all_idx, node->left_idx, npts, ndim,
+		   reordered, owns_pts);
     memcpy(leaves_le, tree->leaves_le, nleaves*ndim*sizeof(double));
     memcpy(leaves_re, tree->leaves_re, nleaves*ndim*sizeof(double));
     neigh->insert(node->all_neighbors.begin(), node->all_neighbors.end());
@@ -467,25 +649,95 @@ public:
       (*rneigh)[k].insert(node->right_neighbors[k].begin(),
     			  node->right_neighbors[k].end());
     }
+    shift_periodic_neighbors();
+    if (DEBUG > 1)
+      printf("%d: Initialized directly on %d\n", id, rank);
+    end_init();
+  }
+
+  template <typename T>
+  CParallelLeaf(uint32_t nleaves0, uint32_t ndim0, const char *ustr,
+		KDTreeFile* tree, T *all_pts, int index,
+		bool reordered = false) {
+    from_node = true;
+    begin_init(nleaves0, ndim0, ustr);
+    // Transfer leaf information from a tree loaded from file
+    FlatNode* node = tree->leaf(index);
+    uint64_t j;
+    uint32_t k, l;
+    id = node->leafid;
+    npts = node->children;
+    idx = (Info*)my_malloc(npts*sizeof(Info));
+    memcpy(le, tree->leaf_left_edge(index), ndim*sizeof(double));
+    memcpy(re, tree->leaf_right_edge(index), ndim*sizeof(double));
+    for (k = 0; k < ndim; k++)
+      domain_width[k] = tree->domain_right_edge()[k] -
+	tree->domain_left_edge()[k];
+    for (j = 0; j < npts; j++)
+      idx[j] = (Info)(node->left_idx + j);
+    pts = leaf_pts(all_pts, tree->all_idx, node->left_idx, npts, ndim,
+		   reordered, owns_pts);
+    for (l = 0; l < nleaves; l++) {
+      memcpy(leaves_le + ndim*l, tree->leaf_left_edge(l), ndim*sizeof(double));
+      memcpy(leaves_re + ndim*l, tree->leaf_right_edge(l), ndim*sizeof(double));
+    }
+    neigh->insert(tree->all_neighbors_begin(index),
+		  tree->all_neighbors_end(index));
+    for (k = 0; k < ndim; k++) {
+      periodic_le[k] = tree->periodic_left(index, k);
+      periodic_re[k] = tree->periodic_right(index, k);
+      (*lneigh)[k].insert(tree->left_neighbors_begin(index, k),
+			  tree->left_neighbors_end(index, k));
+      (*rneigh)[k].insert(tree->right_neighbors_begin(index, k),
+			  tree->right_neighbors_end(index, k));
+    }
+    shift_periodic_neighbors();
+    if (DEBUG > 1)
+      printf("%d: Initialized from file on %d\n", id, rank);
+    end_init();
+  }
+
+  CParallelLeaf(CParallelLeaf *src, uint32_t id0) {
+    from_node = false;
+    begin_init(src->nleaves, src->ndim, src->unique_str);
+    // Empty leaf with the edges and neighbors of the leaf it is split from
+    uint32_t k;
+    id = id0;
+    memcpy(le, src->le, ndim*sizeof(double));
+    memcpy(re, src->re, ndim*sizeof(double));
+    memcpy(periodic_le, src->periodic_le, ndim*sizeof(int));
+    memcpy(periodic_re, src->periodic_re, ndim*sizeof(int));
+    memcpy(domain_width, src->domain_width, ndim*sizeof(double));
+    memcpy(leaves_le, src->leaves_le, nleaves*ndim*sizeof(double));
+    memcpy(leaves_re, src->leaves_re, nleaves*ndim*sizeof(double));
+    for (k = 0; k < ndim; k++) {
+      (*lneigh)[k] = (*(src->lneigh))[k];
+      (*rneigh)[k] = (*(src->rneigh))[k];
+    }
+    if (DEBUG > 1)
+      printf("%d: Initialized from split of %d on %d\n", id, src->id, rank);
+    end_init();
+  }
+
+  void shift_periodic_neighbors() {
+    uint32_t k;
+    std::set<uint32_t>::iterator it;
     // Shift edges of periodic neighbors
     for (k = 0; k < ndim; k++) {
       if (periodic_le[k]) {
 	for (it = (*lneigh)[k].begin(); it != (*lneigh)[k].end(); it++) {
-    	  leaves_le[*it, k] -= domain_width[k];
-    	  leaves_re[*it, k] -= domain_width[k];
+    	  leaves_le[ndim*(*it)+k] -= domain_width[k];
+    	  leaves_re[ndim*(*it)+k] -= domain_width[k];
     	}
       }
       if (periodic_re[k]) {
 	for (it = (*rneigh)[k].begin(); it != (*rneigh)[k].end(); it++) {
     	     
-    	  leaves_le[*it, k] += domain_width[k];
-    	  leaves_re[*it, k] += domain_width[k];
+    	  leaves_le[ndim*(*it)+k] += domain_width[k];
+    	  leaves_re[ndim*(*it)+k] += domain_width[k];
     	}
       }
     }
-    if (DEBUG > 1)
-      printf("%d: Initialized directly on %d\n", id, rank);
-    end_init();
   }
 
   ~CParallelLeaf() {
@@ -496,7 +748,7 @@ public:
     delete(lneigh);
     delete(rneigh);
     delete(T);
-    if (pts != NULL)
+    if ((pts != NULL) && owns_pts)
       free(pts);
     if (idx != NULL)
       free(idx);
@@ -513,7 +765,8 @@ public:
       fd.write((char*)idx, npts*sizeof(Info));
       fd.write((char*)pts, npts*ndim*sizeof(double));
       free(idx);
-      free(pts);
+      if (owns_pts)
+	free(pts);
       if (tess_exists) {
 	T->write_to_buffer(fd);
 	delete(T);
@@ -530,6 +783,7 @@ public:
       std::ifstream fd (OutputFile, std::ios::in | std::ios::binary);
       idx = (Info*)my_malloc(npts*sizeof(Info));
       pts = (double*)my_malloc(npts*ndim*sizeof(double));
+      owns_pts = true;
       fd.read((char*)idx, npts*sizeof(Info));
       fd.read((char*)pts, npts*ndim*sizeof(double));
       if (tess_exists) {
@@ -541,6 +795,16 @@ public:
     }
   }
 
+  void detach() {
+    // Replace points shared with the tree by a copy owned by the leaf
+    if (in_memory && (!(owns_pts))) {
+      double *pts_own = (double*)my_malloc(ndim*npts*sizeof(double));
+      memcpy(pts_own, pts, ndim*npts*sizeof(double));
+      pts = pts_own;
+      owns_pts = true;
+    }
+  }
+
   uint32_t num_cells() {
     return T->num_cells();
   }
@@ -554,7 +818,11 @@ public:
       MPI_Send(idx, npts, MPI_UNSIGNED, dst, i++, MPI_COMM_WORLD);
     else
       MPI_Send(idx, npts, MPI_UNSIGNED_LONG, dst, i++, MPI_COMM_WORLD);
-    MPI_Send(pts, ndim*npts, MPI_DOUBLE, dst, i++, MPI_COMM_WORLD);
+    Coord *pts_send = narrow_pts<Coord>(pts, ndim*npts);
+    MPI_Send(pts_send, ndim*npts, mpi_coord_type<Coord>(), dst, i++,
+	     MPI_COMM_WORLD);
+    if ((void*)pts_send != (void*)pts)
+      free(pts_send);
     MPI_Send(le, ndim, MPI_DOUBLE, dst, i++, MPI_COMM_WORLD);
     MPI_Send(re, ndim, MPI_DOUBLE, dst, i++, MPI_COMM_WORLD);
     MPI_Send(periodic_le, ndim, MPI_INT, dst, i++, MPI_COMM_WORLD);
@@ -609,15 +877,18 @@ public:
     MPI_Recv(&npts, 1, MPI_UNSIGNED_LONG, src, i++, MPI_COMM_WORLD,
     	     MPI_STATUS_IGNORE);
     idx = (Info*)my_malloc(npts*sizeof(Info));
-    pts = (double*)my_malloc(ndim*npts*sizeof(double));
+    Coord *pts_recv = (Coord*)my_malloc(ndim*npts*sizeof(Coord));
     if (sizeof(Info) == sizeof(uint32_t))
       MPI_Recv(idx, npts, MPI_UNSIGNED, src, i++, MPI_COMM_WORLD,
 	       MPI_STATUS_IGNORE);
     else
       MPI_Recv(idx, npts, MPI_UNSIGNED_LONG, src, i++, MPI_COMM_WORLD,
 	       MPI_STATUS_IGNORE);
-    MPI_Recv(pts, ndim*npts, MPI_DOUBLE, src, i++, MPI_COMM_WORLD,
-    	     MPI_STATUS_IGNORE);
+    MPI_Recv(pts_recv, ndim*npts, mpi_coord_type<Coord>(), src, i++,
+	     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    pts = widen_pts(pts_recv, ndim*npts);
+    if ((void*)pts != (void*)pts_recv)
+      free(pts_recv);
     MPI_Recv(le, ndim, MPI_DOUBLE, src, i++, MPI_COMM_WORLD,
     	     MPI_STATUS_IGNORE);
     MPI_Recv(re, ndim, MPI_DOUBLE, src, i++, MPI_COMM_WORLD,
@@ -680,7 +951,8 @@ public:
     tess_exists = true;
   }
 
-  void insert(double *pts_new, Info *idx_new, uint64_t npts_new) {
+  void insert(double *pts_new, Info *idx_new, uint64_t npts_new,
+	      bool own = true) {
     // Insert points
     Info *idx_dum = (Info*)my_malloc(npts_new*sizeof(Info));
     for (Info i = 0, j = npts; i < npts_new; i++, j++)
@@ -691,9 +963,17 @@ public:
     idx = (Info*)my_realloc(idx, (npts+npts_new)*sizeof(Info), "idx in insert");
     memcpy(idx+npts, idx_new, npts_new*sizeof(Info));
     // Copy points
-    pts = (double*)my_realloc(pts, ndim*(npts+npts_new)*sizeof(double),
-			      "pts in insert");
+    if (owns_pts) {
+      pts = (double*)my_realloc(pts, ndim*(npts+npts_new)*sizeof(double),
+				"pts in insert");
+    } else {
+      double *pts_own = (double*)my_malloc(ndim*(npts+npts_new)*sizeof(double));
+      memcpy(pts_own, pts, ndim*npts*sizeof(double));
+      pts = pts_own;
+      owns_pts = true;
+    }
     memcpy(pts+ndim*npts, pts_new, ndim*npts_new*sizeof(double));
+    owned.resize(npts+npts_new, own);
     // Advance count
     npts += npts_new;
     ncells = (uint64_t)(T->num_cells());
@@ -856,7 +1136,7 @@ public:
       }
     }
     // Add points to tessellation, then arrays
-    insert(pts_recv, idx_recv, npts_recv);
+    insert(pts_recv, idx_recv, npts_recv, false);
     // Add neighbors
     uint32_t n;
     for (k = 0; k < nneigh_recv; k++) {
@@ -872,24 +1152,258 @@ public:
   uint64_t voronoi_volumes(double **vols) {
     (*vols) = (double*)my_realloc(*vols, T->num_finite_verts()*sizeof(double),
 				  "leaf voronoi volums");
-    T->dual_volumes(*vols);
+    T->dual_volumes(*vols, T->num_finite_verts());
     return npts;
   }
 
+  // Volumes of the points assigned to this leaf with indices below npts_max
+  // (those from the initial decomposition), along with those indices.
+  // Returns the number of volumes.
+  uint64_t owned_volumes(uint64_t npts_max, Info **idx_vols, double **vols) {
+    uint64_t j, n = 0;
+    (*vols) = (double*)my_realloc(*vols, npts*sizeof(double),
+				  "leaf owned volumes");
+    (*idx_vols) = (Info*)my_realloc(*idx_vols, npts*sizeof(Info),
+				    "leaf owned volume indices");
+    T->dual_volumes(*vols, npts);
+    for (j = 0; j < npts; j++) {
+      if (owned[j] && ((uint64_t)(idx[j]) < npts_max)) {
+	(*idx_vols)[n] = idx[j];
+	(*vols)[n] = (*vols)[j];
+	n++;
+      }
+    }
+    return n;
+  }
+
+  // Choose where to split the points assigned to this leaf: the median
+  // along the dimension they span the furthest. Returns false if either
+  // half would have too few points to triangulate.
+  bool choose_split(uint32_t &split_dim, double &split_val) {
+    uint64_t j, n = 0, nlower = 0;
+    uint32_t k;
+    std::vector<double> mins(ndim, std::numeric_limits<double>::max());
+    std::vector<double> maxs(ndim, -std::numeric_limits<double>::max());
+    for (j = 0; j < npts; j++) {
+      if (!(owned[j]))
+	continue;
+      for (k = 0; k < ndim; k++) {
+	mins[k] = std::min(mins[k], pts[ndim*j+k]);
+	maxs[k] = std::max(maxs[k], pts[ndim*j+k]);
+      }
+      n++;
+    }
+    if (n < 2*(ndim+1))
+      return false;
+    split_dim = 0;
+    for (k = 1; k < ndim; k++) {
+      if ((maxs[k] - mins[k]) > (maxs[split_dim] - mins[split_dim]))
+	split_dim = k;
+    }
+    std::vector<double> x;
+    x.reserve(n);
+    for (j = 0; j < npts; j++) {
+      if (owned[j])
+	x.push_back(pts[ndim*j+split_dim]);
+    }
+    std::nth_element(x.begin(), x.begin() + (n-1)/2, x.end());
+    split_val = x[(n-1)/2];
+    // Points equal to the split go to the lower half (see flat_kdtree_search)
+    for (j = 0; j < n; j++) {
+      if (x[j] <= split_val)
+	nlower++;
+    }
+    return ((nlower >= (ndim+1)) && ((n - nlower) >= (ndim+1)));
+  }
+
+  // Add leaf id_upper, created by splitting leaf id_lower at split_val
+  // along split_dim, to the edges of all leaves. lower_le is the left edge
+  // of id_lower before the split, which is used to carry over any periodic
+  // shift of its edges.
+  void split_leaf_edges(uint32_t id_lower, uint32_t id_upper,
+			uint32_t split_dim, double split_val,
+			const double *lower_le) {
+    nleaves++;
+    leaves_le = (double*)my_realloc(leaves_le, nleaves*ndim*sizeof(double),
+				    "leaves_le in split");
+    leaves_re = (double*)my_realloc(leaves_re, nleaves*ndim*sizeof(double),
+				    "leaves_re in split");
+    double shift = leaves_le[ndim*id_lower+split_dim] - lower_le[split_dim];
+    memcpy(leaves_le+ndim*id_upper, leaves_le+ndim*id_lower,
+	   ndim*sizeof(double));
+    memcpy(leaves_re+ndim*id_upper, leaves_re+ndim*id_lower,
+	   ndim*sizeof(double));
+    leaves_re[ndim*id_lower+split_dim] = split_val + shift;
+    leaves_le[ndim*id_upper+split_dim] = split_val + shift;
+  }
+
+  // Split this leaf at split_val along split_dim. This leaf keeps the
+  // points at or below the split and a new leaf with id id_new is returned
+  // for those above it. Points received from neighbors are dropped and this
+  // leaf is retriangulated. Both leaves will send points to all of their
+  // neighbors at the next exchange.
+  CParallelLeaf* split(uint32_t id_new, uint32_t split_dim,
+		       double split_val) {
+    uint64_t j, nlower = 0, nupper = 0;
+    uint32_t k, n;
+    std::set<uint32_t>::iterator it;
+    std::vector<double> lower_le(le, le + ndim);
+    split_leaf_edges(id, id_new, split_dim, split_val, le);
+    CParallelLeaf *out = new CParallelLeaf(this, id_new);
+    re[split_dim] = split_val;
+    out->le[split_dim] = split_val;
+    periodic_re[split_dim] = 0;
+    out->periodic_le[split_dim] = 0;
+    // The halves border each other along split_dim and border the rest of
+    // this leaf's neighbors in other dimensions if they overlap along
+    // split_dim
+    (*rneigh)[split_dim].clear();
+    (*rneigh)[split_dim].insert(id_new);
+    (*(out->lneigh))[split_dim].clear();
+    (*(out->lneigh))[split_dim].insert(id);
+    for (k = 0; k < ndim; k++) {
+      if (k == split_dim)
+	continue;
+      std::set<uint32_t> *sides[2] = {&((*lneigh)[k]), &((*rneigh)[k])};
+      std::set<uint32_t> *out_sides[2] = {&((*(out->lneigh))[k]),
+					  &((*(out->rneigh))[k])};
+      for (int s = 0; s < 2; s++) {
+	for (it = sides[s]->begin(); it != sides[s]->end(); ) {
+	  n = *it;
+	  if (leaves_re[ndim*n+split_dim] <= out->le[split_dim])
+	    out_sides[s]->erase(n);
+	  if (leaves_le[ndim*n+split_dim] >= re[split_dim])
+	    it = sides[s]->erase(it);
+	  else
+	    it++;
+	}
+      }
+    }
+    reset_neighbors();
+    out->reset_neighbors();
+    // Divide the points assigned to this leaf
+    for (j = 0; j < npts; j++) {
+      if (owned[j]) {
+	if (pts[ndim*j+split_dim] > split_val)
+	  nupper++;
+	else
+	  nlower++;
+      }
+    }
+    Info *idx_lower = (Info*)my_malloc(nlower*sizeof(Info));
+    double *pts_lower = (double*)my_malloc(ndim*nlower*sizeof(double));
+    out->idx = (Info*)my_malloc(nupper*sizeof(Info));
+    out->pts = (double*)my_malloc(ndim*nupper*sizeof(double));
+    nlower = 0;
+    nupper = 0;
+    for (j = 0; j < npts; j++) {
+      if (!(owned[j]))
+	continue;
+      if (pts[ndim*j+split_dim] > split_val) {
+	out->idx[nupper] = idx[j];
+	memcpy(out->pts+ndim*nupper, pts+ndim*j, ndim*sizeof(double));
+	nupper++;
+      } else {
+	idx_lower[nlower] = idx[j];
+	memcpy(pts_lower+ndim*nlower, pts+ndim*j, ndim*sizeof(double));
+	nlower++;
+      }
+    }
+    free(idx);
+    if (owns_pts)
+      free(pts);
+    idx = idx_lower;
+    pts = pts_lower;
+    owns_pts = true;
+    npts = nlower;
+    owned.assign(npts, true);
+    out->npts = nupper;
+    out->owned.assign(nupper, true);
+    // Retriangulate
+    delete(T);
+    T = NULL;
+    tess_exists = false;
+    init_triangulation();
+    if (DEBUG > 1)
+      printf("%d: Split into %d (%lu points) and %d (%lu points) on %d\n",
+	     id, id, nlower, id_new, nupper, rank);
+    return out;
+  }
+
+  // Update this leaf's neighbors after leaf id_lower, with edges lower_le
+  // and lower_re, has been split into itself and id_upper (see split).
+  // Leaves that are still neighbors are marked to receive points at the
+  // next exchange.
+  void add_split(uint32_t id_lower, uint32_t id_upper, uint32_t split_dim,
+		 double split_val, const double *lower_le,
+		 const double *lower_re) {
+    uint32_t k;
+    bool was_neighbor = false;
+    split_leaf_edges(id_lower, id_upper, split_dim, split_val, lower_le);
+    for (k = 0; k < ndim; k++) {
+      std::set<uint32_t> *sides[2] = {&((*lneigh)[k]), &((*rneigh)[k])};
+      for (int s = 0; s < 2; s++) {
+	if (sides[s]->count(id_lower) == 0)
+	  continue;
+	was_neighbor = true;
+	if (k == split_dim) {
+	  // Only the upper half borders leaves to the right of the split leaf
+	  if (s == 0) {
+	    sides[s]->erase(id_lower);
+	    sides[s]->insert(id_upper);
+	  }
+	} else {
+	  if ((le[split_dim] >= split_val) ||
+	      (re[split_dim] <= lower_le[split_dim]))
+	    sides[s]->erase(id_lower);
+	  if ((re[split_dim] > split_val) &&
+	      (le[split_dim] < lower_re[split_dim]))
+	    sides[s]->insert(id_upper);
+	}
+      }
+    }
+    if (!(was_neighbor))
+      return;
+    all_neigh->erase(id_lower);
+    neigh->erase(id_lower);
+    for (k = 0; k < ndim; k++) {
+      if ((*lneigh)[k].count(id_lower) || (*rneigh)[k].count(id_lower))
+	neigh->insert(id_lower);
+      if ((*lneigh)[k].count(id_upper) || (*rneigh)[k].count(id_upper))
+	neigh->insert(id_upper);
+    }
+  }
+
+  // Mark all neighbors as needing points at the next exchange
+  void reset_neighbors() {
+    uint32_t k;
+    neigh->clear();
+    all_neigh->clear();
+    for (k = 0; k < ndim; k++) {
+      neigh->insert((*lneigh)[k].begin(), (*lneigh)[k].end());
+      neigh->insert((*rneigh)[k].begin(), (*rneigh)[k].end());
+    }
+    neigh->erase(id);
+  }
+
 };
 
 
-template <typename Info_>
+template <typename Info_, typename Coord_ = double>
 class ParallelDelaunay_with_info_D
 {
 public:
   typedef Info_ Info;
+  typedef Coord_ Coord;
   int rank;
   int size;
   uint32_t ndim;
   int tree_exists = 0;
   int limit_mem = 0;
+  int reorder = 0;
+  double rebalance = 0.0;
   char unique_str[MAXLEN_FILENAME];
+  char tree_file[MAXLEN_FILENAME];
   // Things only valid for root
   double *le;
   double *re;
@@ -897,20 +1411,33 @@ public:
   uint64_t npts_prev = 0;
   uint64_t npts_total;
   int nleaves_total;
-  double *pts_total = NULL;
+  Coord *pts_total = NULL;
+  // Points the ParallelKDTree is built on. These are pts_total unless Coord
+  // is not double, in which case they are a copy owned by this object.
+  double *pts_tree = NULL;
   uint64_t *idx_total = NULL;
   Info *info_total = NULL;
+  bool pts_reordered = false;
   KDTree *tree = NULL;
+  KDTreeFile *tree_index = NULL;
+  std::vector<FlatNode> route_nodes;
+  std::vector<uint32_t> route_leaves;
+  std::vector<uint64_t> leaf_counts;
   ParallelKDTree *ptree = NULL;
   // Things for each process
   int nleaves;
-  std::vector<CParallelLeaf<Info>*> leaves;
+  std::vector<CParallelLeaf<Info, Coord>*> leaves;
   std::map<int,uint32_t> map_id2idx;
+  // Leaves that have been split by rebalance_leaves and so no longer hold
+  // a slice of the tree's points
+  std::vector<uint8_t> leaf_rebalanced;
 
   ParallelDelaunay_with_info_D() {}
   ParallelDelaunay_with_info_D(uint32_t ndim0, double *le0, double *re0,
 			       bool *periodic0, int limit_mem0 = 0,
-			       const char* unique_str0 = "") {
+			       const char* unique_str0 = "", int reorder0 = 0,
+			       const char* tree_file0 = "",
+			       double rebalance0 = 0.0) {
     MPI_Comm_size ( MPI_COMM_WORLD, &size);
     MPI_Comm_rank ( MPI_COMM_WORLD, &rank);
     if (DEBUG)
@@ -920,9 +1447,13 @@ public:
     re = re0;
     periodic = periodic0;
     limit_mem = limit_mem0;
+    reorder = reorder0;
+    rebalance = rebalance0;
     std::strcpy(unique_str, unique_str0);
+    std::strcpy(tree_file, tree_file0);
     MPI_Bcast(&ndim, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
     MPI_Bcast(&limit_mem, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&rebalance, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
     MPI_Bcast(&unique_str, MAXLEN_FILENAME, MPI_CHAR, 0, MPI_COMM_WORLD);
     if (DEBUG)
       printf("%d: Finishing init\n", rank);
@@ -932,7 +1463,8 @@ public:
     if (DEBUG)
       printf("%d: Beginning dealloc\n", rank);
     int i;
-    if (idx_total != NULL)
+    restore_order();
+    if ((idx_total != NULL) && (tree_index == NULL))
       free(idx_total);
     if (info_total != NULL)
       free(info_total);
@@ -941,13 +1473,17 @@ public:
     }
     if (tree != NULL)
       delete(tree);
+    if (tree_index != NULL)
+      delete(tree_index);
+    if ((pts_tree != NULL) && ((void*)pts_tree != (void*)pts_total))
+      free(pts_tree);
     if (ptree != NULL)
       delete(ptree);
     if (DEBUG)
       printf("%d: Finishing dealloc\n", rank);
   }
 
-  void insert(uint64_t npts0, double *pts0) {
+  void insert(uint64_t npts0, Coord *pts0) {
     if (DEBUG)
       printf("%d: Beginning insert\n", rank);
     int i;
@@ -958,6 +1494,8 @@ public:
       npts_total = npts0;
       pts_total = pts0;
       domain_decomp();
+      // Split leaves on every process only report volumes for these points
+      MPI_Bcast(&npts_total, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
       for (i = 0; i < nleaves; i++) {
 	if (limit_mem > 1)
 	  leaves[i]->load();
@@ -967,44 +1505,45 @@ public:
       }
     } else {
       Info *iidx = NULL;
-      double *ipts = NULL;
+      Coord *ipts = NULL;
+      double *dpts = NULL;
       // Assign points to leaves based on initial domain decomp
       if (rank == 0) {
 	// Assign each point to an existing leaf
-      	std::vector<std::vector<uint64_t>> dist;
-      	for (i = 0; i < nleaves_total; i++) {
-      	  dist.push_back(std::vector<uint64_t>());
-      	  dist[i].reserve(npts0/nleaves_total+1);
-      	}
-	int cnt = 0;
-      	for (j = 0; j < npts0; j++) {
-	  Node *res = tree->search(pts0+ndim*j);
-	  if (res != NULL)
-	    dist[res->leafid].push_back(j);
-	  else
-	    cnt++;
-	}
+	std::vector<uint32_t> leafids(npts0);
+	std::vector<uint64_t> order(npts0);
+	std::vector<uint64_t> offsets(nleaves_total+2);
+	route_points(npts0, pts0, leafids.data(), order.data(),
+		     offsets.data());
+	for (i = 0; i < nleaves_total; i++)
+	  leaf_counts[i] += offsets[i+1] - offsets[i];
+	uint64_t cnt = offsets[nleaves_total+1] - offsets[nleaves_total];
 	if (cnt > 0) {
-	    printf("%d points were not within the bounds of the original domain decomposition\n",
-		   cnt);
+	    printf("%lu points were not within the bounds of the original domain decomposition\n",
+		   (unsigned long)cnt);
 	}
 	// Send new points to leaf
       	int nsend, task;
 	int iroot = 0;
+	uint64_t *ord;
       	for (i = 0; i < nleaves_total; i++) {
       	  task = i % size;
-      	  nsend = (int)(dist[i].size());
+      	  nsend = (int)(offsets[i+1] - offsets[i]);
+	  ord = order.data() + offsets[i];
 	  iidx = (Info*)my_realloc(iidx, nsend*sizeof(Info));
-	  ipts = (double*)my_realloc(ipts, ndim*nsend*sizeof(double));
+	  ipts = (Coord*)my_realloc(ipts, ndim*nsend*sizeof(Coord));
 	  for (j = 0; j < (uint64_t)nsend; j++) {
-	    iidx[j] = dist[i][j] + npts_prev;
+	    iidx[j] = ord[j] + npts_prev;
 	    for (k = 0; k < ndim; k++) 
-	      ipts[ndim*j+k] = pts0[ndim*dist[i][j]+k];
+	      ipts[ndim*j+k] = pts0[ndim*ord[j]+k];
 	  }
       	  if (task == rank) {
 	    if (limit_mem > 1)
 	      leaves[iroot]->load();
-	    leaves[iroot]->insert(ipts, iidx, nsend); // leaves used
+	    dpts = widen_pts(ipts, ndim*nsend);
+	    leaves[iroot]->insert(dpts, iidx, nsend); // leaves used
+	    if ((void*)dpts != (void*)ipts)
+	      free(dpts);
 	    if (limit_mem > 1)
 	      leaves[iroot]->dump();
 	    iroot++;
@@ -1016,11 +1555,9 @@ public:
 	    else
 	      MPI_Send(iidx, nsend, MPI_UNSIGNED_LONG, task, 21+task,
 		       MPI_COMM_WORLD);
-	    MPI_Send(ipts, ndim*nsend, MPI_DOUBLE, task, 22+task,
-		     MPI_COMM_WORLD);
+	    MPI_Send(ipts, ndim*nsend, mpi_coord_type<Coord>(), task,
+		     22+task, MPI_COMM_WORLD);
       	  }
-	  free(iidx);
-	  free(ipts);
       	}
       } else {
       	int nrecv;
@@ -1028,18 +1565,21 @@ public:
       	  MPI_Recv(&nrecv, 1, MPI_INT, 0, 20+rank, MPI_COMM_WORLD,
       		   MPI_STATUS_IGNORE);
 	  iidx = (Info*)my_realloc(iidx,nrecv*sizeof(Info));
-	  ipts = (double*)my_realloc(ipts,ndim*nrecv*sizeof(double));
+	  ipts = (Coord*)my_realloc(ipts,ndim*nrecv*sizeof(Coord));
 	  if (sizeof(Info) == sizeof(uint32_t))
 	    MPI_Recv(iidx, nrecv, MPI_UNSIGNED, 0, 21+rank,
 		     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 	  else
 	    MPI_Recv(iidx, nrecv, MPI_UNSIGNED_LONG, 0, 21+rank,
 		     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	  MPI_Recv(ipts, ndim*nrecv, MPI_DOUBLE, 0, 22+rank,
+	  MPI_Recv(ipts, ndim*nrecv, mpi_coord_type<Coord>(), 0, 22+rank,
 		   MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 	  if (limit_mem > 0)
 	    leaves[i]->load();
-	  leaves[i]->insert(ipts, iidx, nrecv); // leaves used
+	  dpts = widen_pts(ipts, ndim*nrecv);
+	  leaves[i]->insert(dpts, iidx, nrecv); // leaves used
+	  if ((void*)dpts != (void*)ipts)
+	    free(dpts);
 	  if (limit_mem > 0)
 	    leaves[i]->dump();
       	}
@@ -1049,6 +1589,7 @@ public:
       if (ipts != NULL)
 	free(ipts);
     }
+    rebalance_leaves();
     // Exchange points
     exchange();
     npts_prev += npts0;
@@ -1257,18 +1798,18 @@ public:
     free(nct_send);
     // Allocate for arrays
     (*idx_recv) = (Info*)my_malloc(prev_array_recv*sizeof(Info));
-    (*pts_recv) = (double*)my_malloc(ndim*prev_array_recv*sizeof(double));
+    Coord *pts_recv_coord = (Coord*)my_malloc(ndim*prev_array_recv*sizeof(Coord));
     (*ngh_recv) = (uint32_t*)my_malloc(prev_neigh_recv*sizeof(uint32_t));
     Info *idx_send = (Info*)my_malloc(prev_array_send*sizeof(Info));
-    double *pts_send = (double*)my_malloc(ndim*prev_array_send*sizeof(double));
+    Coord *pts_send = (Coord*)my_malloc(ndim*prev_array_send*sizeof(Coord));
     uint32_t *ngh_send = (uint32_t*)my_malloc(prev_neigh_send*sizeof(uint32_t));
     Info *idx_send_curr = idx_send;
-    double *pts_send_curr = pts_send;
+    Coord *pts_send_curr = pts_send;
     uint32_t *ngh_send_curr = ngh_send;
     for (i = 0; i < size; i++) {
       if (count_idx_send[i] > 0) {
     	memmove(idx_send_curr, idx_out[i], count_idx_send[i]*sizeof(Info));
-    	memmove(pts_send_curr, pts_out[i], count_pts_send[i]*sizeof(double));
+    	std::copy(pts_out[i], pts_out[i] + count_pts_send[i], pts_send_curr);
     	idx_send_curr += count_idx_send[i];
     	pts_send_curr += count_pts_send[i];
       }
@@ -1289,9 +1830,12 @@ public:
       MPI_Alltoallv(idx_send, count_idx_send, offset_idx_send, MPI_UNSIGNED_LONG,
 		    *idx_recv, count_idx_recv, offset_idx_recv, MPI_UNSIGNED_LONG,
 		    MPI_COMM_WORLD);
-    MPI_Alltoallv(pts_send, count_pts_send, offset_pts_send, MPI_DOUBLE,
-    		  *pts_recv, count_pts_recv, offset_pts_recv, MPI_DOUBLE,
-    		  MPI_COMM_WORLD);
+    MPI_Alltoallv(pts_send, count_pts_send, offset_pts_send,
+		  mpi_coord_type<Coord>(), pts_recv_coord, count_pts_recv,
+		  offset_pts_recv, mpi_coord_type<Coord>(), MPI_COMM_WORLD);
+    (*pts_recv) = widen_pts(pts_recv_coord, ndim*prev_array_recv);
+    if ((void*)(*pts_recv) != (void*)pts_recv_coord)
+      free(pts_recv_coord);
     MPI_Alltoallv(ngh_send, count_ngh_send, offset_ngh_send, MPI_UNSIGNED,
     		  *ngh_recv, count_ngh_recv, offset_ngh_recv, MPI_UNSIGNED,
     		  MPI_COMM_WORLD);
@@ -1324,31 +1868,55 @@ public:
     if (DEBUG)
       printf("%d: Beginning domain decomposition\n", rank);
     if (rank == 0) {
-      // Create KDtree
+      // Create KDtree. This is cykdtree's tree, which always splits at the
+      // median, so the split policies of domain_decomp's KDTree are not
+      // available here.
       uint32_t leafsize;
       nleaves_total = size;
       nleaves_total = (int)(pow(2,ceil(log2((float)(nleaves_total)))));
       if (limit_mem > 1)
 	nleaves_total *= limit_mem;
       leafsize = std::max((uint32_t)(npts_total/nleaves_total + 1), (ndim+1));
-      idx_total = (uint64_t*)my_malloc(npts_total*sizeof(uint64_t));
-      for (j = 0; j < npts_total; j++)
-	idx_total[j] = j;
-      tree = new KDTree(pts_total, idx_total, npts_total, ndim,
-		        leafsize, le, re, periodic, false);
-      tree->consolidate_edges();
+      if (!(load_tree())) {
+	// The KDTree only takes double points, so single precision points
+	// are widened while it is built. Leaves are then taken from
+	// pts_total, so no widened copy of every point is kept.
+	double *pts_build = widen_pts(pts_total, ndim*npts_total);
+	idx_total = (uint64_t*)my_malloc(npts_total*sizeof(uint64_t));
+	for (j = 0; j < npts_total; j++)
+	  idx_total[j] = j;
+	tree = new KDTree(pts_build, idx_total, npts_total, ndim,
+			  leafsize, le, re, periodic, false);
+	tree->consolidate_edges();
+	if (strlen(tree_file) > 0)
+	  save_tree();
+	if ((void*)pts_build != (void*)pts_total) {
+	  free(pts_build);
+	  tree->all_pts = NULL;
+	}
+      }
+      if (reorder) {
+	// Permute points into leaf order so each leaf is a contiguous slice.
+	// idx_total records the permutation and is used to restore the order.
+	permute_pts(pts_total, idx_total, npts_total, ndim,
+		    (limit_mem > 0));
+	pts_reordered = true;
+      }
       // info_total = (Info*)my_malloc(npts_total*sizeof(Info));
       // for (j = 0; j < npts_total; j++)
       // 	info_total[j] = idx_total[j];
-      nleaves_total = tree->num_leaves;
+      nleaves_total = num_tree_leaves();
+      for (i = 0; i < nleaves_total; i++)
+	leaf_counts.push_back(leaf_npts(i));
     }
     MPI_Bcast(&nleaves_total, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    leaf_rebalanced.assign(nleaves_total, 0);
     // Send number of leaves
     if (rank == 0) {
       nleaves_per_proc = (int*)my_malloc(sizeof(int)*size);
       for (i = 0; i < size; i++)
 	nleaves_per_proc[i] = 0;
-      for (k = 0; k < tree->num_leaves; k++) {
+      for (k = 0; k < (uint32_t)nleaves_total; k++) {
 	nleaves_per_proc[k % size]++;
       }
     }
@@ -1360,8 +1928,8 @@ public:
     // Make sure leaves meet minimum criteria
     if (rank == 0) {
       for (i = 0; i < nleaves_total; i++) {
-	if (tree->leaves[i]->children < (ndim+1)) {
-	  leafsize_limit = tree->leaves[i]->children;
+	if (leaf_npts(i) < (ndim+1)) {
+	  leafsize_limit = leaf_npts(i);
 	  break;
 	}
       }
@@ -1379,16 +1947,15 @@ public:
 	task = i % size;
 	if (task == rank) {
 	  // leaves used
-	  leaves.push_back(new CParallelLeaf<Info>(nleaves_total, ndim,
-						   unique_str,
-						   tree, i));
+	  leaves.push_back(new_root_leaf(i));
 	  if (limit_mem > 1)
 	    leaves[iroot]->dump();
 	  map_id2idx[leaves[iroot]->id] = iroot;
 	  iroot++;
 	} else {
-	  CParallelLeaf<Info> ileaf(nleaves_total, ndim, unique_str, tree, i);
-	  ileaf.send(task);
+	  CParallelLeaf<Info, Coord> *ileaf = new_root_leaf(i);
+	  ileaf->send(task);
+	  delete(ileaf);
 	}
       }
       tree_exists = 1;
@@ -1397,7 +1964,7 @@ public:
     } else {
       for (i = 0; i < nleaves; i++) {
 	// leaves used
-	leaves.push_back(new CParallelLeaf<Info>(nleaves_total, ndim,
+	leaves.push_back(new CParallelLeaf<Info, Coord>(nleaves_total, ndim,
 						 unique_str, 0)); // calls recv
 	if (limit_mem > 1)
 	  leaves[i]->dump();
@@ -1412,6 +1979,347 @@ public:
       printf("%d: Finished domain decomposition\n", rank);
   }
 
+  // Leaves of the decomposition on root, from either the tree built by
+  // domain_decomp or a tree loaded from tree_file
+  uint32_t num_tree_leaves() {
+    if (tree_index != NULL)
+      return tree_index->num_leaves;
+    return tree->num_leaves;
+  }
+  uint64_t leaf_npts(int i) {
+    if (tree_index != NULL)
+      return tree_index->leaf(i)->children;
+    return tree->leaves[i]->children;
+  }
+  uint64_t leaf_start(int i) {
+    if (tree_index != NULL)
+      return tree_index->leaf(i)->left_idx;
+    return tree->leaves[i]->left_idx;
+  }
+  bool is_rebalanced(int i) {
+    return (((size_t)i < leaf_rebalanced.size()) && leaf_rebalanced[i]);
+  }
+  // Group new points by the leaf containing them (see flat_kdtree_route).
+  // The decomposition is copied to flat nodes on first use so points are
+  // routed over the same node layout whether it was built or loaded from
+  // tree_file, and so leaves split by rebalance_leaves can be added to it.
+  void init_route_nodes() {
+    if (!(route_nodes.empty()))
+      return;
+    if (tree_index != NULL) {
+      route_nodes.assign(tree_index->nodes,
+			 tree_index->nodes + tree_index->num_nodes);
+      route_leaves.assign(tree_index->leaves,
+			  tree_index->leaves + tree_index->num_leaves);
+    } else {
+      route_leaves.resize(tree->num_leaves);
+      flatten_tree(route_nodes, NULL, NULL, &route_leaves);
+    }
+  }
+  void route_points(uint64_t n, Coord *pts, uint32_t *leafids,
+		    uint64_t *order, uint64_t *offsets) {
+    uint32_t nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+    init_route_nodes();
+    flat_kdtree_route(&route_nodes[0], (uint32_t)route_nodes.size(),
+		      (uint32_t)nleaves_total, le, re, ndim, pts, n, leafids,
+		      order, offsets, nthreads);
+  }
+  CParallelLeaf<Info, Coord>* new_root_leaf(int i) {
+    if (tree_index != NULL)
+      return new CParallelLeaf<Info, Coord>(nleaves_total, ndim, unique_str,
+				     tree_index, pts_total, i, pts_reordered);
+    return new CParallelLeaf<Info, Coord>(nleaves_total, ndim, unique_str,
+				   tree, pts_total, i, pts_reordered);
+  }
+
+  // Split leaves that have been assigned more than rebalance times the mean
+  // number of points per leaf. Called after each batch of insertions, so
+  // each leaf is split at most once per batch.
+  void rebalance_leaves() {
+    int i, nsplit = 0;
+    std::vector<uint32_t> split_ids;
+    if (rebalance <= 0)
+      return;
+    if (rank == 0) {
+      uint64_t ntot = 0;
+      for (i = 0; i < nleaves_total; i++)
+	ntot += leaf_counts[i];
+      double limit = rebalance*(double)ntot/(double)nleaves_total;
+      for (i = 0; i < nleaves_total; i++) {
+	if ((double)(leaf_counts[i]) > limit)
+	  split_ids.push_back(i);
+      }
+      nsplit = (int)(split_ids.size());
+    }
+    MPI_Bcast(&nsplit, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    split_ids.resize(nsplit);
+    MPI_Bcast(split_ids.data(), nsplit, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    for (i = 0; i < nsplit; i++)
+      split_leaf(split_ids[i]);
+  }
+
+  // Split leaf id at the median of its points (see CParallelLeaf::split).
+  // The upper half becomes leaf nleaves_total and is moved to the process
+  // that owns that id, so the rest of the decomposition is untouched.
+  void split_leaf(uint32_t id) {
+    int i;
+    int src = id % size;
+    uint32_t id_new = (uint32_t)nleaves_total;
+    int dst = id_new % size;
+    uint32_t split_dim = 0;
+    double split_val = 0.0;
+    CParallelLeaf<Info, Coord> *lower = NULL, *upper = NULL;
+    // Split dimension (negative if the leaf cannot be split), split value,
+    // points in each half, and edges of the leaf before the split
+    std::vector<double> desc(4 + 2*ndim, -1.0);
+    if (rank == src) {
+      lower = leaves[map_id2idx[id]];
+      if (limit_mem > 1)
+	lower->load();
+      if (lower->choose_split(split_dim, split_val)) {
+	desc[0] = (double)split_dim;
+	desc[1] = split_val;
+	std::copy(lower->le, lower->le + ndim, desc.begin() + 4);
+	std::copy(lower->re, lower->re + ndim, desc.begin() + 4 + ndim);
+	upper = lower->split(id_new, split_dim, split_val);
+	desc[2] = (double)(lower->npts);
+	desc[3] = (double)(upper->npts);
+      }
+      if (limit_mem > 1)
+	lower->dump();
+    }
+    MPI_Bcast(desc.data(), (int)(desc.size()), MPI_DOUBLE, src,
+	      MPI_COMM_WORLD);
+    if (desc[0] < 0)
+      return;
+    split_dim = (uint32_t)(desc[0]);
+    split_val = desc[1];
+    nleaves_total++;
+    leaf_rebalanced[id] = 1;
+    leaf_rebalanced.push_back(1);
+    for (i = 0; i < nleaves; i++) {
+      if (leaves[i]->id != id)
+	leaves[i]->add_split(id, id_new, split_dim, split_val,
+			     &desc[4], &desc[4+ndim]);
+    }
+    // Move the upper half to its process. New ids are larger than all
+    // others, so leaves stay in order of id on each process.
+    if (rank == dst) {
+      if (src != dst)
+	upper = new CParallelLeaf<Info, Coord>(nleaves_total, ndim,
+					       unique_str, src); // calls recv
+      upper->init_triangulation();
+      if (limit_mem > 1)
+	upper->dump();
+      leaves.push_back(upper);
+      map_id2idx[id_new] = nleaves;
+      nleaves++;
+    } else if (rank == src) {
+      upper->send(dst);
+      delete(upper);
+    }
+    if (rank == 0) {
+      leaf_counts[id] = (uint64_t)(desc[2]);
+      leaf_counts.push_back((uint64_t)(desc[3]));
+      split_route_node(id, id_new, split_dim, split_val);
+    }
+    if (DEBUG)
+      printf("%d: Split leaf %u into %u and %u\n", rank, id, id, id_new);
+  }
+
+  // Replace leaf id in the routing nodes by a node splitting it between id
+  // and id_new
+  void split_route_node(uint32_t id, uint32_t id_new, uint32_t split_dim,
+			double split_val) {
+    init_route_nodes();
+    uint32_t inode = route_leaves[id];
+    uint32_t n = (uint32_t)(route_nodes.size());
+    FlatNode lower = route_nodes[inode];
+    FlatNode upper = route_nodes[inode];
+    lower.children = leaf_counts[id];
+    upper.children = leaf_counts[id_new];
+    upper.leafid = id_new;
+    route_nodes[inode].leafid = FLAT_KDTREE_NONE;
+    route_nodes[inode].split_dim = split_dim;
+    route_nodes[inode].split = split_val;
+    route_nodes[inode].less = n;
+    route_nodes[inode].greater = n + 1;
+    route_nodes.push_back(lower);
+    route_nodes.push_back(upper);
+    route_leaves[id] = n;
+    route_leaves.push_back(n + 1);
+  }
+
+  // Map a tree saved to tree_file by an earlier run instead of building
+  // one. Returns false if there is no usable file, in which case the tree
+  // should be built (and is then saved to tree_file).
+  bool load_tree() {
+    if (strlen(tree_file) == 0)
+      return false;
+    if (access(tree_file, F_OK) != 0)
+      return false;
+    KDTreeFile *index = NULL;
+    try {
+      index = new KDTreeFile(tree_file);
+    } catch (std::exception &e) {
+      printf("%d: %s. The tree will be rebuilt.\n", rank, e.what());
+      return false;
+    }
+    bool match = ((index->npts == npts_total) && (index->ndim == ndim));
+    for (uint32_t k = 0; match && (k < ndim); k++) {
+      if ((index->domain_left_edge()[k] != le[k]) ||
+	  (index->domain_right_edge()[k] != re[k]) ||
+	  ((bool)(index->periodic[k]) != periodic[k]))
+	match = false;
+    }
+    if (!(match)) {
+      printf("%d: Tree file %s does not match the points or domain. "
+	     "The tree will be rebuilt.\n", rank, tree_file);
+      delete(index);
+      return false;
+    }
+    tree_index = index;
+    idx_total = tree_index->all_idx;
+    if (DEBUG)
+      printf("%d: Loaded tree from %s\n", rank, tree_file);
+    return true;
+  }
+
+  // Copy the nodes of the tree built by domain_decomp to nodes in pre-order.
+  // Node edges and the node index of each leaf are also recorded if the
+  // corresponding vectors are provided.
+  void flatten_tree(std::vector<FlatNode> &nodes,
+		    std::vector<double> *node_le = NULL,
+		    std::vector<double> *node_re = NULL,
+		    std::vector<uint32_t> *leaf_nodes = NULL) {
+    std::vector<Node*> stack;
+    std::vector<uint32_t> parents;
+    nodes.clear();
+    // Nodes in pre-order, with each child linked from its parent
+    stack.push_back(tree->root);
+    parents.push_back(FLAT_KDTREE_NONE);
+    while (!(stack.empty())) {
+      Node *node = stack.back();
+      uint32_t parent = parents.back();
+      stack.pop_back();
+      parents.pop_back();
+      uint32_t i = (uint32_t)nodes.size();
+      FlatNode out;
+      out.left_idx = node->left_idx;
+      out.children = node->children;
+      out.split = 0.0;
+      out.split_dim = 0;
+      out.leafid = FLAT_KDTREE_NONE;
+      out.less = FLAT_KDTREE_NONE;
+      out.greater = FLAT_KDTREE_NONE;
+      if (parent != FLAT_KDTREE_NONE) {
+	if (nodes[parent].less == FLAT_KDTREE_NONE)
+	  nodes[parent].less = i;
+	else
+	  nodes[parent].greater = i;
+      }
+      if (node->is_leaf) {
+	out.leafid = node->leafid;
+	if (leaf_nodes != NULL)
+	  (*leaf_nodes)[node->leafid] = i;
+      } else {
+	out.split_dim = node->split_dim;
+	out.split = node->split;
+	stack.push_back(node->greater);
+	parents.push_back(i);
+	stack.push_back(node->less);
+	parents.push_back(i);
+      }
+      nodes.push_back(out);
+      if (node_le != NULL)
+	node_le->insert(node_le->end(), node->left_edge,
+			node->left_edge + ndim);
+      if (node_re != NULL)
+	node_re->insert(node_re->end(), node->right_edge,
+			node->right_edge + ndim);
+    }
+  }
+
+  // Write the tree built by domain_decomp to tree_file
+  void save_tree() {
+    uint32_t k, l, n;
+    std::vector<FlatNode> nodes;
+    std::vector<double> node_le, node_re;
+    std::vector<uint32_t> leaf_nodes(tree->num_leaves);
+    flatten_tree(nodes, &node_le, &node_re, &leaf_nodes);
+    // Neighbor lists
+    std::vector<double> domain(4*ndim);
+    std::vector<uint8_t> domain_periodic(ndim);
+    std::vector<uint8_t> leaf_periodic(2*ndim*tree->num_leaves);
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> neighbors;
+    for (k = 0; k < ndim; k++) {
+      domain[k] = le[k];
+      domain[ndim+k] = re[k];
+      domain[2*ndim+k] = tree->domain_mins[k];
+      domain[3*ndim+k] = tree->domain_maxs[k];
+      domain_periodic[k] = periodic[k];
+    }
+    for (l = 0; l < tree->num_leaves; l++) {
+      Node *node = tree->leaves[l];
+      for (k = 0; k < ndim; k++) {
+	leaf_periodic[2*ndim*l+k] = node->periodic_left[k];
+	leaf_periodic[2*ndim*l+ndim+k] = node->periodic_right[k];
+      }
+      for (k = 0; k < ndim; k++) {
+	offsets.push_back(neighbors.size());
+	neighbors.insert(neighbors.end(), node->left_neighbors[k].begin(),
+			 node->left_neighbors[k].end());
+      }
+      for (k = 0; k < ndim; k++) {
+	offsets.push_back(neighbors.size());
+	neighbors.insert(neighbors.end(), node->right_neighbors[k].begin(),
+			 node->right_neighbors[k].end());
+      }
+      offsets.push_back(neighbors.size());
+      neighbors.insert(neighbors.end(), node->all_neighbors.begin(),
+		       node->all_neighbors.end());
+    }
+    offsets.push_back(neighbors.size());
+    n = (uint32_t)nodes.size();
+    KDTreeFile file;
+    file.ndim = ndim;
+    file.npts = npts_total;
+    file.leafsize = tree->leafsize;
+    file.num_nodes = n;
+    file.num_leaves = tree->num_leaves;
+    file.num_neighbors = neighbors.size();
+    file.domain = domain.data();
+    file.periodic = domain_periodic.data();
+    file.nodes = nodes.data();
+    file.left_edges = node_le.data();
+    file.right_edges = node_re.data();
+    file.all_idx = idx_total;
+    file.leaves = leaf_nodes.data();
+    file.leaf_periodic = leaf_periodic.data();
+    file.neighbor_offsets = offsets.data();
+    file.neighbors = neighbors.data();
+    try {
+      file.save(tree_file);
+      if (DEBUG)
+	printf("%d: Saved tree to %s\n", rank, tree_file);
+    } catch (std::exception &e) {
+      printf("%d: %s\n", rank, e.what());
+    }
+  }
+
+  void restore_order() {
+    // Return points permuted by domain_decomp to the caller's order
+    if (pts_reordered) {
+      typename std::vector<CParallelLeaf<Info, Coord>*>::iterator it;
+      for (it = leaves.begin(); it != leaves.end(); it++)
+	(*it)->detach();
+      unpermute_pts(pts_total, idx_total, npts_total, ndim,
+		    (limit_mem > 0));
+      pts_reordered = false;
+    }
+  }
+
   void parallel_domain_decomp() {
     int i;
     uint64_t j;
@@ -1431,9 +2339,10 @@ public:
       idx_total = (uint64_t*)my_malloc(npts_total*sizeof(uint64_t));
       for (j = 0; j < npts_total; j++)
 	idx_total[j] = j;
+      pts_tree = widen_pts(pts_total, ndim*npts_total);
     }
     // Create tree
-    ptree = new ParallelKDTree(pts_total, idx_total, npts_total, ndim,
+    ptree = new ParallelKDTree(pts_tree, idx_total, npts_total, ndim,
 			       leafsize, le, re, periodic, false);
     nleaves_total = ptree->tot_num_leaves;
     nleaves = ptree->tree->num_leaves;
@@ -1460,7 +2369,7 @@ public:
       // 			       leafsize_limit, );
     // Create leaves from tree nodes
     for (i = 0; i < nleaves; i++) {
-      leaves.push_back(new CParallelLeaf<Info>(nleaves_total, ndim,
+      leaves.push_back(new CParallelLeaf<Info, Coord>(nleaves_total, ndim,
 					       unique_str, ptree, i));
       if (limit_mem > 1)
 	leaves[i]->dump();
@@ -1492,13 +2401,43 @@ public:
       printf("%d: Beginning consolidate_vols\n", rank);
     int i, iroot, task;
     double *ivols = NULL;
+    Info *iidx = NULL;
     int j;
     int nvols;
+    MPI_Datatype mpi_info = MPI_UNSIGNED_LONG;
+    if (sizeof(Info) == sizeof(uint32_t))
+      mpi_info = MPI_UNSIGNED;
     if (rank == 0) {
       iroot = 0;
       for (i = 0; i < nleaves_total; i++) {
-	nvols = tree->leaves[i]->children;
 	task = i % size;
+	if (is_rebalanced(i)) {
+	  // Split leaves send the tree index of each volume
+	  if (task == rank) {
+	    if (limit_mem > 1)
+	      leaves[iroot]->load();
+	    nvols = (int)(leaves[iroot]->owned_volumes(npts_total, &iidx,
+							&ivols));
+	    if (limit_mem > 1)
+	      leaves[iroot]->dump();
+	    iroot++;
+	  } else {
+	    MPI_Recv(&nvols, 1, MPI_INT, task, 0, MPI_COMM_WORLD,
+		     MPI_STATUS_IGNORE);
+	    iidx = (Info*)my_realloc(iidx, nvols*sizeof(Info),
+				     "volume indices being received");
+	    ivols = (double*)my_realloc(ivols, nvols*sizeof(double),
+					"volumes being received");
+	    MPI_Recv(iidx, nvols, mpi_info, task, 0, MPI_COMM_WORLD,
+		     MPI_STATUS_IGNORE);
+	    MPI_Recv(ivols, nvols, MPI_DOUBLE, task, 0, MPI_COMM_WORLD,
+		     MPI_STATUS_IGNORE);
+	  }
+	  for (j = 0; j < nvols; j++)
+	    vols[idx_total[iidx[j]]] = ivols[j];
+	  continue;
+	}
+	nvols = leaf_npts(i);
 	if (task == rank) {
 	  // Local
 	  if (limit_mem > 1)
@@ -1514,11 +2453,22 @@ public:
 		   MPI_STATUS_IGNORE);
 	}
 	for (j = 0; j < nvols; j++) {
-	  vols[tree->all_idx[tree->leaves[i]->left_idx+j]] = ivols[j];
+	  vols[idx_total[leaf_start(i)+j]] = ivols[j];
 	}
       }
     } else {
       for (i = 0; i < nleaves; i++) {
+	if (is_rebalanced(leaves[i]->id)) {
+	  if (limit_mem > 1)
+	    leaves[i]->load();
+	  nvols = (int)(leaves[i]->owned_volumes(npts_total, &iidx, &ivols));
+	  if (limit_mem > 1)
+	    leaves[i]->dump();
+	  MPI_Send(&nvols, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
+	  MPI_Send(iidx, nvols, mpi_info, 0, 0, MPI_COMM_WORLD);
+	  MPI_Send(ivols, nvols, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+	  continue;
+	}
 	nvols = leaves[i]->npts_orig;
 	if (limit_mem > 1)
 	  leaves[i]->load();
@@ -1528,6 +2478,11 @@ public:
 	MPI_Send(ivols, nvols, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
       }
     }
+    if (ivols != NULL)
+      free(ivols);
+    if (iidx != NULL)
+      free(iidx);
+    restore_order();
     if (DEBUG)
       printf("%d: Finished consolidate_vols\n", rank);
   }
@@ -1613,8 +2568,15 @@ public:
     	}
     	// Insert serialized leaf
 	// leaves used
-    	idx_start = tree->leaves[i]->left_idx;
-    	idx_stop = idx_start + tree->leaves[i]->children;
+	// Split leaves no longer own a range of the tree's points, so all of
+	// their cells are checked for duplicates
+	if (is_rebalanced(i)) {
+	  idx_start = 0;
+	  idx_stop = 0;
+	} else {
+	  idx_start = leaf_start(i);
+	  idx_stop = idx_start + leaf_npts(i);
+	}
     	sleaf = SerializedLeaf<Info>(i, ndim, (int64_t)tm, idx_inf,
 				     verts, neigh,
 				     idx_verts, idx_cells,
@@ -1664,6 +2626,7 @@ public:
     free(neigh);
     free(idx_verts);
     free(idx_cells);
+    restore_order();
     if (DEBUG)
       printf("%d: Finished consolidate_tess\n", rank);
     return out;
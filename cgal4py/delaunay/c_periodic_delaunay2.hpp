@@ -10,9 +10,13 @@
 #include <sstream>
 #include <fstream>
 #include <cmath>
+#include <stdexcept>
 #include <algorithm>
 #include <limits>
 #include <stdint.h>
+#include "c_vertex_index.hpp"
+#include "c_box_index.hpp"
+#include "c_dual_volume.hpp"
 #ifdef READTHEDOCS
 #define VALID 1
 #include "dummy_CGAL.hpp"
@@ -30,6 +34,9 @@
 #include <CGAL/Periodic_2_triangulation_vertex_base_2.h>
 #include <CGAL/squared_distance_2.h>
 #include <CGAL/Unique_hash_map.h>
+#include <CGAL/spatial_sort.h>
+#include <CGAL/Spatial_sort_traits_adapter_2.h>
+#include <CGAL/property_map.h>
 #endif
 #endif
 
@@ -142,29 +149,86 @@ public:
       j = 2*i;
       points.push_back( std::make_pair( Point(pts[j],pts[j+1]), val[i]) );
     }
+    if (vertex_index.live()) {
+      insert_indexed(points);
+      return;
+    }
+    vertex_index.invalidate();
     T.insert( points.begin(),points.end() );
   }
-  void remove(Vertex v) { updated = true; T.remove(v._x); }
-  void clear() { updated = true; T.clear(); }
+  // Insert points one at a time in spatial order so that the new vertices
+  // can be added to the vertex index.
+  void insert_indexed(std::vector< std::pair<Point,Info> > &points)
+  {
+    typedef CGAL::Spatial_sort_traits_adapter_2<K,
+      CGAL::First_of_pair_property_map< std::pair<Point,Info> > > Sort_traits;
+    CGAL::spatial_sort(points.begin(), points.end(), Sort_traits());
+    Face_handle hint;
+    Vertex_handle v;
+    std::size_t nverts = T.number_of_vertices();
+    bool existed;
+    for (typename std::vector< std::pair<Point,Info> >::iterator it = points.begin(); it != points.end(); ++it) {
+      v = T.get_original_vertex(T.insert(it->first, hint));
+      existed = (T.number_of_vertices() == nverts);
+      nverts = T.number_of_vertices();
+      vertex_index.inserted(it->second, v, existed,
+                            existed ? v->info() : it->second);
+      v->info() = it->second;
+      hint = v->face();
+    }
+  }
+  void remove(Vertex v) {
+    updated = true;
+    vertex_index.erase(v._x->info());
+    T.remove(v._x);
+  }
+  void clear() { updated = true; vertex_index.invalidate(); T.clear(); }
 
   Vertex move(Vertex v, double *pos) {
     updated = true;
+    Info info = v._x->info();
     Point p = Point(pos[0], pos[1]);
-    return Vertex(T.move_point(v._x, p));
+    Vertex_handle out = T.move_point(v._x, p);
+    moved_vertex_index(info, out);
+    return Vertex(out);
   }
   Vertex move_if_no_collision(Vertex v, double *pos) {
     updated = true;
+    Info info = v._x->info();
     Point p = Point(pos[0], pos[1]);
-    return Vertex(T.move_if_no_collision(v._x, p));
+    Vertex_handle out = T.move_if_no_collision(v._x, p);
+    moved_vertex_index(info, out);
+    return Vertex(out);
   }
 
-  Vertex get_vertex(Info index) const {
+  // Lookup table from info to vertex (see c_vertex_index.hpp), kept up to
+  // date as vertices are added, removed, or moved while it is enabled.
+  mutable VertexIndex<Info, Vertex_handle> vertex_index;
+  template <typename F>
+  void visit_vertices(F f) const {
     Vertex_iterator it = T.vertices_begin();
     for ( ; it != T.vertices_end(); it++) {
-      if (it->info() == index)
-    	return Vertex(T.get_original_vertex(it));
+      if (f(it->info(), T.get_original_vertex(it)))
+        return;
     }
-    return Vertex();
+  }
+  VertexVisitor<const PeriodicDelaunay_with_info_2> vertex_visitor() const {
+    return VertexVisitor<const PeriodicDelaunay_with_info_2>(this);
+  }
+  void set_vertex_index(bool enable) { vertex_index.enable(enable); }
+  void moved_vertex_index(Info info, Vertex_handle out) {
+    vertex_index.moved(info, out, out->info());
+  }
+
+  Vertex get_vertex(Info index) const {
+    Vertex_handle v = Vertex_handle();
+    vertex_index.find(index, vertex_visitor(), T.number_of_vertices(), v);
+    return Vertex(v);
+  }
+  std::vector<Vertex> get_vertices(Info *index, uint64_t n) const {
+    std::vector<Vertex_handle> v = vertex_index.find_many(
+        index, n, vertex_visitor(), T.number_of_vertices(), Vertex_handle());
+    return std::vector<Vertex>(v.begin(), v.end());
   }
 
   Cell locate(double* pos, int& lt, int& li) const {
@@ -598,11 +662,68 @@ public:
     return vol;
   }
 
-  void dual_areas(double* vols) const {
-    Vertex_iterator it = T.vertices_begin();
-    for ( ; it != T.vertices_end(); it++) {
-      vols[it->info()] = dual_area(Vertex(it));
+  double domain_volume() const {
+    Iso_rectangle dom = T.domain();
+    return (dom.xmax() - dom.xmin())*(dom.ymax() - dom.ymin());
+  }
+
+  // One more than the largest info of any vertex (0 if there are none), so
+  // arrays indexed by info can be sized to hold every vertex.
+  uint64_t info_bound() const {
+    uint64_t out = 0;
+    for (Vertex_iterator it = T.vertices_begin(); it != T.vertices_end(); it++) {
+      uint64_t k = (uint64_t)(T.get_original_vertex(it)->info());
+      if (k >= out)
+        out = k + 1;
     }
+    return out;
+  }
+
+  // Voronoi areas of the vertices, indexed by their infos. vols must hold
+  // nvols entries, which are zeroed first, and std::out_of_range is thrown
+  // if any vertex has an info >= nvols (see info_bound). Each stored face
+  // contributes to the areas of its vertices using its positions with
+  // offsets applied, so no face is visited more than once per sheet and
+  // each circumcenter is computed once. Faces are divided between nthreads
+  // threads if CGAL is linked with TBB. Returns the sum of the areas,
+  // which should be the area of the domain.
+  double dual_areas(double* vols, uint64_t nvols, int nthreads = 1) const {
+    std::vector<Face_handle> faces;
+    faces.reserve(T.number_of_stored_faces());
+    for (Face_iterator it = T.tds().faces_begin(); it != T.tds().faces_end(); it++)
+      faces.push_back(it);
+    std::vector<double> contrib(3*faces.size(), 0.0);
+    parallel_for_ranges(faces.size(), nthreads, [&](uint64_t begin, uint64_t end) {
+      double p[6];
+      Point q;
+      for (uint64_t i = begin; i < end; i++) {
+        Triangle t = T.triangle(T.periodic_triangle(faces[i]));
+        for (int j = 0; j < 3; j++) {
+          q = t.vertex(j);
+          p[2*j + 0] = q.x();
+          p[2*j + 1] = q.y();
+        }
+        cell_dual_areas_2(p, &contrib[3*i]);
+      }
+    });
+    std::fill(vols, vols + nvols, 0.0);
+    uint64_t k;
+    for (uint64_t i = 0; i < faces.size(); i++) {
+      for (int j = 0; j < 3; j++) {
+        k = (uint64_t)(T.get_original_vertex(faces[i]->vertex(j))->info());
+        if (k >= nvols)
+          throw std::out_of_range("Vertex info is outside of the areas array.");
+        vols[k] += contrib[3*i + j];
+      }
+    }
+    // Copies of each face are stored for every sheet in the covering
+    double ns = static_cast<double>(num_sheets_total());
+    double total = 0.0;
+    for (uint64_t i = 0; i < nvols; i++) {
+      vols[i] /= ns;
+      total += vols[i];
+    }
+    return total;
   }
 
   double length(const Edge e) const {
@@ -704,6 +825,7 @@ public:
   }
   void read_from_buffer(std::ifstream &is) {
     updated = true;
+    vertex_index.invalidate();
     std::streambuf* oldCoutStreamBuf = std::cout.rdbuf();
     std::ostringstream newCoutStream;
     std::cout.rdbuf( newCoutStream.rdbuf() );
@@ -943,6 +1065,7 @@ public:
 		   I* faces, I* neighbors, int32_t* offsets, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
 
     T.clear();
   
@@ -1026,6 +1149,7 @@ public:
 			   I* faces, I* neighbors, int32_t* offsets, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
 
     T.clear();
   
@@ -1158,32 +1282,25 @@ public:
   std::vector<std::vector<Info>> outgoing_points(uint64_t nbox,
 						 double *left_edges, 
 						 double *right_edges) const {
-    std::vector<std::vector<Info>> out;
-    uint64_t b;
-    for (b = 0; b < nbox; b++) 
-      out.push_back(std::vector<Info>());
-
-    Vertex_handle v;
-    Point cc, p1;
-    double cr;
-    int i;
-
-    for (Face_iterator it = T.faces_begin(); it != T.faces_end(); it++) {
-      p1 = T.point(it->vertex(0));
-      // p1 = it->vertex(0)->point();
-      cc = T.circumcenter(it);
-      cr = std::sqrt(static_cast<double>(CGAL::squared_distance(p1, cc)));
-      for (b = 0; b < nbox; b++) {
-	if (intersect_sph_box(&cc, cr, left_edges + 2*b, right_edges + 2*b))
-	  for (i = 0; i < 3; i++) out[b].push_back((it->vertex(i))->info());
-      }
-    }
-    for (b = 0; b < nbox; b++) {
-      std::sort( out[b].begin(), out[b].end() ); 
-      out[b].erase( std::unique( out[b].begin(), out[b].end() ), out[b].end() );
-    }
-
-    return out;
+    std::vector<Face_handle> faces;
+    faces.reserve(T.number_of_faces());
+    for (Face_iterator it = T.faces_begin(); it != T.faces_end(); it++)
+      faces.push_back(it);
+    return outgoing_points_boxes<Info>(
+        2, nbox, left_edges, right_edges, faces,
+        [this](const Face_handle &f, double *cc, double &cr) {
+          Point p1 = T.point(f->vertex(0));
+          Point p = T.circumcenter(f);
+          cc[0] = p.x();
+          cc[1] = p.y();
+          cr = std::sqrt(static_cast<double>(CGAL::squared_distance(p1, p)));
+          return true;
+        },
+        [](const Face_handle &f, std::vector<Info> &buf) {
+          buf.clear();
+          for (int i = 0; i < 3; i++)
+            buf.push_back(f->vertex(i)->info());
+        });
   }
 
   void boundary_points(double *left_edge, double *right_edge, bool periodic,
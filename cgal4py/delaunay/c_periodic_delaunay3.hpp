@@ -13,6 +13,10 @@
 #include <algorithm>
 #include <limits>
 #include <stdint.h>
+#include <stdexcept>
+#include "c_vertex_index.hpp"
+#include "c_box_index.hpp"
+#include "c_dual_volume.hpp"
 #ifdef READTHEDOCS
 #define VALID 1
 #include "dummy_CGAL.hpp"
@@ -157,34 +161,134 @@ class PeriodicDelaunay_with_info_3
 		  domain[3], domain[4], domain[5]);
     T.set_domain(dr);
   }
+  // Batches of at least this many points are inserted with CGAL's range
+  // insert, which sorts them spatially. If the triangulation is empty,
+  // dummy points are also inserted first so that it starts as a 1-sheeted
+  // covering.
+  static const uint32_t batch_insert_min = 1000;
   void insert(double *pts, Info *val, uint32_t n)
   {
     updated = true;
     uint32_t d, d3;
-    std::size_t i;
     Vertex_handle v;
     Point p;
+    std::size_t nverts = T.number_of_vertices();
+    bool existed;
+    if (n >= batch_insert_min) {
+      std::vector<Point> points;
+      points.reserve(n);
+      for (d = 0; d < n; d++) {
+        d3 = 3*d;
+        points.push_back(Point(pts[d3],pts[d3+1],pts[d3+2]));
+      }
+      bool is_large_point_set = (nverts == 0);
+      T.insert(points.begin(), points.end(), is_large_point_set);
+      set_info(pts, val, n, nverts);
+      return;
+    }
     for (d = 0; d < n; d++) {
       d3 = 3*d;
       p = Point(pts[d3],pts[d3+1],pts[d3+2]);
-      v = T.insert(p);
-      v->info() = val[d];
-      // std::cout << p << val[d] << std::endl;
-      std::vector<Vertex_handle> dups = T.periodic_copies(v);
-      for (i = 0; i < dups.size(); i++)
-	dups[i]->info() = val[d];
-    }
+      v = T.get_original_vertex(T.insert(p));
+      existed = (T.number_of_vertices() == nverts);
+      nverts = T.number_of_vertices();
+      vertex_index.inserted(val[d], v, existed, existed ? v->info() : val[d]);
+      set_info(v, val[d]);
+    }
+  }
+  // Set the info of the vertices, including periodic copies, at the n
+  // positions in pts in one pass over the stored vertices. If a position
+  // is repeated, its last info is used, as when the points are inserted
+  // one at a time. nverts is the number of vertices before the points
+  // were inserted. If none of the positions were already vertices, the
+  // new vertices are added to the vertex index, otherwise it is rebuilt
+  // before its next use. Every position must match exactly one vertex in
+  // the original domain, so that no new vertex is left without an info;
+  // std::runtime_error is thrown if one does not.
+  void set_info(const double *pts, const Info *val, uint32_t n,
+                std::size_t nverts) {
+    auto less = [](const double *a, const double *b) {
+      return std::lexicographical_compare(a, a + 3, b, b + 3);
+    };
+    std::vector<uint32_t> order(n);
+    for (uint32_t i = 0; i < n; i++)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (less(pts + 3*a, pts + 3*b)) return true;
+        if (less(pts + 3*b, pts + 3*a)) return false;
+        return a < b;
+      });
+    std::size_t ndistinct = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      if ((i == 0) || less(pts + 3*order[i-1], pts + 3*order[i]))
+        ndistinct++;
+    }
+    bool index_new = (ndistinct == (T.number_of_vertices() - nverts));
+    if (!index_new)
+      vertex_index.invalidate();
+    std::size_t nmatched = 0;
+    std::vector<uint32_t>::iterator r;
+    double x[3];
+    for (Vertex_iterator it = T.vertices_begin(); it != T.vertices_end(); it++) {
+      x[0] = it->point().x();
+      x[1] = it->point().y();
+      x[2] = it->point().z();
+      r = std::upper_bound(order.begin(), order.end(), (const double*)x,
+                           [&](const double *a, uint32_t b) {
+                             return less(a, pts + 3*b);
+                           });
+      if (r == order.begin())
+        continue;
+      r--;
+      if (less(pts + 3*(*r), x))
+        continue;
+      it->info() = val[*r];
+      if (T.get_original_vertex(it) != Vertex_handle(it))
+        continue;
+      nmatched++;
+      if (index_new)
+        vertex_index.inserted(val[*r], it, false, val[*r]);
+    }
+    if (nmatched != ndistinct)
+      throw std::runtime_error("Only some of the inserted points matched "
+                               "a vertex, so new vertices may be missing "
+                               "their info.");
+  }
+  // Set the info of a vertex and its periodic copies.
+  void set_info(Vertex_handle v, Info info) {
+    v->info() = info;
+    std::vector<Vertex_handle> dups = T.periodic_copies(v);
+    for (std::size_t i = 0; i < dups.size(); i++)
+      dups[i]->info() = info;
+  }
+  void remove(Vertex v) {
+    updated = true;
+    vertex_index.erase(v._x->info());
+    T.remove(v._x);
   }
-  void remove(Vertex v) { updated = true; T.remove(v._x); }
-  void clear() { updated = true; T.clear(); }
+  void clear() { updated = true; vertex_index.invalidate(); T.clear(); }
 
   Vertex move(Vertex v, double *pos) {
     updated = true;
     Point p = Point(pos[0], pos[1], pos[2]);
     // Not implemented in CGAL as of 4.9. Implemeted her as stop gap.
     // return Vertex(T.move(v._x, p));
+    // As in CGAL's move, if there is already a vertex at p, v is removed
+    // and the existing vertex is returned with its info unchanged.
+    int li, lj;
+    Locate_type lt = Locate_type(0);
+    Cell_handle c = T.locate(p, lt, li, lj, v._x->cell());
+    if (lt == 0) {
+      Vertex_handle w = T.get_original_vertex(c->vertex(li));
+      if (w != v._x)
+	remove(v);
+      return Vertex(w);
+    }
+    Info info = v._x->info();
     T.remove(v._x);
     v._x = T.insert(p);
+    set_info(v._x, info);
+    moved_vertex_index(info, v._x);
     return v;
   }
   Vertex move_if_no_collision(Vertex v, double *pos) {
@@ -198,20 +302,181 @@ class PeriodicDelaunay_with_info_3
     if (lt == 0)
       return Vertex(c->vertex(li));
     else {
+      Info info = v._x->info();
+      // c may not survive the removal, so it is not used as a hint
       T.remove(v._x);
-      v._x = T.insert(p, lt, c, li, lj);
+      v._x = T.insert(p);
+      set_info(v._x, info);
+      moved_vertex_index(info, v._x);
       return v;
     }
       
   }
 
-  Vertex get_vertex(Info index) const {
+  // Move v to p without changing the connectivity if the triangulation
+  // stays Delaunay, i.e. if the cells around v stay positively oriented
+  // and locally Delaunay. This is only tried for a 1-sheeted covering and
+  // a position inside the domain, so that the offsets of v in its cells
+  // do not change. Returns false without moving v otherwise.
+  bool move_in_place(Vertex_handle v, const Point &p) {
+    if (num_sheets_total() != 1)
+      return false;
+    Iso_cuboid dom = T.domain();
+    if ((p.x() < dom.xmin()) || (p.x() >= dom.xmax()) ||
+        (p.y() < dom.ymin()) || (p.y() >= dom.ymax()) ||
+        (p.z() < dom.zmin()) || (p.z() >= dom.zmax()))
+      return false;
+    typename Gt3p::Orientation_3 orientation = T.geom_traits().orientation_3_object();
+    typename Gt3p::Side_of_oriented_sphere_3 side_of_sphere =
+      T.geom_traits().side_of_oriented_sphere_3_object();
+    std::vector<Cell_handle> cells;
+    T.incident_cells(v, std::back_inserter(cells));
+    const Point *q[5];
+    Offset o[5];
+    int i, j, k, m;
+    for (typename std::vector<Cell_handle>::iterator c = cells.begin(); c != cells.end(); c++) {
+      for (j = 0; j < 4; j++) {
+        q[j] = ((*c)->vertex(j) == v) ? &p : &((*c)->vertex(j)->point());
+        o[j] = T.get_offset(*c, j);
+      }
+      if (orientation(*q[0], *q[1], *q[2], *q[3],
+                      o[0], o[1], o[2], o[3]) != CGAL::POSITIVE)
+        return false;
+      for (i = 0; i < 4; i++) {
+        Cell_handle n = (*c)->neighbor(i);
+        m = n->index(*c);
+        // Offset from the neighbor's frame to this cell's, found from a
+        // vertex on the shared facet
+        k = (i + 1) & 3;
+        Offset shift = T.get_offset(*c, k) - T.get_offset(n, n->index((*c)->vertex(k)));
+        q[4] = (n->vertex(m) == v) ? &p : &(n->vertex(m)->point());
+        o[4] = T.get_offset(n, m) + shift;
+        if (side_of_sphere(*q[0], *q[1], *q[2], *q[3], *q[4],
+                           o[0], o[1], o[2], o[3], o[4]) != CGAL::ON_NEGATIVE_SIDE)
+          return false;
+      }
+    }
+    v->set_point(p);
+    // Resetting the vertices clears cached circumcenters
+    for (typename std::vector<Cell_handle>::iterator c = cells.begin(); c != cells.end(); c++)
+      (*c)->set_vertex((*c)->index(v), v);
+    return true;
+  }
+
+  // Removing a vertex and inserting it again costs about this many times
+  // as much as inserting it into a new triangulation with the spatially
+  // sorted range insert. move_many rebuilds the triangulation when that
+  // is cheaper than removing and reinserting the vertices that could not
+  // be moved in place.
+  static const uint32_t move_rebuild_cost = 8;
+  // Move the vertices with infos index[0:n] to the positions in pos. Small
+  // displacements that leave the triangulation Delaunay only update the
+  // vertex positions. There is no repair by local flips, so any other
+  // vertex is removed and inserted again with the rest, or the whole
+  // triangulation is rebuilt if more than 1/move_rebuild_cost of the
+  // vertices are left. Infos that are not in the triangulation are
+  // skipped. If an info is repeated, the last position given for it is
+  // used.
+  void move_many(Info *index0, double *pos0, uint64_t n0) {
+    if (n0 == 0)
+      return;
+    updated = true;
+    // Keep one entry per info so that no vertex is removed twice
+    std::vector<uint64_t> order(n0);
+    uint64_t i;
+    for (i = 0; i < n0; i++)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) {
+        return index0[a] < index0[b];
+      });
+    std::vector<Info> index_unique;
+    std::vector<double> pos_unique;
+    for (i = 0; i < n0; i++) {
+      if (((i + 1) < n0) && (index0[order[i]] == index0[order[i+1]]))
+        continue;
+      index_unique.push_back(index0[order[i]]);
+      pos_unique.insert(pos_unique.end(), pos0 + 3*order[i],
+                        pos0 + 3*(order[i] + 1));
+    }
+    Info *index = &index_unique[0];
+    double *pos = &pos_unique[0];
+    uint64_t n = index_unique.size();
+    std::vector<Vertex> verts = get_vertices(index, n);
+    vertex_index.invalidate();
+    std::vector<Vertex_handle> large;
+    std::vector<double> large_pos;
+    std::vector<Info> large_info;
+    for (i = 0; i < n; i++) {
+      if (verts[i]._x == Vertex_handle())
+        continue;
+      Point p(pos[3*i], pos[3*i+1], pos[3*i+2]);
+      if (move_in_place(verts[i]._x, p))
+        continue;
+      large.push_back(verts[i]._x);
+      large_info.push_back(index[i]);
+      large_pos.insert(large_pos.end(), pos + 3*i, pos + 3*(i+1));
+    }
+    if (large.size() == 0)
+      return;
+    uint64_t nverts = T.number_of_vertices();
+    if ((large.size()*move_rebuild_cost) < nverts) {
+      for (i = 0; i < large.size(); i++)
+        T.remove(large[i]);
+      insert(&large_pos[0], &large_info[0], (uint32_t)(large.size()));
+      return;
+    }
+    // Rebuild from the positions of the vertices that were not left, then
+    // the new positions of the ones that were
+    std::vector<Info> moved(large_info);
+    std::sort(moved.begin(), moved.end());
+    std::vector<double> all_pos;
+    std::vector<Info> all_info;
+    all_pos.reserve(3*nverts);
+    all_info.reserve(nverts);
+    for (Vertex_iterator it = T.vertices_begin(); it != T.vertices_end(); it++) {
+      if (T.get_original_vertex(it) != Vertex_handle(it))
+        continue;
+      if (std::binary_search(moved.begin(), moved.end(), it->info()))
+        continue;
+      all_pos.push_back(it->point().x());
+      all_pos.push_back(it->point().y());
+      all_pos.push_back(it->point().z());
+      all_info.push_back(it->info());
+    }
+    all_pos.insert(all_pos.end(), large_pos.begin(), large_pos.end());
+    all_info.insert(all_info.end(), large_info.begin(), large_info.end());
+    T.clear();
+    insert(&all_pos[0], &all_info[0], (uint32_t)(all_info.size()));
+  }
+
+  // Lookup table from info to vertex (see c_vertex_index.hpp), kept up to
+  // date as vertices are added, removed, or moved while it is enabled.
+  mutable VertexIndex<Info, Vertex_handle> vertex_index;
+  template <typename F>
+  void visit_vertices(F f) const {
     Vertex_iterator it = T.vertices_begin();
     for ( ; it != T.vertices_end(); it++) {
-      if (it->info() == index)
-        return Vertex(T.get_original_vertex(it));
+      if (f(it->info(), T.get_original_vertex(it)))
+        return;
     }
-    return Vertex(Vertex_handle());
+  }
+  VertexVisitor<const PeriodicDelaunay_with_info_3> vertex_visitor() const {
+    return VertexVisitor<const PeriodicDelaunay_with_info_3>(this);
+  }
+  void set_vertex_index(bool enable) { vertex_index.enable(enable); }
+  void moved_vertex_index(Info info, Vertex_handle out) {
+    vertex_index.moved(info, out, out->info());
+  }
+
+  Vertex get_vertex(Info index) const {
+    Vertex_handle v = Vertex_handle();
+    vertex_index.find(index, vertex_visitor(), T.number_of_vertices(), v);
+    return Vertex(v);
+  }
+  std::vector<Vertex> get_vertices(Info *index, uint64_t n) const {
+    std::vector<Vertex_handle> v = vertex_index.find_many(
+        index, n, vertex_visitor(), T.number_of_vertices(), Vertex_handle());
+    return std::vector<Vertex>(v.begin(), v.end());
   }
 
   Cell locate(double* pos, int& lt, int& li, int& lj) const {
@@ -1046,10 +1311,70 @@ class PeriodicDelaunay_with_info_3
     return vol;
   }
 
-  void dual_volumes(double *vols) const {
+  double domain_volume() const {
+    Iso_cuboid dom = T.domain();
+    return ((dom.xmax() - dom.xmin())*(dom.ymax() - dom.ymin())*
+            (dom.zmax() - dom.zmin()));
+  }
+
+  // One more than the largest info of any vertex (0 if there are none), so
+  // arrays indexed by info can be sized to hold every vertex.
+  uint64_t info_bound() const {
+    uint64_t out = 0;
     for (Vertex_iterator it = T.vertices_begin(); it != T.vertices_end(); it++) {
-      vols[it->info()] = dual_volume(Vertex(it));
-    }    
+      uint64_t k = (uint64_t)(T.get_original_vertex(it)->info());
+      if (k >= out)
+        out = k + 1;
+    }
+    return out;
+  }
+
+  // Voronoi volumes of the vertices, indexed by their infos. vols must hold
+  // nvols entries, which are zeroed first, and std::out_of_range is thrown
+  // if any vertex has an info >= nvols (see info_bound). Each stored cell
+  // contributes to the volumes of its vertices using its positions with
+  // offsets applied, so no cell is visited more than once per sheet and
+  // each circumcenter is computed once. Cells are divided between nthreads
+  // threads if CGAL is linked with TBB. Returns the sum of the volumes,
+  // which should be the volume of the domain.
+  double dual_volumes(double *vols, uint64_t nvols, int nthreads = 1) const {
+    std::vector<Cell_handle> cells;
+    cells.reserve(T.number_of_stored_cells());
+    for (Cell_iterator it = T.tds().cells_begin(); it != T.tds().cells_end(); it++)
+      cells.push_back(it);
+    std::vector<double> contrib(4*cells.size(), 0.0);
+    parallel_for_ranges(cells.size(), nthreads, [&](uint64_t begin, uint64_t end) {
+      double p[12];
+      Point q;
+      for (uint64_t i = begin; i < end; i++) {
+        Tetrahedron t = T.tetrahedron(T.periodic_tetrahedron(cells[i]));
+        for (int j = 0; j < 4; j++) {
+          q = t.vertex(j);
+          p[3*j + 0] = q.x();
+          p[3*j + 1] = q.y();
+          p[3*j + 2] = q.z();
+        }
+        cell_dual_volumes_3(p, &contrib[4*i]);
+      }
+    });
+    std::fill(vols, vols + nvols, 0.0);
+    uint64_t k;
+    for (uint64_t i = 0; i < cells.size(); i++) {
+      for (int j = 0; j < 4; j++) {
+        k = (uint64_t)(T.get_original_vertex(cells[i]->vertex(j))->info());
+        if (k >= nvols)
+          throw std::out_of_range("Vertex info is outside of the volumes array.");
+        vols[k] += contrib[4*i + j];
+      }
+    }
+    // Copies of each cell are stored for every sheet in the covering
+    double ns = static_cast<double>(num_sheets_total());
+    double total = 0.0;
+    for (uint64_t i = 0; i < nvols; i++) {
+      vols[i] /= ns;
+      total += vols[i];
+    }
+    return total;
   }
 
   double length(const Edge e) const {
@@ -1138,6 +1463,7 @@ class PeriodicDelaunay_with_info_3
   }
   void read_from_buffer(std::ifstream &is) {
     updated = true;
+    vertex_index.invalidate();
     std::streambuf* oldCoutStreamBuf = std::cout.rdbuf();
     std::ostringstream newCoutStream;
     std::cout.rdbuf( newCoutStream.rdbuf() );
@@ -1385,6 +1711,7 @@ class PeriodicDelaunay_with_info_3
                    I* cells, I* neighbors, int32_t* offsets, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
 
     T.clear();
  
@@ -1469,6 +1796,7 @@ class PeriodicDelaunay_with_info_3
 			   I* cells, I* neighbors, int32_t* offsets, I idx_inf)
   {
     updated = true;
+    vertex_index.invalidate();
 
     T.clear();
  
@@ -1615,33 +1943,26 @@ class PeriodicDelaunay_with_info_3
   std::vector<std::vector<Info>> outgoing_points(uint64_t nbox,
                                                  double *left_edges,
                                                  double *right_edges) const {
-    std::vector<std::vector<Info>> out;
-    uint64_t b;
-    for (b = 0; b < nbox; b++)
-      out.push_back(std::vector<Info>());
-
-    Vertex_handle v;
-    Point cc, p1;
-    double cr;
-    int i;
-
-    for (Cell_iterator it = T.all_cells_begin(); it != T.all_cells_end(); it++) {
-      p1 = T.point(T.periodic_point(it->vertex(0)));
-      // p1 = it->vertex(0)->point();
-      cc = T.point(T.periodic_circumcenter(it));
-      // cc = it->circumcenter();
-      cr = std::sqrt(static_cast<double>(CGAL::squared_distance(p1, cc)));
-      for (b = 0; b < nbox; b++) {
-	if (intersect_sph_box(&cc, cr, left_edges + 3*b, right_edges + 3*b))
-	  for (i = 0; i < 4; i++) out[b].push_back((it->vertex(i))->info());
-      }
-    }
-    for (b = 0; b < nbox; b++) {
-      std::sort( out[b].begin(), out[b].end() );
-      out[b].erase( std::unique( out[b].begin(), out[b].end() ), out[b].end() );
-    }
-
-    return out;
+    std::vector<Cell_handle> cells;
+    cells.reserve(T.number_of_cells());
+    for (Cell_iterator it = T.all_cells_begin(); it != T.all_cells_end(); it++)
+      cells.push_back(it);
+    return outgoing_points_boxes<Info>(
+        3, nbox, left_edges, right_edges, cells,
+        [this](const Cell_handle &c, double *cc, double &cr) {
+          Point p1 = T.point(T.periodic_point(c->vertex(0)));
+          Point p = T.point(T.periodic_circumcenter(c));
+          cc[0] = p.x();
+          cc[1] = p.y();
+          cc[2] = p.z();
+          cr = std::sqrt(static_cast<double>(CGAL::squared_distance(p1, p)));
+          return true;
+        },
+        [](const Cell_handle &c, std::vector<Info> &buf) {
+          buf.clear();
+          for (int i = 0; i < 4; i++)
+            buf.push_back(c->vertex(i)->info());
+        });
   }
 
   void boundary_points(double *left_edge, double *right_edge, bool periodic,
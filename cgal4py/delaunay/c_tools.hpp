@@ -7,6 +7,35 @@
 #include <fstream>
 #include <stdint.h>
 #include <exception>
+#include <algorithm>
+#ifdef CGAL_LINKED_WITH_TBB
+#include <tbb/task_arena.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#endif
+
+#ifndef CGAL4PY_TOOLS_HPP
+#define CGAL4PY_TOOLS_HPP
+
+// Call f(begin, end) on ranges that cover [0, n), splitting them between
+// nthreads threads if CGAL is linked with TBB.
+template <typename F>
+void parallel_for_ranges(uint64_t n, int nthreads, F f) {
+#ifdef CGAL_LINKED_WITH_TBB
+  if ((nthreads > 1) && (n > 1)) {
+    uint64_t grain = std::max((uint64_t)1, n/(4*(uint64_t)nthreads));
+    tbb::task_arena arena(nthreads);
+    arena.execute([&]() {
+      tbb::parallel_for(tbb::blocked_range<uint64_t>(0, n, grain),
+                        [&](const tbb::blocked_range<uint64_t> &r) {
+        f(r.begin(), r.end());
+      });
+    });
+    return;
+  }
+#endif
+  f(0, n);
+}
 
 bool intersect_sph_box(uint32_t ndim, double *c, double r, double *le, double *re) {
   uint32_t i;
@@ -970,3 +999,4 @@ public:
   
 };
 
+#endif
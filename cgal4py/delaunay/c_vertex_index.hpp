@@ -0,0 +1,213 @@
+// Lookup table from vertex info to vertex handle used by get_vertex and
+// get_vertices so that each lookup does not have to walk the triangulation.
+// The triangulation wrappers own one, optionally kept up to date as
+// vertices change, and describe their vertices to it with a visitor:
+// visit(f) calls f(info, handle) for each finite vertex, stopping early
+// once f returns true.
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+
+#ifndef CGAL4PY_VERTEX_INDEX_HPP
+#define CGAL4PY_VERTEX_INDEX_HPP
+
+// Visitor for a triangulation wrapper W that forwards to its
+// visit_vertices method.
+template <typename W>
+struct VertexVisitor
+{
+  W *w;
+  explicit VertexVisitor(W *w0) : w(w0) {}
+  template <typename F>
+  void operator()(F f) const { w->visit_vertices(f); }
+};
+
+template <typename Info, typename Handle>
+class VertexIndex
+{
+ public:
+  // Info values below twice the expected number of entries (plus a pad)
+  // are stored in a flat vector, all others in a hash map.
+  static const uint64_t dense_pad = 1024;
+  bool enabled = false;
+  bool stale = true;
+  uint64_t count = 0;
+  uint64_t expected = 0;
+  std::vector<Handle> dense;
+  std::vector<bool> dense_set;
+  std::unordered_map<Info, Handle> sparse;
+
+  void clear() {
+    dense.clear();
+    dense_set.clear();
+    sparse.clear();
+    count = 0;
+    expected = 0;
+    stale = true;
+  }
+  // Empty the index and size it for n entries.
+  void reset(uint64_t n) {
+    clear();
+    expected = n;
+  }
+  // Mark the index as out of date so that it is rebuilt before next use.
+  void invalidate() { stale = true; }
+
+  bool is_dense(Info info) const {
+    return ((uint64_t)info < dense.size());
+  }
+  bool grow_dense(Info info) {
+    uint64_t i = (uint64_t)info;
+    uint64_t nmax = 2*std::max(count, expected) + dense_pad;
+    if (i >= nmax)
+      return false;
+    uint64_t n = std::min(std::max(i + 1, (uint64_t)(2*dense.size())), nmax);
+    dense.resize(n, Handle());
+    dense_set.resize(n, false);
+    // Move entries that are now in the dense range out of the map
+    typename std::unordered_map<Info, Handle>::iterator it = sparse.begin();
+    while (it != sparse.end()) {
+      if ((uint64_t)(it->first) < n) {
+        dense[(uint64_t)(it->first)] = it->second;
+        dense_set[(uint64_t)(it->first)] = true;
+        it = sparse.erase(it);
+      } else {
+        it++;
+      }
+    }
+    return true;
+  }
+
+  // Add an entry. Existing entries are replaced only if overwrite is true.
+  void set(Info info, Handle h, bool overwrite = true) {
+    if (is_dense(info) || grow_dense(info)) {
+      uint64_t i = (uint64_t)info;
+      if (dense_set[i]) {
+        if (overwrite) dense[i] = h;
+        return;
+      }
+      dense[i] = h;
+      dense_set[i] = true;
+      count++;
+    } else {
+      std::pair<typename std::unordered_map<Info, Handle>::iterator, bool> ret;
+      ret = sparse.insert(std::make_pair(info, h));
+      if (ret.second)
+        count++;
+      else if (overwrite)
+        ret.first->second = h;
+    }
+  }
+  void erase(Info info) {
+    if (is_dense(info)) {
+      uint64_t i = (uint64_t)info;
+      if (dense_set[i]) {
+        dense[i] = Handle();
+        dense_set[i] = false;
+        count--;
+      }
+    } else if (sparse.erase(info) > 0) {
+      count--;
+    }
+  }
+  bool get(Info info, Handle &h) const {
+    if (is_dense(info)) {
+      uint64_t i = (uint64_t)info;
+      if (!dense_set[i]) return false;
+      h = dense[i];
+      return true;
+    }
+    typename std::unordered_map<Info, Handle>::const_iterator it = sparse.find(info);
+    if (it == sparse.end()) return false;
+    h = it->second;
+    return true;
+  }
+
+  // Turn the index on or off. Either way it is emptied, so it is filled
+  // on first use.
+  void enable(bool enable0) {
+    clear();
+    enabled = enable0;
+  }
+  // Replace the contents with the n vertices reported by visit. Copies of
+  // a vertex after the first are ignored.
+  template <typename Visit>
+  void fill(Visit visit, uint64_t n) {
+    reset(n);
+    visit([this](Info info, Handle h) {
+	set(info, h, false);
+	return false;
+      });
+    stale = false;
+  }
+  template <typename Visit>
+  void update(Visit visit, uint64_t n) {
+    if (enabled && stale)
+      fill(visit, n);
+  }
+  // True if the index is on and filled, so changes can be applied to it
+  // directly instead of rebuilding it.
+  bool live() const { return (enabled && !stale); }
+  // Record that an insertion gave h the info. If the point was already a
+  // vertex (existed is true), h had old_info before.
+  void inserted(Info info, Handle h, bool existed, Info old_info) {
+    if (!live())
+      return;
+    Handle old;
+    if (existed && (old_info != info) && get(old_info, old) && (old == h))
+      erase(old_info);
+    set(info, h);
+  }
+  // Record that the vertex with info was moved to out, which has info
+  // out_info. If the move landed on another vertex, the index is rebuilt
+  // before its next use.
+  void moved(Info info, Handle out, Info out_info) {
+    if (!enabled || stale)
+      return;
+    if (out_info == info)
+      set(info, out);
+    else
+      invalidate();
+  }
+
+  // Find the vertex with info among the n reported by visit. Without the
+  // index, this walks the vertices until it is found.
+  template <typename Visit>
+  bool find(Info info, Visit visit, uint64_t n, Handle &h) {
+    if (enabled) {
+      update(visit, n);
+      return get(info, h);
+    }
+    bool found = false;
+    visit([&](Info i, Handle v) {
+	if (i == info) {
+	  h = v;
+	  found = true;
+	}
+	return found;
+      });
+    return found;
+  }
+  // Find the vertices with each of the ninfo infos, using missing for
+  // those that are not present. Without the index, a temporary one is
+  // filled for the call.
+  template <typename Visit>
+  std::vector<Handle> find_many(const Info *infos, uint64_t ninfo,
+				Visit visit, uint64_t n, Handle missing) {
+    VertexIndex tmp;
+    VertexIndex *idx = this;
+    if (enabled)
+      update(visit, n);
+    else {
+      tmp.fill(visit, n);
+      idx = &tmp;
+    }
+    std::vector<Handle> out(ninfo, missing);
+    for (uint64_t i = 0; i < ninfo; i++)
+      idx->get(infos[i], out[i]);
+    return out;
+  }
+};
+
+#endif
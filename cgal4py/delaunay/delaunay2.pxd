@@ -54,6 +54,8 @@ cdef extern from "c_delaunay2.hpp":
                                     I* faces, I* neighbors, I idx_inf)
 
         Vertex get_vertex(Info index) except +
+        void set_vertex_index(bool enable)
+        vector[Vertex] get_vertices(Info *index, uint64_t n) except +
         Cell locate(double* pos, int& lt, int& li)
         Cell locate(double* pos, int& lt, int& li, Cell c)
 
@@ -178,6 +180,7 @@ cdef extern from "c_delaunay2.hpp":
         void circumcenter(Cell x, double* out)
         double dual_area(const Vertex v)
         void dual_areas(double* vols) const
+        void set_incremental_volumes(bool enable)
         double length(const Edge e)
 
         bool is_boundary_cell(const Cell c) const 
@@ -1822,6 +1822,21 @@ cdef class Delaunay2:
             self.T.edge_info(&out[0,0])
         return out
 
+    def set_incremental_volumes(self, pybool enable=True):
+        r"""Turn on/off caching of the Voronoi volumes. While it is on, 
+        :meth:`Delaunay2.voronoi_volumes` only recomputes the volumes of 
+        vertices whose cells were changed by insertions, removals, moves, or 
+        flips since the last call.
+
+        Args:
+            enable (bool, optional): If True, the volumes are cached. If 
+                False, the cache is freed. Defaults to True.
+
+        """
+        cdef cbool c_enable = <cbool>enable
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.set_incremental_volumes(c_enable)
+
     @cython.boundscheck(False)
     @cython.wraparound(False)
     def voronoi_volumes(self):
@@ -1965,6 +1980,49 @@ cdef class Delaunay2:
         out.assign(self.T, v)
         return out
 
+    def set_vertex_index(self, pybool enable=True):
+        r"""Turn on/off the table used to look up vertices by index. While
+        it is on, :meth:`Delaunay2.get_vertex` and :meth:`Delaunay2.get_vertices`
+        do not walk the vertices and the table is kept up to date as
+        vertices are inserted, removed, and moved.
+
+        Args:
+            enable (bool, optional): If True, the table is used. If False, it
+                is freed. Defaults to True.
+
+        """
+        cdef cbool c_enable = <cbool>enable
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.set_vertex_index(c_enable)
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def get_vertices(self, object indices):
+        r"""Get the vertex objects corresponding to a set of indices.
+
+        Args:
+            indices (:obj:`ndarray` of np_info_t): Indices of vertices that
+                should be found.
+
+        Returns:
+            Delaunay2_vertex_vector: Vertices corresponding to the
+                given indices. Indices that are not found are handled as
+                in :meth:`Delaunay2.get_vertex`.
+
+        """
+        cdef np.ndarray[np_info_t, ndim=1] idx
+        idx = np.ascontiguousarray(indices, dtype=np_info).ravel()
+        cdef uint64_t n = idx.size
+        cdef info_t* ptr_idx = NULL
+        if n > 0:
+            ptr_idx = &idx[0]
+        cdef vector[Delaunay_with_info_2[info_t].Vertex] v
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            v = self.T.get_vertices(ptr_idx, n)
+        cdef Delaunay2_vertex_vector out = Delaunay2_vertex_vector()
+        out.assign(self.T, v)
+        return out
+
     def locate(self, np.ndarray[np.float64_t, ndim=1] pos,
                Delaunay2_cell start = None):
         r"""Get the vertex/cell/edge that a given point is a part of.
@@ -12,6 +12,7 @@ cdef extern from "c_delaunay3.hpp":
         Delaunay_with_info_3() except +
         Delaunay_with_info_3(double *pts, Info *val, uint32_t n) except +
         bool updated
+        int nthreads
         bool is_valid() const
         uint32_t num_finite_verts() const
         uint32_t num_finite_edges() const
@@ -46,6 +47,9 @@ cdef extern from "c_delaunay3.hpp":
         I serialize[I](I &n, I &m, int32_t &d,
                        double* vert_pos, Info* vert_info,
                        I* cells, I* neighbors) const
+        I serialize_vectors[I](int32_t &d, vector[double] &vert_pos,
+                               vector[Info] &vert_info, vector[I] &cells,
+                               vector[I] &neighbors) const
         Info serialize_idxinfo[I](I &n, I &m, int32_t &d,
                                   Info* cells, I* neighbors) const
         I serialize_info2idx[I](I &n, I &m, int32_t &d,
@@ -58,12 +62,19 @@ cdef extern from "c_delaunay3.hpp":
                                     I* cells, I* neighbors, I idx_inf)
 
         Vertex get_vertex(Info index) except +
+        void set_vertex_index(bool enable)
+        vector[Vertex] get_vertices(Info *index, uint64_t n) except +
         Cell locate(double* pos, int& lt, int& li, int& lj)
         Cell locate(double* pos, int& lt, int& li, int& lj, Cell c)
+        void locate_many(double* pos, uint64_t n, Info* cells, int* lt,
+                         int* li, int* lj) except +
 
         void info_ordered_vertices(double* pos)
         void vertex_info(Info* verts)
         void edge_info(Info* edges)
+        void cell_circumcenters(double* out)
+        void facet_info(Info* facets)
+        void vertex_adjacency(uint64_t nverts, uint64_t* indptr, Info* indices)
 
         cppclass All_verts_iter:
             All_verts_iter()
@@ -206,6 +217,7 @@ cdef extern from "c_delaunay3.hpp":
         vector[Cell] incident_cells(Cell x)
 
         Vertex nearest_vertex(double* pos)
+        void nearest_vertex_many(double* pos, uint64_t n, Info* verts) except +
 
         Facet mirror_facet(Facet x) const
         int mirror_index(Cell x, int i) const
@@ -214,6 +226,7 @@ cdef extern from "c_delaunay3.hpp":
         void circumcenter(Cell x, double* out) const
         double dual_volume(const Vertex v) const
         void dual_volumes(double* vols) const
+        void set_incremental_volumes(bool enable)
         double length(const Edge e) const
 
         bool is_boundary_cell(const Cell c) const
@@ -31,6 +31,72 @@ ctypedef np.uint64_t np_info_t
 
 from cgal4py.delaunay.delaunay3 cimport Delaunay_with_info_3,VALID
 
+cdef class _DoubleVector:
+    r"""C++ vector of float64 exposed through the buffer protocol so that 
+    numpy arrays can use its memory without copying it."""
+    cdef vector[double] v
+    cdef int ndim
+    cdef Py_ssize_t shape[2]
+    cdef Py_ssize_t strides[2]
+
+    cdef void set_shape(self, int ndim, Py_ssize_t nrow, Py_ssize_t ncol=1):
+        self.ndim = ndim
+        self.shape[0] = nrow
+        self.shape[1] = ncol
+        self.strides[0] = ncol*sizeof(double)
+        self.strides[1] = sizeof(double)
+
+    def __getbuffer__(self, Py_buffer *buffer, int flags):
+        buffer.buf = <char*>self.v.data()
+        buffer.format = 'd'
+        buffer.internal = NULL
+        buffer.itemsize = sizeof(double)
+        buffer.len = self.v.size()*sizeof(double)
+        buffer.ndim = self.ndim
+        buffer.obj = self
+        buffer.readonly = 0
+        buffer.shape = self.shape
+        buffer.strides = self.strides
+        buffer.suboffsets = NULL
+
+    def __releasebuffer__(self, Py_buffer *buffer):
+        pass
+
+cdef class _InfoVector:
+    r"""C++ vector of info_t exposed through the buffer protocol so that 
+    numpy arrays can use its memory without copying it."""
+    cdef vector[info_t] v
+    cdef bytes fmt
+    cdef int ndim
+    cdef Py_ssize_t shape[2]
+    cdef Py_ssize_t strides[2]
+
+    def __cinit__(self):
+        self.fmt = np.dtype(np_info).char.encode('ascii')
+
+    cdef void set_shape(self, int ndim, Py_ssize_t nrow, Py_ssize_t ncol=1):
+        self.ndim = ndim
+        self.shape[0] = nrow
+        self.shape[1] = ncol
+        self.strides[0] = ncol*sizeof(info_t)
+        self.strides[1] = sizeof(info_t)
+
+    def __getbuffer__(self, Py_buffer *buffer, int flags):
+        buffer.buf = <char*>self.v.data()
+        buffer.format = self.fmt
+        buffer.internal = NULL
+        buffer.itemsize = sizeof(info_t)
+        buffer.len = self.v.size()*sizeof(info_t)
+        buffer.ndim = self.ndim
+        buffer.obj = self
+        buffer.readonly = 0
+        buffer.shape = self.shape
+        buffer.strides = self.strides
+        buffer.suboffsets = NULL
+
+    def __releasebuffer__(self, Py_buffer *buffer):
+        pass
+
 def is_valid():
     if (VALID == 1):
         return True
@@ -1731,16 +1797,24 @@ cdef class Delaunay3_64bit_cell_vector:
 cdef class Delaunay3_64bit:
     r"""Wrapper class for a 3D Delaunay triangulation.
 
+    Args:
+        nthreads (int, optional): Number of threads used to insert points,
+            compute volumes, and answer batch queries. Defaults to 1.
+
     Attributes:
         n (int): The number of points inserted into the triangulation.
         T (:obj:`Delaunay_with_info_3[info_t]`): C++ triangulation object. 
             Direct interaction with this object is not recommended. 
         n_per_insert (list of int): The number of points inserted at each
             insert.
+        nthreads (int): The number of threads used to insert points,
+            compute volumes, and answer batch queries. Threads are only used
+            if CGAL is linked with TBB.
 
     """
 
     cdef Delaunay_with_info_3[info_t] *T
+    cdef readonly int nthreads
     cdef readonly int n
     cdef public object n_per_insert
     cdef readonly pybool _locked
@@ -1748,9 +1822,11 @@ cdef class Delaunay3_64bit:
 
     @cython.boundscheck(False)
     @cython.wraparound(False)
-    def __cinit__(self):
+    def __cinit__(self, int nthreads = 1):
         with nogil, cython.boundscheck(False), cython.wraparound(False):
             self.T = new Delaunay_with_info_3[info_t]()
+        self.nthreads = max(nthreads, 1)
+        self.T.nthreads = self.nthreads
         self.n = 0
         self.n_per_insert = []
         self._locked = False
@@ -1983,6 +2059,47 @@ cdef class Delaunay3_64bit:
         self.n = self.T.num_finite_verts()
         self.n_per_insert.append(self.n)
 
+    def serialize_arrays(self):
+        r"""Serialize triangulation into arrays that use the memory the C++ 
+        serialization was written to, so the arrays are not copied. Vertices 
+        and cells are in the order they are stored in the triangulation.
+
+        Returns:
+            tuple containing:
+                pos (np.ndarray of float64): (n,3) Positions of the n finite 
+                    vertices.
+                info (np.ndarray of info_t): (n,) Info for the n finite 
+                    vertices.
+                cells (np.ndarray of info_t): (m,4) Indices in `pos` of the 
+                    4 vertices of each of the m cells. A value of `idx_inf` 
+                    indicates the infinite vertex.
+                neighbors (np.ndarray of info_t): (m,4) Indices in `cells` of 
+                    the neighbor opposite each vertex of each cell.
+                idx_inf (info_t): Value representing the infinite vertex.
+
+        """
+        cdef _DoubleVector pos = _DoubleVector()
+        cdef _InfoVector info = _InfoVector()
+        cdef _InfoVector cells = _InfoVector()
+        cdef _InfoVector neighbors = _InfoVector()
+        cdef int32_t d = 3
+        cdef info_t idx_inf
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            idx_inf = self.T.serialize_vectors[info_t](
+                d, pos.v, info.v, cells.v, neighbors.v)
+        cdef Py_ssize_t n = info.v.size()
+        if n == 0:
+            return (np.zeros((0, 3), 'float64'), np.zeros(0, np_info),
+                    np.zeros((0, d+1), np_info), np.zeros((0, d+1), np_info),
+                    idx_inf)
+        cdef Py_ssize_t m = cells.v.size()/(d+1)
+        pos.set_shape(2, n, 3)
+        info.set_shape(1, n)
+        cells.set_shape(2, m, d+1)
+        neighbors.set_shape(2, m, d+1)
+        return (np.asarray(pos), np.asarray(info), np.asarray(cells),
+                np.asarray(neighbors), idx_inf)
+
     @cython.boundscheck(False)
     @cython.wraparound(False)
     def serialize(self, pybool sort = False):
@@ -2361,12 +2478,93 @@ cdef class Delaunay3_64bit:
             self.T.edge_info(&out[0,0])
         return out
 
+    @_dependent_property
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def facets(self):
+        r""":obj:`ndarray` of info_t: Vertex indices for finite facets."""
+        cdef np.ndarray[np_info_t, ndim=2] out
+        out = np.zeros([self.num_finite_facets, 3], np_info)
+        if out.shape[0] == 0:
+            return out
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.facet_info(&out[0,0])
+        return out
+
+    @_dependent_property
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def circumcenters(self):
+        r""":obj:`ndarray` of float64: x,y,z coordinates of the circumcenter 
+        of every cell, in the same order as the cells returned by 
+        :meth:`Delaunay3.serialize`. Infinite cells have infinite 
+        coordinates. If `nthreads` is greater than 1, the cells are divided 
+        between that many threads."""
+        cdef np.ndarray[np.float64_t, ndim=2] out
+        out = np.zeros([self.num_cells, 3], 'float64')
+        if out.shape[0] == 0:
+            return out
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.cell_circumcenters(&out[0,0])
+        return out
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def adjacency(self):
+        r"""Get the vertex-to-vertex adjacency of the finite vertices in 
+        compressed sparse row format.
+
+        Returns:
+            tuple containing:
+                indptr (np.ndarray of uint64): (n+1,) The indices of the 
+                    vertices that share an edge with vertex i are 
+                    `indices[indptr[i]:indptr[i+1]]`. n is one more than 
+                    the largest vertex index, so vertices that were removed 
+                    have no neighbors.
+                indices (np.ndarray of info_t): (2*num_finite_edges,) Vertex 
+                    indices in ascending order for each vertex.
+
+        """
+        cdef uint64_t n = self.num_finite_verts
+        cdef np.ndarray[np.uint64_t, ndim=1] indptr
+        cdef np.ndarray[np_info_t, ndim=1] indices
+        cdef np.ndarray[np_info_t, ndim=1] info
+        if n > 0:
+            info = np.empty(n, np_info)
+            with nogil, cython.boundscheck(False), cython.wraparound(False):
+                self.T.vertex_info(&info[0])
+            n = <uint64_t>np.max(info) + 1
+        indptr = np.zeros(n+1, 'uint64')
+        indices = np.zeros(2*self.num_finite_edges, np_info)
+        if indices.shape[0] == 0:
+            return indptr, indices
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.vertex_adjacency(n, &indptr[0], &indices[0])
+        return indptr, indices
+
+    def set_incremental_volumes(self, pybool enable=True):
+        r"""Turn on/off caching of the Voronoi volumes. While it is on, 
+        :meth:`Delaunay3_64bit.voronoi_volumes` only recomputes the volumes of 
+        vertices whose cells were changed by insertions, removals, moves, or 
+        flips since the last call.
+
+        Args:
+            enable (bool, optional): If True, the volumes are cached. If 
+                False, the cache is freed. Defaults to True.
+
+        """
+        cdef cbool c_enable = <cbool>enable
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.set_incremental_volumes(c_enable)
+
     @cython.boundscheck(False)
     @cython.wraparound(False)
     def voronoi_volumes(self):
         r"""np.ndarray of float64: Array of voronoi cell volumes for vertices in 
         the triangulation. The volumes are in the order in which the vertices 
-        were added to the triangulation."""
+        were added to the triangulation. Vertices with infinite cells have a 
+        volume of -1. If `nthreads` is greater than 1, the cells are divided 
+        between that many threads."""
         cdef np.ndarray[np.float64_t, ndim=1] out
         out = np.empty(self.num_finite_verts, 'float64')
         if self.n == 0:
@@ -2501,6 +2699,49 @@ cdef class Delaunay3_64bit:
         out.assign(self.T, v)
         return out
 
+    def set_vertex_index(self, pybool enable=True):
+        r"""Turn on/off the table used to look up vertices by index. While
+        it is on, :meth:`Delaunay3_64bit.get_vertex` and :meth:`Delaunay3_64bit.get_vertices`
+        do not walk the vertices and the table is kept up to date as
+        vertices are inserted, removed, and moved.
+
+        Args:
+            enable (bool, optional): If True, the table is used. If False, it
+                is freed. Defaults to True.
+
+        """
+        cdef cbool c_enable = <cbool>enable
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.set_vertex_index(c_enable)
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def get_vertices(self, object indices):
+        r"""Get the vertex objects corresponding to a set of indices.
+
+        Args:
+            indices (:obj:`ndarray` of np_info_t): Indices of vertices that
+                should be found.
+
+        Returns:
+            Delaunay3_64bit_vertex_vector: Vertices corresponding to the
+                given indices. Indices that are not found are handled as
+                in :meth:`Delaunay3_64bit.get_vertex`.
+
+        """
+        cdef np.ndarray[np_info_t, ndim=1] idx
+        idx = np.ascontiguousarray(indices, dtype=np_info).ravel()
+        cdef uint64_t n = idx.size
+        cdef info_t* ptr_idx = NULL
+        if n > 0:
+            ptr_idx = &idx[0]
+        cdef vector[Delaunay_with_info_3[info_t].Vertex] v
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            v = self.T.get_vertices(ptr_idx, n)
+        cdef Delaunay3_64bit_vertex_vector out = Delaunay3_64bit_vertex_vector()
+        out.assign(self.T, v)
+        return out
+
     def locate(self, np.ndarray[np.float64_t, ndim=1] pos,
                Delaunay3_64bit_cell start = None):
         r"""Get the vertex/cell/facet/edge that a given point is a part of.
@@ -2541,6 +2782,75 @@ cdef class Delaunay3_64bit:
         else:
             raise RuntimeError("Value of {} not expected from CGAL locate.".format(lt))
 
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def locate_many(self, np.ndarray[np.float64_t, ndim=2] pos):
+        r"""Locate a set of points. The points are sorted along a Hilbert 
+        curve so that each search starts from the result of the previous 
+        one. If `nthreads` is greater than 1, the points are divided 
+        between that many threads.
+
+        Args:
+            pos (:obj:`ndarray` of float64): (n,3) coordinates of points.
+
+        Returns:
+            tuple: Arrays describing where each point was found.
+
+                * cells (:obj:`ndarray` of np_info_t): (n,4) Indices of the 
+                  vertices of the cell containing each point. A value of 
+                  np.iinfo(np_info).max indicates the infinite vertex.
+                * lt (:obj:`ndarray` of int32): Locate type for each point 
+                  (0 = vertex, 1 = edge, 2 = facet, 3 = cell, 4 = outside 
+                  the convex hull, 5 = outside the affine hull).
+                * li (:obj:`ndarray` of int32): Index in the cell of the 
+                  vertex (lt == 0), first vertex of the edge (lt == 1), or 
+                  vertex opposite the facet (lt == 2).
+                * lj (:obj:`ndarray` of int32): Index in the cell of the 
+                  second vertex of the edge (lt == 1).
+
+        """
+        assert(pos.shape[1] == 3)
+        pos = np.ascontiguousarray(pos)
+        cdef uint64_t n = pos.shape[0]
+        cdef np.ndarray[np_info_t, ndim=2] cells
+        cdef np.ndarray[np.int32_t, ndim=1] lt, li, lj
+        cells = np.zeros((n, 4), np_info)
+        lt = np.zeros(n, 'int32')
+        li = np.zeros(n, 'int32')
+        lj = np.zeros(n, 'int32')
+        if n == 0:
+            return cells, lt, li, lj
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.locate_many(&pos[0,0], n, &cells[0,0],
+                               <int*>&lt[0], <int*>&li[0], <int*>&lj[0])
+        return cells, lt, li, lj
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def nearest_vertex_many(self, np.ndarray[np.float64_t, ndim=2] pos):
+        r"""Determine which vertex is closest to each point in a set. The 
+        points are sorted and divided between threads as in 
+        :meth:`Delaunay3_64bit.locate_many`.
+
+        Args:
+            pos (:obj:`ndarray` of float64): (n,3) coordinates of points.
+
+        Returns:
+            :obj:`ndarray` of np_info_t: Index of the vertex closest to each 
+                point.
+
+        """
+        assert(pos.shape[1] == 3)
+        pos = np.ascontiguousarray(pos)
+        cdef uint64_t n = pos.shape[0]
+        cdef np.ndarray[np_info_t, ndim=1] verts
+        verts = np.zeros(n, np_info)
+        if n == 0:
+            return verts
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.nearest_vertex_many(&pos[0,0], n, &verts[0])
+        return verts
+
     @property
     def all_verts_begin(self):
         r"""Delaunay3_64bit_vertex_iter: Starting vertex for all vertices in the 
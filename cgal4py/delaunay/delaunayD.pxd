@@ -35,6 +35,7 @@ cdef extern from "c_delaunayD.hpp":
         Vertex infinite_vertex() const
 
         void insert(double *, Info *val, uint32_t n) except +
+        void insert_unsorted(double *, Info *val, uint32_t n) except +
         void remove(Vertex) except +
         void clear() except + 
 
@@ -55,6 +56,8 @@ cdef extern from "c_delaunayD.hpp":
                                     I* cells, I* neighbors, I idx_inf)
 
         Vertex get_vertex(Info index) except +
+        void set_vertex_index(bool enable)
+        vector[Vertex] get_vertices(Info *index, uint64_t n) except +
         Cell locate(double* pos, int& lt, Face &f, Facet &ft)
         Cell locate(double* pos, int& lt, Face &f, Facet &ft, Cell c)
 
@@ -1866,12 +1866,18 @@ cdef class DelaunayD:
     @_update_to_tess
     @cython.boundscheck(False)
     @cython.wraparound(False)
-    def insert(self, np.ndarray[double, ndim=2, mode="c"] pts not None):
+    def insert(self, np.ndarray[double, ndim=2, mode="c"] pts not None,
+               pybool sort=True):
         r"""Insert points into the triangulation.
 
         Args:
-            pts (:obj:`ndarray` of :obj:`float64`): Array of 3D cartesian 
-                points to insert into the triangulation. 
+            pts (:obj:`ndarray` of :obj:`float64`): Array of D-dimensional
+                cartesian points to insert into the triangulation. 
+            sort (bool, optional): If True, the points are sorted along a
+                space filling curve and each is located starting from the
+                last vertex inserted, which is much faster for large sets of
+                points. If False, the points are inserted one at a time in
+                the order given. Defaults to True.
 
         """
         global np_info, np_info_t
@@ -1885,8 +1891,12 @@ cdef class DelaunayD:
         assert(m == D)
         cdef np.ndarray[np_info_t, ndim=1] idx
         idx = np.arange(Nold, Nold+Nnew).astype(np_info)
+        cdef cbool c_sort = <cbool>sort
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            self.T.insert(&pts[0,0], &idx[0], <info_t>Nnew)
+            if c_sort:
+                self.T.insert(&pts[0,0], &idx[0], <info_t>Nnew)
+            else:
+                self.T.insert_unsorted(&pts[0,0], &idx[0], <info_t>Nnew)
         self.n += Nnew
         self.n_per_insert.append(Nnew)
 
@@ -1952,6 +1962,49 @@ cdef class DelaunayD:
         out.assign(self.T, v)
         return out
 
+    def set_vertex_index(self, pybool enable=True):
+        r"""Turn on/off the table used to look up vertices by index. While
+        it is on, :meth:`DelaunayD.get_vertex` and :meth:`DelaunayD.get_vertices`
+        do not walk the vertices and the table is kept up to date as
+        vertices are inserted, removed, and moved.
+
+        Args:
+            enable (bool, optional): If True, the table is used. If False, it
+                is freed. Defaults to True.
+
+        """
+        cdef cbool c_enable = <cbool>enable
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.set_vertex_index(c_enable)
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def get_vertices(self, object indices):
+        r"""Get the vertex objects corresponding to a set of indices.
+
+        Args:
+            indices (:obj:`ndarray` of np_info_t): Indices of vertices that
+                should be found.
+
+        Returns:
+            DelaunayD_vertex_vector: Vertices corresponding to the
+                given indices. Indices that are not found are handled as
+                in :meth:`DelaunayD.get_vertex`.
+
+        """
+        cdef np.ndarray[np_info_t, ndim=1] idx
+        idx = np.ascontiguousarray(indices, dtype=np_info).ravel()
+        cdef uint64_t n = idx.size
+        cdef info_t* ptr_idx = NULL
+        if n > 0:
+            ptr_idx = &idx[0]
+        cdef vector[Delaunay_with_info_D[info_t].Vertex] v
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            v = self.T.get_vertices(ptr_idx, n)
+        cdef DelaunayD_vertex_vector out = DelaunayD_vertex_vector()
+        out.assign(self.T, v)
+        return out
+
     def locate(self, np.ndarray[np.float64_t, ndim=1] pos,
                DelaunayD_cell start = None):
         r"""Get the vertex/cell/facet/edge that a given point is a part of.
@@ -79,6 +79,8 @@ enum  Sign
       int y() { return 0; }
       int z() { return 0; }
       int operator[](int i) { return 0;}
+      Offset operator+(const Offset &o) const { return Offset(); }
+      Offset operator-(const Offset &o) const { return Offset(); }
     };
 
     class Point {
@@ -86,9 +88,9 @@ enum  Sign
       Point() {};
       Point(double x, double y) {};
       Point(double x, double y, double z) {};
-      double x() { return 0.0; }
-      double y() { return 0.0; }
-      double z() { return 0.0; }
+      double x() const { return 0.0; }
+      double y() const { return 0.0; }
+      double z() const { return 0.0; }
     };
 
     class Segment {
@@ -1697,7 +1699,29 @@ enum  Sign
   template < class K >
   class Periodic_2_triangulation_traits_2 : public K {};
   template < class K >
-  class Periodic_3_Delaunay_triangulation_traits_3 : public K {};
+  class Periodic_3_Delaunay_triangulation_traits_3 : public K {
+  public:
+    typedef typename K::Point Point;
+    typedef typename K::Offset Offset;
+    class Orientation_3 {
+    public:
+      Orientation operator()(const Point &p0, const Point &p1,
+                             const Point &p2, const Point &p3,
+                             const Offset &o0, const Offset &o1,
+                             const Offset &o2, const Offset &o3) const { return ZERO; }
+    };
+    class Side_of_oriented_sphere_3 {
+    public:
+      Oriented_side operator()(const Point &p0, const Point &p1,
+                               const Point &p2, const Point &p3,
+                               const Point &p4,
+                               const Offset &o0, const Offset &o1,
+                               const Offset &o2, const Offset &o3,
+                               const Offset &o4) const { return ON_ORIENTED_BOUNDARY; }
+    };
+    Orientation_3 orientation_3_object() const { return Orientation_3(); }
+    Side_of_oriented_sphere_3 side_of_oriented_sphere_3_object() const { return Side_of_oriented_sphere_3(); }
+  };
 
   template < class Gt, class Tds >
   class Periodic_2_Delaunay_triangulation_2 : 
@@ -1841,8 +1865,10 @@ enum  Sign
 
   private:
     std::vector<Vertex_handle> _vert;
+    Gt _gt;
   public:
 
+    const Gt& geom_traits() const { return _gt; }
     Covering_sheets number_of_sheets() const { return {0,0,0}; }
     int number_of_stored_vertices() const { return 0; }
     int number_of_stored_edges() const { return 0; }
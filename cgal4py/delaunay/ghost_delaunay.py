@@ -0,0 +1,252 @@
+r"""Periodic triangulations emulated by adding periodic images ("ghosts") of
+the points near the domain edges to a non-periodic triangulation.
+
+When the points are dense enough, this is much cheaper than the periodic
+CGAL triangulations and never needs the covering sheets those start from.
+
+"""
+import itertools
+import numpy as np
+from cgal4py.delaunay import tools
+
+
+class GhostPeriodicDelaunay(object):
+    r"""Triangulation of points in a periodic domain that adds images of the
+    points within a layer around the domain to a non-periodic triangulation.
+    The layer is grown until the circumsphere of every cell with an original
+    point lies inside it, at which point the cells around the original
+    points are the same as in the periodic triangulation.
+
+    Args:
+        pts (np.ndarray of float64): (n,m) array of n m-dimensional
+            coordinates inside the domain.
+        left_edge (np.ndarray of float64): (m,) lower limits on the domain.
+        right_edge (np.ndarray of float64): (m,) upper limits on the domain.
+        use_double (bool, optional): If True, the triangulation uses 64bit
+            integers. Defaults to False.
+        width (float, optional): Initial width of the ghost layer. If None,
+            twice the mean spacing between points is used. Defaults to None.
+
+    Raises:
+        NotImplementedError: If the points are not 2D or 3D.
+        RuntimeError: If the layer is as wide as the domain and the stars of
+            some points are still not complete. A periodic triangulation
+            should be used for such sparse point sets.
+
+    Attributes:
+        T (:class:`cgal4py.delaunay.Delaunay2` or
+            :class:`cgal4py.delaunay.Delaunay3`): Non-periodic triangulation
+            of the points and their images. Vertices with indices of at
+            least `n` are images.
+        n (int): Number of original points.
+        width (float): Width of the ghost layer.
+        ghost_source (np.ndarray of int64): Index of the original point
+            for each image.
+        ghost_offset (np.ndarray of int64): (nghost,m) Number of domain
+            widths each image is shifted by in each dimension.
+
+    """
+
+    def __init__(self, pts, left_edge, right_edge, use_double=False,
+                 width=None):
+        from cgal4py.delaunay import _get_Delaunay
+        self.ndim = pts.shape[1]
+        if self.ndim not in (2, 3):
+            raise NotImplementedError("Ghost periodic triangulations are " +
+                                      "only supported in 2D and 3D.")
+        self.n = pts.shape[0]
+        self.left_edge = np.asarray(left_edge, dtype='float64')
+        self.right_edge = np.asarray(right_edge, dtype='float64')
+        self.domain_width = self.right_edge - self.left_edge
+        self.pts = np.ascontiguousarray(pts, dtype='float64')
+        self.T = _get_Delaunay(self.ndim, bit64=use_double)()
+        self.ghost_source = np.zeros(0, 'int64')
+        self.ghost_offset = np.zeros((0, self.ndim), 'int64')
+        self.width = 0.0
+        if self.n == 0:
+            return
+        self.T.insert(self.pts)
+        if width is None:
+            width = 2.0*(np.prod(self.domain_width)/self.n)**(1.0/self.ndim)
+        max_width = np.max(self.domain_width)
+        while True:
+            self._add_ghosts(min(width, max_width))
+            need = self._needed_width()
+            if np.all(need <= np.minimum(self.width, self.domain_width)):
+                break
+            if self.width >= max_width:
+                raise RuntimeError("The ghost layer is as wide as the " +
+                                   "domain, but not all stars are " +
+                                   "complete. Use a periodic triangulation.")
+            width = max(2.0*self.width, np.max(need))
+
+    def _add_ghosts(self, width):
+        r"""Insert the images that are within `width` of the domain, but
+        not within the current layer.
+
+        Args:
+            width (float): New width of the ghost layer.
+
+        """
+        le, re = self.left_edge, self.right_edge
+        old = np.minimum(self.width, self.domain_width)
+        new = np.minimum(width, self.domain_width)
+        src = []
+        off = []
+        for o in itertools.product([-1, 0, 1], repeat=self.ndim):
+            o = np.array(o, 'int64')
+            if not np.any(o):
+                continue
+            x = self.pts + o*self.domain_width
+            inside_new = np.all((x >= le - new) & (x < re + new), axis=1)
+            inside_old = np.all((x >= le - old) & (x < re + old), axis=1)
+            idx = np.where(inside_new & ~inside_old)[0]
+            src.append(idx)
+            off.append(np.tile(o, (len(idx), 1)))
+        self.width = width
+        src = np.concatenate(src)
+        off = np.concatenate(off)
+        if len(src) == 0:
+            return
+        # Images are added in the same order as ghost_source, so their
+        # indices follow on from the points already in the triangulation
+        self.T.insert(np.ascontiguousarray(self.pts[src] +
+                                           off*self.domain_width))
+        self.ghost_source = np.concatenate([self.ghost_source, src])
+        self.ghost_offset = np.concatenate([self.ghost_offset, off])
+
+    def _needed_width(self):
+        r"""Get the width of the ghost layer needed to contain the
+        circumspheres of all cells with an original point.
+
+        Returns:
+            np.ndarray of float64: (m,) Needed width in each dimension. This
+                is infinite if an original point is on the convex hull.
+
+        """
+        cells, neighbors, idx_inf = self.T.serialize()
+        cells = cells[np.any(cells < self.n, axis=1)]
+        if np.any(cells == idx_inf):
+            return np.inf*np.ones(self.ndim)
+        pos = self.T.vertices
+        cc = tools.circumcenters(pos, cells)
+        r = np.sqrt(((pos[cells[:, 0]] - cc)**2).sum(axis=1))[:, None]
+        lo = np.max(self.left_edge - (cc - r), axis=0)
+        hi = np.max((cc + r) - self.right_edge, axis=0)
+        return np.maximum(0.0, np.maximum(lo, hi))
+
+    def source(self, index):
+        r"""Get the index of the original point for vertices of :attr:`T`.
+
+        Args:
+            index (int or np.ndarray of int): Vertex indices.
+
+        Returns:
+            int or np.ndarray of int: Indices of the original points.
+
+        """
+        index = np.asarray(index, dtype='int64')
+        out = index.copy()
+        ghost = (index >= self.n)
+        out[ghost] = self.ghost_source[index[ghost] - self.n]
+        return out
+
+    def wrap(self, pos):
+        r"""Shift positions by whole domain widths so that they are inside
+        the domain. Positions that are already inside are not changed.
+
+        Args:
+            pos (np.ndarray of float64): (m,) or (n,m) coordinates.
+
+        Returns:
+            np.ndarray of float64: Coordinates inside the domain.
+
+        """
+        pos = np.asarray(pos, dtype='float64')
+        shift = np.floor((pos - self.left_edge)/self.domain_width)
+        return pos - shift*self.domain_width
+
+    def get_vertex(self, index):
+        r"""Get the vertex of :attr:`T` for an original point. Indices of
+        images are mapped to the original point they are an image of.
+
+        Args:
+            index (int): Index of a vertex in :attr:`T`.
+
+        Returns:
+            :class:`cgal4py.delaunay.Delaunay2_vertex` or
+                :class:`cgal4py.delaunay.Delaunay3_vertex`: Vertex of the
+                original point. If the index is not found, the infinite
+                vertex is returned.
+
+        """
+        if 0 <= index < self.T.num_finite_verts:
+            index = int(self.source(index))
+        return self.T.get_vertex(index)
+
+    def nearest_vertex(self, x):
+        r"""Determine which original point is closest to a position in the
+        periodic domain.
+
+        Args:
+            x (np.ndarray of float64): (m,) coordinates. These can be outside
+                of the domain.
+
+        Returns:
+            :class:`cgal4py.delaunay.Delaunay2_vertex` or
+                :class:`cgal4py.delaunay.Delaunay3_vertex`: Vertex of the
+                closest original point.
+
+        """
+        v = self.T.nearest_vertex(np.ascontiguousarray(self.wrap(x)))
+        return self.get_vertex(v.index)
+
+    def locate(self, pos):
+        r"""Get the original points at the vertices of the vertex, edge,
+        facet, or cell that a position in the periodic domain is a part of.
+
+        Args:
+            pos (np.ndarray of float64): (m,) coordinates. These can be
+                outside of the domain.
+
+        Returns:
+            np.ndarray of int64: Indices of the original points at the
+                vertices of the vertex, edge, facet, or cell containing
+                `pos`. Images are replaced by their original points, so
+                the same point can occur more than once in small domains.
+
+        """
+        x = self.T.locate(np.ascontiguousarray(self.wrap(pos)))
+        kind = type(x).__name__.rsplit('_', 1)[-1]
+        if kind == 'vertex':
+            idx = [x.index]
+        else:
+            nverts = {'edge': 2, 'facet': 3, 'cell': self.ndim + 1}[kind]
+            idx = [x.vertex(i).index for i in range(nverts)]
+        return self.source(np.array(idx, dtype='int64'))
+
+    @property
+    def num_finite_verts(self):
+        r"""int: Number of original points."""
+        return self.n
+
+    @property
+    def vertices(self):
+        r"""ndarray: Coordinates of the original points."""
+        return self.T.vertices[:self.n]
+
+    @property
+    def edges(self):
+        r""":obj:`ndarray` of int64: Pairs of original point indices that
+        share an edge in the periodic triangulation."""
+        e = np.asarray(self.T.edges, dtype='int64')
+        e = e[np.any(e < self.n, axis=1)]
+        e = np.sort(self.source(e), axis=1)
+        if len(e) == 0:
+            return e
+        return np.unique(e, axis=0)
+
+    def voronoi_volumes(self):
+        r"""np.ndarray of float64: Volumes of the periodic voronoi cells of
+        the original points."""
+        return self.T.voronoi_volumes()[:self.n]
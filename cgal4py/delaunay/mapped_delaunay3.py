@@ -0,0 +1,284 @@
+r"""Read-only access to 3D triangulations saved with
+:meth:`cgal4py.delaunay.Delaunay3.write_to_file` that does not construct a
+CGAL triangulation.
+
+The vertex positions, infos, cell vertices, and cell neighbors are memory
+mapped from the file, so only the pages that are needed are read. For
+anything that the mapped view does not provide (e.g. insert or remove), a
+full triangulation must be read from the file with
+:meth:`MappedDelaunay3.full`.
+
+"""
+import numpy as np
+from cgal4py.delaunay import tools
+
+
+_header_dtype = np.dtype([('format', '<i4'), ('d', '<i4'),
+                          ('info_size', '<u4'), ('idx_size', '<u4'),
+                          ('n', '<u8'), ('m', '<u8')])
+
+# Pairs of cell vertices that are connected by edges
+_cell_edges = [(0, 1), (0, 2), (0, 3), (1, 2), (1, 3), (2, 3)]
+
+
+class MappedDelaunay3(object):
+    r"""Read-only view of a 3D triangulation file written by
+    :meth:`cgal4py.delaunay.Delaunay3.write_to_file`.
+
+    :attr:`vertices`, :attr:`edges`, :meth:`voronoi_volumes`,
+    :meth:`incident_vertices`, and :meth:`locate` are computed from the
+    memory mapped arrays. Other methods of
+    :class:`cgal4py.delaunay.Delaunay3` (e.g. insert, remove, move) are not
+    provided and must be called on the triangulation returned by
+    :meth:`full`. Once it has been read, the methods above are answered by
+    that triangulation instead, so they reflect any changes made to it.
+
+    Args:
+        fname (str): Full path to the triangulation file.
+        chunk_size (int, optional): Number of cells processed at once by
+            :meth:`voronoi_volumes` and :attr:`edges`. Defaults to 2**20.
+
+    Raises:
+        ValueError: If the file was written in the older per-element format,
+            which cannot be mapped.
+
+    Attributes:
+        fname (str): Full path to the triangulation file.
+        positions (np.ndarray of float64): (n, 3) vertex positions in file
+            order.
+        info (np.ndarray of uint32 or uint64): (n,) vertex infos in file
+            order.
+        cells (np.ndarray of uint32 or uint64): (num_cells, 4) indices of
+            the vertices of each cell in file order. The infinite vertex is
+            `n`.
+        neighbors (np.ndarray of uint32 or uint64): (num_cells, 4) indices
+            of the cell opposite each vertex of each cell.
+
+    """
+
+    def __init__(self, fname, chunk_size=2**20):
+        self._T = None
+        self.fname = fname
+        self.chunk_size = chunk_size
+        header = np.fromfile(fname, dtype=_header_dtype, count=1)
+        if (len(header) == 0) or (header['format'][0] >= 0):
+            raise ValueError("{} was not written in the ".format(fname) +
+                             "array format and cannot be mapped.")
+        self._d = int(header['d'][0])
+        self._n = int(header['n'][0])
+        self._num_cells = int(header['m'][0])
+        info_dtype = np.dtype('<u{}'.format(header['info_size'][0]))
+        idx_dtype = np.dtype('<u{}'.format(header['idx_size'][0]))
+        self._bit64 = (info_dtype.itemsize == 8)
+        self._vertex_of_info = None
+        self._incident_start = None
+        self._incident_cells = None
+        n, m = self._n, self._num_cells
+        ncv = self._d + 1
+        if n == 0:
+            self.positions = np.zeros((0, 3), 'float64')
+            self.info = np.zeros(0, info_dtype)
+            self.cells = np.zeros((0, 4), idx_dtype)
+            self.neighbors = np.zeros((0, 4), idx_dtype)
+            return
+        offset = _header_dtype.itemsize
+        self.positions = np.memmap(fname, dtype='<f8', mode='r',
+                                   offset=offset, shape=(n, 3))
+        offset += 3*n*8
+        self.info = np.memmap(fname, dtype=info_dtype, mode='r',
+                              offset=offset, shape=(n,))
+        offset += n*info_dtype.itemsize
+        self.cells = np.memmap(fname, dtype=idx_dtype, mode='r',
+                               offset=offset, shape=(m, ncv))
+        offset += m*ncv*idx_dtype.itemsize
+        self.neighbors = np.memmap(fname, dtype=idx_dtype, mode='r',
+                                   offset=offset, shape=(m, ncv))
+
+    def full(self):
+        r"""Read the file into a full triangulation. Later calls return the
+        same triangulation.
+
+        Returns:
+            :class:`cgal4py.delaunay.Delaunay3`: Triangulation read from the
+                file.
+
+        """
+        if self._T is None:
+            from cgal4py.delaunay import _get_Delaunay
+            self._T = _get_Delaunay(3, bit64=self._bit64).from_file(self.fname)
+        return self._T
+
+    def _mapped(self):
+        r"""bool: True if calls can be answered from the mapped arrays."""
+        return (self._T is None) and (self._d == 3)
+
+    @property
+    def n(self):
+        r"""int: Number of finite vertices."""
+        if self._T is not None:
+            return self._T.num_finite_verts
+        return self._n
+
+    @property
+    def num_cells(self):
+        r"""int: Number of cells, including infinite cells."""
+        if self._T is not None:
+            return self._T.num_cells
+        return self._num_cells
+
+    @property
+    def num_finite_verts(self):
+        r"""int: Number of finite vertices."""
+        if not self._mapped():
+            return self.full().num_finite_verts
+        return self.n
+
+    @property
+    def vertices(self):
+        r"""ndarray: The x,y,z coordinates of the vertices in the order of
+        their infos."""
+        if not self._mapped():
+            return self.full().vertices
+        out = np.zeros([self.n, 3], 'float64')
+        out[self.info, :] = self.positions
+        return out
+
+    def _chunks(self):
+        for i in range(0, self.num_cells, self.chunk_size):
+            yield i, min(i + self.chunk_size, self.num_cells)
+
+    @property
+    def edges(self):
+        r""":obj:`ndarray` of info: Info pairs for finite edges."""
+        if not self._mapped():
+            return self.full().edges
+        pairs = []
+        for i0, i1 in self._chunks():
+            c = np.asarray(self.cells[i0:i1], dtype='uint64')
+            for a, b in _cell_edges:
+                e = np.sort(np.stack([c[:, a], c[:, b]], axis=1), axis=1)
+                pairs.append(e[e[:, 1] < self.n])
+        if len(pairs) == 0:
+            return np.zeros((0, 2), self.info.dtype)
+        pairs = np.concatenate(pairs)
+        pairs = pairs[np.lexsort((pairs[:, 1], pairs[:, 0]))]
+        keep = np.ones(len(pairs), 'bool')
+        keep[1:] = np.any(pairs[1:] != pairs[:-1], axis=1)
+        return np.asarray(self.info)[pairs[keep]]
+
+    def voronoi_volumes(self):
+        r"""np.ndarray of float64: Array of voronoi cell volumes for vertices
+        in the order of their infos. Vertices with infinite cells have a
+        volume of -1. The finite cells are passed to
+        :func:`cgal4py.delaunay.tools.dual_volumes` one chunk at a time, so
+        the volumes use the same kernel as
+        :meth:`cgal4py.delaunay.Delaunay3.voronoi_volumes`."""
+        if not self._mapped():
+            return self.full().voronoi_volumes()
+        vols = np.zeros(self.n, 'float64')
+        unbounded = np.zeros(self.n, 'bool')
+        for i0, i1 in self._chunks():
+            c = np.asarray(self.cells[i0:i1], dtype='int64')
+            finite = np.all(c < self.n, axis=1)
+            inf_verts = c[~finite].ravel()
+            unbounded[inf_verts[inf_verts < self.n]] = True
+            c = c[finite]
+            if len(c) == 0:
+                continue
+            vols += tools.dual_volumes(self.positions, c, self.n)
+        vols[unbounded] = -1.0
+        out = np.empty(self.n, 'float64')
+        out[self.info] = vols
+        return out
+
+    def _vertex(self, index):
+        r"""Position of the vertex with the given info in the mapped arrays."""
+        if self._vertex_of_info is None:
+            self._vertex_of_info = np.empty(self.n, 'int64')
+            self._vertex_of_info[self.info] = np.arange(self.n)
+        return self._vertex_of_info[index]
+
+    def incident_vertices(self, index):
+        r"""Get the finite vertices that share an edge with a vertex.
+
+        Args:
+            index (int): Info of the vertex.
+
+        Returns:
+            np.ndarray of info: Infos of the incident finite vertices in
+                ascending order.
+
+        """
+        if not self._mapped():
+            v = self.full().get_vertex(index)
+            out = [x.index for x in v.incident_vertices()
+                   if not x.is_infinite()]
+            return np.sort(np.array(out, dtype=self.info.dtype))
+        if self._incident_start is None:
+            flat = np.asarray(self.cells, dtype='int64').ravel()
+            self._incident_cells = np.argsort(flat, kind='mergesort') // 4
+            counts = np.bincount(flat, minlength=self.n + 1)
+            self._incident_start = np.zeros(self.n + 2, 'int64')
+            np.cumsum(counts, out=self._incident_start[1:])
+        v = self._vertex(index)
+        c = self._incident_cells[self._incident_start[v]:
+                                 self._incident_start[v+1]]
+        x = np.unique(np.asarray(self.cells[c]).ravel())
+        x = x[(x != v) & (x < self.n)]
+        return np.sort(np.asarray(self.info)[x])
+
+    def locate(self, pos, start=None):
+        r"""Find the cell containing a point by walking between neighboring
+        cells. Orientations are computed in floating point, so the result
+        may differ from :meth:`cgal4py.delaunay.Delaunay3.locate` for points
+        on or very near a facet. The compiled locate is not used because it
+        needs the full CGAL triangulation, which would mean reading every
+        cell in the file, while the walk only reads the cells it visits.
+
+        Args:
+            pos (np.ndarray of float64): (3,) coordinates of the point.
+            start (int, optional): Index of the cell to start the walk
+                from. If None, the walk starts from the first finite cell.
+                Defaults to None.
+
+        Returns:
+            int: Index of the cell containing the point in :attr:`cells`.
+                This is an infinite cell if the point is outside the convex
+                hull.
+
+        """
+        if not self._mapped():
+            raise NotImplementedError("Only triangulations with 4 or more " +
+                                      "non-coplanar points that have not " +
+                                      "been modified can be located in.")
+        pos = np.asarray(pos, dtype='float64')
+        if start is None:
+            start = 0
+            for i0, i1 in self._chunks():
+                finite = np.all(np.asarray(self.cells[i0:i1]) < self.n, axis=1)
+                if np.any(finite):
+                    start = i0 + int(np.argmax(finite))
+                    break
+        c = start
+        prev = -1
+        rng = np.random.RandomState(0)
+        for _ in range(self.num_cells + 1):
+            verts = np.asarray(self.cells[c], dtype='int64')
+            if np.any(verts == self.n):
+                return c
+            p = [np.asarray(self.positions[v]) for v in verts]
+            nxt = -1
+            for i in rng.permutation(4):
+                nc = int(self.neighbors[c, i])
+                if nc == prev:
+                    continue
+                q = list(p)
+                q[i] = pos
+                if np.dot(q[1] - q[0],
+                          np.cross(q[2] - q[0], q[3] - q[0])) < 0:
+                    nxt = nc
+                    break
+            if nxt < 0:
+                return c
+            prev, c = c, nxt
+        return c
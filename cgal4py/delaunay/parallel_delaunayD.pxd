@@ -9,7 +9,7 @@ from libc.stdint cimport uint32_t, uint64_t, int32_t, int64_t, uint8_t
 cdef extern from "c_parallel_delaunayD.hpp":
     cdef int VALID
 
-    cdef cppclass ParallelDelaunay_with_info_D[Info] nogil:
+    cdef cppclass ParallelDelaunay_with_info_D[Info, Coord=*] nogil:
         ParallelDelaunay_with_info_D()
         ParallelDelaunay_with_info_D(uint32_t ndim0, double *le0, double *re0,
                                      cbool *periodic0, const char *unique_str0)
@@ -18,17 +18,31 @@ cdef extern from "c_parallel_delaunayD.hpp":
         ParallelDelaunay_with_info_D(uint32_t ndim0, double *le0, double *re0,
                                      cbool *periodic0, int limit_mem,
                                      const char *unique_str0)
+        ParallelDelaunay_with_info_D(uint32_t ndim0, double *le0, double *re0,
+                                     cbool *periodic0, int limit_mem,
+                                     const char *unique_str0, int reorder0)
+        ParallelDelaunay_with_info_D(uint32_t ndim0, double *le0, double *re0,
+                                     cbool *periodic0, int limit_mem,
+                                     const char *unique_str0, int reorder0,
+                                     const char *tree_file0)
+        ParallelDelaunay_with_info_D(uint32_t ndim0, double *le0, double *re0,
+                                     cbool *periodic0, int limit_mem,
+                                     const char *unique_str0, int reorder0,
+                                     const char *tree_file0,
+                                     double rebalance0)
 
         int rank
         int size
         uint32_t ndim
         int limit_mem
+        int reorder
+        double rebalance
         uint64_t npts_total
         uint64_t *idx_total
         Info *info_total
-        double *pts_total
+        Coord *pts_total
 
-        void insert(uint64_t npts, double *pts) except +
+        void insert(uint64_t npts, Coord *pts) except +
 
         uint64_t num_cells()
         void consolidate_vols(double *vols) except +
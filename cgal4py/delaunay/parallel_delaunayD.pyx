@@ -19,7 +19,9 @@ ctypedef np.uint32_t np_info_t
 cdef class ParallelDelaunayD:
 
     cdef ParallelDelaunay_with_info_D[info_t] *T
+    cdef ParallelDelaunay_with_info_D[info_t, float] *T32
     cdef object pts_total
+    cdef object dtype
     cdef int rank
     cdef int size
 
@@ -27,16 +29,29 @@ cdef class ParallelDelaunayD:
     @cython.wraparound(False)
     def __cinit__(self, np.ndarray[np.float64_t, ndim=1] le = None,
                   np.ndarray[np.float64_t, ndim=1] re = None,
-                  object periodic=False, str unique_str="", int limit_mem=0):
+                  object periodic=False, str unique_str="", int limit_mem=0,
+                  cbool reorder=False, str tree_file="",
+                  str dtype='float64', double rebalance=0.0):
         cdef np.uint32_t ndim = 0
         cdef cbool* per = NULL
         cdef double* ptr_le = NULL
         cdef double* ptr_re = NULL
         cdef object comm = MPI.COMM_WORLD
+        if dtype not in ['float64', 'float32']:
+            raise ValueError("'{}' is not a supported dtype. ".format(dtype) +
+                             "Options are 'float64' and 'float32'.")
+        self.dtype = dtype
+        cdef cbool single = (dtype == 'float32')
+        self.T = NULL
+        self.T32 = NULL
         self.size = comm.Get_size()
         self.rank = comm.Get_rank()
         cdef bytes py_bytes = unique_str.encode()
         cdef char* c_unique_str = py_bytes
+        if tree_file is None:
+            tree_file = ""
+        cdef bytes py_tree_file = tree_file.encode()
+        cdef char* c_tree_file = py_tree_file
         if self.rank == 0:
             ndim = le.size
             ptr_le = &le[0]
@@ -52,33 +67,70 @@ cdef class ParallelDelaunayD:
             assert(le == None)
             assert(re == None)
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            self.T = new ParallelDelaunay_with_info_D[info_t](
-                ndim, ptr_le, ptr_re, per, limit_mem, c_unique_str)
+            if single:
+                self.T32 = new ParallelDelaunay_with_info_D[info_t, float](
+                    ndim, ptr_le, ptr_re, per, limit_mem, c_unique_str,
+                    <int>reorder, c_tree_file, rebalance)
+            else:
+                self.T = new ParallelDelaunay_with_info_D[info_t](
+                    ndim, ptr_le, ptr_re, per, limit_mem, c_unique_str,
+                    <int>reorder, c_tree_file, rebalance)
 
     @cython.boundscheck(False)
     @cython.wraparound(False)
-    def insert(self, np.ndarray[np.float64_t, ndim=2] pts = None):
+    def insert(self, np.ndarray pts = None):
         cdef np.uint32_t ndim = 0
         cdef np.uint64_t npts = 0
+        cdef np.ndarray[np.float64_t, ndim=2] pts64
+        cdef np.ndarray[np.float32_t, ndim=2] pts32
         cdef double *ptr_pts = NULL
+        cdef float *ptr_pts32 = NULL
         if self.rank == 0:
+            pts = np.ascontiguousarray(pts, dtype=self.dtype)
             ndim = pts.shape[1]
-            assert(ndim == self.T.ndim)
+            assert(ndim == self.ndim)
             npts = pts.shape[0]
-            ptr_pts = &pts[0,0]
+            if self.T32 != NULL:
+                pts32 = pts
+                ptr_pts32 = &pts32[0,0]
+            else:
+                pts64 = pts
+                ptr_pts = &pts64[0,0]
         else:
             assert(pts == None)
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            self.T.insert(npts, ptr_pts)
+            if self.T32 != NULL:
+                self.T32.insert(npts, ptr_pts32)
+            else:
+                self.T.insert(npts, ptr_pts)
         self.pts_total = pts
 
+    @property
+    def ndim(self):
+        if self.T32 != NULL:
+            return self.T32.ndim
+        return self.T.ndim
+
+    @property
+    def npts_total(self):
+        if self.T32 != NULL:
+            return self.T32.npts_total
+        return self.T.npts_total
+
     @cython.boundscheck(False)
     @cython.wraparound(False)
     def consolidate_vols(self):
         cdef np.ndarray[np.float64_t, ndim=1] vols
-        vols = np.empty(self.T.npts_total, 'float64')
+        # Volumes are only gathered on root
+        if self.rank == 0:
+            vols = np.empty(self.npts_total, 'float64')
+        else:
+            vols = np.empty(0, 'float64')
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            self.T.consolidate_vols(&vols[0])
+            if self.T32 != NULL:
+                self.T32.consolidate_vols(&vols[0])
+            else:
+                self.T.consolidate_vols(&vols[0])
         return vols
 
     @cython.boundscheck(False)
@@ -88,25 +140,43 @@ cdef class ParallelDelaunayD:
         cdef uint64_t ncells, ncells_out
         cdef info_t idx_inf = 0
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            ncells = <uint64_t>self.T.num_cells()
+            if self.T32 != NULL:
+                ncells = <uint64_t>self.T32.num_cells()
+            else:
+                ncells = <uint64_t>self.T.num_cells()
+        cdef uint32_t ndim = self.ndim
         cdef np.ndarray[np_info_t, ndim=2] allverts
         cdef np.ndarray[np_info_t, ndim=2] allneigh
-        allverts = np.empty((ncells, self.T.ndim+1), np_info)
-        allneigh = np.empty((ncells, self.T.ndim+1), np_info)
+        allverts = np.empty((ncells, ndim+1), np_info)
+        allneigh = np.empty((ncells, ndim+1), np_info)
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            ncells_out = self.T.consolidate_tess(ncells, &idx_inf,
-                                                 &allverts[0,0], &allneigh[0,0])
-        allverts.resize(ncells_out, self.T.ndim+1, refcheck=False)
-        allneigh.resize(ncells_out, self.T.ndim+1, refcheck=False)
+            if self.T32 != NULL:
+                ncells_out = self.T32.consolidate_tess(ncells, &idx_inf,
+                                                       &allverts[0,0],
+                                                       &allneigh[0,0])
+            else:
+                ncells_out = self.T.consolidate_tess(ncells, &idx_inf,
+                                                     &allverts[0,0],
+                                                     &allneigh[0,0])
+        allverts.resize(ncells_out, ndim+1, refcheck=False)
+        allneigh.resize(ncells_out, ndim+1, refcheck=False)
+        cdef uint64_t npts_total = self.npts_total
+        cdef uint64_t *idx_total
+        if self.T32 != NULL:
+            idx_total = self.T32.idx_total
+        else:
+            idx_total = self.T.idx_total
         cdef np.ndarray[np_info_t, ndim=1] info_total
-        info_total = np.empty(self.T.npts_total, np_info)
         cdef uint64_t i
-        for i in range(self.T.npts_total):
-            info_total[i] = self.T.idx_total[i]
         cdef object T = None
-        if self.T.rank == 0:
-            Delaunay = _get_Delaunay(self.T.ndim, bit64=(np_info==np.uint64))
+        if self.rank == 0:
+            # Only root has the tree's index
+            info_total = np.empty(npts_total, np_info)
+            for i in range(npts_total):
+                info_total[i] = idx_total[i]
+            Delaunay = _get_Delaunay(ndim, bit64=(np_info==np.uint64))
             T = Delaunay()
-            T.deserialize_with_info(self.pts_total, info_total,
-                                    allverts, allneigh, idx_inf)
+            # The serial triangulation is double precision
+            T.deserialize_with_info(np.asarray(self.pts_total, 'float64'),
+                                    info_total, allverts, allneigh, idx_inf)
         return T
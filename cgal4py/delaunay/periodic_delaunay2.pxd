@@ -80,6 +80,8 @@ cdef extern from "c_periodic_delaunay2.hpp":
                                     I* faces, I* neighbors, int32_t* offsets, I idx_inf)
 
         Vertex get_vertex(Info index) except +
+        void set_vertex_index(bool enable)
+        vector[Vertex] get_vertices(Info *index, uint64_t n) except +
         Cell locate(double* pos, int& lt, int& li)
         Cell locate(double* pos, int& lt, int& li, Cell c)
 
@@ -201,7 +203,9 @@ cdef extern from "c_periodic_delaunay2.hpp":
 
         void circumcenter(Cell x, double* out)
         double dual_area(const Vertex v)
-        void dual_areas(double* vols) const
+        double domain_volume() const
+        uint64_t info_bound() const
+        double dual_areas(double* vols, uint64_t nvols, int nthreads) except +
         double length(const Edge e)
 
         bool flip(Cell x, int i)
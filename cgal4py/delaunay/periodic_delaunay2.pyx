@@ -2103,16 +2103,40 @@ cdef class PeriodicDelaunay2:
 
     @cython.boundscheck(False)
     @cython.wraparound(False)
-    def voronoi_volumes(self):
-        r"""np.ndarray of float64: Array of voronoi cell volumes for vertices in 
-        the triangulation. The volumes are in the order in which the vertices 
-        were added to the triangulation."""
+    def voronoi_volumes(self, int nthreads = 1):
+        r"""Get the volumes of the periodic voronoi cells of the vertices in
+        the triangulation. Each cell contributes once to the volumes of its
+        vertices, so no circumcenter is computed more than once.
+
+        Args:
+            nthreads (int, optional): Number of threads the cells are
+                divided between. Defaults to 1.
+
+        Returns:
+            np.ndarray of float64: Array of voronoi cell volumes for vertices
+                in the triangulation. The volumes are in the order in which
+                the vertices were added to the triangulation, indexed by
+                vertex info. Infos without a vertex (e.g. those of removed
+                vertices) have a volume of 0.
+
+        Raises:
+            RuntimeError: If the volumes do not sum to the area of the
+                domain.
+
+        """
         cdef np.ndarray[np.float64_t, ndim=1] out
-        out = np.empty(self.num_finite_verts, 'float64')
+        cdef double total, expected
+        cdef uint64_t nvols
         if self.n == 0:
-            return out
+            return np.empty(0, 'float64')
+        nvols = self.T.info_bound()
+        out = np.empty(nvols, 'float64')
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            self.T.dual_areas(&out[0])
+            total = self.T.dual_areas(&out[0], nvols, nthreads)
+            expected = self.T.domain_volume()
+        if not np.isclose(total, expected, rtol=1e-6, atol=0.0):
+            raise RuntimeError(("Voronoi volumes sum to {}, but the domain " +
+                                "area is {}.").format(total, expected))
         return out
         
     @_update_to_tess
@@ -2246,6 +2270,49 @@ cdef class PeriodicDelaunay2:
         out.assign(self.T, v)
         return out
 
+    def set_vertex_index(self, pybool enable=True):
+        r"""Turn on/off the table used to look up vertices by index. While
+        it is on, :meth:`PeriodicDelaunay2.get_vertex` and :meth:`PeriodicDelaunay2.get_vertices`
+        do not walk the vertices and the table is kept up to date as
+        vertices are inserted, removed, and moved.
+
+        Args:
+            enable (bool, optional): If True, the table is used. If False, it
+                is freed. Defaults to True.
+
+        """
+        cdef cbool c_enable = <cbool>enable
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.set_vertex_index(c_enable)
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def get_vertices(self, object indices):
+        r"""Get the vertex objects corresponding to a set of indices.
+
+        Args:
+            indices (:obj:`ndarray` of np_info_t): Indices of vertices that
+                should be found.
+
+        Returns:
+            PeriodicDelaunay2_vertex_vector: Vertices corresponding to the
+                given indices. Indices that are not found are handled as
+                in :meth:`PeriodicDelaunay2.get_vertex`.
+
+        """
+        cdef np.ndarray[np_info_t, ndim=1] idx
+        idx = np.ascontiguousarray(indices, dtype=np_info).ravel()
+        cdef uint64_t n = idx.size
+        cdef info_t* ptr_idx = NULL
+        if n > 0:
+            ptr_idx = &idx[0]
+        cdef vector[PeriodicDelaunay_with_info_2[info_t].Vertex] v
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            v = self.T.get_vertices(ptr_idx, n)
+        cdef PeriodicDelaunay2_vertex_vector out = PeriodicDelaunay2_vertex_vector()
+        out.assign(self.T, v)
+        return out
+
     def locate(self, np.ndarray[np.float64_t, ndim=1] pos,
                PeriodicDelaunay2_cell start = None):
         r"""Get the vertex/cell/edge that a given point is a part of.
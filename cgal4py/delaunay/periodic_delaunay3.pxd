@@ -71,6 +71,7 @@ cdef extern from "c_periodic_delaunay3.hpp":
         void clear() except + 
         Vertex move(Vertex v, double *pos) except + 
         Vertex move_if_no_collision(Vertex v, double *pos) except +
+        void move_many(Info *index, double *pos, uint64_t n) except +
 
         void write_to_file(const char* filename) except +
         void read_from_file(const char* filename) except +
@@ -98,6 +99,8 @@ cdef extern from "c_periodic_delaunay3.hpp":
                                     int32_t *offsets, I idx_inf)
 
         Vertex get_vertex(Info index) except +
+        void set_vertex_index(bool enable)
+        vector[Vertex] get_vertices(Info *index, uint64_t n) except +
         Cell locate(double* pos, int& lt, int& li, int& lj)
         Cell locate(double* pos, int& lt, int& li, int& lj, Cell c)
 
@@ -254,7 +257,9 @@ cdef extern from "c_periodic_delaunay3.hpp":
         void circumcenter(Cell x, double* out) const
         void periodic_circumcenter(Cell x, double* out) const
         double dual_volume(const Vertex v) const
-        void dual_volumes(double* vols) const
+        double domain_volume() const
+        uint64_t info_bound() const
+        double dual_volumes(double* vols, uint64_t nvols, int nthreads) except +
         double length(const Edge e) const
 
         pair[vector[Cell],vector[Facet]] find_conflicts(double* pos, Cell start)
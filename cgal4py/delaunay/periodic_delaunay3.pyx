@@ -2699,16 +2699,40 @@ cdef class PeriodicDelaunay3:
 
     @cython.boundscheck(False)
     @cython.wraparound(False)
-    def voronoi_volumes(self):
-        r"""np.ndarray of float64: Array of voronoi cell volumes for vertices in 
-        the triangulation. The volumes are in the order in which the vertices 
-        were added to the triangulation."""
+    def voronoi_volumes(self, int nthreads = 1):
+        r"""Get the volumes of the periodic voronoi cells of the vertices in
+        the triangulation. Each cell contributes once to the volumes of its
+        vertices, so no circumcenter is computed more than once.
+
+        Args:
+            nthreads (int, optional): Number of threads the cells are
+                divided between. Defaults to 1.
+
+        Returns:
+            np.ndarray of float64: Array of voronoi cell volumes for vertices
+                in the triangulation. The volumes are in the order in which
+                the vertices were added to the triangulation, indexed by
+                vertex info. Infos without a vertex (e.g. those of removed
+                vertices) have a volume of 0.
+
+        Raises:
+            RuntimeError: If the volumes do not sum to the volume of the
+                domain.
+
+        """
         cdef np.ndarray[np.float64_t, ndim=1] out
-        out = np.empty(self.num_finite_verts, 'float64')
+        cdef double total, expected
+        cdef uint64_t nvols
         if self.n == 0:
-            return out
+            return np.empty(0, 'float64')
+        nvols = self.T.info_bound()
+        out = np.empty(nvols, 'float64')
         with nogil, cython.boundscheck(False), cython.wraparound(False):
-            self.T.dual_volumes(&out[0])
+            total = self.T.dual_volumes(&out[0], nvols, nthreads)
+            expected = self.T.domain_volume()
+        if not np.isclose(total, expected, rtol=1e-6, atol=0.0):
+            raise RuntimeError(("Voronoi volumes sum to {}, but the domain " +
+                                "volume is {}.").format(total, expected))
         return out
 
     @_update_to_tess
@@ -2774,6 +2798,46 @@ cdef class PeriodicDelaunay3:
         out.assign(self.T, v)
         return out
 
+    @_update_to_tess
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def move_many(self, indices, pos):
+        r"""Move many vertices to new locations at once. This is much faster
+        than moving them one at a time with :meth:`move`. Vertices whose
+        displacements leave the triangulation Delaunay are moved in place.
+        The rest are removed and inserted again as a batch, or the
+        triangulation is rebuilt if that is cheaper.
+
+        Args:
+            indices (:obj:`ndarray` of info_t): Indices of the vertices that
+                should be moved. If an index is repeated, the vertex is moved
+                to the last position given for it.
+            pos (:obj:`ndarray` of float64): (n, 3) x,y,z coordinates that
+                the vertices should be moved to.
+
+        Raises:
+            ValueError: If pos is not (n, 3) where n is the number of
+                indices, or if an index is not less than the number of
+                points inserted into the triangulation.
+
+        """
+        global np_info
+        cdef np.ndarray[np_info_t, ndim=1] idx
+        cdef np.ndarray[np.float64_t, ndim=2] x
+        idx = np.ascontiguousarray(indices, dtype=np_info)
+        x = np.ascontiguousarray(pos, dtype='float64')
+        if (x.shape[0] != idx.shape[0]) or (x.shape[1] != 3):
+            raise ValueError("pos must be a ({}, 3) array.".format(
+                idx.shape[0]))
+        if idx.shape[0] == 0:
+            return
+        if np.any(idx >= self.n):
+            raise ValueError("Vertex indices must be less than {}.".format(
+                self.n))
+        cdef uint64_t n = idx.shape[0]
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.move_many(&idx[0], &x[0,0], n)
+
     def get_vertex(self, np_info_t index):
         r"""Get the vertex object corresponding to the given index. 
 
@@ -2792,6 +2856,49 @@ cdef class PeriodicDelaunay3:
         out.assign(self.T, v)
         return out
 
+    def set_vertex_index(self, pybool enable=True):
+        r"""Turn on/off the table used to look up vertices by index. While
+        it is on, :meth:`PeriodicDelaunay3.get_vertex` and :meth:`PeriodicDelaunay3.get_vertices`
+        do not walk the vertices and the table is kept up to date as
+        vertices are inserted, removed, and moved.
+
+        Args:
+            enable (bool, optional): If True, the table is used. If False, it
+                is freed. Defaults to True.
+
+        """
+        cdef cbool c_enable = <cbool>enable
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            self.T.set_vertex_index(c_enable)
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def get_vertices(self, object indices):
+        r"""Get the vertex objects corresponding to a set of indices.
+
+        Args:
+            indices (:obj:`ndarray` of np_info_t): Indices of vertices that
+                should be found.
+
+        Returns:
+            PeriodicDelaunay3_vertex_vector: Vertices corresponding to the
+                given indices. Indices that are not found are handled as
+                in :meth:`PeriodicDelaunay3.get_vertex`.
+
+        """
+        cdef np.ndarray[np_info_t, ndim=1] idx
+        idx = np.ascontiguousarray(indices, dtype=np_info).ravel()
+        cdef uint64_t n = idx.size
+        cdef info_t* ptr_idx = NULL
+        if n > 0:
+            ptr_idx = &idx[0]
+        cdef vector[PeriodicDelaunay_with_info_3[info_t].Vertex] v
+        with nogil, cython.boundscheck(False), cython.wraparound(False):
+            v = self.T.get_vertices(ptr_idx, n)
+        cdef PeriodicDelaunay3_vertex_vector out = PeriodicDelaunay3_vertex_vector()
+        out.assign(self.T, v)
+        return out
+
     def locate(self, np.ndarray[np.float64_t, ndim=1] pos,
                PeriodicDelaunay3_cell start = None):
         r"""Get the vertex/cell/facet/edge that a given point is a part of.
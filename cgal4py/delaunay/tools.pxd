@@ -73,6 +73,12 @@ cdef extern from "c_tools.hpp":
         int64_t count_inf()
         void add_inf()
 
+cdef extern from "c_dual_volume.hpp":
+    void cell_circumcenter_2(const double *p, double *out) nogil
+    void cell_circumcenter_3(const double *p, double *out) nogil
+    void cell_dual_areas_2(const double *p, double *out) nogil
+    void cell_dual_volumes_3(const double *p, double *out) nogil
+
 ctypedef SerializedLeaf[uint32_t] sLeaf32
 ctypedef SerializedLeaf[uint64_t] sLeaf64
 ctypedef vector[sLeaf32] sLeaves32
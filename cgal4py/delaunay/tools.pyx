@@ -631,6 +631,110 @@ def py_swap_cells(verts, neigh, i1, i2):
     else:
         raise TypeError
 
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def circumcenters(np.ndarray[np.float64_t, ndim=2] pos, object cells):
+    r"""Get the circumcenters of 2D triangles or 3D tetrahedra.
+
+    Args:
+        pos (np.ndarray of float64): (n,m) positions of the vertices.
+        cells (np.ndarray of int): (ncells,m+1) indices of the vertices of
+            each cell in `pos`.
+
+    Returns:
+        np.ndarray of float64: (ncells,m) circumcenters of the cells.
+
+    Raises:
+        NotImplementedError: If the cells are not 2D or 3D.
+        ValueError: If `cells` is not a 2D array with m+1 columns.
+
+    """
+    cdef uint32_t ndim = <uint32_t>pos.shape[1]
+    if ndim not in (2, 3):
+        raise NotImplementedError("Circumcenters are only supported in " +
+                                  "2D and 3D.")
+    cells = np.asarray(cells)
+    if (cells.ndim != 2) or (cells.shape[1] != ndim + 1):
+        raise ValueError("cells must have {} columns.".format(ndim + 1))
+    cdef np.ndarray[np.int64_t, ndim=2] c
+    c = np.ascontiguousarray(cells, dtype='int64')
+    pos = np.ascontiguousarray(pos)
+    cdef uint64_t ncells = <uint64_t>c.shape[0]
+    cdef np.ndarray[np.float64_t, ndim=2] out = np.empty((ncells, ndim),
+                                                         'float64')
+    cdef double p[12]
+    cdef uint64_t i
+    cdef uint32_t j, d
+    with nogil, cython.boundscheck(False), cython.wraparound(False):
+        for i in range(ncells):
+            for j in range(ndim + 1):
+                for d in range(ndim):
+                    p[ndim*j + d] = pos[c[i, j], d]
+            if ndim == 2:
+                cell_circumcenter_2(p, &out[i, 0])
+            else:
+                cell_circumcenter_3(p, &out[i, 0])
+    return out
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def dual_volumes(np.ndarray[np.float64_t, ndim=2] pos, object cells,
+                 uint64_t nverts):
+    r"""Sum the parts of the voronoi cells of vertices that lie within a set
+    of finite cells, using the same kernels as the triangulations (see
+    c_dual_volume.hpp). Summed over all of the cells incident to a vertex,
+    this is the volume (area in 2D) of its voronoi cell.
+
+    Args:
+        pos (np.ndarray of float64): (n,m) positions of the vertices.
+        cells (np.ndarray of int): (ncells,m+1) indices of the vertices of
+            each cell in `pos`. Cells must be positively oriented (counter-
+            clockwise in 2D), as they are in the triangulations.
+        nverts (uint64): Number of vertices to return volumes for.
+
+    Returns:
+        np.ndarray of float64: (nverts,) sum of the contributions of the
+            cells to each vertex.
+
+    Raises:
+        NotImplementedError: If the cells are not 2D or 3D.
+        ValueError: If `cells` is not a 2D array with m+1 columns.
+        ValueError: If a cell has a vertex index >= `nverts`.
+
+    """
+    cdef uint32_t ndim = <uint32_t>pos.shape[1]
+    if ndim not in (2, 3):
+        raise NotImplementedError("Dual volumes are only supported in " +
+                                  "2D and 3D.")
+    cells = np.asarray(cells)
+    if (cells.ndim != 2) or (cells.shape[1] != ndim + 1):
+        raise ValueError("cells must have {} columns.".format(ndim + 1))
+    cdef np.ndarray[np.int64_t, ndim=2] c
+    c = np.ascontiguousarray(cells, dtype='int64')
+    if (c.size > 0) and ((c.min() < 0) or (<uint64_t>c.max() >= nverts)):
+        raise ValueError("Cell vertex indices must be in [0, {}).".format(
+            nverts))
+    pos = np.ascontiguousarray(pos)
+    cdef uint64_t ncells = <uint64_t>c.shape[0]
+    cdef np.ndarray[np.float64_t, ndim=1] out = np.zeros(nverts, 'float64')
+    cdef double p[12]
+    cdef double contrib[4]
+    cdef uint64_t i
+    cdef uint32_t j, d
+    with nogil, cython.boundscheck(False), cython.wraparound(False):
+        for i in range(ncells):
+            for j in range(ndim + 1):
+                contrib[j] = 0.0
+                for d in range(ndim):
+                    p[ndim*j + d] = pos[c[i, j], d]
+            if ndim == 2:
+                cell_dual_areas_2(p, contrib)
+            else:
+                cell_dual_volumes_3(p, contrib)
+            for j in range(ndim + 1):
+                out[c[i, j]] += contrib[j]
+    return out
+
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cdef sLeaves32 _vectorize_leaves_uint32(np.uint32_t ndim, object serial,
@@ -1,7 +1,12 @@
 import numpy as np
-import cykdtree as kdtree
+import cykdtree
 from cgal4py import PY_MAJOR_VERSION
 
+# Keyword arguments only supported by the local KDTree
+_local_kdtree_kwargs = ['layout', 'nthreads', 'split', 'ghost_weight',
+                        'variance_weight', 'tree_file', 'sample_size',
+                        'sample_tolerance']
+
 def tree(method, pts, left_edge, right_edge, periodic, *args, **kwargs):
     r"""Get tree for a given domain decomposition schema.
 
@@ -10,9 +15,21 @@ def tree(method, pts, left_edge, right_edge, periodic, *args, **kwargs):
             'kdtree': KDTree based on median position along the dimension
                 with the greatest domain width. See
                 :meth:`cgal4py.domain_decomp.kdtree` for details on
-                accepted keyword arguments.
-        pts (np.ndarray of float64): (n, m) array of n coordinates in a
-            m-dimensional domain.
+                accepted keyword arguments. If any of the keyword arguments
+                `layout`, `nthreads`, `split`, `ghost_weight`,
+                `variance_weight`, `tree_file`, `sample_size`, or
+                `sample_tolerance` are provided, the tree is built (or
+                loaded) by
+                :class:`cgal4py.domain_decomp.kdtree.PyKDTree`, which is
+                also used for float32 points.
+            'hilbert': Contiguous pieces of the Hilbert curve through the
+                points. See :class:`cgal4py.domain_decomp.sfc.PySFCTree` for
+                details on accepted keyword arguments.
+            'morton': Contiguous pieces of the Morton (Z-order) curve through
+                the points. See :class:`cgal4py.domain_decomp.sfc.PySFCTree`
+                for details on accepted keyword arguments.
+        pts (np.ndarray of float64 or float32): (n, m) array of n
+            coordinates in a m-dimensional domain.
         left_edge (np.ndarray of float64): (m,) domain minimum in each
             dimension.
         right_edge (np.ndarray of float64): (m,) domain maximum in each
@@ -32,7 +49,18 @@ def tree(method, pts, left_edge, right_edge, periodic, *args, **kwargs):
     """
     # Get leaves
     if method.lower() == 'kdtree':
-        tree = kdtree.PyKDTree(pts, left_edge, right_edge, *args, **kwargs)
+        if ((getattr(pts, 'dtype', None) == np.float32) or
+                any(k in kwargs for k in _local_kdtree_kwargs)):
+            from cgal4py.domain_decomp import kdtree
+            tree = kdtree.PyKDTree(pts, left_edge, right_edge,
+                                   periodic=periodic, *args, **kwargs)
+        else:
+            tree = cykdtree.PyKDTree(pts, left_edge, right_edge, *args,
+                                     **kwargs)
+    elif method.lower() in ['hilbert', 'morton']:
+        from cgal4py.domain_decomp import sfc
+        tree = sfc.PySFCTree(pts, left_edge, right_edge, periodic=periodic,
+                             curve=method.lower(), *args, **kwargs)
     else:
         raise ValueError("'{}' is not a supported ".format(method) +
                          "domain decomposition.")
@@ -81,7 +109,8 @@ class GenericLeaf(object):
         out = cls(leaf.npts, leaf.left_edge, leaf.right_edge)
         other_attr = ['id', 'ndim', 'num_leaves', 'start_idx', 'stop_idx',
                       'domain_width', 'periodic_left', 'periodic_right',
-                      'left_neighbors', 'right_neighbors', 'neighbors']
+                      'left_neighbors', 'right_neighbors',
+                      'overlap_neighbors', 'neighbors']
         for k in other_attr:
             if hasattr(leaf, k):
                 setattr(out, k, getattr(leaf, k))
@@ -257,11 +286,14 @@ def process_leaves(leaves, left_edge, right_edge, periodic):
             for leaf in leaves:
                 leaf.periodic_left = np.zeros(leaf.ndim, 'bool')
                 leaf.periodic_right = np.zeros(leaf.ndim, 'bool')
-    # Add neighbors
+    # Add neighbors. Leaves whose edges overlap without sharing a face (as
+    # happens for space filling curve leaves) are added to
+    # overlap_neighbors.
     if getattr(leaves[0], 'left_neighbors', None) is None:
         for j, leaf in enumerate(leaves):
             leaf.left_neighbors = [[] for _ in range(ndim)]
             leaf.right_neighbors = [[] for _ in range(ndim)]
+            leaf.overlap_neighbors = []
             for prev in leaves[:(j+1)]:
                 match = True
                 for i in range(ndim):
@@ -276,6 +308,8 @@ def process_leaves(leaves, left_edge, right_edge, periodic):
                             match = False
                             break
                 if match:
+                    nprev = sum(len(x) for x in leaf.left_neighbors +
+                                leaf.right_neighbors)
                     for i in range(ndim):
                         if np.isclose(leaf.left_edge[i], prev.right_edge[i]):
                             leaf.left_neighbors[i].append(prev.id)
@@ -292,12 +326,18 @@ def process_leaves(leaves, left_edge, right_edge, periodic):
                                     leaf.periodic_left[i]):
                                 leaf.left_neighbors[i].append(prev.id)
                                 prev.right_neighbors[i].append(leaf.id)
+                    nnew = sum(len(x) for x in leaf.left_neighbors +
+                               leaf.right_neighbors)
+                    if (nnew == nprev) and (prev is not leaf):
+                        leaf.overlap_neighbors.append(prev.id)
+                        prev.overlap_neighbors.append(leaf.id)
     if getattr(leaves[0], 'neighbors', None) is None:
         for leaf in leaves:
             neighbors = [leaf.id]
             for i in range(ndim):
                 neighbors += leaf.left_neighbors[i]
                 neighbors += leaf.right_neighbors[i]
+            neighbors += getattr(leaf, 'overlap_neighbors', [])
             leaf.neighbors = list(set(neighbors))
     # Return leaves
     return leaves
@@ -1,3 +1,5 @@
+#ifndef C_KDTREE_HPP
+#define C_KDTREE_HPP
 #include <vector>
 #include <array>
 #include <stdio.h>
@@ -5,7 +7,531 @@
 #include <iostream>
 #include <fstream>
 #include <stdint.h>
-#include "../c_utils.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include "c_utils.hpp"
+#include "c_kdtree_file.hpp"
+#include "c_kdtree_route.hpp"
+
+// Fork-join pool used to build subtrees in parallel. Each thread owns a
+// deque of tasks, pops its own work from the back, and steals from the
+// front of the other deques when idle. A thread waiting on a task keeps
+// running queued tasks so nested forks cannot deadlock. The calling thread
+// is worker 0; idle workers spin, so the pool should only live for the
+// duration of a build.
+class KDTreeTaskPool
+{
+public:
+  struct Task
+  {
+    std::function<void(uint32_t)> func;
+    std::atomic<bool> done;
+    Task() : done(false) {}
+  };
+  uint32_t nthreads;
+  std::vector<std::deque<Task*> > queues;
+  std::vector<std::mutex> locks;
+  std::vector<std::thread> workers;
+  std::atomic<bool> finished;
+
+  KDTreeTaskPool(uint32_t nthreads0) :
+    nthreads(nthreads0), queues(nthreads0), locks(nthreads0), finished(false)
+  {
+    for (uint32_t t = 1; t < nthreads; t++)
+      workers.push_back(std::thread(&KDTreeTaskPool::work, this, t));
+  }
+  ~KDTreeTaskPool()
+  {
+    finished = true;
+    for (uint32_t t = 0; t < workers.size(); t++)
+      workers[t].join();
+  }
+
+  void push(uint32_t tid, Task* task)
+  {
+    std::lock_guard<std::mutex> guard(locks[tid]);
+    queues[tid].push_back(task);
+  }
+  Task* pop(uint32_t tid)
+  {
+    std::lock_guard<std::mutex> guard(locks[tid]);
+    if (queues[tid].empty())
+      return NULL;
+    Task* out = queues[tid].back();
+    queues[tid].pop_back();
+    return out;
+  }
+  Task* steal(uint32_t tid)
+  {
+    for (uint32_t k = 1; k < nthreads; k++) {
+      uint32_t victim = (tid + k) % nthreads;
+      std::lock_guard<std::mutex> guard(locks[victim]);
+      if (!queues[victim].empty()) {
+	Task* out = queues[victim].front();
+	queues[victim].pop_front();
+	return out;
+      }
+    }
+    return NULL;
+  }
+  bool run_one(uint32_t tid)
+  {
+    Task* task = pop(tid);
+    if (task == NULL)
+      task = steal(tid);
+    if (task == NULL)
+      return false;
+    task->func(tid);
+    task->done.store(true, std::memory_order_release);
+    return true;
+  }
+  void wait(uint32_t tid, Task* task)
+  {
+    while (!task->done.load(std::memory_order_acquire)) {
+      if (!run_one(tid))
+	std::this_thread::yield();
+    }
+  }
+  void work(uint32_t tid)
+  {
+    while (!finished.load(std::memory_order_acquire)) {
+      if (!run_one(tid))
+	std::this_thread::yield();
+    }
+  }
+};
+
+// Depth above which subtrees are handed to the pool. Forking roughly 8
+// tasks per thread leaves enough slack for stealing to even out the load.
+inline uint32_t kdtree_cutoff_depth(uint32_t nthreads)
+{
+  uint32_t depth = 0;
+  if (nthreads > 1) {
+    while ((1u << depth) < 8*nthreads)
+      depth++;
+  }
+  return depth;
+}
+
+enum KDTreeSplit { KDTREE_SPLIT_MEDIAN = 0, KDTREE_SPLIT_COST = 1,
+		   KDTREE_SPLIT_SAMPLE = 2 };
+
+#define KDTREE_COST_BINS 64
+// Number of trees built to measure leaf costs before the final build
+#define KDTREE_COST_PASSES 3
+// Defaults for the sampled median split
+#define KDTREE_SAMPLE_SIZE 4096
+#define KDTREE_SAMPLE_TOLERANCE 0.05
+
+// Trees are templated on the coordinate type T of the points so that single
+// precision positions can be decomposed without a double copy. Node edges,
+// splits, and domain bounds are always double, and every float value is
+// exactly representable as a double, so a float tree has the same splits
+// as a double tree built from the widened points.
+//
+// The utilities from cykdtree only accept double, so these wrap them for
+// double points and provide equivalent versions for other types.
+
+// Partially sort idx[l..r] along dimension d so that idx[n] refers to the
+// point that would be there if the range were sorted.
+template <typename T>
+inline int64_t kdtree_select(T *pts, uint64_t *idx, uint32_t ndim,
+			     uint32_t d, int64_t l, int64_t r, int64_t n)
+{
+  std::nth_element(idx + l, idx + n, idx + r + 1,
+		   [&](uint64_t a, uint64_t b) {
+		     return (pts[ndim*a + d] < pts[ndim*b + d]);
+		   });
+  return n;
+}
+inline int64_t kdtree_select(double *pts, uint64_t *idx, uint32_t ndim,
+			     uint32_t d, int64_t l, int64_t r, int64_t n)
+{
+  return select(pts, idx, ndim, d, l, r, n);
+}
+
+// Minimum and maximum of the points in each dimension, allocated with
+// malloc.
+template <typename T>
+inline double* kdtree_min_pts(T *pts, uint64_t n, uint32_t m)
+{
+  double *out = (double*)malloc(m*sizeof(double));
+  for (uint32_t d = 0; d < m; d++) {
+    out[d] = std::numeric_limits<double>::max();
+    for (uint64_t i = 0; i < n; i++)
+      out[d] = std::min(out[d], (double)pts[m*i + d]);
+  }
+  return out;
+}
+inline double* kdtree_min_pts(double *pts, uint64_t n, uint32_t m)
+{
+  return min_pts(pts, n, m);
+}
+template <typename T>
+inline double* kdtree_max_pts(T *pts, uint64_t n, uint32_t m)
+{
+  double *out = (double*)malloc(m*sizeof(double));
+  for (uint32_t d = 0; d < m; d++) {
+    out[d] = -std::numeric_limits<double>::max();
+    for (uint64_t i = 0; i < n; i++)
+      out[d] = std::max(out[d], (double)pts[m*i + d]);
+  }
+  return out;
+}
+inline double* kdtree_max_pts(double *pts, uint64_t n, uint32_t m)
+{
+  return max_pts(pts, n, m);
+}
+
+// Partially sort idx[l..r] along dimension d so that the points before the
+// returned position carry less than target of the total weight and the
+// point at that position brings the running total to at least target.
+// Weights are indexed by point, not position. Expected time is linear.
+template <typename T>
+inline int64_t weighted_select(T *pts, uint64_t *idx, const double *w,
+			       uint32_t ndim, uint32_t d, int64_t l,
+			       int64_t r, double target)
+{
+  while (l < r) {
+    // Median of three pivot
+    int64_t mid = l + (r - l)/2;
+    T a = pts[ndim*idx[l] + d], b = pts[ndim*idx[mid] + d];
+    T c = pts[ndim*idx[r] + d];
+    T pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+    // Three-way partition: [l, lt) < pivot, [lt, gt] == pivot, (gt, r] > pivot
+    int64_t lt = l, gt = r, i = l;
+    while (i <= gt) {
+      T x = pts[ndim*idx[i] + d];
+      if (x < pivot)
+	std::swap(idx[lt++], idx[i++]);
+      else if (x > pivot)
+	std::swap(idx[i], idx[gt--]);
+      else
+	i++;
+    }
+    double wless = 0.0, wequal = 0.0;
+    for (i = l; i < lt; i++)
+      wless += w[idx[i]];
+    for (i = lt; i <= gt; i++)
+      wequal += w[idx[i]];
+    if (target <= wless) {
+      r = lt - 1;
+    } else if (target <= (wless + wequal)) {
+      target -= wless;
+      for (i = lt; i < gt; i++) {
+	target -= w[idx[i]];
+	if (target <= 0)
+	  break;
+      }
+      return i;
+    } else {
+      target -= (wless + wequal);
+      l = gt + 1;
+    }
+  }
+  return l;
+}
+
+// Mix the bits of x (splitmix64 finalizer). Used to draw sample positions
+// from the node being split, so samples do not depend on which thread
+// builds the node.
+inline uint64_t kdtree_hash(uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27))*0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Split idx[Lidx, Lidx+n) along dimension d at the median of a random
+// sample of the points, partitioning the range in a single pass. Returns
+// the number of points in the less child and sets split so that points in
+// the less child are <= split and the rest are greater.
+//
+// If the less child ends up with more than (1+tolerance)/2 or fewer than
+// (1-tolerance)/2 of the points, or either child has fewer than min_child
+// points, the exact median is selected instead. The partition already
+// separates the points around the exact median, so only the side that
+// contains it is searched. Small ranges are always split at the exact
+// median.
+template <typename T>
+inline uint64_t sample_select(T *pts, uint64_t *idx, uint32_t ndim,
+			      uint32_t d, uint64_t Lidx, uint64_t n,
+			      uint32_t sample_size, double tolerance,
+			      double &split, uint64_t min_child = 1)
+{
+  // Same position as the exact median split
+  uint64_t med = Lidx + (n - 1)/2;
+  uint64_t Nmed = med - Lidx + 1;
+  if ((sample_size == 0) || (n <= 4*(uint64_t)sample_size)) {
+    kdtree_select(pts, idx, ndim, d, Lidx, Lidx + n - 1, med);
+    split = pts[ndim*idx[med] + d];
+    return Nmed;
+  }
+  std::vector<T> sample(sample_size);
+  uint64_t seed = kdtree_hash(Lidx ^ kdtree_hash(n ^ ((uint64_t)d << 58)));
+  for (uint32_t s = 0; s < sample_size; s++)
+    sample[s] = pts[ndim*idx[Lidx + kdtree_hash(seed + s) % n] + d];
+  std::nth_element(sample.begin(), sample.begin() + sample_size/2,
+		   sample.end());
+  T pivot = sample[sample_size/2];
+  uint64_t *mid = std::partition(idx + Lidx, idx + Lidx + n,
+				 [&](uint64_t i) {
+				   return (pts[ndim*i + d] <= pivot);
+				 });
+  uint64_t Nless = (uint64_t)(mid - (idx + Lidx));
+  double imbalance = fabs((double)Nless - 0.5*(double)n)/(0.5*(double)n);
+  if ((Nless >= min_child) && ((n - Nless) >= min_child) &&
+      (imbalance <= tolerance)) {
+    split = pivot;
+    return Nless;
+  }
+  if (Nless >= Nmed)
+    kdtree_select(pts, idx, ndim, d, Lidx, Lidx + Nless - 1, med);
+  else
+    kdtree_select(pts, idx, ndim, d, Lidx + Nless, Lidx + n - 1, med);
+  split = pts[ndim*idx[med] + d];
+  return Nmed;
+}
+
+// Estimate of the work needed to triangulate a set of points and exchange
+// its ghost layer. Ghost points are approximated as the points in a layer
+// one mean inter-particle spacing thick around the bounding box of the
+// points (empty space in a leaf does not contribute ghosts) and both terms
+// are scaled up by the excess variance of the point density, since
+// clustered regions produce more cells per point and larger halos.
+//
+// Density variance only matters at the scale of a leaf, so the cost cannot
+// be judged from a node high in the tree. Instead the cost of each leaf in
+// a median tree is spread over its points as weights and the tree is
+// rebuilt by splitting at the weighted median.
+class KDTreeCostModel
+{
+public:
+  uint32_t ndim;
+  double ghost_weight;
+  double variance_weight;
+  uint64_t min_leaf;
+  uint32_t max_depth;
+  std::vector<double> weights;
+
+  KDTreeCostModel() : ndim(0), ghost_weight(1.0), variance_weight(1.0),
+		      min_leaf(1), max_depth(0) {}
+  KDTreeCostModel(uint32_t ndim0, uint32_t leafsize, uint64_t npts,
+		  double ghost_weight0 = 1.0, double variance_weight0 = 1.0)
+  {
+    ndim = ndim0;
+    ghost_weight = ghost_weight0;
+    variance_weight = variance_weight0;
+    // Children keep at least this many points, which bounds the number
+    // of nodes for FlatKDTree while leaving room to move cuts away from
+    // the median.
+    min_leaf = leafsize/8;
+    if (min_leaf == 0)
+      min_leaf = 1;
+    // Split to the same depth the median split would reach, so there are
+    // as many leaves.
+    max_depth = 0;
+    while ((max_depth < 63) && ((npts >> max_depth) >= leafsize))
+      max_depth++;
+  }
+
+  double box_cost(double n, const double *le, const double *re,
+		  double variance) const
+  {
+    if (n <= 0)
+      return 0.0;
+    double vol = 1.0, area = 0.0, w;
+    uint32_t d;
+    for (d = 0; d < ndim; d++)
+      vol *= (re[d] - le[d]);
+    double ghost = 0.0;
+    if (vol > 0) {
+      for (d = 0; d < ndim; d++) {
+	w = re[d] - le[d];
+	area += 2.0*vol/w;
+      }
+      double spacing = pow(vol/n, 1.0/(double)ndim);
+      ghost = n*area*spacing/vol;
+    }
+    double m = n + ghost_weight*ghost;
+    // The variance penalty saturates so that strongly peaked leaves cost
+    // at most (1 + variance_weight) times a uniform leaf
+    return m*log2(m + 2.0)*(1.0 + variance_weight*variance/(1.0 + variance));
+  }
+
+  // Excess (non-Poisson) variance of bin counts b0 to b1, normalized by
+  // the squared mean count. P1 and P2 are prefix sums of the counts and
+  // squared counts.
+  static double excess_variance(const double *P1, const double *P2,
+				uint32_t b0, uint32_t b1)
+  {
+    double k = (double)(b1 - b0);
+    if (k <= 0)
+      return 0.0;
+    double mean = (P1[b1] - P1[b0])/k;
+    if (mean <= 0)
+      return 0.0;
+    double var = (P2[b1] - P2[b0])/k - mean*mean;
+    double out = (var - mean)/(mean*mean);
+    if (out < 0)
+      out = 0.0;
+    return out;
+  }
+
+  template <typename T>
+  void histogram(T *pts, uint64_t *idx, uint64_t Lidx, uint64_t n,
+		 uint32_t d, double dmin, double dmax, double *P1,
+		 double *P2) const
+  {
+    double counts[KDTREE_COST_BINS];
+    uint32_t b;
+    for (b = 0; b < KDTREE_COST_BINS; b++)
+      counts[b] = 0.0;
+    double scale = 0.0;
+    if (dmax > dmin)
+      scale = (double)KDTREE_COST_BINS/(dmax - dmin);
+    for (uint64_t i = Lidx; i < (Lidx + n); i++) {
+      int64_t ib = (int64_t)((pts[ndim*idx[i] + d] - dmin)*scale);
+      if (ib < 0)
+	ib = 0;
+      if (ib >= KDTREE_COST_BINS)
+	ib = KDTREE_COST_BINS - 1;
+      counts[ib] += 1.0;
+    }
+    P1[0] = 0.0;
+    P2[0] = 0.0;
+    for (b = 0; b < KDTREE_COST_BINS; b++) {
+      P1[b+1] = P1[b] + counts[b];
+      P2[b+1] = P2[b] + counts[b]*counts[b];
+    }
+  }
+
+  // Estimated cost of a node covering points Lidx to Lidx+n. The density
+  // variance is taken from the dimension where it is largest.
+  template <typename T>
+  double node_cost(T *pts, uint64_t *idx, uint64_t Lidx, uint64_t n) const
+  {
+    if (n == 0)
+      return 0.0;
+    std::vector<double> mins(ndim), maxs(ndim);
+    uint32_t d;
+    for (d = 0; d < ndim; d++) {
+      mins[d] = pts[ndim*idx[Lidx] + d];
+      maxs[d] = mins[d];
+    }
+    for (uint64_t i = Lidx; i < (Lidx + n); i++) {
+      for (d = 0; d < ndim; d++) {
+	double x = pts[ndim*idx[i] + d];
+	if (x < mins[d]) mins[d] = x;
+	if (x > maxs[d]) maxs[d] = x;
+      }
+    }
+    double P1[KDTREE_COST_BINS+1], P2[KDTREE_COST_BINS+1];
+    double variance = 0.0, v;
+    for (d = 0; d < ndim; d++) {
+      if (maxs[d] == mins[d])
+	continue;
+      histogram(pts, idx, Lidx, n, d, mins[d], maxs[d], P1, P2);
+      v = excess_variance(P1, P2, 0, KDTREE_COST_BINS);
+      if (v > variance)
+	variance = v;
+    }
+    return box_cost((double)n, &mins[0], &maxs[0], variance);
+  }
+
+  // Spread the cost of the leaf covering points Lidx to Lidx+n evenly over
+  // its points. When refining, the new weight is the geometric mean with
+  // the previous one to damp oscillation between passes.
+  template <typename T>
+  void assign_weights(T *pts, uint64_t *idx, uint64_t npts,
+		      uint64_t Lidx, uint64_t n, bool refine = false)
+  {
+    if (weights.size() != npts)
+      weights.resize(npts, 1.0);
+    if (n == 0)
+      return;
+    double w = node_cost(pts, idx, Lidx, n)/(double)n;
+    for (uint64_t i = Lidx; i < (Lidx + n); i++) {
+      if (refine)
+	weights[idx[i]] = sqrt(w*weights[idx[i]]);
+      else
+	weights[idx[i]] = w;
+    }
+  }
+
+  // Partition points Lidx to Lidx+n along dimension d at the weighted
+  // median and return the number of points in the less child. A return
+  // value of 0 indicates the node should be a leaf.
+  template <typename T>
+  uint64_t split(T *pts, uint64_t *idx, uint64_t Lidx, uint64_t n,
+		 uint32_t d, uint32_t depth) const
+  {
+    if ((depth >= max_depth) || (n < 2*min_leaf))
+      return 0;
+    int64_t l = Lidx, r = Lidx + n - 1;
+    double total = 0.0;
+    for (int64_t i = l; i <= r; i++)
+      total += weights[idx[i]];
+    int64_t med = weighted_select(pts, idx, &weights[0], ndim, d, l, r,
+				  total/2.0);
+    // Keep both children large enough for the node count bound
+    int64_t lo = l + (int64_t)min_leaf - 1;
+    int64_t hi = r - (int64_t)min_leaf;
+    if ((med < lo) || (med > hi)) {
+      med = (med < lo) ? lo : hi;
+      kdtree_select(pts, idx, ndim, d, l, r, med);
+    }
+    return (uint64_t)(med - l + 1);
+  }
+};
+
+// Write a tree whose nodes have been laid out in pre-order to a KD tree
+// file. See KDTreeFile for the layout of the periodicity flags and the
+// neighbor lists.
+template <typename Tree>
+void write_kdtree_file(const char *filename, Tree *tree, FlatNode *nodes,
+		       double *left_edges, double *right_edges,
+		       uint32_t num_nodes, uint32_t *leaves,
+		       uint32_t num_leaves, uint8_t *periodic,
+		       uint8_t *leaf_periodic, uint64_t *neighbor_offsets,
+		       uint32_t *neighbors)
+{
+  uint32_t ndim = tree->ndim;
+  std::vector<double> domain(4*ndim);
+  memcpy(&domain[0], tree->domain_left_edge, ndim*sizeof(double));
+  memcpy(&domain[ndim], tree->domain_right_edge, ndim*sizeof(double));
+  memcpy(&domain[2*ndim], tree->domain_mins, ndim*sizeof(double));
+  memcpy(&domain[3*ndim], tree->domain_maxs, ndim*sizeof(double));
+  KDTreeFile file;
+  file.ndim = ndim;
+  file.npts = tree->npts;
+  file.leafsize = tree->leafsize;
+  file.split_policy = tree->split_policy;
+  file.ghost_weight = tree->cost_model.ghost_weight;
+  file.variance_weight = tree->cost_model.variance_weight;
+  file.num_nodes = num_nodes;
+  file.num_leaves = num_leaves;
+  file.num_neighbors = neighbor_offsets[file.num_lists()];
+  file.domain = &domain[0];
+  file.periodic = periodic;
+  file.nodes = nodes;
+  file.left_edges = left_edges;
+  file.right_edges = right_edges;
+  file.all_idx = tree->all_idx;
+  file.leaves = leaves;
+  file.leaf_periodic = leaf_periodic;
+  file.neighbor_offsets = neighbor_offsets;
+  file.neighbors = neighbors;
+  file.save(filename);
+}
 
 class Node
 {
@@ -51,10 +577,11 @@ public:
   }
 };
 
+template <typename T = double>
 class KDTree
 {
 public:
-  double* all_pts;
+  T* all_pts;
   uint64_t* all_idx;
   uint64_t npts;
   uint32_t ndim;
@@ -65,10 +592,22 @@ public:
   double* domain_maxs;
   std::vector<Node*> leaves;
   Node* root;
+  uint64_t num_nodes;
+  uint32_t nthreads;
+  uint32_t cutoff_depth;
+  KDTreeTaskPool* pool;
+  uint32_t split_policy;
+  KDTreeCostModel cost_model;
+  uint32_t sample_size;
+  double sample_tolerance;
 
   // KDTree() {}
-  KDTree(double *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0, 
-	 double *left_edge, double *right_edge)
+  KDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0, 
+	 double *left_edge, double *right_edge, uint32_t nthreads0 = 1,
+	 uint32_t split_policy0 = KDTREE_SPLIT_MEDIAN,
+	 double ghost_weight = 1.0, double variance_weight = 1.0,
+	 uint32_t sample_size0 = KDTREE_SAMPLE_SIZE,
+	 double sample_tolerance0 = KDTREE_SAMPLE_TOLERANCE)
   {
     all_pts = pts;
     all_idx = idx;
@@ -77,38 +616,202 @@ public:
     leafsize = leafsize0;
     domain_left_edge = left_edge;
     domain_right_edge = right_edge;
+    num_nodes = 0;
+    nthreads = nthreads0;
+    if (nthreads == 0)
+      nthreads = 1;
+    cutoff_depth = kdtree_cutoff_depth(nthreads);
+    pool = NULL;
+    split_policy = split_policy0;
+    cost_model = KDTreeCostModel(m, leafsize, n, ghost_weight,
+				 variance_weight);
+    set_sampling(sample_size0, sample_tolerance0);
+
+    domain_mins = kdtree_min_pts(pts, n, m);
+    domain_maxs = kdtree_max_pts(pts, n, m);
+
+    if (split_policy == KDTREE_SPLIT_COST) {
+      // Measure leaf costs on a median tree to weight the points, then
+      // refine the weights on the trees they produce
+      split_policy = KDTREE_SPLIT_MEDIAN;
+      for (uint32_t pass = 0; pass < KDTREE_COST_PASSES; pass++) {
+	build_tree();
+	for (uint32_t k = 0; k < leaves.size(); k++)
+	  cost_model.assign_weights(all_pts, all_idx, npts,
+				    leaves[k]->left_idx, leaves[k]->children,
+				    pass > 0);
+	delete_node(root);
+	leaves.clear();
+	num_nodes = 0;
+	split_policy = KDTREE_SPLIT_COST;
+      }
+    }
+    build_tree();
+  }
 
-    domain_mins = min_pts(pts, n, m);
-    domain_maxs = max_pts(pts, n, m);
+  // Sampled splits stop at the depth a median split would reach (see
+  // KDTreeCostModel), so there are as many leaves as in a median tree. A
+  // sampled split that would leave either child with fewer than
+  // cost_model.min_leaf points falls back to the exact median.
+  void set_sampling(uint32_t sample_size0, double sample_tolerance0)
+  {
+    sample_size = sample_size0;
+    sample_tolerance = std::min(std::max(sample_tolerance0, 0.0), 0.5);
+  }
 
+  void build_tree()
+  {
     std::vector<double> LE;
     std::vector<double> RE;
     std::vector<double> mins;
     std::vector<double> maxs;
-    for (uint32_t d = 0; d < m; d++) {
-      LE.push_back(left_edge[d]);
-      RE.push_back(right_edge[d]);
+    for (uint32_t d = 0; d < ndim; d++) {
+      LE.push_back(domain_left_edge[d]);
+      RE.push_back(domain_right_edge[d]);
       mins.push_back(domain_mins[d]);
       maxs.push_back(domain_maxs[d]);
     }
 
-    root = build(0, n, LE, RE, mins, maxs);
+    if (nthreads > 1) {
+      KDTreeTaskPool build_pool(nthreads);
+      pool = &build_pool;
+      root = build(0, npts, LE, RE, mins, maxs);
+      pool = NULL;
+    } else {
+      root = build(0, npts, LE, RE, mins, maxs);
+    }
+    finalize(root);
   }
   ~KDTree()
   {
     // free(idx);
     free(domain_mins);
     free(domain_maxs);
-    free(root);
+    delete_node(root);
+  }
+
+  void delete_node(Node* node)
+  {
+    if (!(node->is_leaf)) {
+      delete_node(node->less);
+      delete_node(node->greater);
+    }
+    delete node;
+  }
+
+  // Count nodes and collect leaves in depth-first order, so the leaf order
+  // does not depend on the order in which subtrees were built.
+  void finalize(Node* node)
+  {
+    num_nodes++;
+    if (node->is_leaf) {
+      leaves.push_back(node);
+    } else {
+      finalize(node->less);
+      finalize(node->greater);
+    }
+  }
+
+  // Bytes held by the nodes, not counting per-allocation overhead
+  uint64_t nbytes()
+  {
+    return num_nodes*(sizeof(Node) + 2*ndim*sizeof(double)) +
+      leaves.capacity()*sizeof(Node*);
+  }
+
+  // Append node and its descendents to nodes in pre-order, returning the
+  // index of node. Leaves are numbered in the order they are reached, which
+  // matches the order of leaves.
+  uint32_t flatten(Node* node, std::vector<FlatNode>& nodes,
+		   std::vector<double>& le, std::vector<double>& re,
+		   std::vector<uint32_t>& leaf_nodes)
+  {
+    uint32_t i = (uint32_t)nodes.size();
+    FlatNode out;
+    out.left_idx = node->left_idx;
+    out.children = node->children;
+    out.split = 0.0;
+    out.split_dim = 0;
+    out.leafid = FLAT_KDTREE_NONE;
+    out.less = FLAT_KDTREE_NONE;
+    out.greater = FLAT_KDTREE_NONE;
+    nodes.push_back(out);
+    le.insert(le.end(), node->left_edge.begin(), node->left_edge.end());
+    re.insert(re.end(), node->right_edge.begin(), node->right_edge.end());
+    if (node->is_leaf) {
+      nodes[i].leafid = (uint32_t)leaf_nodes.size();
+      leaf_nodes.push_back(i);
+    } else {
+      nodes[i].split_dim = node->split_dim;
+      nodes[i].split = node->split;
+      uint32_t less = flatten(node->less, nodes, le, re, leaf_nodes);
+      uint32_t greater = flatten(node->greater, nodes, le, re, leaf_nodes);
+      nodes[i].less = less;
+      nodes[i].greater = greater;
+    }
+    return i;
+  }
+
+  // Write the tree to a file that can be mapped by FlatKDTree
+  void save(const char *filename, uint8_t *periodic, uint8_t *leaf_periodic,
+	    uint64_t *neighbor_offsets, uint32_t *neighbors)
+  {
+    std::vector<FlatNode> nodes;
+    std::vector<double> le, re;
+    std::vector<uint32_t> leaf_nodes;
+    nodes.reserve(num_nodes);
+    le.reserve(num_nodes*ndim);
+    re.reserve(num_nodes*ndim);
+    leaf_nodes.reserve(leaves.size());
+    flatten(root, nodes, le, re, leaf_nodes);
+    write_kdtree_file(filename, this, &nodes[0], &le[0], &re[0],
+		      (uint32_t)nodes.size(), &leaf_nodes[0],
+		      (uint32_t)leaf_nodes.size(), periodic, leaf_periodic,
+		      neighbor_offsets, neighbors);
+  }
+
+  // Route points to leaves (see flat_kdtree_route). The nodes are flattened
+  // for the descent, which costs O(num_nodes) per call.
+  void route(T *pts, uint64_t n, uint32_t *leafids,
+	     uint64_t *order = NULL, uint64_t *offsets = NULL,
+	     uint32_t nthreads0 = 1)
+  {
+    std::vector<FlatNode> nodes;
+    std::vector<double> le, re;
+    std::vector<uint32_t> leaf_nodes;
+    nodes.reserve(num_nodes);
+    leaf_nodes.reserve(leaves.size());
+    flatten(root, nodes, le, re, leaf_nodes);
+    flat_kdtree_route(&nodes[0], (uint32_t)nodes.size(),
+		      (uint32_t)leaves.size(), domain_left_edge,
+		      domain_right_edge, ndim, pts, n, leafids, order, offsets,
+		      nthreads0);
+  }
+
+  // Estimated cost of each leaf under the cost model
+  void leaf_costs(double *out)
+  {
+    for (uint32_t k = 0; k < leaves.size(); k++) {
+      Node* leaf = leaves[k];
+      out[k] = cost_model.node_cost(all_pts, all_idx, leaf->left_idx,
+				    leaf->children);
+    }
   }
 
   Node* build(uint64_t Lidx, uint64_t n, 
 	      std::vector<double> LE, std::vector<double> RE, 
-	      std::vector<double> mins, std::vector<double> maxes)
+	      std::vector<double> mins, std::vector<double> maxes,
+	      uint32_t depth = 0, uint32_t tid = 0)
   {
-    if (n < leafsize) {
+    bool small;
+    if ((split_policy == KDTREE_SPLIT_COST) ||
+	(split_policy == KDTREE_SPLIT_SAMPLE))
+      small = ((depth >= cost_model.max_depth) ||
+	     (n < 2*cost_model.min_leaf));
+    else
+      small = ((n < leafsize) || (n < 2));
+    if (small) {
       Node* out = new Node(ndim, LE, RE, Lidx, n);
-      leaves.push_back(out);
       return out;
     } else {
       // Find dimension to split along
@@ -120,21 +823,34 @@ public:
       if (maxes[dmax] == mins[dmax]) {
 	// all points singular
 	Node* out = new Node(ndim, LE, RE, Lidx, n);
-	leaves.push_back(out);
 	return out;
       }
       
-      // Find median along dimension
+      // Find median (or cost-weighted median) along dimension
       int64_t stop = n-1;
-      int64_t med = (n/2) + (n%2);
-
-      // Version using pointer to all points and index
-      med = select(all_pts, all_idx, ndim, dmax, Lidx, stop+Lidx, (stop/2)+Lidx);
-      med = (stop/2)+Lidx;
+      int64_t med = (stop/2)+Lidx;
+      double split;
+      if (split_policy == KDTREE_SPLIT_COST) {
+	uint64_t Ncost = cost_model.split(all_pts, all_idx, Lidx, n, dmax,
+					  depth);
+	if (Ncost == 0) {
+	  Node* out = new Node(ndim, LE, RE, Lidx, n);
+	  return out;
+	}
+	med = Lidx + Ncost - 1;
+      } else if (split_policy == KDTREE_SPLIT_SAMPLE) {
+	med = Lidx + sample_select(all_pts, all_idx, ndim, dmax, Lidx, n,
+				   sample_size, sample_tolerance, split,
+				   cost_model.min_leaf) - 1;
+      } else {
+	// Version using pointer to all points and index
+	kdtree_select(all_pts, all_idx, ndim, dmax, Lidx, stop+Lidx, med);
+      }
       uint64_t Nless = med-Lidx+1;
       uint64_t Ngreater = n - Nless;
-      double split;
-      if ((n%2) == 0) {
+      if (split_policy == KDTREE_SPLIT_SAMPLE) {
+	// split was set by sample_select
+      } else if ((n%2) == 0) {
 	split = all_pts[ndim*all_idx[med] + dmax];
 	// split = (all_pts[ndim*all_idx[med] + dmax] + 
 	// 	 all_pts[ndim*all_idx[med+1] + dmax])/2.0;
@@ -159,8 +875,22 @@ public:
       greaterleft[dmax] = split;
 
       // Build less and greater nodes
-      Node* less = build(Lidx, Nless, LE, lessright, mins, lessmaxes);
-      Node* greater = build(Lidx+Nless, Ngreater, greaterleft, RE, greatermins, maxes);
+      Node* less;
+      Node* greater;
+      if ((pool != NULL) && (depth < cutoff_depth)) {
+	KDTreeTaskPool::Task task;
+	task.func = [&](uint32_t t) {
+	  less = build(Lidx, Nless, LE, lessright, mins, lessmaxes, depth+1, t);
+	};
+	pool->push(tid, &task);
+	greater = build(Lidx+Nless, Ngreater, greaterleft, RE, greatermins, maxes,
+			depth+1, tid);
+	pool->wait(tid, &task);
+      } else {
+	less = build(Lidx, Nless, LE, lessright, mins, lessmaxes, depth+1, tid);
+	greater = build(Lidx+Nless, Ngreater, greaterleft, RE, greatermins, maxes,
+			depth+1, tid);
+      }
 
       // Create innernode referencing child nodes
       Node* out = new Node(ndim, LE, RE, Lidx, dmax, split, less, greater);
@@ -170,3 +900,459 @@ public:
 };
 
 
+
+// Single block of memory that is carved into regions by offset and released
+// in one call, so a tree does not have to be torn down node by node.
+class KDTreeArena
+{
+public:
+  char *buffer;
+  size_t size;
+  KDTreeArena() : buffer(NULL), size(0) {}
+  ~KDTreeArena() { release(); }
+  void* resize(size_t nbytes)
+  {
+    if (nbytes == 0) {
+      release();
+      return NULL;
+    }
+    char *new_buffer = (char*)realloc(buffer, nbytes);
+    if (new_buffer == NULL) {
+      fprintf(stderr, "KDTreeArena: failed to allocate %lu bytes\n",
+	      (unsigned long)nbytes);
+      exit(EXIT_FAILURE);
+    }
+    buffer = new_buffer;
+    size = nbytes;
+    return (void*)buffer;
+  }
+  void release()
+  {
+    free(buffer);
+    buffer = NULL;
+    size = 0;
+  }
+};
+
+// KDTree with the same splits as KDTree, but with all nodes stored
+// contiguously in pre-order inside a single arena. The arena holds the node
+// array followed by the left edges of every node and then the right edges
+// of every node (ndim values per node).
+//
+// During the build each subtree is given a fixed range of slots sized by
+// node_bound, so subtrees can be built concurrently without coordinating
+// node indices. The pool is compacted into pre-order afterwards, which
+// makes the layout independent of the number of threads.
+template <typename T = double>
+class FlatKDTree
+{
+public:
+  T* all_pts;
+  uint64_t* all_idx;
+  uint64_t npts;
+  uint32_t ndim;
+  uint32_t leafsize;
+  double* domain_left_edge;
+  double* domain_right_edge;
+  double* domain_mins;
+  double* domain_maxs;
+  KDTreeArena arena;
+  FlatNode* nodes;
+  double* left_edges;
+  double* right_edges;
+  uint32_t num_nodes;
+  uint32_t max_nodes;
+  std::vector<uint32_t> leaves;
+  uint32_t nthreads;
+  uint32_t cutoff_depth;
+  KDTreeTaskPool* pool;
+  uint32_t split_policy;
+  KDTreeCostModel cost_model;
+  KDTreeFile* file;
+  uint32_t sample_size;
+  double sample_tolerance;
+
+  FlatKDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m,
+	     uint32_t leafsize0, double *left_edge, double *right_edge,
+	     uint32_t nthreads0 = 1,
+	     uint32_t split_policy0 = KDTREE_SPLIT_MEDIAN,
+	     double ghost_weight = 1.0, double variance_weight = 1.0,
+	     uint32_t sample_size0 = KDTREE_SAMPLE_SIZE,
+	     double sample_tolerance0 = KDTREE_SAMPLE_TOLERANCE)
+  {
+    all_pts = pts;
+    all_idx = idx;
+    npts = n;
+    ndim = m;
+    leafsize = leafsize0;
+    if (leafsize == 0)
+      leafsize = 1;
+    domain_left_edge = left_edge;
+    domain_right_edge = right_edge;
+    nthreads = nthreads0;
+    if (nthreads == 0)
+      nthreads = 1;
+    cutoff_depth = kdtree_cutoff_depth(nthreads);
+    pool = NULL;
+    split_policy = split_policy0;
+    cost_model = KDTreeCostModel(m, leafsize, n, ghost_weight,
+				 variance_weight);
+    set_sampling(sample_size0, sample_tolerance0);
+
+    domain_mins = kdtree_min_pts(pts, n, m);
+    domain_maxs = kdtree_max_pts(pts, n, m);
+
+    file = NULL;
+    nodes = NULL;
+    num_nodes = 0;
+    max_nodes = 0;
+    if (split_policy == KDTREE_SPLIT_COST) {
+      // Measure leaf costs on a median tree to weight the points, then
+      // refine the weights on the trees they produce
+      split_policy = KDTREE_SPLIT_MEDIAN;
+      for (uint32_t pass = 0; pass < KDTREE_COST_PASSES; pass++) {
+	build_tree();
+	for (uint32_t k = 0; k < num_leaves(); k++)
+	  cost_model.assign_weights(all_pts, all_idx, npts, leaf(k)->left_idx,
+				    leaf(k)->children, pass > 0);
+	split_policy = KDTREE_SPLIT_COST;
+      }
+    }
+    build_tree();
+  }
+
+  // Sampled splits stop at the depth a median split would reach (see
+  // KDTreeCostModel), so there are as many leaves as in a median tree. A
+  // sampled split that would leave either child with fewer than
+  // cost_model.min_leaf points falls back to the exact median.
+  void set_sampling(uint32_t sample_size0, double sample_tolerance0)
+  {
+    sample_size = sample_size0;
+    sample_tolerance = std::min(std::max(sample_tolerance0, 0.0), 0.5);
+  }
+
+  void build_tree()
+  {
+    arena.release();
+    num_nodes = 0;
+    max_nodes = node_bound(npts);
+    allocate(max_nodes);
+    // Unused slots are marked by a left_idx of all ones
+    memset(nodes, 0xFF, max_nodes*sizeof(FlatNode));
+
+    memcpy(left_edges, domain_left_edge, ndim*sizeof(double));
+    memcpy(right_edges, domain_right_edge, ndim*sizeof(double));
+    if (nthreads > 1) {
+      KDTreeTaskPool build_pool(nthreads);
+      pool = &build_pool;
+      build(0, 0, npts, domain_mins, domain_maxs);
+      pool = NULL;
+    } else {
+      build(0, 0, npts, domain_mins, domain_maxs);
+    }
+    compact();
+
+    // Drop the unused tail of the node pool
+    allocate(num_nodes);
+  }
+  // Use the tree saved in a KD tree file for the points pts without
+  // rebuilding it. The nodes, edges and index are used in place from the
+  // mapped file, so only the pages that are touched are read.
+  FlatKDTree(const char *filename, T *pts)
+  {
+    file = new KDTreeFile(filename);
+    all_pts = pts;
+    all_idx = file->all_idx;
+    npts = file->npts;
+    ndim = file->ndim;
+    leafsize = file->leafsize;
+    domain_left_edge = file->domain_left_edge();
+    domain_right_edge = file->domain_right_edge();
+    domain_mins = (double*)malloc(ndim*sizeof(double));
+    domain_maxs = (double*)malloc(ndim*sizeof(double));
+    memcpy(domain_mins, file->domain_mins(), ndim*sizeof(double));
+    memcpy(domain_maxs, file->domain_maxs(), ndim*sizeof(double));
+    nthreads = 1;
+    cutoff_depth = 0;
+    pool = NULL;
+    split_policy = file->split_policy;
+    cost_model = KDTreeCostModel(ndim, leafsize, npts, file->ghost_weight,
+				 file->variance_weight);
+    set_sampling(KDTREE_SAMPLE_SIZE, KDTREE_SAMPLE_TOLERANCE);
+    nodes = file->nodes;
+    left_edges = file->left_edges;
+    right_edges = file->right_edges;
+    num_nodes = file->num_nodes;
+    max_nodes = num_nodes;
+    leaves.assign(file->leaves, file->leaves + file->num_leaves);
+  }
+  ~FlatKDTree()
+  {
+    free(domain_mins);
+    free(domain_maxs);
+    arena.release();
+    if (file != NULL)
+      delete file;
+  }
+
+  // Write the tree to a file that can be mapped by FlatKDTree
+  void save(const char *filename, uint8_t *periodic, uint8_t *leaf_periodic,
+	    uint64_t *neighbor_offsets, uint32_t *neighbors)
+  {
+    write_kdtree_file(filename, this, nodes, left_edges, right_edges,
+		      num_nodes, leaves.data(), num_leaves(), periodic,
+		      leaf_periodic, neighbor_offsets, neighbors);
+  }
+
+  bool too_small(uint64_t n, uint32_t depth = 0)
+  {
+    if ((split_policy == KDTREE_SPLIT_COST) ||
+	(split_policy == KDTREE_SPLIT_SAMPLE))
+      return ((depth >= cost_model.max_depth) ||
+	      (n < 2*cost_model.min_leaf));
+    // A single point cannot be split, even with a leafsize of 1
+    return ((n < leafsize) || (n < 2));
+  }
+
+  // Upper bound on the number of nodes in a tree over n points. Median
+  // splits divide n points into ceil(n/2) and floor(n/2), so the nodes at
+  // each depth have one of two consecutive sizes and the number of nodes
+  // in the full median tree is counted exactly. Cost and sampled splits
+  // keep both children above cost_model.min_leaf points, so there can be
+  // at most n/min_leaf leaves.
+  uint32_t node_bound(uint64_t n)
+  {
+    uint64_t out = 1;
+    if (too_small(n)) {
+      out = 1;
+    } else if (split_policy == KDTREE_SPLIT_MEDIAN) {
+      out = median_node_count(n);
+    } else {
+      out = 2*(n/cost_model.min_leaf) - 1;
+    }
+    if (out >= (uint64_t)FLAT_KDTREE_NONE) {
+      fprintf(stderr, "FlatKDTree: too many nodes (%lu)\n",
+	      (unsigned long)out);
+      exit(EXIT_FAILURE);
+    }
+    return (uint32_t)out;
+  }
+
+  // Number of nodes in a median tree over n points. Single points are
+  // always leaves since there is nothing to split.
+  uint64_t median_node_count(uint64_t n)
+  {
+    // Number of nodes with a and a+1 points at the current depth
+    uint64_t a = n, na = 1, nb = 0, out = 0;
+    uint64_t lo, nlo, nhi, s, c;
+    while ((na + nb) > 0) {
+      out += na + nb;
+      lo = a/2;
+      nlo = 0;
+      nhi = 0;
+      for (int k = 0; k < 2; k++) {
+	s = a + k;
+	c = (k == 0) ? na : nb;
+	if ((c == 0) || (s < leafsize) || (s < 2))
+	  continue;
+	// Children with ceil(s/2) and floor(s/2) points
+	if ((s/2) == lo) nlo += c; else nhi += c;
+	if (((s + 1)/2) == lo) nlo += c; else nhi += c;
+      }
+      a = lo;
+      na = nlo;
+      nb = nhi;
+    }
+    return out;
+  }
+
+  // Size the arena for nalloc nodes, moving existing edges so the buffer
+  // layout stays [nodes | left edges | right edges].
+  void allocate(uint32_t nalloc)
+  {
+    size_t edge_bytes = ndim*sizeof(double);
+    size_t new_size = nalloc*(sizeof(FlatNode) + 2*edge_bytes);
+    if (arena.buffer != NULL) {
+      if (nalloc > max_nodes) {
+	fprintf(stderr, "FlatKDTree: cannot grow node pool\n");
+	exit(EXIT_FAILURE);
+      }
+      // Shrink: compact regions toward the front before releasing the tail
+      char *le_new = arena.buffer + nalloc*sizeof(FlatNode);
+      memmove(le_new, left_edges, num_nodes*edge_bytes);
+      memmove(le_new + nalloc*edge_bytes, right_edges, num_nodes*edge_bytes);
+    }
+    char *buf = (char*)arena.resize(new_size);
+    max_nodes = nalloc;
+    nodes = (FlatNode*)buf;
+    left_edges = (double*)(buf + nalloc*sizeof(FlatNode));
+    right_edges = left_edges + nalloc*ndim;
+  }
+
+  // Move used slots to the front of the pool in pre-order, renumbering
+  // children and assigning leaf ids along the way.
+  void compact()
+  {
+    std::vector<uint32_t> remap(max_nodes, FLAT_KDTREE_NONE);
+    uint32_t i, j = 0;
+    for (i = 0; i < max_nodes; i++) {
+      if (nodes[i].left_idx != UINT64_MAX)
+	remap[i] = j++;
+    }
+    num_nodes = j;
+    leaves.clear();
+    for (i = 0; i < max_nodes; i++) {
+      j = remap[i];
+      if (j == FLAT_KDTREE_NONE)
+	continue;
+      // j <= i, so moving forward never overwrites an unvisited slot
+      if (j != i) {
+	nodes[j] = nodes[i];
+	memcpy(left_edges + ndim*j, left_edges + ndim*i, ndim*sizeof(double));
+	memcpy(right_edges + ndim*j, right_edges + ndim*i, ndim*sizeof(double));
+      }
+      if (nodes[j].less == FLAT_KDTREE_NONE) {
+	nodes[j].leafid = (uint32_t)leaves.size();
+	leaves.push_back(j);
+      } else {
+	nodes[j].less = remap[nodes[j].less];
+	nodes[j].greater = remap[nodes[j].greater];
+      }
+    }
+  }
+
+  void build(uint32_t i, uint64_t Lidx, uint64_t n, double *mins,
+	     double *maxs, uint32_t depth = 0, uint32_t tid = 0)
+  {
+    FlatNode *node = nodes + i;
+    node->left_idx = Lidx;
+    node->children = n;
+    node->split = 0.0;
+    node->split_dim = 0;
+    node->leafid = FLAT_KDTREE_NONE;
+    node->less = FLAT_KDTREE_NONE;
+    node->greater = FLAT_KDTREE_NONE;
+    if (too_small(n, depth))
+      return;
+    // Find dimension to split along
+    uint32_t dmax, d;
+    dmax = 0;
+    for (d = 1; d < ndim; d++)
+      if ((maxs[d]-mins[d]) > (maxs[dmax]-mins[dmax]))
+	dmax = d;
+    if (maxs[dmax] == mins[dmax]) {
+      // all points singular
+      return;
+    }
+
+    // Find median (or cost-weighted median) along dimension
+    int64_t stop = n-1;
+    int64_t med = (stop/2)+Lidx;
+    double split;
+    if (split_policy == KDTREE_SPLIT_COST) {
+      uint64_t Ncost = cost_model.split(all_pts, all_idx, Lidx, n, dmax,
+					depth);
+      if (Ncost == 0)
+	return;
+      med = Lidx + Ncost - 1;
+    } else if (split_policy == KDTREE_SPLIT_SAMPLE) {
+      med = Lidx + sample_select(all_pts, all_idx, ndim, dmax, Lidx, n,
+				 sample_size, sample_tolerance, split,
+				 cost_model.min_leaf) - 1;
+    } else {
+      kdtree_select(all_pts, all_idx, ndim, dmax, Lidx, stop+Lidx, med);
+    }
+    uint64_t Nless = med-Lidx+1;
+    uint64_t Ngreater = n - Nless;
+    if (split_policy != KDTREE_SPLIT_SAMPLE)
+      split = all_pts[ndim*all_idx[med] + dmax];
+    node->split_dim = dmax;
+    node->split = split;
+
+    // Less child directly follows its parent and the greater child
+    // follows the range reserved for the less subtree
+    uint32_t less = i + 1;
+    uint32_t greater = less + node_bound(Nless);
+    if (((uint64_t)greater + node_bound(Ngreater)) >
+	((uint64_t)i + node_bound(n))) {
+      fprintf(stderr, "FlatKDTree: children of node %u (%lu points) "
+	      "overflow its reserved slots\n", i, (unsigned long)n);
+      exit(EXIT_FAILURE);
+    }
+    node->less = less;
+    node->greater = greater;
+    memcpy(left_edges + ndim*less, left_edges + ndim*i, ndim*sizeof(double));
+    memcpy(right_edges + ndim*less, right_edges + ndim*i, ndim*sizeof(double));
+    right_edges[ndim*less + dmax] = split;
+    memcpy(left_edges + ndim*greater, left_edges + ndim*i, ndim*sizeof(double));
+    memcpy(right_edges + ndim*greater, right_edges + ndim*i, ndim*sizeof(double));
+    left_edges[ndim*greater + dmax] = split;
+
+    double save;
+    if ((pool != NULL) && (depth < cutoff_depth)) {
+      // The forked subtree gets its own copy of the bounds
+      std::vector<double> less_bounds(mins, mins + ndim);
+      less_bounds.insert(less_bounds.end(), maxs, maxs + ndim);
+      less_bounds[ndim + dmax] = split;
+      KDTreeTaskPool::Task task;
+      task.func = [&](uint32_t t) {
+	build(less, Lidx, Nless, &less_bounds[0], &less_bounds[ndim],
+	      depth+1, t);
+      };
+      pool->push(tid, &task);
+      save = mins[dmax];
+      mins[dmax] = split;
+      build(greater, Lidx+Nless, Ngreater, mins, maxs, depth+1, tid);
+      mins[dmax] = save;
+      pool->wait(tid, &task);
+    } else {
+      save = maxs[dmax];
+      maxs[dmax] = split;
+      build(less, Lidx, Nless, mins, maxs, depth+1, tid);
+      maxs[dmax] = save;
+      save = mins[dmax];
+      mins[dmax] = split;
+      build(greater, Lidx+Nless, Ngreater, mins, maxs, depth+1, tid);
+      mins[dmax] = save;
+    }
+  }
+
+  bool is_leaf(uint32_t i) { return (nodes[i].less == FLAT_KDTREE_NONE); }
+  uint32_t num_leaves() { return (uint32_t)leaves.size(); }
+  FlatNode* leaf(uint32_t k) { return nodes + leaves[k]; }
+  double* node_left_edge(uint32_t i) { return left_edges + ndim*i; }
+  double* node_right_edge(uint32_t i) { return right_edges + ndim*i; }
+  double* leaf_left_edge(uint32_t k) { return node_left_edge(leaves[k]); }
+  double* leaf_right_edge(uint32_t k) { return node_right_edge(leaves[k]); }
+
+  // Route points to leaves (see flat_kdtree_route)
+  void route(T *pts, uint64_t n, uint32_t *leafids,
+	     uint64_t *order = NULL, uint64_t *offsets = NULL,
+	     uint32_t nthreads0 = 1)
+  {
+    flat_kdtree_route(nodes, num_nodes, num_leaves(), domain_left_edge,
+		      domain_right_edge, ndim, pts, n, leafids, order, offsets,
+		      nthreads0);
+  }
+
+  // Bytes held by the nodes and leaf list
+  uint64_t nbytes()
+  {
+    if (file != NULL)
+      return (file->map_size - npts*sizeof(uint64_t) +
+	      leaves.capacity()*sizeof(uint32_t));
+    return arena.size + leaves.capacity()*sizeof(uint32_t);
+  }
+
+  // Estimated cost of each leaf under the cost model
+  void leaf_costs(double *out)
+  {
+    for (uint32_t k = 0; k < leaves.size(); k++) {
+      FlatNode* node = leaf(k);
+      out[k] = cost_model.node_cost(all_pts, all_idx, node->left_idx,
+				    node->children);
+    }
+  }
+};
+
+#endif
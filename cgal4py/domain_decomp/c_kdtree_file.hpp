@@ -0,0 +1,327 @@
+#ifndef C_KDTREE_FILE_HPP
+#define C_KDTREE_FILE_HPP
+
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Node in a FlatKDTree. Children are referenced by their index in the node
+// array and edges live in the tree's edge buffer.
+struct FlatNode
+{
+  uint64_t left_idx;
+  uint64_t children;
+  double split;
+  uint32_t split_dim;
+  uint32_t leafid;
+  uint32_t less;
+  uint32_t greater;
+};
+
+static const uint32_t FLAT_KDTREE_NONE = 0xFFFFFFFF;
+
+// Leaf containing a position in a tree of FlatNodes with the root at index
+// 0, or FLAT_KDTREE_NONE if the position is outside the domain. Positions
+// on a split go to the less child. The child is picked by indexing rather
+// than branching so the descent does not stall on mispredicted splits.
+template <typename T>
+inline uint32_t flat_kdtree_search(const FlatNode *nodes, uint32_t num_nodes,
+				   const double *domain_left_edge,
+				   const double *domain_right_edge,
+				   uint32_t ndim, const T *pos)
+{
+  uint32_t d;
+  bool outside = (num_nodes == 0);
+  for (d = 0; d < ndim; d++)
+    outside |= ((pos[d] < domain_left_edge[d]) |
+		(pos[d] > domain_right_edge[d]));
+  if (outside)
+    return FLAT_KDTREE_NONE;
+  const FlatNode *node = nodes;
+  while (node->less != FLAT_KDTREE_NONE) {
+    uint32_t child[2] = {node->less, node->greater};
+    node = nodes + child[pos[node->split_dim] > node->split];
+  }
+  return node->leafid;
+}
+
+#define KDTREE_FILE_VERSION 1
+
+// Sections of a KD tree file, in the order they are written
+enum KDTreeFileSection {
+  KDTREE_FILE_DOMAIN = 0,     // double: left edge, right edge, mins, maxs
+  KDTREE_FILE_PERIODIC,       // uint8: domain periodicity in each dimension
+  KDTREE_FILE_NODES,          // FlatNode: nodes in pre-order
+  KDTREE_FILE_LEFT_EDGES,     // double: left edge of each node
+  KDTREE_FILE_RIGHT_EDGES,    // double: right edge of each node
+  KDTREE_FILE_IDX,            // uint64: indices sorting points by leaf
+  KDTREE_FILE_LEAVES,         // uint32: node index of each leaf
+  KDTREE_FILE_LEAF_PERIODIC,  // uint8: periodic_left then periodic_right
+  KDTREE_FILE_NEIGHBOR_OFFSETS, // uint64: start of each neighbor list
+  KDTREE_FILE_NEIGHBORS,      // uint32: concatenated neighbor lists
+  KDTREE_FILE_NSECTIONS
+};
+
+struct KDTreeFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t ndim;
+  uint64_t npts;
+  uint32_t leafsize;
+  uint32_t split_policy;
+  double ghost_weight;
+  double variance_weight;
+  uint32_t num_nodes;
+  uint32_t num_leaves;
+  uint64_t num_neighbors;
+  uint64_t offsets[KDTREE_FILE_NSECTIONS];
+  uint64_t sizes[KDTREE_FILE_NSECTIONS];
+  uint64_t file_size;
+};
+
+static const char KDTREE_FILE_MAGIC[8] = {'C', '4', 'P', 'Y', 'K', 'D', 'T',
+					  '\0'};
+
+// Binary image of a built KD tree and its leaf neighbors. The header is
+// followed by one section per array, each starting on an 8 byte boundary,
+// so a file can be memory mapped and used in place. Loading a file only
+// maps it; pages are read from disk as they are touched.
+//
+// Each leaf has 2*ndim+1 neighbor lists. List d < ndim holds the left
+// neighbors in dimension d, list ndim+d holds the right neighbors in
+// dimension d, and list 2*ndim holds every neighbor as stored by the tree
+// that was saved (trees built by cgal4py include the leaf itself).
+//
+// To write a file, fill in the counts and point the arrays at the data
+// before calling save. Files are written in native byte order.
+class KDTreeFile
+{
+public:
+  uint32_t ndim;
+  uint64_t npts;
+  uint32_t leafsize;
+  uint32_t split_policy;
+  double ghost_weight;
+  double variance_weight;
+  uint32_t num_nodes;
+  uint32_t num_leaves;
+  uint64_t num_neighbors;
+  double* domain;
+  uint8_t* periodic;
+  FlatNode* nodes;
+  double* left_edges;
+  double* right_edges;
+  uint64_t* all_idx;
+  uint32_t* leaves;
+  uint8_t* leaf_periodic;
+  uint64_t* neighbor_offsets;
+  uint32_t* neighbors;
+  void* map;
+  size_t map_size;
+
+  KDTreeFile()
+  {
+    ndim = 0;
+    npts = 0;
+    leafsize = 0;
+    split_policy = 0;
+    ghost_weight = 1.0;
+    variance_weight = 1.0;
+    num_nodes = 0;
+    num_leaves = 0;
+    num_neighbors = 0;
+    domain = NULL;
+    periodic = NULL;
+    nodes = NULL;
+    left_edges = NULL;
+    right_edges = NULL;
+    all_idx = NULL;
+    leaves = NULL;
+    leaf_periodic = NULL;
+    neighbor_offsets = NULL;
+    neighbors = NULL;
+    map = NULL;
+    map_size = 0;
+  }
+  // Map a file written by save. The mapping is private, so writes to the
+  // arrays (e.g. re-sorting all_idx) are not carried back to the file.
+  KDTreeFile(const char *filename) : KDTreeFile()
+  {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error(std::string("Cannot open KD tree file: ") +
+			       filename);
+    struct stat st;
+    if ((fstat(fd, &st) != 0) ||
+	(st.st_size < (off_t)sizeof(KDTreeFileHeader))) {
+      close(fd);
+      throw std::runtime_error(std::string("Invalid KD tree file: ") +
+			       filename);
+    }
+    map_size = (size_t)st.st_size;
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      map = NULL;
+      throw std::runtime_error(std::string("Cannot map KD tree file: ") +
+			       filename);
+    }
+    KDTreeFileHeader *h = (KDTreeFileHeader*)map;
+    if ((memcmp(h->magic, KDTREE_FILE_MAGIC, 8) != 0) ||
+	(h->version != KDTREE_FILE_VERSION) ||
+	(h->file_size != (uint64_t)map_size)) {
+      munmap(map, map_size);
+      map = NULL;
+      throw std::runtime_error(std::string("Invalid KD tree file: ") +
+			       filename);
+    }
+    ndim = h->ndim;
+    npts = h->npts;
+    leafsize = h->leafsize;
+    split_policy = h->split_policy;
+    ghost_weight = h->ghost_weight;
+    variance_weight = h->variance_weight;
+    num_nodes = h->num_nodes;
+    num_leaves = h->num_leaves;
+    num_neighbors = h->num_neighbors;
+    uint64_t sizes[KDTREE_FILE_NSECTIONS];
+    section_sizes(sizes);
+    for (uint32_t s = 0; s < KDTREE_FILE_NSECTIONS; s++) {
+      if ((h->sizes[s] != sizes[s]) || (h->offsets[s] % 8) ||
+	  ((h->offsets[s] + sizes[s]) > (uint64_t)map_size)) {
+	munmap(map, map_size);
+	map = NULL;
+	throw std::runtime_error(std::string("Corrupt KD tree file: ") +
+				 filename);
+      }
+    }
+    char *buf = (char*)map;
+    domain = (double*)(buf + h->offsets[KDTREE_FILE_DOMAIN]);
+    periodic = (uint8_t*)(buf + h->offsets[KDTREE_FILE_PERIODIC]);
+    nodes = (FlatNode*)(buf + h->offsets[KDTREE_FILE_NODES]);
+    left_edges = (double*)(buf + h->offsets[KDTREE_FILE_LEFT_EDGES]);
+    right_edges = (double*)(buf + h->offsets[KDTREE_FILE_RIGHT_EDGES]);
+    all_idx = (uint64_t*)(buf + h->offsets[KDTREE_FILE_IDX]);
+    leaves = (uint32_t*)(buf + h->offsets[KDTREE_FILE_LEAVES]);
+    leaf_periodic = (uint8_t*)(buf + h->offsets[KDTREE_FILE_LEAF_PERIODIC]);
+    neighbor_offsets = (uint64_t*)(buf +
+				   h->offsets[KDTREE_FILE_NEIGHBOR_OFFSETS]);
+    neighbors = (uint32_t*)(buf + h->offsets[KDTREE_FILE_NEIGHBORS]);
+  }
+  ~KDTreeFile()
+  {
+    if (map != NULL)
+      munmap(map, map_size);
+  }
+
+  // Number of bytes in each section for the current counts
+  void section_sizes(uint64_t *sizes) const
+  {
+    sizes[KDTREE_FILE_DOMAIN] = 4*ndim*sizeof(double);
+    sizes[KDTREE_FILE_PERIODIC] = ndim*sizeof(uint8_t);
+    sizes[KDTREE_FILE_NODES] = num_nodes*sizeof(FlatNode);
+    sizes[KDTREE_FILE_LEFT_EDGES] = num_nodes*ndim*sizeof(double);
+    sizes[KDTREE_FILE_RIGHT_EDGES] = num_nodes*ndim*sizeof(double);
+    sizes[KDTREE_FILE_IDX] = npts*sizeof(uint64_t);
+    sizes[KDTREE_FILE_LEAVES] = num_leaves*sizeof(uint32_t);
+    sizes[KDTREE_FILE_LEAF_PERIODIC] = 2*num_leaves*ndim*sizeof(uint8_t);
+    sizes[KDTREE_FILE_NEIGHBOR_OFFSETS] = (num_lists() + 1)*sizeof(uint64_t);
+    sizes[KDTREE_FILE_NEIGHBORS] = num_neighbors*sizeof(uint32_t);
+  }
+
+  void save(const char *filename) const
+  {
+    KDTreeFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, KDTREE_FILE_MAGIC, 8);
+    h.version = KDTREE_FILE_VERSION;
+    h.ndim = ndim;
+    h.npts = npts;
+    h.leafsize = leafsize;
+    h.split_policy = split_policy;
+    h.ghost_weight = ghost_weight;
+    h.variance_weight = variance_weight;
+    h.num_nodes = num_nodes;
+    h.num_leaves = num_leaves;
+    h.num_neighbors = num_neighbors;
+    section_sizes(h.sizes);
+    const void *data[KDTREE_FILE_NSECTIONS] = {
+      domain, periodic, nodes, left_edges, right_edges, all_idx, leaves,
+      leaf_periodic, neighbor_offsets, neighbors};
+    uint64_t pos = sizeof(KDTreeFileHeader);
+    uint32_t s;
+    for (s = 0; s < KDTREE_FILE_NSECTIONS; s++) {
+      pos = (pos + 7) & ~((uint64_t)7);
+      h.offsets[s] = pos;
+      pos += h.sizes[s];
+    }
+    h.file_size = pos;
+    FILE *fd = fopen(filename, "wb");
+    if (fd == NULL)
+      throw std::runtime_error(std::string("Cannot create KD tree file: ") +
+			       filename);
+    bool ok = (fwrite(&h, sizeof(h), 1, fd) == 1);
+    const char zeros[8] = {0};
+    pos = sizeof(KDTreeFileHeader);
+    for (s = 0; (s < KDTREE_FILE_NSECTIONS) && ok; s++) {
+      if (h.offsets[s] > pos)
+	ok = (fwrite(zeros, 1, h.offsets[s] - pos, fd) == (h.offsets[s] - pos));
+      if (ok && (h.sizes[s] > 0))
+	ok = (fwrite(data[s], 1, h.sizes[s], fd) == h.sizes[s]);
+      pos = h.offsets[s] + h.sizes[s];
+    }
+    if ((fclose(fd) != 0) || (!ok))
+      throw std::runtime_error(std::string("Error writing KD tree file: ") +
+			       filename);
+  }
+
+  double* domain_left_edge() { return domain; }
+  double* domain_right_edge() { return domain + ndim; }
+  double* domain_mins() { return domain + 2*ndim; }
+  double* domain_maxs() { return domain + 3*ndim; }
+  FlatNode* leaf(uint32_t k) { return nodes + leaves[k]; }
+  double* leaf_left_edge(uint32_t k) { return left_edges + ndim*leaves[k]; }
+  double* leaf_right_edge(uint32_t k) { return right_edges + ndim*leaves[k]; }
+  bool periodic_left(uint32_t k, uint32_t d)
+  { return leaf_periodic[2*ndim*k + d]; }
+  bool periodic_right(uint32_t k, uint32_t d)
+  { return leaf_periodic[2*ndim*k + ndim + d]; }
+
+  // Neighbor lists
+  uint64_t num_lists() const { return (uint64_t)num_leaves*(2*ndim + 1); }
+  uint64_t list_index(uint32_t k, uint32_t l) const
+  { return (uint64_t)k*(2*ndim + 1) + l; }
+  uint32_t* list_begin(uint32_t k, uint32_t l)
+  { return neighbors + neighbor_offsets[list_index(k, l)]; }
+  uint32_t* list_end(uint32_t k, uint32_t l)
+  { return neighbors + neighbor_offsets[list_index(k, l) + 1]; }
+  uint32_t* left_neighbors_begin(uint32_t k, uint32_t d)
+  { return list_begin(k, d); }
+  uint32_t* left_neighbors_end(uint32_t k, uint32_t d)
+  { return list_end(k, d); }
+  uint32_t* right_neighbors_begin(uint32_t k, uint32_t d)
+  { return list_begin(k, ndim + d); }
+  uint32_t* right_neighbors_end(uint32_t k, uint32_t d)
+  { return list_end(k, ndim + d); }
+  uint32_t* all_neighbors_begin(uint32_t k) { return list_begin(k, 2*ndim); }
+  uint32_t* all_neighbors_end(uint32_t k) { return list_end(k, 2*ndim); }
+
+  // Leaf containing a position, or FLAT_KDTREE_NONE if the position is
+  // outside the domain. Positions on a split go to the less child.
+  uint32_t search(const double *pos)
+  {
+    return flat_kdtree_search(nodes, num_nodes, domain_left_edge(),
+			      domain_right_edge(), ndim, pos);
+  }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef C_KDTREE_ROUTE_HPP
+#define C_KDTREE_ROUTE_HPP
+
+#include <vector>
+#include <thread>
+#include <stdint.h>
+#include "c_kdtree_file.hpp"
+
+// Route n points to the leaves of a flat tree in one pass. leafids[j] is
+// set to the leaf containing point j, or FLAT_KDTREE_NONE if it is outside
+// the domain.
+//
+// If order is not NULL, it receives a permutation of the points grouped by
+// leaf with points in their original order within each leaf (a counting
+// sort on leafids), and offsets (num_leaves+2 entries) receives the start
+// of each leaf's group. Points outside the domain are grouped last,
+// between offsets[num_leaves] and offsets[num_leaves+1].
+//
+// The points are split into nthreads contiguous chunks that are routed
+// concurrently. Each thread counts its chunk per leaf so the permutation
+// can also be scattered in parallel, and the result does not depend on the
+// number of threads.
+template <typename T>
+inline void flat_kdtree_route(const FlatNode *nodes, uint32_t num_nodes,
+			      uint32_t num_leaves,
+			      const double *domain_left_edge,
+			      const double *domain_right_edge, uint32_t ndim,
+			      const T *pts, uint64_t n, uint32_t *leafids,
+			      uint64_t *order = NULL, uint64_t *offsets = NULL,
+			      uint32_t nthreads = 1)
+{
+  uint32_t t, k;
+  uint64_t j;
+  uint32_t nbins = num_leaves + 1;
+  if (nthreads == 0)
+    nthreads = 1;
+  if ((uint64_t)nthreads > n)
+    nthreads = (n > 0) ? (uint32_t)n : 1;
+  std::vector<uint64_t> starts(nthreads + 1);
+  for (t = 0; t <= nthreads; t++)
+    starts[t] = (n*t)/nthreads;
+  std::vector<uint64_t> counts;
+  if (order != NULL)
+    counts.assign((uint64_t)nthreads*nbins, 0);
+  auto route = [&](uint32_t tid) {
+    uint64_t *cnt = (order != NULL) ? &counts[(uint64_t)tid*nbins] : NULL;
+    for (uint64_t i = starts[tid]; i < starts[tid+1]; i++) {
+      uint32_t leaf = flat_kdtree_search(nodes, num_nodes, domain_left_edge,
+					 domain_right_edge, ndim,
+					 pts + ndim*i);
+      leafids[i] = leaf;
+      if (cnt != NULL)
+	cnt[(leaf == FLAT_KDTREE_NONE) ? num_leaves : leaf]++;
+    }
+  };
+  auto scatter = [&](uint32_t tid) {
+    uint64_t *pos = &counts[(uint64_t)tid*nbins];
+    for (uint64_t i = starts[tid]; i < starts[tid+1]; i++) {
+      uint32_t leaf = leafids[i];
+      order[pos[(leaf == FLAT_KDTREE_NONE) ? num_leaves : leaf]++] = i;
+    }
+  };
+  std::vector<std::thread> workers;
+  for (t = 1; t < nthreads; t++)
+    workers.push_back(std::thread(route, t));
+  route(0);
+  for (t = 0; t < workers.size(); t++)
+    workers[t].join();
+  if (order == NULL)
+    return;
+  // Turn per-thread counts into per-thread write positions, ordered by
+  // leaf and then by thread so the sort is stable
+  uint64_t total = 0;
+  for (k = 0; k < nbins; k++) {
+    if (offsets != NULL)
+      offsets[k] = total;
+    for (t = 0; t < nthreads; t++) {
+      j = counts[(uint64_t)t*nbins + k];
+      counts[(uint64_t)t*nbins + k] = total;
+      total += j;
+    }
+  }
+  if (offsets != NULL)
+    offsets[nbins] = total;
+  workers.clear();
+  for (t = 1; t < nthreads; t++)
+    workers.push_back(std::thread(scatter, t));
+  scatter(0);
+  for (t = 0; t < workers.size(); t++)
+    workers[t].join();
+}
+
+#endif
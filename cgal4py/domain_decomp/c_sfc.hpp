@@ -0,0 +1,565 @@
+#ifndef C_SFC_HPP
+#define C_SFC_HPP
+#include <vector>
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <functional>
+
+enum SFCCurve { SFC_HILBERT=0, SFC_MORTON=1 };
+
+// Number of bits in each radix sort digit
+#define SFC_RADIX_BITS 11
+#define SFC_RADIX_SIZE (1 << SFC_RADIX_BITS)
+// Bits per dimension beyond those needed to give each point its own cell
+#define SFC_EXTRA_BITS 4
+
+// Run func(tid, start, stop) over nthreads contiguous chunks of [0, n). The
+// calling thread handles the first chunk.
+inline void sfc_parallel_for(uint32_t nthreads, uint64_t n,
+			     std::function<void(uint32_t, uint64_t,
+						uint64_t)> func)
+{
+  if (nthreads <= 1) {
+    func(0, 0, n);
+    return;
+  }
+  std::vector<std::thread> workers;
+  uint64_t chunk = n/nthreads;
+  for (uint32_t t = 1; t < nthreads; t++) {
+    uint64_t stop = (t == (nthreads - 1)) ? n : (t + 1)*chunk;
+    workers.push_back(std::thread(func, t, t*chunk, stop));
+  }
+  func(0, 0, chunk);
+  for (uint32_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+}
+
+// Number of bits per dimension used for keys. The grid only needs to be
+// fine enough that few points share a cell, so a few bits beyond
+// log2(npts)/ndim are used, up to what fits in a 63 bit key. Fewer bits
+// make keys cheaper to compute and sort.
+inline uint32_t sfc_bits(uint32_t ndim, uint64_t npts)
+{
+  uint32_t lg = 0;
+  while ((lg < 64) && (((uint64_t)1 << lg) < npts))
+    lg++;
+  uint32_t bits = (lg + ndim - 1)/ndim + SFC_EXTRA_BITS;
+  if (bits > 63/ndim)
+    bits = 63/ndim;
+  if (bits > 32)
+    bits = 32;
+  if (bits < 1)
+    bits = 1;
+  return bits;
+}
+
+// Hilbert keys follow Hamilton 2006, "Compact Hilbert Indices". At each
+// level the ndim bits of the cell coordinates are transformed into the
+// orientation of the current sub-cube, Gray decoded to give the next key
+// digit, and the orientation (entry point e and direction d) is updated.
+// This needs a fixed number of operations per level with no data dependent
+// branches.
+inline uint64_t sfc_rotl(uint64_t x, uint32_t r, uint32_t ndim)
+{
+  uint64_t mask = ((uint64_t)1 << ndim) - 1;
+  r %= ndim;
+  if (r == 0)
+    return x;
+  return ((x << r) | (x >> (ndim - r))) & mask;
+}
+
+inline uint64_t sfc_rotr(uint64_t x, uint32_t r, uint32_t ndim)
+{
+  r %= ndim;
+  return sfc_rotl(x, (ndim - r) % ndim, ndim);
+}
+
+inline uint64_t sfc_gray(uint64_t x)
+{
+  return x ^ (x >> 1);
+}
+
+inline uint64_t sfc_gray_inverse(uint64_t g)
+{
+  g ^= g >> 1;
+  g ^= g >> 2;
+  g ^= g >> 4;
+  g ^= g >> 8;
+  g ^= g >> 16;
+  g ^= g >> 32;
+  return g;
+}
+
+// Number of trailing set bits
+inline uint32_t sfc_trailing_ones(uint64_t x)
+{
+  uint32_t c = 0;
+  while (x & 1) {
+    x >>= 1;
+    c++;
+  }
+  return c;
+}
+
+// Entry point of sub-cube w
+inline uint64_t sfc_entry(uint64_t w)
+{
+  if (w == 0)
+    return 0;
+  return sfc_gray(((w - 1) >> 1) << 1);
+}
+
+// Direction of sub-cube w
+inline uint32_t sfc_direction(uint64_t w, uint32_t ndim)
+{
+  if (w == 0)
+    return 0;
+  if (w & 1)
+    return sfc_trailing_ones(w) % ndim;
+  return sfc_trailing_ones(w - 1) % ndim;
+}
+
+inline uint64_t sfc_hilbert_encode(const uint32_t *X, uint32_t ndim,
+				   uint32_t bits)
+{
+  uint64_t key = 0, e = 0, l, w;
+  uint32_t d = 0, j;
+  for (int32_t b = bits - 1; b >= 0; b--) {
+    l = 0;
+    for (j = 0; j < ndim; j++)
+      l |= (uint64_t)((X[j] >> b) & 1) << j;
+    l = sfc_rotr(l ^ e, d + 1, ndim);
+    w = sfc_gray_inverse(l);
+    e ^= sfc_rotl(sfc_entry(w), d + 1, ndim);
+    d = (d + sfc_direction(w, ndim) + 1) % ndim;
+    key = (key << ndim) | w;
+  }
+  return key;
+}
+
+inline void sfc_hilbert_decode(uint64_t key, uint32_t *X, uint32_t ndim,
+			       uint32_t bits)
+{
+  uint64_t e = 0, l, w, mask = ((uint64_t)1 << ndim) - 1;
+  uint32_t d = 0, j;
+  for (j = 0; j < ndim; j++)
+    X[j] = 0;
+  for (int32_t b = bits - 1; b >= 0; b--) {
+    w = (key >> (b*ndim)) & mask;
+    l = sfc_rotl(sfc_gray(w), d + 1, ndim) ^ e;
+    for (j = 0; j < ndim; j++)
+      X[j] |= (uint32_t)((l >> j) & 1) << b;
+    e ^= sfc_rotl(sfc_entry(w), d + 1, ndim);
+    d = (d + sfc_direction(w, ndim) + 1) % ndim;
+  }
+}
+
+// Spread the lowest 21 bits of x so that bit b moves to bit 3*b
+inline uint64_t sfc_spread3(uint32_t x)
+{
+  uint64_t v = x & 0x1FFFFF;
+  v = (v | (v << 32)) & 0x001F00000000FFFFull;
+  v = (v | (v << 16)) & 0x001F0000FF0000FFull;
+  v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+  v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+  v = (v | (v << 2)) & 0x1249249249249249ull;
+  return v;
+}
+
+// Spread the 32 bits of x so that bit b moves to bit 2*b
+inline uint64_t sfc_spread2(uint32_t x)
+{
+  uint64_t v = x;
+  v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+  v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+  v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+  v = (v | (v << 2)) & 0x3333333333333333ull;
+  v = (v | (v << 1)) & 0x5555555555555555ull;
+  return v;
+}
+
+// Interleave the bits of X into a key, most significant bits first
+inline uint64_t sfc_interleave(const uint32_t *X, uint32_t ndim,
+			       uint32_t bits)
+{
+  if ((ndim == 3) && (bits <= 21))
+    return (sfc_spread3(X[0]) << 2) | (sfc_spread3(X[1]) << 1) |
+      sfc_spread3(X[2]);
+  if ((ndim == 2) && (bits <= 32))
+    return (sfc_spread2(X[0]) << 1) | sfc_spread2(X[1]);
+  uint64_t key = 0;
+  for (int32_t b = bits - 1; b >= 0; b--) {
+    for (uint32_t i = 0; i < ndim; i++)
+      key = (key << 1) | ((X[i] >> b) & 1);
+  }
+  return key;
+}
+
+inline void sfc_deinterleave(uint64_t key, uint32_t *X, uint32_t ndim,
+			     uint32_t bits)
+{
+  uint32_t i;
+  for (i = 0; i < ndim; i++)
+    X[i] = 0;
+  for (uint32_t b = 0; b < bits; b++) {
+    for (i = 0; i < ndim; i++) {
+      X[ndim-1-i] |= (uint32_t)(key & 1) << b;
+      key >>= 1;
+    }
+  }
+}
+
+// Maximum number of dimensions for which Hilbert keys are computed from
+// state tables, which have ndim*4**ndim entries
+#define SFC_TABLE_MAXDIM 6
+
+// State tables giving the Hilbert digit, cell bits, and next orientation
+// for each orientation state (e*ndim + d) and input, so keys cost one
+// lookup per level.
+class SFCHilbertTable
+{
+public:
+  uint32_t ndim;
+  std::vector<uint32_t> digit;
+  std::vector<uint32_t> cell;
+  std::vector<uint32_t> next_enc;
+  std::vector<uint32_t> next_dec;
+
+  SFCHilbertTable(uint32_t ndim0 = 0) : ndim(ndim0)
+  {
+    if ((ndim == 0) || (ndim > SFC_TABLE_MAXDIM))
+      return;
+    uint64_t nchild = (uint64_t)1 << ndim;
+    uint64_t nstate = nchild*ndim;
+    digit.resize(nstate*nchild);
+    cell.resize(nstate*nchild);
+    next_enc.resize(nstate*nchild);
+    next_dec.resize(nstate*nchild);
+    for (uint64_t e = 0; e < nchild; e++) {
+      for (uint32_t d = 0; d < ndim; d++) {
+	uint64_t s = e*ndim + d;
+	for (uint64_t l = 0; l < nchild; l++) {
+	  uint64_t w = sfc_gray_inverse(sfc_rotr(l ^ e, d + 1, ndim));
+	  uint64_t e2 = e ^ sfc_rotl(sfc_entry(w), d + 1, ndim);
+	  uint32_t d2 = (d + sfc_direction(w, ndim) + 1) % ndim;
+	  uint32_t s2 = (uint32_t)(e2*ndim + d2);
+	  digit[s*nchild + l] = (uint32_t)w;
+	  next_enc[s*nchild + l] = s2;
+	  cell[s*nchild + w] = (uint32_t)l;
+	  next_dec[s*nchild + w] = s2;
+	}
+      }
+    }
+  }
+
+  bool valid() const
+  {
+    return !digit.empty();
+  }
+
+  uint64_t encode(const uint32_t *X, uint32_t bits) const
+  {
+    uint64_t key = 0, l;
+    uint32_t s = 0, j;
+    for (int32_t b = bits - 1; b >= 0; b--) {
+      l = 0;
+      for (j = 0; j < ndim; j++)
+	l |= (uint64_t)((X[j] >> b) & 1) << j;
+      l |= (uint64_t)s << ndim;
+      key = (key << ndim) | digit[l];
+      s = next_enc[l];
+    }
+    return key;
+  }
+
+  void decode(uint64_t key, uint32_t *X, uint32_t bits) const
+  {
+    uint64_t mask = ((uint64_t)1 << ndim) - 1, w, l;
+    uint32_t s = 0, j;
+    for (j = 0; j < ndim; j++)
+      X[j] = 0;
+    for (int32_t b = bits - 1; b >= 0; b--) {
+      w = ((key >> (b*ndim)) & mask) | ((uint64_t)s << ndim);
+      l = cell[w];
+      for (j = 0; j < ndim; j++)
+	X[j] |= (uint32_t)((l >> j) & 1) << b;
+      s = next_dec[w];
+    }
+  }
+};
+
+// Stable least significant digit radix sort of keys, permuting idx along
+// with them. Only the lowest nbits of the keys are sorted on. Each pass
+// counts digits in per-thread chunks and scatters each chunk into its own
+// slice of the output, so the result does not depend on nthreads.
+inline void sfc_radix_sort(uint64_t *keys, uint64_t *idx, uint64_t n,
+			   uint32_t nbits, uint32_t nthreads)
+{
+  if (n < 2)
+    return;
+  if (nthreads < 1)
+    nthreads = 1;
+  if ((uint64_t)nthreads > n)
+    nthreads = (uint32_t)n;
+  std::vector<uint64_t> keys_tmp(n), idx_tmp(n);
+  uint64_t *src_keys = keys, *src_idx = idx;
+  uint64_t *dst_keys = &keys_tmp[0], *dst_idx = &idx_tmp[0];
+  std::vector<uint64_t> counts(nthreads*SFC_RADIX_SIZE);
+  for (uint32_t shift = 0; shift < nbits; shift += SFC_RADIX_BITS) {
+    std::fill(counts.begin(), counts.end(), 0);
+    sfc_parallel_for(nthreads, n,
+		     [&](uint32_t tid, uint64_t start, uint64_t stop) {
+		       uint64_t *c = &counts[tid*SFC_RADIX_SIZE];
+		       for (uint64_t i = start; i < stop; i++)
+			 c[(src_keys[i] >> shift) & (SFC_RADIX_SIZE - 1)]++;
+		     });
+    // Skip passes where every key has the same digit
+    bool trivial = false;
+    for (uint32_t b = 0; b < SFC_RADIX_SIZE; b++) {
+      uint64_t tot = 0;
+      for (uint32_t t = 0; t < nthreads; t++)
+	tot += counts[t*SFC_RADIX_SIZE + b];
+      if (tot == n)
+	trivial = true;
+      if (tot != 0)
+	break;
+    }
+    if (trivial)
+      continue;
+    // Offsets ordered by digit, then by thread
+    uint64_t offset = 0, c;
+    for (uint32_t b = 0; b < SFC_RADIX_SIZE; b++) {
+      for (uint32_t t = 0; t < nthreads; t++) {
+	c = counts[t*SFC_RADIX_SIZE + b];
+	counts[t*SFC_RADIX_SIZE + b] = offset;
+	offset += c;
+      }
+    }
+    sfc_parallel_for(nthreads, n,
+		     [&](uint32_t tid, uint64_t start, uint64_t stop) {
+		       uint64_t *c = &counts[tid*SFC_RADIX_SIZE];
+		       for (uint64_t i = start; i < stop; i++) {
+			 uint64_t j = c[(src_keys[i] >> shift) &
+					(SFC_RADIX_SIZE - 1)]++;
+			 dst_keys[j] = src_keys[i];
+			 dst_idx[j] = src_idx[i];
+		       }
+		     });
+    std::swap(src_keys, dst_keys);
+    std::swap(src_idx, dst_idx);
+  }
+  if (src_keys != keys) {
+    memcpy(keys, src_keys, n*sizeof(uint64_t));
+    memcpy(idx, src_idx, n*sizeof(uint64_t));
+  }
+}
+
+// Domain decomposition that sorts points along a space filling curve and
+// cuts the curve into contiguous leaves of roughly equal weight. The curve
+// is traced over a grid with 2**bits cells along each dimension. Each leaf
+// owns the range of keys from its first point up to the first point of the
+// next leaf, so the leaves cover the whole domain. Leaf edges are the
+// bounding box of the cells in that range and may overlap those of other
+// leaves.
+class SFCTree
+{
+public:
+  double* all_pts;
+  uint64_t* all_idx;
+  uint64_t npts;
+  uint32_t ndim;
+  uint32_t curve;
+  uint32_t bits;
+  uint32_t nthreads;
+  double* domain_left_edge;
+  double* domain_right_edge;
+  SFCHilbertTable table;
+  std::vector<uint64_t> keys;
+  uint32_t num_leaves;
+  std::vector<uint64_t> leaf_start;
+  std::vector<uint64_t> leaf_key;
+  std::vector<double> leaf_left_edges;
+  std::vector<double> leaf_right_edges;
+
+  // pts and weights are indexed by the original point index and are not
+  // reordered; idx is sorted along the curve. weights may be NULL for
+  // equal weights.
+  SFCTree(double *pts, uint64_t *idx, uint64_t n, uint32_t m,
+	  uint32_t nleaves, double *left_edge, double *right_edge,
+	  uint32_t curve0 = SFC_HILBERT, uint32_t nthreads0 = 1,
+	  double *weights = NULL)
+  {
+    all_pts = pts;
+    all_idx = idx;
+    npts = n;
+    ndim = m;
+    curve = curve0;
+    bits = sfc_bits(ndim, npts);
+    if (curve == SFC_HILBERT)
+      table = SFCHilbertTable(ndim);
+    nthreads = nthreads0;
+    if (nthreads < 1)
+      nthreads = 1;
+    if ((uint64_t)nthreads > npts)
+      nthreads = (npts > 0) ? (uint32_t)npts : 1;
+    domain_left_edge = left_edge;
+    domain_right_edge = right_edge;
+
+    compute_keys();
+    sfc_radix_sort(keys.data(), all_idx, npts, ndim*bits, nthreads);
+    cut(nleaves, weights);
+    leaf_left_edges.resize(num_leaves*ndim);
+    leaf_right_edges.resize(num_leaves*ndim);
+    for (uint32_t k = 0; k < num_leaves; k++)
+      range_edges(leaf_key[k], leaf_key[k+1], &leaf_left_edges[k*ndim],
+		  &leaf_right_edges[k*ndim]);
+  }
+
+  uint64_t encode(const uint32_t *X) const
+  {
+    if (curve == SFC_MORTON)
+      return sfc_interleave(X, ndim, bits);
+    if (table.valid())
+      return table.encode(X, bits);
+    return sfc_hilbert_encode(X, ndim, bits);
+  }
+
+  void decode(uint64_t key, uint32_t *X) const
+  {
+    if (curve == SFC_MORTON)
+      sfc_deinterleave(key, X, ndim, bits);
+    else if (table.valid())
+      table.decode(key, X, bits);
+    else
+      sfc_hilbert_decode(key, X, ndim, bits);
+  }
+
+  uint64_t key_end() const
+  {
+    return (uint64_t)1 << (ndim*bits);
+  }
+
+  void compute_keys()
+  {
+    keys.resize(npts);
+    if (npts == 0)
+      return;
+    uint64_t ncell = (uint64_t)1 << bits;
+    sfc_parallel_for(nthreads, npts,
+		     [&](uint32_t, uint64_t start, uint64_t stop) {
+		       std::vector<uint32_t> X(ndim);
+		       double w, x;
+		       for (uint64_t i = start; i < stop; i++) {
+			 const double *p = all_pts + ndim*all_idx[i];
+			 for (uint32_t d = 0; d < ndim; d++) {
+			   w = domain_right_edge[d] - domain_left_edge[d];
+			   x = 0.0;
+			   if (w > 0)
+			     x = (p[d] - domain_left_edge[d])*(double)ncell/w;
+			   if (x < 0)
+			     x = 0.0;
+			   if (x >= (double)ncell)
+			     X[d] = (uint32_t)(ncell - 1);
+			   else
+			     X[d] = (uint32_t)x;
+			 }
+			 keys[i] = encode(&X[0]);
+		       }
+		     });
+  }
+
+  // Cut the sorted points into nleaves pieces with equal total weight.
+  // Cuts are moved forward so points sharing a key stay on one leaf, and
+  // empty leaves are dropped.
+  void cut(uint32_t nleaves, double *weights)
+  {
+    leaf_start.clear();
+    leaf_key.clear();
+    if (nleaves < 1)
+      nleaves = 1;
+    std::vector<double> cum(npts + 1, 0.0);
+    for (uint64_t i = 0; i < npts; i++) {
+      double w = (weights == NULL) ? 1.0 : weights[all_idx[i]];
+      cum[i+1] = cum[i] + w;
+    }
+    double total = cum[npts];
+    leaf_start.push_back(0);
+    leaf_key.push_back(0);
+    uint64_t prev = 0;
+    for (uint32_t k = 1; k < nleaves; k++) {
+      double target = total*(double)k/(double)nleaves;
+      uint64_t i = (uint64_t)(std::lower_bound(cum.begin(), cum.end(),
+					       target) - cum.begin());
+      if (i > npts)
+	i = npts;
+      while ((i > 0) && (i < npts) && (keys[i] == keys[i-1]))
+	i++;
+      if ((i <= prev) || (i >= npts))
+	continue;
+      leaf_start.push_back(i);
+      leaf_key.push_back(keys[i]);
+      prev = i;
+    }
+    leaf_start.push_back(npts);
+    leaf_key.push_back(key_end());
+    num_leaves = (uint32_t)(leaf_start.size() - 1);
+  }
+
+  // Bounding box of the cells with keys in [a, b). The range is split into
+  // aligned blocks of 2**(ndim*k) keys, each of which covers a cube of
+  // 2**k cells along each dimension for both curves.
+  void range_edges(uint64_t a, uint64_t b, double *le, double *re) const
+  {
+    std::vector<uint32_t> X(ndim), mins(ndim, 0xFFFFFFFF), maxs(ndim, 0);
+    uint32_t d, k;
+    uint64_t block;
+    while (a < b) {
+      k = 0;
+      while (k < bits) {
+	block = (uint64_t)1 << (ndim*(k + 1));
+	if (((a & (block - 1)) != 0) || ((b - a) < block))
+	  break;
+	k++;
+      }
+      decode(a, &X[0]);
+      uint32_t mask = (uint32_t)(((uint64_t)1 << k) - 1);
+      for (d = 0; d < ndim; d++) {
+	if ((X[d] & ~mask) < mins[d])
+	  mins[d] = X[d] & ~mask;
+	if ((X[d] | mask) > maxs[d])
+	  maxs[d] = X[d] | mask;
+      }
+      a += (uint64_t)1 << (ndim*k);
+    }
+    double ncell = (double)((uint64_t)1 << bits);
+    for (d = 0; d < ndim; d++) {
+      double w = domain_right_edge[d] - domain_left_edge[d];
+      le[d] = domain_left_edge[d] + w*((double)mins[d]/ncell);
+      if (((uint64_t)maxs[d] + 1) == ((uint64_t)1 << bits))
+	re[d] = domain_right_edge[d];
+      else
+	re[d] = domain_left_edge[d] + w*((double)(maxs[d] + 1)/ncell);
+    }
+  }
+
+  uint64_t leaf_npts(uint32_t k) const
+  {
+    return leaf_start[k+1] - leaf_start[k];
+  }
+  double* leaf_left_edge(uint32_t k)
+  {
+    return &leaf_left_edges[k*ndim];
+  }
+  double* leaf_right_edge(uint32_t k)
+  {
+    return &leaf_right_edges[k*ndim];
+  }
+
+};
+
+#endif
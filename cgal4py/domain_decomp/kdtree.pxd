@@ -2,9 +2,13 @@ cimport numpy as np
 from libcpp.vector cimport vector
 from libcpp.pair cimport pair
 from libcpp cimport bool
-from libc.stdint cimport uint32_t, uint64_t, int64_t, int32_t
+from libc.stdint cimport uint8_t, uint32_t, uint64_t, int64_t, int32_t
 
 cdef extern from "c_kdtree.hpp":
+    cdef enum KDTreeSplit:
+        KDTREE_SPLIT_MEDIAN
+        KDTREE_SPLIT_COST
+        KDTREE_SPLIT_SAMPLE
     cdef cppclass Node:
         bool is_leaf
         uint32_t ndim
@@ -16,8 +20,9 @@ cdef extern from "c_kdtree.hpp":
         double split
         Node* less
         Node* greater
-    cdef cppclass KDTree:
-        double* all_pts
+    cdef cppclass KDTree[T]:
+        T* all_pts
+        uint64_t* all_idx
         uint64_t npts
         uint32_t ndim
         uint32_t leafsize
@@ -27,18 +32,123 @@ cdef extern from "c_kdtree.hpp":
         double* domain_maxs
         vector[Node*] leaves
         Node* root
+        uint64_t num_nodes
         # KDTree()
-        KDTree(double *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+        uint32_t nthreads
+        KDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
                double *left_edge, double *right_edge)
+        KDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+               double *left_edge, double *right_edge, uint32_t nthreads0)
+        KDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+               double *left_edge, double *right_edge, uint32_t nthreads0,
+               uint32_t split_policy0, double ghost_weight,
+               double variance_weight)
+        KDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+               double *left_edge, double *right_edge, uint32_t nthreads0,
+               uint32_t split_policy0, double ghost_weight,
+               double variance_weight, uint32_t sample_size0,
+               double sample_tolerance0)
+        uint32_t split_policy
+        uint64_t nbytes()
+        void leaf_costs(double *out)
+        void route(T *pts, uint64_t n, uint32_t *leafids,
+                   uint64_t *order, uint64_t *offsets,
+                   uint32_t nthreads0) nogil
+        void save(const char *filename, uint8_t *periodic,
+                  uint8_t *leaf_periodic, uint64_t *neighbor_offsets,
+                  uint32_t *neighbors) except +
+    cdef cppclass FlatNode:
+        uint64_t left_idx
+        uint64_t children
+        double split
+        uint32_t split_dim
+        uint32_t leafid
+        uint32_t less
+        uint32_t greater
+    cdef cppclass KDTreeFile:
+        uint32_t ndim
+        uint64_t npts
+        uint32_t leafsize
+        uint32_t split_policy
+        uint32_t num_leaves
+        uint8_t* periodic
+        uint64_t* all_idx
+        void* map
+        double* domain_left_edge()
+        double* domain_right_edge()
+        bool periodic_left(uint32_t k, uint32_t d)
+        bool periodic_right(uint32_t k, uint32_t d)
+        uint32_t* left_neighbors_begin(uint32_t k, uint32_t d)
+        uint32_t* left_neighbors_end(uint32_t k, uint32_t d)
+        uint32_t* right_neighbors_begin(uint32_t k, uint32_t d)
+        uint32_t* right_neighbors_end(uint32_t k, uint32_t d)
+        uint32_t* all_neighbors_begin(uint32_t k)
+        uint32_t* all_neighbors_end(uint32_t k)
+    cdef cppclass FlatKDTree[T]:
+        T* all_pts
+        uint64_t* all_idx
+        uint64_t npts
+        uint32_t ndim
+        uint32_t leafsize
+        double* domain_left_edge
+        double* domain_right_edge
+        double* domain_mins
+        double* domain_maxs
+        FlatNode* nodes
+        double* left_edges
+        double* right_edges
+        uint32_t num_nodes
+        vector[uint32_t] leaves
+        uint32_t nthreads
+        FlatKDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+                   double *left_edge, double *right_edge)
+        FlatKDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+                   double *left_edge, double *right_edge, uint32_t nthreads0)
+        FlatKDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+                   double *left_edge, double *right_edge, uint32_t nthreads0,
+                   uint32_t split_policy0, double ghost_weight,
+                   double variance_weight)
+        FlatKDTree(T *pts, uint64_t *idx, uint64_t n, uint32_t m, uint32_t leafsize0,
+                   double *left_edge, double *right_edge, uint32_t nthreads0,
+                   uint32_t split_policy0, double ghost_weight,
+                   double variance_weight, uint32_t sample_size0,
+                   double sample_tolerance0)
+        FlatKDTree(const char *filename, T *pts) except +
+        KDTreeFile* file
+        uint32_t split_policy
+        bool is_leaf(uint32_t i)
+        uint32_t num_leaves()
+        FlatNode* leaf(uint32_t k)
+        double* leaf_left_edge(uint32_t k)
+        double* leaf_right_edge(uint32_t k)
+        uint64_t nbytes()
+        void leaf_costs(double *out)
+        void route(T *pts, uint64_t n, uint32_t *leafids,
+                   uint64_t *order, uint64_t *offsets,
+                   uint32_t nthreads0) nogil
+        void save(const char *filename, uint8_t *periodic,
+                  uint8_t *leaf_periodic, uint64_t *neighbor_offsets,
+                  uint32_t *neighbors) except +
 
 cdef class PyKDTree:
-    cdef uint64_t npts
-    cdef uint32_t ndim
+    cdef readonly uint64_t npts
+    cdef readonly uint32_t ndim
     cdef readonly uint32_t leafsize
-    cdef double* left_edge
-    cdef double* right_edge
-    cdef double* domain_width
-    cdef KDTree* tree
-    cdef bool periodic
+    cdef readonly object left_edge
+    cdef readonly object right_edge
+    cdef readonly object domain_width
+    cdef readonly object idx
+    cdef readonly object layout
+    cdef readonly uint32_t nthreads
+    cdef readonly object split
+    cdef readonly object dtype
+    cdef KDTree[double]* tree
+    cdef FlatKDTree[double]* flat_tree
+    cdef KDTree[float]* tree32
+    cdef FlatKDTree[float]* flat_tree32
+    cdef readonly bool periodic
     cdef readonly object leaves
     cdef readonly int num_leaves
+    cdef readonly double build_time
+    cdef object _pts
+    cdef KDTreeFile* _file(self)
@@ -1,51 +1,675 @@
-from cgal4py.domain_decomp import Leaf
-
 import cython
+import time
 import numpy as np
 cimport numpy as np
-from libc.stdint cimport uint32_t, uint64_t, int32_t, int64_t
+from libcpp cimport bool
+from libc.stdint cimport uint8_t, uint32_t, uint64_t, int32_t, int64_t
+from cgal4py.domain_decomp import GenericLeaf, process_leaves
+
+_layouts = ['pointer', 'flat']
+_splits = {'median': KDTREE_SPLIT_MEDIAN, 'cost': KDTREE_SPLIT_COST,
+           'sample': KDTREE_SPLIT_SAMPLE}
+
+
+def _coord_array(pts):
+    # Single and double precision points are used in place if contiguous;
+    # anything else is converted to double
+    pts = np.asarray(pts)
+    if pts.dtype == np.float32:
+        return np.ascontiguousarray(pts)
+    return np.ascontiguousarray(pts, dtype='float64')
 
-def kdtree(np.ndarray[double, ndim=2] pts,
+
+def kdtree(np.ndarray pts,
            np.ndarray[double, ndim=1] left_edge, 
            np.ndarray[double, ndim=1] right_edge, 
-           int leafsize = 10000):
+           int leafsize = 10000, str layout = 'pointer', int nthreads = 1,
+           str split = 'median', double ghost_weight = 1.0,
+           double variance_weight = 1.0, object tree_file = None,
+           int sample_size = 4096, double sample_tolerance = 0.05):
     r"""Get the leaves in a KDTree constructed for a set of points.
 
     Args:
-        pts (np.ndarray of double): (n,m) array of n coordinates in a 
-            m-dimensional domain.
+        pts (np.ndarray of float or double): (n,m) array of n coordinates in
+            a m-dimensional domain.
         left_edge (np.ndarray of double): (m,) domain minimum in each dimension.
         right_edge (np.ndarray of double): (m,) domain maximum in each dimension.
         leafsize (int, optional): The maximum number of points that should be in 
             a leaf. Defaults to 10000.
+        layout (str, optional): Memory layout used for the tree nodes. See
+            :class:`cgal4py.domain_decomp.kdtree.PyKDTree` for options.
+            Defaults to 'pointer'.
+        nthreads (int, optional): Number of threads used to build the tree.
+            The resulting tree does not depend on the number of threads.
+            Defaults to 1.
+        split (str, optional): Policy used to place splits. See
+            :class:`cgal4py.domain_decomp.kdtree.PyKDTree` for options.
+            Defaults to 'median'.
+        ghost_weight (float, optional): Weight of the ghost layer in the
+            leaf cost model. Only used if `split` is 'cost'. Defaults to 1.
+        variance_weight (float, optional): Weight of the density variance in
+            the leaf cost model. Only used if `split` is 'cost'. Defaults
+            to 1.
+        tree_file (str, optional): Path to a file written by
+            :meth:`cgal4py.domain_decomp.kdtree.PyKDTree.save` for the same
+            points. If provided, the tree is loaded from the file instead of
+            being constructed. Defaults to None.
+        sample_size (int, optional): Number of points sampled to estimate
+            each split. Only used if `split` is 'sample'. Defaults to 4096.
+        sample_tolerance (float, optional): Largest allowed imbalance of a
+            sampled split. Only used if `split` is 'sample'. Defaults to
+            0.05.
         
     Returns:
-        list of :class:`domain_decomp.Leaf`s: Leaves in the KDTree.
+        list of :class:`cgal4py.domain_decomp.GenericLeaf`: Leaves in the
+            KDTree. In addition to the processed leaf attributes, each leaf
+            has an attribute `idx` containing the indices of the points in
+            the leaf.
 
     Raises:
-        ValueError: If `leafsize < 2`. This currectly segfaults.
+        ValueError: If `leafsize < 2`.
+        ValueError: If `layout` is not a supported layout.
+        ValueError: If `split` is not a supported split policy.
 
     """
-    if (leafsize < 2):
-        # This is here to prevent segfault. The cpp code needs modified to 
-        # support leafsize = 1
-        raise ValueError("'leafsize' cannot be smaller than 2.")
-    cdef uint32_t k,i
-    cdef uint64_t npts = <uint64_t>pts.shape[0]
-    cdef uint32_t ndim = <uint32_t>pts.shape[1]
-    cdef np.ndarray[np.uint64_t] idx = np.arange(npts).astype('uint64')
-    cdef KDTree* tree = new KDTree(&pts[0,0], &idx[0], npts, ndim, 
-                                   <uint32_t>leafsize, 
-                                   &left_edge[0], &right_edge[0])
-    cdef object leaves = []
-    cdef np.ndarray[np.float64_t] leaf_left_edge = np.zeros(ndim, 'float64')
-    cdef np.ndarray[np.float64_t] leaf_right_edge = np.zeros(ndim, 'float64')
-    for k in xrange(tree.leaves.size()):
-        leafnode = tree.leaves[k]
-        leaf_idx = idx[leafnode.left_idx:(leafnode.left_idx + leafnode.children)] 
-        assert(len(leaf_idx) == <int>leafnode.children)
-        for i in range(ndim):
-            leaf_left_edge[i] = leafnode.left_edge[i]
-            leaf_right_edge[i] = leafnode.right_edge[i]
-        leaves.append(Leaf(k, leaf_idx, leaf_left_edge, leaf_right_edge))
-    return leaves
+    tree = PyKDTree(pts, left_edge, right_edge, leafsize=leafsize,
+                    layout=layout, nthreads=nthreads, split=split,
+                    ghost_weight=ghost_weight,
+                    variance_weight=variance_weight, tree_file=tree_file,
+                    sample_size=sample_size,
+                    sample_tolerance=sample_tolerance)
+    for leaf in tree.leaves:
+        leaf.idx = tree.idx[leaf.slice]
+    return tree.leaves
+
+
+cdef list _neighbor_list(uint32_t *begin, uint32_t *end):
+    cdef uint32_t *it = begin
+    cdef list out = []
+    while it != end:
+        out.append(it[0])
+        it += 1
+    return out
+
+
+cdef class PyKDTree:
+    r"""Object for constructing a KDTree domain decomposition.
+
+    Args:
+        pts (np.ndarray of float or double): (n,m) array of n coordinates in
+            a m-dimensional domain. Single (float32) and double (float64)
+            precision points are used without being copied if they are C
+            contiguous; other types are converted to double. Node edges and
+            splits are always double, and a tree over single precision
+            points has the same leaves as one over the same points widened
+            to double.
+        left_edge (np.ndarray of double): (m,) domain minimum in each dimension.
+        right_edge (np.ndarray of double): (m,) domain maximum in each dimension.
+        periodic (bool, optional): True if the domain is periodic. Defaults to
+            False.
+        leafsize (int, optional): The maximum number of points that should be in 
+            a leaf. Defaults to 10000.
+        nleaves (int, optional): The number of leaves that should be in the
+            resulting tree. If greater than 0, leafsize is adjusted to produce
+            a tree with 2**(ceil(log2(nleaves))) leaves. Defaults to 0.
+        layout (str, optional): Memory layout used for the tree nodes. Values
+            include:
+                'pointer': Each node is allocated separately and references
+                    its children by pointer.
+                'flat': All nodes are stored in pre-order in one contiguous
+                    block and reference their children by index. Nodes edges
+                    are stored in a single buffer and the tree is freed in
+                    one step.
+            Both layouts produce the same leaves. Defaults to 'pointer'.
+        nthreads (int, optional): Number of threads used to build the tree.
+            Subtrees below the top few levels are handed to a work-stealing
+            pool, while the splits above them are found serially. The
+            resulting tree does not depend on the number of threads.
+            Defaults to 1.
+        split (str, optional): Policy used to place splits. Values include:
+                'median': Each node is split at the median point along its
+                    widest dimension.
+                'cost': Each node is split so that the estimated cost of
+                    triangulating the two children is balanced. The cost of
+                    a leaf is modeled from its number of points, the size
+                    of the ghost layer implied by its surface area, and the
+                    variance of its point density. Point weights are
+                    measured on a median tree and refined over a few
+                    passes, so construction is several times slower.
+                'sample': Each node is split at the median of a random
+                    sample of its points along its widest dimension, so
+                    the points are partitioned once instead of selected.
+                    If a split leaves more than (1 + `sample_tolerance`)/2
+                    of the points on one side, the exact median is used.
+                    Nodes are split to the same depth as 'median', so
+                    there are as many leaves, but leaf sizes vary by a few
+                    percent and may exceed `leafsize`.
+            Defaults to 'median'.
+        ghost_weight (float, optional): Weight of the ghost layer in the
+            leaf cost model. Only used if `split` is 'cost'. Defaults to 1.
+        variance_weight (float, optional): Weight of the density variance in
+            the leaf cost model. Only used if `split` is 'cost'. Defaults
+            to 1.
+        sample_size (int, optional): Number of points sampled to estimate
+            each split. Nodes with fewer than 4 times this many points are
+            split at the exact median. Only used if `split` is 'sample'.
+            Defaults to 4096.
+        sample_tolerance (float, optional): Largest allowed imbalance of a
+            sampled split, as a fraction of half the points in the node.
+            Values are limited to [0, 0.5]. Splits that would leave either
+            child with fewer than leafsize/8 points are taken at the exact
+            median instead. Only used if `split` is 'sample'. Defaults to
+            0.05.
+        tree_file (str, optional): Path to a file written by
+            :meth:`cgal4py.domain_decomp.kdtree.PyKDTree.save` for the same
+            points. If provided, the file is memory mapped and used in
+            place of constructing the tree, so loading takes constant time
+            and pages are only read as they are used. The leafsize, split
+            policy, periodicity, and leaf neighbors are taken from the file,
+            the layout is 'flat', and `idx` is a copy-on-write map of the
+            file. Defaults to None.
+
+    Raises:
+        ValueError: If `leafsize < 2`.
+        ValueError: If `layout` is not a supported layout.
+        ValueError: If `split` is not a supported split policy.
+        ValueError: If `tree_file` was saved for a different number of
+            points, dimensions, or domain.
+        RuntimeError: If `tree_file` cannot be read or is not a valid tree
+            file.
+
+    Attributes:
+        npts (uint64): Number of points in the tree.
+        ndim (uint32): Number of dimensions points occupy.
+        leafsize (uint32): Maximum number of points a leaf can have.
+        left_edge (np.ndarray of double): (m,) domain minimum in each
+            dimension.
+        right_edge (np.ndarray of double): (m,) domain maximum in each
+            dimension.
+        domain_width (np.ndarray of double): (m,) domain width in each
+            dimension.
+        idx (np.ndarray of uint64): (n,) indices sorting the points by the
+            leaf that contains them.
+        layout (str): Memory layout used for the tree nodes.
+        nthreads (uint32): Number of threads used to build the tree.
+        split (str): Policy used to place splits.
+        dtype (str): Type of the point coordinates, 'float32' or 'float64'.
+        periodic (bool): True if the domain is periodic, False otherwise.
+        leaves (list of :class:`cgal4py.domain_decomp.GenericLeaf`):
+            Processed leaves in the tree.
+        num_leaves (int): Number of leaves in the tree.
+        build_time (double): Time in seconds spent constructing the tree.
+
+    """
+
+    def __cinit__(self, np.ndarray pts,
+                  np.ndarray[double, ndim=1] left_edge,
+                  np.ndarray[double, ndim=1] right_edge,
+                  bool periodic = False, int leafsize = 10000,
+                  int nleaves = 0, str layout = 'pointer',
+                  int nthreads = 1, str split = 'median',
+                  double ghost_weight = 1.0, double variance_weight = 1.0,
+                  object tree_file = None, int sample_size = 4096,
+                  double sample_tolerance = 0.05):
+        self.tree = NULL
+        self.flat_tree = NULL
+        self.tree32 = NULL
+        self.flat_tree32 = NULL
+        pts = _coord_array(pts)
+        self.dtype = str(pts.dtype)
+        if tree_file is not None:
+            self._load(pts, left_edge, right_edge, tree_file)
+            return
+        if nleaves > 0:
+            nleaves = <int>(2**np.ceil(np.log2(<float>nleaves)))
+            leafsize = pts.shape[0]//nleaves + 1
+        if (leafsize < 2):
+            # Every leaf must be able to hold at least 2 points
+            raise ValueError("'leafsize' cannot be smaller than 2.")
+        if layout not in _layouts:
+            raise ValueError("'{}' is not a supported layout. ".format(layout) +
+                             "Options are {}.".format(_layouts))
+        if split not in _splits:
+            raise ValueError("'{}' is not a supported split ".format(split) +
+                             "policy. Options are {}.".format(
+                                 list(_splits.keys())))
+        self._pts = pts
+        self.npts = <uint64_t>pts.shape[0]
+        self.ndim = <uint32_t>pts.shape[1]
+        self.leafsize = <uint32_t>leafsize
+        self.left_edge = np.array(left_edge, dtype='float64')
+        self.right_edge = np.array(right_edge, dtype='float64')
+        self.domain_width = self.right_edge - self.left_edge
+        self.periodic = periodic
+        self.layout = layout
+        self.nthreads = <uint32_t>max(nthreads, 1)
+        self.split = split
+        self.idx = np.arange(self.npts).astype('uint64')
+        cdef np.ndarray[np.float64_t] le = self.left_edge
+        cdef np.ndarray[np.float64_t] re = self.right_edge
+        cdef np.ndarray[np.uint64_t] idx = self.idx
+        cdef np.ndarray[np.float64_t, ndim=2] pts64
+        cdef np.ndarray[np.float32_t, ndim=2] pts32
+        cdef double *ptr_pts = NULL
+        cdef float *ptr_pts32 = NULL
+        if self.dtype == 'float32':
+            pts32 = pts
+            ptr_pts32 = &pts32[0,0]
+        else:
+            pts64 = pts
+            ptr_pts = &pts64[0,0]
+        cdef uint64_t *ptr_idx = &idx[0]
+        cdef double *ptr_le = &le[0]
+        cdef double *ptr_re = &re[0]
+        cdef uint64_t n = self.npts
+        cdef uint32_t m = self.ndim
+        cdef uint32_t ls = self.leafsize
+        cdef uint32_t nt = self.nthreads
+        cdef uint32_t sp = <uint32_t>_splits[split]
+        cdef double gw = ghost_weight
+        cdef double vw = variance_weight
+        cdef uint32_t ss = <uint32_t>max(sample_size, 0)
+        cdef double st = sample_tolerance
+        cdef KDTree[double]* tree = NULL
+        cdef FlatKDTree[double]* flat_tree = NULL
+        cdef KDTree[float]* tree32 = NULL
+        cdef FlatKDTree[float]* flat_tree32 = NULL
+        cdef bool flat = (layout == 'flat')
+        t0 = time.time()
+        with nogil:
+            if flat and (ptr_pts32 != NULL):
+                flat_tree32 = new FlatKDTree[float](ptr_pts32, ptr_idx, n, m,
+                                                    ls, ptr_le, ptr_re, nt,
+                                                    sp, gw, vw, ss, st)
+            elif flat:
+                flat_tree = new FlatKDTree[double](ptr_pts, ptr_idx, n, m, ls,
+                                                   ptr_le, ptr_re, nt, sp, gw,
+                                                   vw, ss, st)
+            elif ptr_pts32 != NULL:
+                tree32 = new KDTree[float](ptr_pts32, ptr_idx, n, m, ls,
+                                           ptr_le, ptr_re, nt, sp, gw, vw,
+                                           ss, st)
+            else:
+                tree = new KDTree[double](ptr_pts, ptr_idx, n, m, ls, ptr_le,
+                                          ptr_re, nt, sp, gw, vw, ss, st)
+        self.tree = tree
+        self.flat_tree = flat_tree
+        self.tree32 = tree32
+        self.flat_tree32 = flat_tree32
+        self.build_time = time.time() - t0
+        self._make_leaves()
+
+    def __dealloc__(self):
+        if self.tree != NULL:
+            del self.tree
+        if self.flat_tree != NULL:
+            del self.flat_tree
+        if self.tree32 != NULL:
+            del self.tree32
+        if self.flat_tree32 != NULL:
+            del self.flat_tree32
+
+    cdef KDTreeFile* _file(self):
+        if self.flat_tree != NULL:
+            return self.flat_tree.file
+        if self.flat_tree32 != NULL:
+            return self.flat_tree32.file
+        return NULL
+
+    def _load(self, np.ndarray pts,
+              np.ndarray[double, ndim=1] left_edge,
+              np.ndarray[double, ndim=1] right_edge, str tree_file):
+        cdef bytes py_fname = tree_file.encode()
+        cdef char* c_fname = py_fname
+        cdef np.ndarray[np.float64_t, ndim=2] pts64
+        cdef np.ndarray[np.float32_t, ndim=2] pts32
+        cdef double *ptr_pts = NULL
+        cdef float *ptr_pts32 = NULL
+        if self.dtype == 'float32':
+            pts32 = pts
+            if pts.shape[0] > 0:
+                ptr_pts32 = &pts32[0,0]
+        else:
+            pts64 = pts
+            if pts.shape[0] > 0:
+                ptr_pts = &pts64[0,0]
+        t0 = time.time()
+        if self.dtype == 'float32':
+            self.flat_tree32 = new FlatKDTree[float](c_fname, ptr_pts32)
+        else:
+            self.flat_tree = new FlatKDTree[double](c_fname, ptr_pts)
+        cdef KDTreeFile* f = self._file()
+        cdef uint32_t d
+        cdef np.ndarray[np.float64_t] le = np.empty(f.ndim, 'float64')
+        cdef np.ndarray[np.float64_t] re = np.empty(f.ndim, 'float64')
+        for d in range(f.ndim):
+            le[d] = f.domain_left_edge()[d]
+            re[d] = f.domain_right_edge()[d]
+        if ((f.npts != <uint64_t>pts.shape[0]) or
+                (f.ndim != <uint32_t>pts.shape[1]) or
+                (not np.allclose(le, left_edge)) or
+                (not np.allclose(re, right_edge))):
+            raise ValueError("Tree file {} was not saved for ".format(
+                tree_file) + "these points and domain.")
+        self._pts = pts
+        self.npts = f.npts
+        self.ndim = f.ndim
+        self.leafsize = f.leafsize
+        self.left_edge = le
+        self.right_edge = re
+        self.domain_width = self.right_edge - self.left_edge
+        self.periodic = (f.ndim > 0) and <bool>f.periodic[0]
+        self.layout = 'flat'
+        self.nthreads = 1
+        for k, v in _splits.items():
+            if v == f.split_policy:
+                self.split = k
+        if self.npts > 0:
+            self.idx = np.memmap(tree_file, dtype='uint64', mode='c',
+                                 offset=<char*>f.all_idx - <char*>f.map,
+                                 shape=(self.npts,))
+        else:
+            self.idx = np.empty(0, 'uint64')
+        self.build_time = time.time() - t0
+        self._make_leaves()
+
+    def save(self, str fname):
+        r"""Save the tree and its leaf neighbors to a file that can be passed
+        as `tree_file` to skip construction when the same points are
+        decomposed again.
+
+        Args:
+            fname (str): Full path to the file the tree should be saved to.
+
+        Raises:
+            RuntimeError: If the file cannot be written.
+
+        """
+        cdef uint32_t ndim = self.ndim
+        cdef np.ndarray[np.uint8_t] periodic
+        cdef np.ndarray[np.uint8_t] leaf_periodic
+        cdef np.ndarray[np.uint64_t] offsets
+        cdef np.ndarray[np.uint32_t] neighbors
+        periodic = np.full(ndim, self.periodic, 'uint8')
+        leaf_periodic = np.zeros(2*ndim*max(self.num_leaves, 1), 'uint8')
+        lists = []
+        for k, leaf in enumerate(self.leaves):
+            leaf_periodic[2*ndim*k:(2*ndim*k+ndim)] = leaf.periodic_left
+            leaf_periodic[(2*ndim*k+ndim):2*ndim*(k+1)] = leaf.periodic_right
+            lists += [x for x in leaf.left_neighbors]
+            lists += [x for x in leaf.right_neighbors]
+            lists.append(leaf.neighbors)
+        offsets = np.zeros(len(lists)+1, 'uint64')
+        neighbors = np.zeros(max(sum(len(x) for x in lists), 1), 'uint32')
+        start = 0
+        for i, x in enumerate(lists):
+            neighbors[start:(start+len(x))] = x
+            start += len(x)
+            offsets[i+1] = start
+        cdef bytes py_fname = fname.encode()
+        cdef char* c_fname = py_fname
+        if self.flat_tree != NULL:
+            self.flat_tree.save(c_fname, &periodic[0], &leaf_periodic[0],
+                                &offsets[0], &neighbors[0])
+        elif self.flat_tree32 != NULL:
+            self.flat_tree32.save(c_fname, &periodic[0], &leaf_periodic[0],
+                                  &offsets[0], &neighbors[0])
+        elif self.tree32 != NULL:
+            self.tree32.save(c_fname, &periodic[0], &leaf_periodic[0],
+                             &offsets[0], &neighbors[0])
+        else:
+            self.tree.save(c_fname, &periodic[0], &leaf_periodic[0],
+                           &offsets[0], &neighbors[0])
+
+    def route(self, np.ndarray pts, object nthreads=None):
+        r"""Find the leaf containing each of a set of points and group the
+        points by leaf.
+
+        The points are routed down the tree in one pass on `nthreads`
+        threads and grouped with a counting sort, so routing does not depend
+        on the points being part of the tree. Positions on a split are
+        assigned to the leaf on the left side of the split. If the domain is
+        periodic, points are first wrapped into the domain. Points are
+        converted to `dtype` for the tree, so single precision points are
+        routed as they would be routed during construction.
+
+        Args:
+            pts (np.ndarray of float or double): (n,m) array of n coordinates
+                in the m-dimensional domain of the tree.
+            nthreads (int, optional): Number of threads used to route the
+                points. Defaults to `nthreads` for the tree.
+
+        Returns:
+            tuple: np.ndarray of int64 (n,) leaf id for each point (-1 for
+                points outside the domain), np.ndarray of uint64 (n,)
+                indices sorting the points by leaf, with points in their
+                original order within each leaf, and np.ndarray of uint64
+                (num_leaves+2,) start of each leaf's points in the sorted
+                indices. Points outside the domain are sorted last, between
+                the last two offsets.
+
+        Raises:
+            ValueError: If the points do not have the same number of
+                dimensions as the tree.
+
+        """
+        if pts.shape[1] != self.ndim:
+            raise ValueError("Points have {} dimensions, ".format(
+                pts.shape[1]) + "but the tree has {}.".format(self.ndim))
+        if self.periodic:
+            pts = self.left_edge + np.mod(pts - self.left_edge,
+                                          self.domain_width)
+        pts = np.ascontiguousarray(pts, dtype=self.dtype)
+        cdef uint64_t n = <uint64_t>pts.shape[0]
+        cdef np.ndarray[np.uint32_t] leafids = np.empty(n, 'uint32')
+        cdef np.ndarray[np.uint64_t] order = np.empty(n, 'uint64')
+        cdef np.ndarray[np.uint64_t] offsets = np.zeros(self.num_leaves+2,
+                                                        'uint64')
+        if nthreads is None:
+            nthreads = self.nthreads
+        cdef uint32_t nt = <uint32_t>max(int(nthreads), 1)
+        cdef np.ndarray[np.float64_t, ndim=2] pts64
+        cdef np.ndarray[np.float32_t, ndim=2] pts32
+        cdef double *ptr_pts = NULL
+        cdef float *ptr_pts32 = NULL
+        cdef uint32_t *ptr_leafids = NULL
+        cdef uint64_t *ptr_order = NULL
+        cdef uint64_t *ptr_offsets = &offsets[0]
+        if n > 0:
+            if self.dtype == 'float32':
+                pts32 = pts
+                ptr_pts32 = &pts32[0,0]
+            else:
+                pts64 = pts
+                ptr_pts = &pts64[0,0]
+            ptr_leafids = &leafids[0]
+            ptr_order = &order[0]
+        cdef KDTree[double]* tree = self.tree
+        cdef FlatKDTree[double]* flat_tree = self.flat_tree
+        cdef KDTree[float]* tree32 = self.tree32
+        cdef FlatKDTree[float]* flat_tree32 = self.flat_tree32
+        with nogil:
+            if flat_tree != NULL:
+                flat_tree.route(ptr_pts, n, ptr_leafids, ptr_order,
+                                ptr_offsets, nt)
+            elif flat_tree32 != NULL:
+                flat_tree32.route(ptr_pts32, n, ptr_leafids, ptr_order,
+                                  ptr_offsets, nt)
+            elif tree32 != NULL:
+                tree32.route(ptr_pts32, n, ptr_leafids, ptr_order,
+                             ptr_offsets, nt)
+            else:
+                tree.route(ptr_pts, n, ptr_leafids, ptr_order, ptr_offsets,
+                           nt)
+        out = leafids.astype('int64')
+        out[leafids == 0xFFFFFFFF] = -1
+        return out, order, offsets
+
+    def leaf_of(self, np.ndarray pts, object nthreads=None):
+        r"""Find the leaf containing each of a set of points.
+
+        Args:
+            pts (np.ndarray of float or double): (n,m) array of n coordinates
+                in the m-dimensional domain of the tree.
+            nthreads (int, optional): Number of threads used to route the
+                points. Defaults to `nthreads` for the tree.
+
+        Returns:
+            np.ndarray of int64: (n,) id of the leaf containing each point, or
+                -1 if the point is outside the domain.
+
+        """
+        return self.route(pts, nthreads=nthreads)[0]
+
+    def _make_leaves(self):
+        cdef uint32_t k, d
+        cdef Node* node
+        cdef FlatNode* fnode
+        cdef double* fle
+        cdef double* fre
+        cdef uint64_t start, npts_leaf
+        cdef np.ndarray[np.float64_t] leaf_le
+        cdef np.ndarray[np.float64_t] leaf_re
+        # Nodes and edges do not depend on the coordinate type
+        cdef vector[Node*]* tree_leaves = NULL
+        cdef vector[uint32_t]* flat_leaves = NULL
+        cdef FlatNode* flat_nodes = NULL
+        cdef double* flat_le = NULL
+        cdef double* flat_re = NULL
+        if self.flat_tree != NULL:
+            flat_leaves = &self.flat_tree.leaves
+            flat_nodes = self.flat_tree.nodes
+            flat_le = self.flat_tree.left_edges
+            flat_re = self.flat_tree.right_edges
+        elif self.flat_tree32 != NULL:
+            flat_leaves = &self.flat_tree32.leaves
+            flat_nodes = self.flat_tree32.nodes
+            flat_le = self.flat_tree32.left_edges
+            flat_re = self.flat_tree32.right_edges
+        elif self.tree32 != NULL:
+            tree_leaves = &self.tree32.leaves
+        else:
+            tree_leaves = &self.tree.leaves
+        leaves = []
+        if flat_leaves != NULL:
+            self.num_leaves = <int>flat_leaves.size()
+        else:
+            self.num_leaves = <int>tree_leaves.size()
+        for k in range(<uint32_t>self.num_leaves):
+            leaf_le = np.empty(self.ndim, 'float64')
+            leaf_re = np.empty(self.ndim, 'float64')
+            if flat_leaves != NULL:
+                fnode = flat_nodes + flat_leaves[0][k]
+                fle = flat_le + self.ndim*flat_leaves[0][k]
+                fre = flat_re + self.ndim*flat_leaves[0][k]
+                for d in range(self.ndim):
+                    leaf_le[d] = fle[d]
+                    leaf_re[d] = fre[d]
+                start = fnode.left_idx
+                npts_leaf = fnode.children
+            else:
+                node = tree_leaves[0][k]
+                for d in range(self.ndim):
+                    leaf_le[d] = node.left_edge[d]
+                    leaf_re[d] = node.right_edge[d]
+                start = node.left_idx
+                npts_leaf = node.children
+            leaf = GenericLeaf(npts_leaf, leaf_le, leaf_re)
+            leaf.id = k
+            leaf.start_idx = start
+            leaf.stop_idx = start + npts_leaf
+            leaf.slice = slice(leaf.start_idx, leaf.stop_idx)
+            leaves.append(leaf)
+        if self._file() != NULL:
+            self._load_neighbors(leaves)
+        self.leaves = process_leaves(leaves, self.left_edge, self.right_edge,
+                                     self.periodic)
+
+    def _load_neighbors(self, leaves):
+        # Neighbors saved with the tree stand in for the neighbor search in
+        # process_leaves
+        cdef KDTreeFile* f = self._file()
+        cdef uint32_t k, d
+        for k in range(<uint32_t>len(leaves)):
+            leaf = leaves[k]
+            leaf.periodic_left = np.zeros(self.ndim, 'bool')
+            leaf.periodic_right = np.zeros(self.ndim, 'bool')
+            leaf.left_neighbors = []
+            leaf.right_neighbors = []
+            for d in range(self.ndim):
+                leaf.periodic_left[d] = f.periodic_left(k, d)
+                leaf.periodic_right[d] = f.periodic_right(k, d)
+                leaf.left_neighbors.append(_neighbor_list(
+                    f.left_neighbors_begin(k, d), f.left_neighbors_end(k, d)))
+                leaf.right_neighbors.append(_neighbor_list(
+                    f.right_neighbors_begin(k, d),
+                    f.right_neighbors_end(k, d)))
+            leaf.neighbors = _neighbor_list(f.all_neighbors_begin(k),
+                                            f.all_neighbors_end(k))
+
+    @property
+    def num_nodes(self):
+        r"""uint64: Number of nodes in the tree."""
+        if self.flat_tree != NULL:
+            return self.flat_tree.num_nodes
+        if self.flat_tree32 != NULL:
+            return self.flat_tree32.num_nodes
+        if self.tree32 != NULL:
+            return self.tree32.num_nodes
+        return self.tree.num_nodes
+
+    @property
+    def nbytes(self):
+        r"""uint64: Bytes used to store the tree nodes, excluding the points
+        and indices."""
+        if self.flat_tree != NULL:
+            return self.flat_tree.nbytes()
+        if self.flat_tree32 != NULL:
+            return self.flat_tree32.nbytes()
+        if self.tree32 != NULL:
+            return self.tree32.nbytes()
+        return self.tree.nbytes()
+
+    def build_stats(self):
+        r"""Get statistics on the construction of the tree.
+
+        Returns:
+            dict: Build time in seconds ('time'), number of nodes ('nnodes'),
+                total bytes used by the nodes ('nbytes'), and bytes per node
+                ('bytes_per_node').
+
+        """
+        nnodes = self.num_nodes
+        nbytes = self.nbytes
+        return dict(time=self.build_time, nnodes=nnodes, nbytes=nbytes,
+                    bytes_per_node=float(nbytes)/max(nnodes, 1))
+
+    def leaf_costs(self):
+        r"""Get the estimated cost of triangulating each leaf.
+
+        Returns:
+            np.ndarray of double: (num_leaves,) estimated cost of each leaf
+                under the cost model used by the 'cost' split policy.
+
+        """
+        cdef np.ndarray[np.float64_t] out = np.zeros(self.num_leaves,
+                                                     'float64')
+        if self.num_leaves == 0:
+            return out
+        if self.flat_tree != NULL:
+            self.flat_tree.leaf_costs(&out[0])
+        elif self.flat_tree32 != NULL:
+            self.flat_tree32.leaf_costs(&out[0])
+        elif self.tree32 != NULL:
+            self.tree32.leaf_costs(&out[0])
+        else:
+            self.tree.leaf_costs(&out[0])
+        return out
+
+    @property
+    def cost_imbalance(self):
+        r"""double: Ratio of the maximum to the mean estimated leaf cost."""
+        costs = self.leaf_costs()
+        if costs.size == 0 or costs.mean() == 0:
+            return 1.0
+        return costs.max()/costs.mean()
@@ -0,0 +1,47 @@
+cimport numpy as np
+from libcpp.vector cimport vector
+from libcpp cimport bool
+from libc.stdint cimport uint32_t, uint64_t, int64_t, int32_t
+
+cdef extern from "c_sfc.hpp":
+    cdef enum SFCCurve:
+        SFC_HILBERT
+        SFC_MORTON
+    cdef cppclass SFCTree:
+        double* all_pts
+        uint64_t* all_idx
+        uint64_t npts
+        uint32_t ndim
+        uint32_t curve
+        uint32_t bits
+        uint32_t nthreads
+        double* domain_left_edge
+        double* domain_right_edge
+        vector[uint64_t] keys
+        uint32_t num_leaves
+        vector[uint64_t] leaf_start
+        vector[uint64_t] leaf_key
+        SFCTree(double *pts, uint64_t *idx, uint64_t n, uint32_t m,
+                uint32_t nleaves, double *left_edge, double *right_edge,
+                uint32_t curve0, uint32_t nthreads0, double *weights)
+        uint64_t leaf_npts(uint32_t k)
+        double* leaf_left_edge(uint32_t k)
+        double* leaf_right_edge(uint32_t k)
+
+cdef class PySFCTree:
+    cdef readonly uint64_t npts
+    cdef readonly uint32_t ndim
+    cdef readonly uint32_t leafsize
+    cdef readonly object left_edge
+    cdef readonly object right_edge
+    cdef readonly object domain_width
+    cdef readonly object idx
+    cdef readonly object curve
+    cdef readonly uint32_t bits
+    cdef readonly uint32_t nthreads
+    cdef SFCTree* tree
+    cdef readonly bool periodic
+    cdef readonly object leaves
+    cdef readonly int num_leaves
+    cdef readonly double build_time
+    cdef object _pts
@@ -0,0 +1,213 @@
+import cython
+import time
+import numpy as np
+cimport numpy as np
+from libcpp cimport bool
+from libc.stdint cimport uint32_t, uint64_t, int32_t, int64_t
+from cgal4py.domain_decomp import GenericLeaf, process_leaves
+
+_curves = {'hilbert': SFC_HILBERT, 'morton': SFC_MORTON}
+
+
+def sfc(np.ndarray[double, ndim=2] pts,
+        np.ndarray[double, ndim=1] left_edge,
+        np.ndarray[double, ndim=1] right_edge,
+        int leafsize = 10000, str curve = 'hilbert', int nthreads = 1):
+    r"""Get the leaves in a space filling curve decomposition of a set of
+    points.
+
+    Args:
+        pts (np.ndarray of double): (n,m) array of n coordinates in a
+            m-dimensional domain.
+        left_edge (np.ndarray of double): (m,) domain minimum in each dimension.
+        right_edge (np.ndarray of double): (m,) domain maximum in each dimension.
+        leafsize (int, optional): The average number of points that should be
+            in a leaf. Defaults to 10000.
+        curve (str, optional): Space filling curve used to order the points.
+            See :class:`cgal4py.domain_decomp.sfc.PySFCTree` for options.
+            Defaults to 'hilbert'.
+        nthreads (int, optional): Number of threads used to compute and sort
+            the keys. Defaults to 1.
+
+    Returns:
+        list of :class:`cgal4py.domain_decomp.GenericLeaf`: Leaves in the
+            decomposition. In addition to the processed leaf attributes, each
+            leaf has an attribute `idx` containing the indices of the points
+            in the leaf.
+
+    Raises:
+        ValueError: If `curve` is not a supported curve.
+
+    """
+    tree = PySFCTree(pts, left_edge, right_edge, leafsize=leafsize,
+                     curve=curve, nthreads=nthreads)
+    for leaf in tree.leaves:
+        leaf.idx = tree.idx[leaf.slice]
+    return tree.leaves
+
+
+cdef class PySFCTree:
+    r"""Object for constructing a domain decomposition by cutting a space
+    filling curve through the points into contiguous pieces.
+
+    Points are assigned integer keys along the curve on a regular grid,
+    sorted by key with a parallel radix sort, and the sorted points are cut
+    into leaves with equal total weight. Each leaf owns the stretch of the
+    curve from its first point to the first point of the next leaf, so the
+    leaves cover the domain. A leaf's edges are the bounding box of its
+    stretch of the curve and may overlap the edges of other leaves. Points
+    within each leaf are in curve order.
+
+    Args:
+        pts (np.ndarray of double): (n,m) array of n coordinates in a
+            m-dimensional domain.
+        left_edge (np.ndarray of double): (m,) domain minimum in each dimension.
+        right_edge (np.ndarray of double): (m,) domain maximum in each dimension.
+        periodic (bool, optional): True if the domain is periodic. Defaults to
+            False.
+        leafsize (int, optional): The average number of points that should be
+            in a leaf. Defaults to 10000.
+        nleaves (int, optional): The number of leaves that should be in the
+            resulting decomposition. If greater than 0, `leafsize` is
+            ignored. Defaults to 0.
+        curve (str, optional): Space filling curve used to order the points.
+            Values include:
+                'hilbert': Hilbert curve. Consecutive grid cells are adjacent,
+                    so leaves are compact.
+                'morton': Morton (Z-order) curve. Keys are cheaper to compute,
+                    but leaves are less compact and their edges overlap more.
+            Defaults to 'hilbert'.
+        nthreads (int, optional): Number of threads used to compute and sort
+            the keys. The result does not depend on the number of threads.
+            Defaults to 1.
+        weights (np.ndarray of double, optional): (n,) estimated cost of each
+            point. If provided, leaves are cut to have equal total weight
+            rather than an equal number of points. Defaults to None.
+
+    Raises:
+        ValueError: If `curve` is not a supported curve.
+        ValueError: If `weights` does not have one entry for each point.
+
+    Attributes:
+        npts (uint64): Number of points in the decomposition.
+        ndim (uint32): Number of dimensions points occupy.
+        leafsize (uint32): Average number of points in a leaf.
+        left_edge (np.ndarray of double): (m,) domain minimum in each
+            dimension.
+        right_edge (np.ndarray of double): (m,) domain maximum in each
+            dimension.
+        domain_width (np.ndarray of double): (m,) domain width in each
+            dimension.
+        idx (np.ndarray of uint64): (n,) indices sorting the points along the
+            curve.
+        curve (str): Space filling curve used to order the points.
+        bits (uint32): Number of bits per dimension in the grid the curve is
+            traced over.
+        nthreads (uint32): Number of threads used to compute and sort keys.
+        periodic (bool): True if the domain is periodic, False otherwise.
+        leaves (list of :class:`cgal4py.domain_decomp.GenericLeaf`):
+            Processed leaves in the decomposition.
+        num_leaves (int): Number of leaves in the decomposition.
+        build_time (double): Time in seconds spent constructing the
+            decomposition.
+
+    """
+
+    def __cinit__(self, np.ndarray[double, ndim=2] pts,
+                  np.ndarray[double, ndim=1] left_edge,
+                  np.ndarray[double, ndim=1] right_edge,
+                  bool periodic = False, int leafsize = 10000,
+                  int nleaves = 0, str curve = 'hilbert', int nthreads = 1,
+                  object weights = None):
+        self.tree = NULL
+        if curve not in _curves:
+            raise ValueError("'{}' is not a supported curve. ".format(curve) +
+                             "Options are {}.".format(list(_curves.keys())))
+        if nleaves <= 0:
+            nleaves = max(1, <int>np.ceil(
+                float(pts.shape[0])/max(leafsize, 1)))
+        self._pts = pts
+        self.npts = <uint64_t>pts.shape[0]
+        self.ndim = <uint32_t>pts.shape[1]
+        self.leafsize = <uint32_t>max(1, <int>np.ceil(
+            float(self.npts)/nleaves))
+        self.left_edge = np.array(left_edge, dtype='float64')
+        self.right_edge = np.array(right_edge, dtype='float64')
+        self.domain_width = self.right_edge - self.left_edge
+        self.periodic = periodic
+        self.curve = curve
+        self.nthreads = <uint32_t>max(nthreads, 1)
+        self.idx = np.arange(self.npts).astype('uint64')
+        cdef np.ndarray[np.float64_t] w
+        cdef double *ptr_w = NULL
+        if weights is not None:
+            w = np.ascontiguousarray(weights, dtype='float64')
+            if w.shape[0] != self.npts:
+                raise ValueError("'weights' has {} entries, ".format(
+                    w.shape[0]) + "but there are {} points.".format(
+                        self.npts))
+            if self.npts > 0:
+                ptr_w = &w[0]
+        cdef np.ndarray[np.float64_t] le = self.left_edge
+        cdef np.ndarray[np.float64_t] re = self.right_edge
+        cdef np.ndarray[np.uint64_t] idx = self.idx
+        cdef double *ptr_pts = NULL
+        cdef uint64_t *ptr_idx = NULL
+        if self.npts > 0:
+            ptr_pts = &pts[0,0]
+            ptr_idx = &idx[0]
+        cdef double *ptr_le = &le[0]
+        cdef double *ptr_re = &re[0]
+        cdef uint64_t n = self.npts
+        cdef uint32_t m = self.ndim
+        cdef uint32_t nl = <uint32_t>nleaves
+        cdef uint32_t c = <uint32_t>_curves[curve]
+        cdef uint32_t nt = self.nthreads
+        cdef SFCTree* tree = NULL
+        t0 = time.time()
+        with nogil:
+            tree = new SFCTree(ptr_pts, ptr_idx, n, m, nl, ptr_le, ptr_re,
+                               c, nt, ptr_w)
+        self.tree = tree
+        self.bits = tree.bits
+        self.build_time = time.time() - t0
+        self._make_leaves()
+
+    def __dealloc__(self):
+        if self.tree != NULL:
+            del self.tree
+
+    def _make_leaves(self):
+        cdef uint32_t k, d
+        cdef double* cle
+        cdef double* cre
+        cdef np.ndarray[np.float64_t] leaf_le
+        cdef np.ndarray[np.float64_t] leaf_re
+        leaves = []
+        self.num_leaves = <int>self.tree.num_leaves
+        for k in range(self.tree.num_leaves):
+            leaf_le = np.empty(self.ndim, 'float64')
+            leaf_re = np.empty(self.ndim, 'float64')
+            cle = self.tree.leaf_left_edge(k)
+            cre = self.tree.leaf_right_edge(k)
+            for d in range(self.ndim):
+                leaf_le[d] = cle[d]
+                leaf_re[d] = cre[d]
+            leaf = GenericLeaf(self.tree.leaf_npts(k), leaf_le, leaf_re)
+            leaf.id = k
+            leaf.start_idx = self.tree.leaf_start[k]
+            leaf.stop_idx = self.tree.leaf_start[k+1]
+            leaf.slice = slice(leaf.start_idx, leaf.stop_idx)
+            leaves.append(leaf)
+        self.leaves = process_leaves(leaves, self.left_edge, self.right_edge,
+                                     self.periodic)
+
+    @property
+    def keys(self):
+        r"""np.ndarray of uint64: (n,) sorted curve keys of the points in the
+        order given by `idx`."""
+        cdef np.ndarray[np.uint64_t] out = np.empty(self.npts, 'uint64')
+        cdef uint64_t i
+        for i in range(self.npts):
+            out[i] = self.tree.keys[i]
+        return out
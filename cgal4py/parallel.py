@@ -97,7 +97,8 @@ def _final_leaf_tess_filename(leaf_id, unique_str=None):
 def write_mpi_script(fname, read_func, taskname, unique_str=None,
                      use_double=False, use_python=False, use_buffer=False,
                      overwrite=False, profile=False, limit_mem=False,
-                     suppress_final_output=False):
+                     suppress_final_output=False, reorder_pts=False,
+                     tree_file=None, rebalance=0.0):
     r"""Write an MPI script for calling MPI parallelized triangulation.
 
     Args:
@@ -124,6 +125,10 @@ def write_mpi_script(fname, read_func, taskname, unique_str=None,
             points is <=4294967295. Defaults to False.
         use_python (bool, optional): If True, communications are done in python
             using mpi4py. Otherwise, communications are done in C++ using MPI.
+            In that case the domain is always decomposed by a median split
+            KD tree built in C++, so any 'tree' returned by `read_func`, the
+            'hilbert' and 'morton' decompositions, and the `split` policies
+            of :class:`cgal4py.domain_decomp.kdtree.PyKDTree` are not used.
             Defaults to False.
         use_buffer (bool, optional): If True, communications are done by way of
             buffers rather than pickling python objects. Defaults to False.
@@ -141,6 +146,21 @@ def write_mpi_script(fname, read_func, taskname, unique_str=None,
         suppress_final_output (bool, optional): If True, output of the result
             to file is suppressed. This is mainly for testing purposes.
             Defaults to False.
+        reorder_pts (bool, optional): If True and communications are done
+            in C++, the points are permuted into leaf order after the domain
+            decomposition so that leaves on the root process share memory
+            with the points rather than copying them. The original order is
+            restored before results are returned. Defaults to False.
+        tree_file (str, optional): Path to a file containing a KD tree saved
+            for the same points and domain. If communications are done in
+            C++ and the file exists, the tree is memory mapped from it rather
+            than built. Otherwise the tree that is built is saved to it so
+            later runs on the same points can skip construction. Defaults to
+            None.
+        rebalance (float, optional): If greater than 0 and communications
+            are done in C++, leaves assigned more than this many times the
+            mean number of points per leaf are split after each insertion.
+            Defaults to 0.
 
     """
     if not mpi_loaded:
@@ -177,6 +197,9 @@ def write_mpi_script(fname, read_func, taskname, unique_str=None,
         "use_python = {}".format(use_python),
         "use_buffer = {}".format(use_buffer),
         "suppress_final_output = {}".format(suppress_final_output),
+        "reorder_pts = {}".format(reorder_pts),
+        "tree_file = {}".format(repr(tree_file)),
+        "rebalance = {}".format(rebalance),
         ""]
     # Commands to read in data
     lines += [
@@ -211,7 +234,8 @@ def write_mpi_script(fname, read_func, taskname, unique_str=None,
         "    pts, tree, left_edge=left_edge, right_edge=right_edge,",
         "    periodic=periodic, use_double=use_double, unique_str=unique_str,",
         "    limit_mem=limit_mem, use_python=use_python,",
-        "    use_buffer=use_buffer,",
+        "    use_buffer=use_buffer, reorder_pts=reorder_pts,",
+        "    tree_file=tree_file, rebalance=rebalance,",
         "    suppress_final_output=suppress_final_output)",
         "p.run()"]
     if profile:
@@ -236,7 +260,11 @@ def ParallelDelaunay(pts, tree, nproc, use_mpi=True, **kwargs):
         pts (np.ndarray of float64): (n,m) array of n m-dimensional
             coordinates.
         tree (object): Domain decomposition tree for splitting points among the
-            processes. Produced by :meth:`cgal4py.domain_decomp.tree`.
+            processes. Produced by :meth:`cgal4py.domain_decomp.tree`. This
+            is not used if `use_mpi` is True and `use_python` is False, in
+            which case the points are decomposed by a KD tree built in C++
+            whatever the method used to create `tree` (e.g. 'hilbert' or
+            'morton').
         nproc (int): Number of processors that should be used.
         use_mpi (bool, optional): If True, `mpi4py` is used for communications.
             Otherwise `multiprocessing` is used. Defaults to True.
@@ -288,7 +316,11 @@ def ParallelVoronoiVolumes(pts, tree, nproc, use_mpi=True, **kwargs):
         pts (np.ndarray of float64): (n,m) array of n m-dimensional
             coordinates.
         tree (object): Domain decomposition tree for splitting points among the
-            processes. Produced by :meth:`cgal4py.domain_decomp.tree`.
+            processes. Produced by :meth:`cgal4py.domain_decomp.tree`. This
+            is not used if `use_mpi` is True and `use_python` is False, in
+            which case the points are decomposed by a KD tree built in C++
+            whatever the method used to create `tree` (e.g. 'hilbert' or
+            'morton').
         nproc (int): Number of processors that should be used.
         use_mpi (bool, optional): If True, `mpi4py` is used for communications.
             Otherwise `multiprocessing` is used. Defaults to True.
@@ -360,7 +392,8 @@ def ParallelVoronoiVolumesMPI(*args, **kwargs):
 
 def ParallelMPI(task, read_func, ndim, nproc, use_double=False,
                 limit_mem=False, use_python=False, use_buffer=False,
-                profile=False, suppress_final_output=False):
+                profile=False, suppress_final_output=False, reorder_pts=False,
+                tree_file=None, rebalance=0.0):
     r"""Return results form a triangulation that is constructed in parallel
     using MPI.
 
@@ -396,6 +429,10 @@ def ParallelMPI(task, read_func, ndim, nproc, use_double=False,
             Defaults to False.
         use_python (bool, optional): If True, communications are done in python
             using mpi4py. Otherwise, communications are done in C++ using MPI.
+            In that case the domain is always decomposed by a median split
+            KD tree built in C++, so any 'tree' returned by `read_func`, the
+            'hilbert' and 'morton' decompositions, and the `split` policies
+            of :class:`cgal4py.domain_decomp.kdtree.PyKDTree` are not used.
             Defaults to False.
         use_buffer (bool, optional): If True, communications are done by way of
             buffers rather than pickling python objects. Defaults to False.
@@ -406,6 +443,21 @@ def ParallelMPI(task, read_func, ndim, nproc, use_double=False,
         suppress_final_output (bool, optional): If True, output of the result
             to file is suppressed. This is mainly for testing purposes.
             Defaults to False.
+        reorder_pts (bool, optional): If True and communications are done
+            in C++, the points are permuted into leaf order after the domain
+            decomposition so that leaves on the root process share memory
+            with the points rather than copying them. The original order is
+            restored before results are returned. Defaults to False.
+        tree_file (str, optional): Path to a file containing a KD tree saved
+            for the same points and domain. If communications are done in
+            C++ and the file exists, the tree is memory mapped from it rather
+            than built. Otherwise the tree that is built is saved to it so
+            later runs on the same points can skip construction. Defaults to
+            None.
+        rebalance (float, optional): If greater than 0 and communications
+            are done in C++, leaves assigned more than this many times the
+            mean number of points per leaf are split after each insertion.
+            Defaults to 0.
 
     Returns:
         Dependent on task. For 'triangulate', a Delaunay triangulation class
@@ -427,7 +479,8 @@ def ParallelMPI(task, read_func, ndim, nproc, use_double=False,
     write_mpi_script(fscript, read_func, task, limit_mem=limit_mem,
                      unique_str=unique_str, use_double=use_double,
                      use_python=use_python, use_buffer=use_buffer,
-                     profile=profile,
+                     profile=profile, reorder_pts=reorder_pts,
+                     tree_file=tree_file, rebalance=rebalance,
                      suppress_final_output=suppress_final_output)
     cmd = 'mpiexec -np {} python {}'.format(nproc, fscript)
     os.system(cmd)
@@ -679,7 +732,8 @@ def DelaunayProcessMPI(taskname, pts, tree=None,
                        left_edge=None, right_edge=None,
                        periodic=False, unique_str=None, use_double=False,
                        use_python=False, use_buffer=False, limit_mem=False,
-                       suppress_final_output=False):
+                       suppress_final_output=False, reorder_pts=False,
+                       tree_file=None, rebalance=0.0):
     r"""Get object for coordinating MPI operations.
 
     Args:
@@ -707,14 +761,20 @@ def DelaunayProcessMPI(taskname, pts, tree=None,
             taskname, pts, left_edge=left_edge,
             right_edge=right_edge, periodic=periodic, unique_str=unique_str,
             use_double=use_double, limit_mem=limit_mem,
-            suppress_final_output=suppress_final_output)
+            suppress_final_output=suppress_final_output,
+            reorder_pts=reorder_pts, tree_file=tree_file,
+            rebalance=rebalance)
     return out
 
 
 class DelaunayProcessMPI_C(object):
     r"""Class for coordinating MPI operations in C. This serves as a wrapper
     for :class:`cagl4py.delaunay.ParallelDelaunayD` to function the same as
-    :class:`cgal4py.parallel.DelaunayProcessMPI_Python`.
+    :class:`cgal4py.parallel.DelaunayProcessMPI_Python`. The domain is
+    decomposed in C++ by a median split KD tree (or the tree loaded from
+    `tree_file`), so neither the 'hilbert' and 'morton' decompositions
+    nor the `split` policies of
+    :class:`cgal4py.domain_decomp.kdtree.PyKDTree` are used.
 
     Args:
         taskname (str): Key for the task that should be parallelized. 
@@ -724,7 +784,14 @@ class DelaunayProcessMPI_C(object):
               the output queue.
             * 'volumes': Perform triangulation and put volumes in output queue.
 
-        pts (np.ndarray of float64): Array of coordinates to triangulate.
+        pts (np.ndarray of float64 or float32): Array of coordinates to
+            triangulate. Single precision points are sent between
+            processes without being converted to double, which halves the
+            size of those messages and of the buffers they are received
+            into. Peak memory on the root process is not reduced, since a
+            double precision copy of all the points is made there for the
+            domain decomposition, and each process still widens its points
+            to double for the triangulation.
         left_edge (np.ndarray of float64, optional): Array of domain mins in
             each dimension. If not provided, they are determined from the
             points. Defaults to None.
@@ -746,6 +813,18 @@ class DelaunayProcessMPI_C(object):
         suppress_final_output (bool, optional): If True, output of the result
             to file is suppressed. This is mainly for testing purposes.
             Defaults to False.
+        reorder_pts (bool, optional): If True, the points are permuted
+            into leaf order after the domain decomposition so that leaves
+            on the root process share memory with the points rather than
+            copying them. The original order is restored before results
+            are returned. Defaults to False.
+        tree_file (str, optional): Path to a file containing a KD tree saved
+            for the same points and domain. If the file exists, the tree is
+            memory mapped from it rather than built. Otherwise the tree that
+            is built is saved to it. Defaults to None.
+        rebalance (float, optional): If greater than 0, leaves assigned
+            more than this many times the mean number of points per leaf
+            are split after each insertion. Defaults to 0.
 
     Raises:
         ValueError: if `task` is not one of the accepted values listed above.
@@ -753,7 +832,8 @@ class DelaunayProcessMPI_C(object):
     """
     def __init__(self, taskname, pts, left_edge=None, right_edge=None,
                  periodic=False, unique_str=None, use_double=False,
-                 limit_mem=False, suppress_final_output=False):
+                 limit_mem=False, suppress_final_output=False,
+                 reorder_pts=False, tree_file=None, rebalance=0.0):
         if not mpi_loaded:
             raise Exception("mpi4py could not be imported.")
         task_list = ['triangulate', 'volumes']
@@ -763,16 +843,22 @@ class DelaunayProcessMPI_C(object):
         size = comm.Get_size()
         rank = comm.Get_rank()
         ndim = None
+        dtype = None
         if rank == 0:
             ndim = pts.shape[1]
+            dtype = 'float32' if pts.dtype == np.float32 else 'float64'
             if left_edge is None:
                 left_edge = pts.min(axis=0)
             if right_edge is None:
                 right_edge = pts.max(axis=0)
-        ndim = comm.bcast(ndim, root=0)
+            left_edge = np.asarray(left_edge, 'float64')
+            right_edge = np.asarray(right_edge, 'float64')
+        ndim, dtype = comm.bcast((ndim, dtype), root=0)
         Delaunay = _get_Delaunay(ndim, parallel=True, bit64=use_double)
         self.PT = Delaunay(left_edge, right_edge, periodic=periodic,
-                           limit_mem=limit_mem)
+                           limit_mem=limit_mem, reorder=reorder_pts,
+                           tree_file=tree_file, dtype=dtype,
+                           rebalance=rebalance)
         self.size = size
         self.rank = rank
         self.comm = comm
@@ -796,8 +882,10 @@ class DelaunayProcessMPI_C(object):
             if (self.rank == 0):
                 if not self.suppress_final_output:
                     ftess = self.output_filename()
+                    # The triangulation is read back in double precision
                     with open(ftess, 'wb') as fd:
-                         T.serialize_to_buffer(fd, pts)
+                         T.serialize_to_buffer(
+                             fd, np.asarray(self.pts, 'float64'))
         elif self.taskname == 'volumes':
             vols = self.PT.consolidate_vols()
             if (self.rank == 0):
@@ -1658,7 +1746,8 @@ class ParallelLeaf(object):
         all_neighbors (set): Indices of all leaves that have been considered
             during particle exchanges.
         neighbors (list): Neighboring leaves that will be considered during the
-            next particle exchange.
+            next particle exchange. A leaf that borders this one both
+            directly and across a periodic boundary is listed twice.
         left_neighbors (list): Neighboring leaves to the left of this leaf in
             each dimension.
         right_neighbors (list): Neighboring leaves to the right of this leaf in
@@ -1711,8 +1800,27 @@ class ParallelLeaf(object):
                 for k in leaf.right_neighbors[i]:
                     le[k, i] += self.domain_width[i]
                     re[k, i] += self.domain_width[i]
-        self.left_edges = le[self.neighbors, :]
-        self.right_edges = re[self.neighbors, :]
+        # A neighbor across a periodic boundary can also border this leaf
+        # directly (e.g. overlapping space filling curve leaves), in which
+        # case it is listed once for each image
+        neighbors = []
+        left_edges_img = []
+        right_edges_img = []
+        for k in self.neighbors:
+            neighbors.append(k)
+            left_edges_img.append(le[k, :])
+            right_edges_img.append(re[k, :])
+            if ((k != leaf.id) and np.any(le[k, :] != left_edges[k, :]) and
+                    np.all(left_edges[k, :] <= leaf.right_edge) and
+                    np.all(right_edges[k, :] >= leaf.left_edge)):
+                neighbors.append(k)
+                left_edges_img.append(left_edges[k, :])
+                right_edges_img.append(right_edges[k, :])
+        self.neighbors = neighbors
+        self.left_edges = np.array(left_edges_img,
+                                   'float64').reshape(-1, self.ndim)
+        self.right_edges = np.array(right_edges_img,
+                                    'float64').reshape(-1, self.ndim)
         self.unique_str = unique_str
         self.limit_mem = limit_mem
 
@@ -1825,10 +1933,17 @@ class ParallelLeaf(object):
         for i in range(len(n)):
             ridx = (idx_enq[i] < self.norig)
             idx_enq[i] = idx_enq[i][ridx]
+        # Combine images of the same neighbor
+        iloc = [None for k in range(self.num_leaves)]
+        for i, k in enumerate(n):
+            if iloc[k] is None:
+                iloc[k] = idx_enq[i]
+            else:
+                iloc[k] = np.union1d(iloc[k], idx_enq[i])
         # Translate and add entries for non-neighbors
         hvall = [None for k in range(self.num_leaves)]
-        for i, k in enumerate(n):
-            hvall[k] = self.idx[idx_enq[i]]
+        for k in set(n):
+            hvall[k] = self.idx[iloc[k]]
         # Reset neighbors for incoming
         self.all_neighbors.update(self.neighbors)
         self.neighbors = []
@@ -1837,8 +1952,8 @@ class ParallelLeaf(object):
         # Return correct structure
         if return_pts:
             ptall = [None for k in range(self.num_leaves)]
-            for i, k in enumerate(n):
-                ptall[k] = self.pts[idx_enq[i]]
+            for k in set(n):
+                ptall[k] = self.pts[iloc[k]]
             out = (hvall, n, le, re, ptall)
         else:
             out = (hvall, n, le, re)
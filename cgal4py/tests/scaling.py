@@ -261,3 +261,258 @@ def weak_scaling(func, npart=1e4, nrep=1, periodic=False, use_mpi=False,
     axs.legend()
     fig.savefig(fname_plot)
     print('    '+fname_plot)
+
+
+def kdtree_layouts(npart=1e6, ndim=3, leafsize=10, nrep=1):
+    r"""Compare construction time and memory use for the KDTree node layouts.
+
+    Args:
+        npart (int, optional): Number of particles. Defaults to 1e6.
+        ndim (int, optional): Number of dimensions. Defaults to 3.
+        leafsize (int, optional): Maximum number of particles in a leaf.
+            Defaults to 10.
+        nrep (int, optional): Number of times each tree should be built to
+            get an average. Defaults to 1.
+
+    Returns:
+        dict: Build statistics for each layout. See
+            :meth:`cgal4py.domain_decomp.kdtree.PyKDTree.build_stats`.
+
+    """
+    from cgal4py.domain_decomp import kdtree
+    npart = int(npart)
+    pts = np.random.rand(npart, ndim).astype('float64')
+    left_edge = np.zeros(ndim, 'float64')
+    right_edge = np.ones(ndim, 'float64')
+    out = {}
+    for layout in kdtree._layouts:
+        times = np.empty(nrep, 'float')
+        for i in range(nrep):
+            tree = kdtree.PyKDTree(pts, left_edge, right_edge,
+                                   leafsize=leafsize, layout=layout)
+            times[i] = tree.build_time
+        out[layout] = tree.build_stats()
+        out[layout]['time'] = np.mean(times)
+        print("{:8s}: {:10.4f} s, {:10d} nodes, {:8.1f} bytes/node".format(
+            layout, out[layout]['time'], out[layout]['nnodes'],
+            out[layout]['bytes_per_node']))
+    return out
+
+
+def kdtree_strong_scaling(npart=1e7, ndim=3, leafsize=100, layout='flat',
+                          nrep=1, nthreads_list=[1, 2, 4, 8, 16, 32, 64]):
+    r"""Plot the scaling of KDTree construction with the number of threads.
+    No reference timings are kept with this routine; the speedup depends on
+    the machine and is limited by the serial median selection for the top
+    levels of the tree. Thread counts above the number of cores available
+    only measure the overhead of oversubscription.
+
+    Args:
+        npart (int, optional): Number of particles. Defaults to 1e7.
+        ndim (int, optional): Number of dimensions. Defaults to 3.
+        leafsize (int, optional): Maximum number of particles in a leaf.
+            Defaults to 100.
+        layout (str, optional): KDTree node layout. Defaults to 'flat'.
+        nrep (int, optional): Number of times each tree should be built to
+            get an average. Defaults to 1.
+        nthreads_list (list, optional): Numbers of threads that should be
+            tested. Defaults to [1, 2, 4, 8, 16, 32, 64].
+
+    """
+    from cgal4py.domain_decomp import kdtree
+    npart = int(npart)
+    fname_plot = 'plot_strong_scaling_kdtree_{}_nthreads_{}part_{}dim.png'.format(
+        layout, npart, ndim)
+    pts = np.random.rand(npart, ndim).astype('float64')
+    left_edge = np.zeros(ndim, 'float64')
+    right_edge = np.ones(ndim, 'float64')
+    times = np.empty((len(nthreads_list), 2), 'float')
+    for j, nthreads in enumerate(nthreads_list):
+        itimes = np.empty(nrep, 'float')
+        for i in range(nrep):
+            tree = kdtree.PyKDTree(pts, left_edge, right_edge,
+                                   leafsize=leafsize, layout=layout,
+                                   nthreads=nthreads)
+            itimes[i] = tree.build_time
+        times[j, 0], times[j, 1] = np.mean(itimes), np.std(itimes)
+        print("{:3d} threads: {:10.4f} s (speedup {:6.2f})".format(
+            nthreads, times[j, 0], times[0, 0]/times[j, 0]))
+    fig, axs = plt.subplots(1, 1)
+    axs.errorbar(nthreads_list, times[:, 0], yerr=times[:, 1], fmt='b',
+                 label='ndim = {}'.format(ndim))
+    axs.set_xscale('log')
+    axs.set_xlabel("# of Threads")
+    axs.set_ylabel("Time (s)")
+    axs.legend()
+    fig.savefig(fname_plot)
+    print('    '+fname_plot)
+    return times
+
+
+def kdtree_cost_imbalance(npart=1e6, ndim=3, leafsize=1000, layout='flat',
+                          nclusters=4, width=0.03, frac_uniform=0.3):
+    r"""Compare the estimated leaf cost imbalance for the KDTree split
+    policies on a clustered point distribution.
+
+    Args:
+        npart (int, optional): Number of particles. Defaults to 1e6.
+        ndim (int, optional): Number of dimensions. Defaults to 3.
+        leafsize (int, optional): Maximum number of particles in a leaf.
+            Defaults to 1000.
+        layout (str, optional): KDTree node layout. Defaults to 'flat'.
+        nclusters (int, optional): Number of Gaussian clusters. Defaults
+            to 4.
+        width (float, optional): Standard deviation of each cluster.
+            Defaults to 0.03.
+        frac_uniform (float, optional): Fraction of particles distributed
+            uniformly in the domain rather than in clusters. Defaults to 0.3.
+
+    Returns:
+        dict: Ratio of the maximum to mean estimated leaf cost and the
+            build time for each split policy.
+
+    """
+    from cgal4py.domain_decomp import kdtree
+    npart = int(npart)
+    nuni = int(frac_uniform*npart)
+    centers = np.random.rand(nclusters, ndim)
+    which = np.random.randint(0, nclusters, npart - nuni)
+    pts = np.vstack([np.random.rand(nuni, ndim),
+                     centers[which, :] +
+                     width*np.random.randn(npart - nuni, ndim)])
+    pts = np.clip(pts, 0.0, 1.0).astype('float64')
+    left_edge = np.zeros(ndim, 'float64')
+    right_edge = np.ones(ndim, 'float64')
+    out = {}
+    for split in kdtree._splits:
+        tree = kdtree.PyKDTree(pts, left_edge, right_edge,
+                               leafsize=leafsize, layout=layout, split=split)
+        out[split] = dict(imbalance=tree.cost_imbalance,
+                          time=tree.build_time)
+        print("{:8s}: max/mean cost {:8.3f}, {:10.4f} s, {:6d} leaves".format(
+            split, out[split]['imbalance'], out[split]['time'],
+            tree.num_leaves))
+    return out
+
+
+def kdtree_sampled_splits(npart=1e7, ndim=3, leafsize=1000, layout='flat',
+                          nthreads=1, sample_sizes=[1024, 4096, 16384],
+                          sample_tolerance=0.05, nrep=1):
+    r"""Compare construction time and leaf size variation for KDTree splits
+    at the exact median and at the median of a random sample.
+
+    Args:
+        npart (int, optional): Number of particles. Defaults to 1e7.
+        ndim (int, optional): Number of dimensions. Defaults to 3.
+        leafsize (int, optional): Maximum number of particles in a leaf for
+            the exact median split. Defaults to 1000.
+        layout (str, optional): KDTree node layout. Defaults to 'flat'.
+        nthreads (int, optional): Number of threads used to build each
+            tree. Defaults to 1.
+        sample_sizes (list, optional): Sample sizes that should be tested.
+            Defaults to [1024, 4096, 16384].
+        sample_tolerance (float, optional): Largest allowed imbalance of a
+            sampled split. Defaults to 0.05.
+        nrep (int, optional): Number of times each tree should be built to
+            get an average. Defaults to 1.
+
+    Returns:
+        dict: Build time, number of leaves, and ratio of the standard
+            deviation to the mean of the leaf sizes for the exact median and
+            each sample size.
+
+    """
+    from cgal4py.domain_decomp import kdtree
+    npart = int(npart)
+    pts = np.random.rand(npart, ndim).astype('float64')
+    left_edge = np.zeros(ndim, 'float64')
+    right_edge = np.ones(ndim, 'float64')
+    runs = [('median', dict(split='median'))]
+    for sample_size in sample_sizes:
+        runs.append(('sample{}'.format(sample_size),
+                     dict(split='sample', sample_size=sample_size,
+                          sample_tolerance=sample_tolerance)))
+    out = {}
+    for name, kwargs in runs:
+        times = np.empty(nrep, 'float')
+        for i in range(nrep):
+            tree = kdtree.PyKDTree(pts, left_edge, right_edge,
+                                   leafsize=leafsize, layout=layout,
+                                   nthreads=nthreads, **kwargs)
+            times[i] = tree.build_time
+        sizes = np.array([leaf.npts for leaf in tree.leaves], 'float')
+        out[name] = dict(time=np.mean(times), nleaves=tree.num_leaves,
+                         size_variation=np.std(sizes)/np.mean(sizes),
+                         max_size=int(sizes.max()))
+        print("{:12s}: {:10.4f} s, {:6d} leaves, ".format(
+            name, out[name]['time'], out[name]['nleaves']) +
+            "std/mean size {:8.4f}, max size {:8d}".format(
+                out[name]['size_variation'], out[name]['max_size']))
+    return out
+
+
+def decomposition_methods(npart=1e6, ndim=3, leafsize=1000, nthreads=1):
+    r"""Compare construction time for the domain decomposition methods.
+
+    Args:
+        npart (int, optional): Number of particles. Defaults to 1e6.
+        ndim (int, optional): Number of dimensions. Defaults to 3.
+        leafsize (int, optional): Maximum (KDTree) or average (space filling
+            curves) number of particles in a leaf. Defaults to 1000.
+        nthreads (int, optional): Number of threads used to build each
+            decomposition. Defaults to 1.
+
+    Returns:
+        dict: Build time and number of leaves for each method.
+
+    """
+    from cgal4py.domain_decomp import kdtree, sfc
+    npart = int(npart)
+    pts = np.random.rand(npart, ndim).astype('float64')
+    left_edge = np.zeros(ndim, 'float64')
+    right_edge = np.ones(ndim, 'float64')
+    out = {}
+    tree = kdtree.PyKDTree(pts, left_edge, right_edge, leafsize=leafsize,
+                           layout='flat', nthreads=nthreads)
+    out['kdtree'] = dict(time=tree.build_time, nleaves=tree.num_leaves)
+    for curve in sfc._curves:
+        tree = sfc.PySFCTree(pts, left_edge, right_edge,
+                             nleaves=out['kdtree']['nleaves'], curve=curve,
+                             nthreads=nthreads)
+        out[curve] = dict(time=tree.build_time, nleaves=tree.num_leaves)
+    for k, v in out.items():
+        print("{:8s}: {:10.4f} s, {:6d} leaves".format(k, v['time'],
+                                                        v['nleaves']))
+    return out
+
+
+def insert_sorting(npart=1e6, ndim=4, nrep=1):
+    r"""Compare the time taken to insert points into an nD triangulation
+    with and without spatial sorting.
+
+    Args:
+        npart (int, optional): Number of particles. Defaults to 1e6.
+        ndim (int, optional): Number of dimensions. Defaults to 4.
+        nrep (int, optional): Number of times each triangulation should be
+            built to get an average. Defaults to 1.
+
+    Returns:
+        dict: Average insertion time for sorted and unsorted insertion.
+
+    """
+    npart = int(npart)
+    pts = np.random.rand(npart, ndim).astype('float64')
+    DelaunayD = delaunay._get_Delaunay(ndim, overwrite=False)
+    out = {}
+    for sort in [True, False]:
+        times = np.empty(nrep, 'float')
+        for i in range(nrep):
+            T = DelaunayD()
+            t0 = time.time()
+            T.insert(pts, sort=sort)
+            times[i] = time.time() - t0
+        key = 'sorted' if sort else 'unsorted'
+        out[key] = np.mean(times)
+        print("{:8s}: {:10.4f} s".format(key, out[key]))
+    print("speedup : {:10.4f}".format(out['unsorted']/out['sorted']))
+    return out
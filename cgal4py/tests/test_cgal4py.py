@@ -67,14 +67,14 @@ def make_points(npts, ndim, distrib='uniform', seed=0):
 
 @nt.nottest
 def make_test(npts, ndim, distrib='uniform', periodic=False,
-              leafsize=None, nleaves=0):
+              leafsize=None, nleaves=0, method='kdtree'):
     # Points
     pts, left_edge, right_edge = make_points(npts, ndim, distrib=distrib)
     npts = pts.shape[0]
     # Tree
     if leafsize is None:
-        leafsize = npts/2 + 2
-    tree = domain_decomp.tree("kdtree", pts, left_edge, right_edge,
+        leafsize = npts//2 + 2
+    tree = domain_decomp.tree(method, pts, left_edge, right_edge,
                               periodic=periodic, leafsize=leafsize,
                               nleaves=nleaves)
     return pts, tree
@@ -58,6 +58,48 @@ def test_Delaunay_both():
     assert_raises(ValueError, Delaunay, np.zeros((3, 3, 3)))
 
 
+def test_Delaunay_ghost():
+    for ndim in [2, 3]:
+        pts, le, re = make_points(200, ndim)
+        T = Delaunay(pts, periodic='ghost', left_edge=le, right_edge=re)
+        assert_equal(T.num_finite_verts, pts.shape[0])
+        assert(np.all(T.ghost_source < pts.shape[0]))
+        edges = T.edges
+        assert(np.all((edges >= 0) & (edges < pts.shape[0])))
+        vols = T.voronoi_volumes()
+        assert_equal(vols.shape[0], pts.shape[0])
+        assert(np.all(vols > 0))
+        assert(np.isclose(vols.sum(), np.prod(re - le)))
+    assert_raises(NotImplementedError, Delaunay, pts4, False, 'ghost',
+                  le4, re4)
+
+
+def test_Delaunay_ghost_queries():
+    for ndim in [2, 3]:
+        pts, le, re = make_points(200, ndim)
+        width = re - le
+        T = Delaunay(pts, periodic='ghost', left_edge=le, right_edge=re)
+        # Images are mapped back to their original points
+        nghost = len(T.ghost_source)
+        for i in [0, T.n, T.n + nghost - 1]:
+            assert(np.allclose(T.get_vertex(i).point, pts[T.source(i)]))
+        assert_equal(T.get_vertex(T.n).index, T.ghost_source[0])
+        assert(T.get_vertex(T.n + nghost).is_infinite())
+        assert_equal(list(T.locate(pts[5])), [5])
+        # Positions outside the domain are wrapped into it
+        np.random.seed(1)
+        x = le + np.random.uniform(-1, 2, (20, ndim))*width
+        for q in x:
+            d = q - pts
+            d -= width*np.round(d/width)
+            nearest = np.argmin((d**2).sum(axis=1))
+            assert_equal(T.nearest_vertex(q).index, nearest)
+            idx = T.locate(q)
+            assert_equal(len(idx), ndim + 1)
+            assert(np.all((idx >= 0) & (idx < pts.shape[0])))
+            assert_equal(sorted(idx), sorted(T.locate(q + width)))
+
+
 def test_VoronoiVolumes():
     T2 = VoronoiVolumes(pts2)
     assert_equal(T2.shape[0], pts2.shape[0])
@@ -126,6 +168,40 @@ def test_intersect_sph_box():
         assert(tools.py_intersect_sph_box(c, r, le, re) == False)
 
 
+def test_circumcenters():
+    np.random.seed(0)
+    for ndim in [2, 3]:
+        pos = np.random.rand(20, ndim)
+        cells = np.array([np.random.permutation(20)[:(ndim+1)]
+                          for _ in range(10)], dtype='uint32')
+        cc = tools.circumcenters(pos, cells)
+        assert_equal(cc.shape, (10, ndim))
+        r = [np.sqrt(((pos[cells[:, i]] - cc)**2).sum(axis=1))
+             for i in range(ndim + 1)]
+        for i in range(1, ndim + 1):
+            assert(np.allclose(r[i], r[0]))
+        assert_raises(ValueError, tools.circumcenters, pos, cells[:, :ndim])
+    assert_raises(NotImplementedError, tools.circumcenters,
+                  np.zeros((5, 4)), np.zeros((1, 5), 'int64'))
+
+
+def test_dual_volumes():
+    for ndim in [2, 3]:
+        pts, le, re = make_points(0, ndim)
+        T = Delaunay(pts)
+        cells, neigh, idx_inf = T.serialize()
+        cells = cells[np.all(cells != idx_inf, axis=1)]
+        v = tools.dual_volumes(T.vertices, cells, T.num_finite_verts)
+        # The contributions of the cells sum to the volume of the hull
+        x = T.vertices[cells]
+        vol = np.abs(np.linalg.det(x[:, 1:] - x[:, :1])).sum()
+        assert(np.isclose(v.sum(), vol/np.prod(np.arange(1, ndim + 1))))
+        # Only the central vertex has a bounded voronoi cell
+        assert(np.isclose(v[0], T.voronoi_volumes()[0]))
+        assert_raises(ValueError, tools.dual_volumes, T.vertices, cells,
+                      T.num_finite_verts - 1)
+
+
 def test_arg_tLT():
     cells = np.array([[2, 1, 0],
                       [3, 1, 0],
@@ -348,6 +348,34 @@ def test_move():
     assert(T.num_verts == (nverts-1))
 
 
+def test_vertex_index():
+    T = Delaunay2()
+    T.set_vertex_index()
+    T.insert(pts)
+    idx = np.arange(nverts_fin)[::-1]
+    for use_index in [True, False]:
+        T.set_vertex_index(use_index)
+        vs = T.get_vertices(idx)
+        for i, v in zip(idx, vs):
+            assert(np.allclose(v.point, pts[i, :]))
+            assert(v == T.get_vertex(i))
+    T.set_vertex_index()
+    new_pos = np.zeros(2, 'float64')
+    T.move(T.get_vertex(0), new_pos)
+    assert(np.allclose(T.get_vertex(0).point, new_pos))
+    T.remove(T.get_vertex(1))
+    assert(T.get_vertex(1).is_infinite())
+    assert(np.allclose(T.get_vertex(2).point, pts[2, :]))
+    # Vertices inserted once the index is filled are added to it, and a
+    # point that is already a vertex takes the new index
+    T.insert(np.vstack([pts[2:3, :], pts[2:3, :] + 10.0]))
+    assert(np.allclose(T.get_vertex(nverts_fin).point, pts[2, :]))
+    assert(np.allclose(T.get_vertex(nverts_fin+1).point, pts[2, :] + 10.0))
+    assert(T.get_vertex(2).is_infinite())
+    T.clear()
+    assert(T.get_vertex(0).is_infinite())
+
+
 def test_move_if_no_collision():
     T = Delaunay2()
     T.insert(pts)
@@ -623,6 +651,22 @@ def test_voronoi_volumes():
     v = T.voronoi_volumes()
     assert(v.shape[0] == T.num_finite_verts)
 
+def test_incremental_volumes():
+    pts_rand, le, re = make_points(100, 2)
+    T1 = Delaunay2()
+    T1.set_incremental_volumes()
+    T2 = Delaunay2()
+    for T in [T1, T2]:
+        T.insert(pts_rand[:80, :])
+    assert(np.allclose(T1.voronoi_volumes(), T2.voronoi_volumes()))
+    new_pos = pts_rand[5, :] + 0.01
+    for T in [T1, T2]:
+        T.insert(pts_rand[80:, :])
+        T.move(T.get_vertex(5), new_pos)
+        T.remove(T.get_vertex(99))
+    assert(np.allclose(T1.voronoi_volumes(), T2.voronoi_volumes()))
+
+
 def test_minimum_angles():
     T = Delaunay2()
     T.insert(pts)
@@ -8,7 +8,7 @@ r"""Tests for 3D Delaunay Triangulation.
 """
 import numpy as np
 import os
-from cgal4py.delaunay import Delaunay3
+from cgal4py.delaunay import Delaunay3, MappedDelaunay3
 from cgal4py.tests.test_cgal4py import MyTestCase, make_points
 
 
@@ -44,6 +44,18 @@ def test_insert():
     assert(T.is_valid())
 
 
+def test_insert_nthreads():
+    pts_rand, le, re = make_points(1000, 3)
+    T1 = Delaunay3()
+    T1.insert(pts_rand)
+    T2 = Delaunay3(nthreads=4)
+    assert(T2.nthreads == 4)
+    T2.insert(pts_rand[:500, :])
+    T2.insert(pts_rand[500:, :])
+    assert(T2.is_valid())
+    assert(T1.is_equivalent(T2))
+
+
 def test_equal():
     T1 = Delaunay3()
     T1.insert(pts)
@@ -205,6 +217,40 @@ def test_get_vertex():
         assert(np.allclose(v.point, pts[i, :]))
 
 
+def test_get_vertices():
+    T = Delaunay3()
+    T.insert(pts)
+    idx = np.arange(nverts_fin)[::-1]
+    for use_index in [False, True]:
+        T.set_vertex_index(use_index)
+        vs = T.get_vertices(idx)
+        for i, v in zip(idx, vs):
+            assert(np.allclose(v.point, pts[i, :]))
+            assert(v == T.get_vertex(i))
+
+
+def test_vertex_index():
+    T = Delaunay3()
+    T.set_vertex_index()
+    T.insert(pts)
+    for i in range(nverts_fin):
+        assert(np.allclose(T.get_vertex(i).point, pts[i, :]))
+    new_pos = np.zeros(3, 'float64')
+    T.move(T.get_vertex(0), new_pos)
+    assert(np.allclose(T.get_vertex(0).point, new_pos))
+    T.remove(T.get_vertex(1))
+    assert(T.get_vertex(1).is_infinite())
+    assert(np.allclose(T.get_vertex(2).point, pts[2, :]))
+    # Vertices inserted once the index is filled are added to it, and a
+    # point that is already a vertex takes the new index
+    T.insert(np.vstack([pts[2:3, :], pts[2:3, :] + 10.0]))
+    assert(np.allclose(T.get_vertex(nverts_fin).point, pts[2, :]))
+    assert(np.allclose(T.get_vertex(nverts_fin+1).point, pts[2, :] + 10.0))
+    assert(T.get_vertex(2).is_infinite())
+    T.clear()
+    assert(T.get_vertex(0).is_infinite())
+
+
 def test_locate():
     T = Delaunay3()
     T.insert(pts)
@@ -524,6 +570,111 @@ def test_io():
     Tin.read_from_file(fname)
     assert(Tout.num_verts == Tin.num_verts)
     assert(Tout.num_cells == Tin.num_cells)
+    assert(Tin.is_valid())
+    for v in Tout.all_verts:
+        if v.is_infinite():
+            continue
+        v2 = Tin.get_vertex(v.index)
+        assert(np.allclose(v.point, v2.point))
+    os.remove(fname)
+
+
+def test_serialize_arrays():
+    T = Delaunay3()
+    T.insert(pts)
+    pos, info, cells, neighbors, idx_inf = T.serialize_arrays()
+    assert(not pos.flags['OWNDATA'])
+    assert(pos.shape == (nverts_fin, 3))
+    assert(cells.shape == (ncells, 4))
+    assert(np.allclose(pos, T.vertices[info]))
+    cells0, neighbors0, idx_inf0 = T.serialize()
+    finite = (cells != idx_inf)
+    assert(np.all(cells0[~finite] == idx_inf0))
+    assert(np.all(cells0[finite] == info[cells[finite]]))
+    assert(np.all(neighbors == neighbors0))
+    T2 = Delaunay3()
+    pos, info, cells, neighbors, idx_inf = T2.serialize_arrays()
+    assert(pos.shape == (0, 3))
+
+
+def test_bulk_topology():
+    T = Delaunay3()
+    T.insert(pts)
+    edges = set(tuple(sorted(e)) for e in T.edges)
+    facets = T.facets
+    assert(facets.shape == (nfacets_fin, 3))
+    for f in facets:
+        for i in range(3):
+            assert(tuple(sorted((f[i], f[(i+1) % 3]))) in edges)
+    cc = T.circumcenters
+    assert(cc.shape == (ncells, 3))
+    for i, c in enumerate(T.all_cells):
+        if c.is_infinite():
+            assert(np.all(np.isinf(cc[i])))
+        else:
+            assert(np.allclose(cc[i], c.circumcenter))
+    indptr, indices = T.adjacency()
+    assert(indptr[-1] == 2*nedges_fin)
+    adj = set()
+    for i in range(nverts_fin):
+        row = indices[indptr[i]:indptr[i+1]]
+        assert(np.all(np.diff(row.astype('int64')) > 0))
+        adj.update((min(i, j), max(i, j)) for j in row)
+    assert(adj == edges)
+
+
+def test_adjacency_remove():
+    T = Delaunay3()
+    T.insert(pts)
+    T.remove(T.get_vertex(0))
+    indptr, indices = T.adjacency()
+    assert(len(indptr) == (nverts_fin+1))
+    assert(indptr[1] == 0)
+    edges = set(tuple(sorted(e)) for e in T.edges)
+    adj = set()
+    for i in range(nverts_fin):
+        row = indices[indptr[i]:indptr[i+1]]
+        adj.update((min(i, j), max(i, j)) for j in row)
+    assert(adj == edges)
+
+
+def test_mapped():
+    fname = 'test_mapped2348_3.dat'
+    T = Delaunay3()
+    T.insert(pts)
+    T.write_to_file(fname)
+    M = MappedDelaunay3(fname)
+    assert(M.num_finite_verts == T.num_finite_verts)
+    assert(np.allclose(M.vertices, T.vertices))
+    e1 = set(tuple(sorted(e)) for e in M.edges)
+    e2 = set(tuple(sorted(e)) for e in T.edges)
+    assert(e1 == e2)
+    assert(np.allclose(M.voronoi_volumes(), T.voronoi_volumes()))
+    for v in T.finite_verts:
+        x = sorted(y.index for y in v.incident_vertices()
+                   if not y.is_infinite())
+        assert(list(M.incident_vertices(v.index)) == x)
+    # Walk to the cell containing the center of the points
+    x = np.mean(pts, axis=0)
+    c = M.locate(x)
+    assert(np.all(M.cells[c] < M.n))
+    p = M.positions[np.asarray(M.cells[c], dtype='int64')]
+    for i in range(4):
+        q = p.copy()
+        q[i] = x
+        assert(np.linalg.det(q[1:] - q[0]) >= 0)
+    c = M.locate(np.max(pts, axis=0) + 10.0)
+    assert(np.any(M.cells[c] == M.n))
+    # Mutating calls need the full triangulation
+    assert(M._T is None)
+    assert(not hasattr(M, 'insert'))
+    M.full().insert(pts_dup[-1:] + 10.0)
+    assert(M._T is not None)
+    assert(M.num_finite_verts == T.num_finite_verts + 1)
+    T.insert(pts_dup[-1:] + 10.0)
+    assert(M.n == T.num_finite_verts)
+    assert(M.num_cells == T.num_cells)
+    del M
     os.remove(fname)
 
 
@@ -762,6 +913,33 @@ def test_nearest_vertex():
     assert(v.index == idx_test)
 
 
+def test_nearest_vertex_many():
+    x = pts - 0.1
+    for nthreads in [1, 4]:
+        T = Delaunay3(nthreads=nthreads)
+        T.insert(pts)
+        idx = T.nearest_vertex_many(x)
+        assert(idx.shape[0] == x.shape[0])
+        for i in range(x.shape[0]):
+            assert(idx[i] == T.nearest_vertex(x[i, :]).index)
+
+
+def test_locate_many():
+    for nthreads in [1, 4]:
+        T = Delaunay3(nthreads=nthreads)
+        T.insert(pts)
+        centers = np.array([c.center for c in T.finite_cells])
+        cells, lt, li, lj = T.locate_many(centers)
+        assert(np.all(lt == 3))
+        for i, c in enumerate(T.finite_cells):
+            assert(np.all(np.sort(cells[i, :]) ==
+                          np.sort([c.vertex(j).index for j in range(4)])))
+        cells, lt, li, lj = T.locate_many(pts)
+        assert(np.all(lt == 0))
+        assert(np.all(cells[np.arange(nverts_fin), li] ==
+                      np.arange(nverts_fin)))
+
+
 def test_mirror():
     T = Delaunay3()
     T.insert(pts)
@@ -823,11 +1001,60 @@ def test_edges():
     assert(e.shape[0] == T.num_finite_edges)
     assert(e.shape[1] == 2)
 
+def test_outgoing_points():
+    pts_rand, le, re = make_points(100, 3)
+    T = Delaunay3()
+    T.insert(pts_rand)
+    np.random.seed(10)
+    left_edges = np.random.rand(20, 3)
+    right_edges = left_edges + 0.2*np.random.rand(20, 3)
+    out = T.outgoing_points(left_edges, right_edges)
+    assert(len(out) == left_edges.shape[0])
+    # Compare to testing every cell against every box
+    ans = [set() for b in range(left_edges.shape[0])]
+    for c in T.all_cells:
+        verts = [c.vertex(i) for i in range(4)]
+        idx = [v.index for v in verts if not v.is_infinite()]
+        if c.is_infinite():
+            for b in range(len(ans)):
+                ans[b].update(idx)
+            continue
+        cc = c.circumcenter
+        cr = np.sqrt(np.sum((verts[0].point - cc)**2))
+        for b in range(len(ans)):
+            if np.all(cc + cr >= left_edges[b]) and \
+               np.all(cc - cr <= right_edges[b]):
+                ans[b].update(idx)
+    for b in range(len(ans)):
+        assert(np.all(out[b] == np.array(sorted(ans[b]))))
+
+
 def test_voronoi_volumes():
     T = Delaunay3()
     T.insert(pts)
     v = T.voronoi_volumes()
     assert(v.shape[0] == T.num_finite_verts)
+    for i in range(nverts_fin):
+        assert(np.isclose(v[i], T.get_vertex(i).dual_volume))
+    T4 = Delaunay3(nthreads=4)
+    T4.insert(pts)
+    assert(np.allclose(T4.voronoi_volumes(), v))
+
+def test_incremental_volumes():
+    pts_rand, le, re = make_points(100, 3)
+    T1 = Delaunay3()
+    T1.set_incremental_volumes()
+    T2 = Delaunay3()
+    for T in [T1, T2]:
+        T.insert(pts_rand[:80, :])
+    assert(np.allclose(T1.voronoi_volumes(), T2.voronoi_volumes()))
+    new_pos = pts_rand[5, :] + 0.01
+    for T in [T1, T2]:
+        T.insert(pts_rand[80:, :])
+        T.move(T.get_vertex(5), new_pos)
+        T.remove(T.get_vertex(99))
+    assert(np.allclose(T1.voronoi_volumes(), T2.voronoi_volumes()))
+
 
 def test_minimum_angles():
     T = Delaunay3()
@@ -61,6 +61,35 @@ def test_insert():
     T = DelaunayD()
     T.insert(pts_dup)
     assert(T.is_valid())
+    # without spatial sorting
+    T = DelaunayD()
+    T.insert(pts, sort=False)
+    assert(T.is_valid())
+    assert(T.num_finite_cells == ncells_fin)
+
+
+def test_insert_sort():
+    np.random.seed(0)
+    pts_big = np.random.uniform(-2, 2, (1000, ndim))
+
+    def cells(T):
+        return set(tuple(sorted(c.vertex(i).index for i in range(ndim+1)))
+                   for c in T.finite_cells)
+    # Random points are in general position, so the triangulation is
+    # unique and both insertion orders must give the same cells. The
+    # second batch starts from the hint of an existing triangulation.
+    T1 = DelaunayD()
+    T1.insert(pts_big[:600])
+    T1.insert(pts_big[600:])
+    assert(T1.is_valid())
+    assert(T1.num_finite_verts == pts_big.shape[0])
+    assert(np.allclose(T1.vertices, pts_big))
+    T2 = DelaunayD()
+    T2.insert(pts_big[:600], sort=False)
+    T2.insert(pts_big[600:], sort=False)
+    assert(T2.is_valid())
+    assert(T1.is_equivalent(T2))
+    assert(cells(T1) == cells(T2))
 
 
 def test_equal():
@@ -1,4 +1,5 @@
 r"""Tests for domain decomposition methods."""
+import os
 import numpy as np
 from nose.tools import assert_raises
 from cgal4py import domain_decomp
@@ -81,3 +82,252 @@ def test_GenericTree():
         np.arange(5*left_edges.shape[0]).astype('int'),
         leaves, left_edge2, right_edge2, False)
     del tree, leaves2, leaves3
+
+
+def test_kdtree_layouts():
+    from cgal4py.domain_decomp import kdtree
+    for pts, le, re in [(pts2, left_edge2, right_edge2),
+                        (pts3, left_edge3, right_edge3)]:
+        tree_ptr = kdtree.PyKDTree(pts, le, re, leafsize=leafsize,
+                                   layout='pointer')
+        tree_flat = kdtree.PyKDTree(pts, le, re, leafsize=leafsize,
+                                    layout='flat')
+        assert(tree_ptr.num_leaves == tree_flat.num_leaves)
+        assert(tree_ptr.num_nodes == tree_flat.num_nodes)
+        np.testing.assert_array_equal(tree_ptr.idx, tree_flat.idx)
+        for lp, lf in zip(tree_ptr.leaves, tree_flat.leaves):
+            assert(lp.start_idx == lf.start_idx)
+            assert(lp.npts == lf.npts)
+            np.testing.assert_array_equal(lp.left_edge, lf.left_edge)
+            np.testing.assert_array_equal(lp.right_edge, lf.right_edge)
+        stats = tree_flat.build_stats()
+        assert(stats['nbytes'] < tree_ptr.build_stats()['nbytes'])
+    assert_raises(ValueError, kdtree.PyKDTree, pts2, left_edge2, right_edge2,
+                  layout='invalid')
+
+
+def test_kdtree_nthreads():
+    from cgal4py.domain_decomp import kdtree
+    pts = np.random.rand(10*N, 3).astype('float64')
+    for layout in kdtree._layouts:
+        tree1 = kdtree.PyKDTree(pts, left_edge3, right_edge3,
+                                leafsize=leafsize, layout=layout, nthreads=1)
+        tree4 = kdtree.PyKDTree(pts, left_edge3, right_edge3,
+                                leafsize=leafsize, layout=layout, nthreads=4)
+        assert(tree1.num_leaves == tree4.num_leaves)
+        np.testing.assert_array_equal(tree1.idx, tree4.idx)
+        for l1, l4 in zip(tree1.leaves, tree4.leaves):
+            assert(l1.start_idx == l4.start_idx)
+            assert(l1.npts == l4.npts)
+            np.testing.assert_array_equal(l1.left_edge, l4.left_edge)
+            np.testing.assert_array_equal(l1.right_edge, l4.right_edge)
+
+
+def test_kdtree_split():
+    from cgal4py.domain_decomp import kdtree
+    pts = np.vstack([np.random.rand(5*N, 3),
+                     0.3 + 0.03*np.random.randn(5*N, 3)])
+    pts = np.clip(pts, 0.0, 1.0).astype('float64')
+    for layout in kdtree._layouts:
+        tree_med = kdtree.PyKDTree(pts, left_edge3, right_edge3,
+                                   leafsize=leafsize, layout=layout,
+                                   split='median')
+        tree_cost = kdtree.PyKDTree(pts, left_edge3, right_edge3,
+                                    leafsize=leafsize, layout=layout,
+                                    split='cost')
+        assert(tree_cost.split == 'cost')
+        assert(tree_cost.leaf_costs().shape == (tree_cost.num_leaves,))
+        assert(sum(l.npts for l in tree_cost.leaves) == pts.shape[0])
+        np.testing.assert_array_equal(np.sort(tree_cost.idx),
+                                      np.arange(pts.shape[0]))
+        assert(tree_med.split == 'median')
+    assert_raises(ValueError, kdtree.PyKDTree, pts3, left_edge3, right_edge3,
+                  split='invalid')
+    tree = domain_decomp.tree('kdtree', pts3, left_edge3, right_edge3, False,
+                              leafsize=leafsize, split='cost')
+    assert(tree.split == 'cost')
+
+
+def test_kdtree_sample():
+    from cgal4py.domain_decomp import kdtree
+    pts = np.random.rand(20*N, 3).astype('float64')
+    trees = []
+    for layout in kdtree._layouts:
+        for nthreads in [1, 4]:
+            trees.append(kdtree.PyKDTree(pts, left_edge3, right_edge3,
+                                         leafsize=leafsize, layout=layout,
+                                         nthreads=nthreads, split='sample',
+                                         sample_size=16,
+                                         sample_tolerance=0.2))
+    tree_med = kdtree.PyKDTree(pts, left_edge3, right_edge3,
+                               leafsize=leafsize, split='median')
+    tree = trees[0]
+    assert(tree.split == 'sample')
+    assert(tree.num_leaves == tree_med.num_leaves)
+    np.testing.assert_array_equal(np.sort(tree.idx),
+                                  np.arange(pts.shape[0]))
+    for leaf in tree.leaves:
+        lpts = pts[tree.idx[leaf.slice], :]
+        assert(np.all(lpts >= leaf.left_edge))
+        assert(np.all(lpts <= leaf.right_edge))
+    for other in trees[1:]:
+        np.testing.assert_array_equal(tree.idx, other.idx)
+        for l0, l1 in zip(tree.leaves, other.leaves):
+            assert(l0.npts == l1.npts)
+            np.testing.assert_array_equal(l0.left_edge, l1.left_edge)
+            np.testing.assert_array_equal(l0.right_edge, l1.right_edge)
+
+
+def test_kdtree_sample_small():
+    # Tiny samples of skewed points often give lopsided splits, which must
+    # fall back to the median rather than drop points
+    from cgal4py.domain_decomp import kdtree
+    pts = np.random.rand(200*N, 3).astype('float64')
+    pts[:, 0] = pts[:, 0]**6
+    ls = 64
+    for sample_size in [1, 4]:
+        num_leaves = []
+        for layout in kdtree._layouts:
+            tree = kdtree.PyKDTree(pts, left_edge3, right_edge3,
+                                   leafsize=ls, layout=layout,
+                                   split='sample', sample_size=sample_size,
+                                   sample_tolerance=0.5)
+            num_leaves.append(tree.num_leaves)
+            assert(len(tree.leaves) == tree.num_leaves)
+            assert(sum(leaf.npts for leaf in tree.leaves) == pts.shape[0])
+            np.testing.assert_array_equal(np.sort(tree.idx),
+                                          np.arange(pts.shape[0]))
+            for leaf in tree.leaves:
+                assert(leaf.npts >= ls//8)
+        assert(len(set(num_leaves)) == 1)
+
+
+def test_kdtree_file():
+    from cgal4py.domain_decomp import kdtree
+    fname = 'test_kdtree_file2348.dat'
+    for pts, le, re in [(pts2, left_edge2, right_edge2),
+                        (pts3, left_edge3, right_edge3)]:
+        for layout in kdtree._layouts:
+            tree0 = kdtree.PyKDTree(pts, le, re, periodic=True,
+                                    leafsize=leafsize, layout=layout)
+            tree0.save(fname)
+            tree1 = kdtree.PyKDTree(pts, le, re, periodic=True,
+                                    tree_file=fname)
+            assert(tree1.layout == 'flat')
+            assert(tree1.periodic)
+            assert(tree0.num_leaves == tree1.num_leaves)
+            np.testing.assert_array_equal(tree0.idx, tree1.idx)
+            for l0, l1 in zip(tree0.leaves, tree1.leaves):
+                assert(l0.start_idx == l1.start_idx)
+                assert(l0.npts == l1.npts)
+                np.testing.assert_array_equal(l0.left_edge, l1.left_edge)
+                np.testing.assert_array_equal(l0.right_edge, l1.right_edge)
+                assert(sorted(l0.neighbors) == sorted(l1.neighbors))
+                for d in range(pts.shape[1]):
+                    assert(sorted(l0.left_neighbors[d]) ==
+                           sorted(l1.left_neighbors[d]))
+                    assert(sorted(l0.right_neighbors[d]) ==
+                           sorted(l1.right_neighbors[d]))
+            del tree1
+            assert_raises(ValueError, kdtree.PyKDTree, pts[:-1], le, re,
+                          tree_file=fname)
+    tree = domain_decomp.tree('kdtree', pts3, left_edge3, right_edge3, True,
+                              tree_file=fname)
+    assert(tree.num_leaves > 1)
+    os.remove(fname)
+
+
+def test_kdtree_route():
+    from cgal4py.domain_decomp import kdtree
+    for layout in kdtree._layouts:
+        tree = kdtree.PyKDTree(pts3, left_edge3, right_edge3,
+                               leafsize=leafsize, layout=layout)
+        leafids = tree.leaf_of(pts3)
+        for leaf in tree.leaves:
+            assert(np.all(leafids[tree.idx[leaf.slice]] == leaf.id))
+        new_pts = np.vstack([np.random.rand(N, 3), [[2.0, 0.5, 0.5]]])
+        leafids1, order, offsets = tree.route(new_pts, nthreads=1)
+        leafids4, order4, offsets4 = tree.route(new_pts, nthreads=4)
+        np.testing.assert_array_equal(leafids1, leafids4)
+        np.testing.assert_array_equal(order, order4)
+        np.testing.assert_array_equal(offsets, offsets4)
+        assert(leafids1[-1] == -1)
+        assert(offsets[-1] - offsets[-2] == 1)
+        for leaf in tree.leaves:
+            members = order[offsets[leaf.id]:offsets[leaf.id+1]]
+            np.testing.assert_array_equal(members,
+                                          np.where(leafids1 == leaf.id)[0])
+            assert(np.all(new_pts[members] >= leaf.left_edge))
+            assert(np.all(new_pts[members] <= leaf.right_edge))
+        assert_raises(ValueError, tree.route, pts2)
+    tree = kdtree.PyKDTree(pts3, left_edge3, right_edge3, periodic=True,
+                           leafsize=leafsize)
+    new_pts = np.random.rand(N, 3)
+    np.testing.assert_array_equal(tree.leaf_of(new_pts + 1.0),
+                                  tree.leaf_of(new_pts))
+
+
+def test_kdtree_float32():
+    from cgal4py.domain_decomp import kdtree
+    pts32 = pts3.astype('float32')
+    pts64 = pts32.astype('float64')
+    for layout in kdtree._layouts:
+        for split in kdtree._splits:
+            tree32 = kdtree.PyKDTree(pts32, left_edge3, right_edge3,
+                                     leafsize=leafsize, layout=layout,
+                                     split=split)
+            tree64 = kdtree.PyKDTree(pts64, left_edge3, right_edge3,
+                                     leafsize=leafsize, layout=layout,
+                                     split=split)
+            assert(tree32.dtype == 'float32')
+            assert(tree64.dtype == 'float64')
+            assert(tree32.num_leaves == tree64.num_leaves)
+            for l0, l1 in zip(tree32.leaves, tree64.leaves):
+                assert(l0.npts == l1.npts)
+                np.testing.assert_array_equal(l0.left_edge, l1.left_edge)
+                np.testing.assert_array_equal(l0.right_edge, l1.right_edge)
+                np.testing.assert_array_equal(
+                    np.sort(tree32.idx[l0.slice]),
+                    np.sort(tree64.idx[l1.slice]))
+            np.testing.assert_array_equal(tree32.leaf_of(pts32),
+                                          tree64.leaf_of(pts64))
+    tree = domain_decomp.tree('kdtree', pts32, left_edge3, right_edge3,
+                              periodic=False, leafsize=leafsize)
+    assert(tree.dtype == 'float32')
+
+
+def test_sfc():
+    from cgal4py.domain_decomp import sfc
+    for pts, le, re in [(pts2, left_edge2, right_edge2),
+                        (pts3, left_edge3, right_edge3)]:
+        for curve in sfc._curves:
+            for periodic in [False, True]:
+                tree = sfc.PySFCTree(pts, le, re, periodic=periodic,
+                                     leafsize=leafsize, curve=curve)
+                assert(0 < tree.num_leaves <= N//leafsize)
+                np.testing.assert_array_equal(np.sort(tree.idx),
+                                              np.arange(N))
+                assert(np.all(np.diff(tree.keys.astype('float')) >= 0))
+                for leaf in tree.leaves:
+                    lpts = pts[tree.idx[leaf.slice], :]
+                    assert(np.all(lpts >= leaf.left_edge))
+                    assert(np.all(lpts <= leaf.right_edge))
+                    for k in leaf.neighbors:
+                        assert(leaf.id in tree.leaves[k].neighbors)
+            tree4 = sfc.PySFCTree(pts, le, re, leafsize=leafsize,
+                                  curve=curve, nthreads=4)
+            np.testing.assert_array_equal(tree.idx, tree4.idx)
+    weights = np.ones(N, 'float64')
+    weights[:N//2] = 3.0
+    tree = sfc.PySFCTree(pts3, left_edge3, right_edge3, nleaves=4,
+                         weights=weights)
+    cost = [weights[tree.idx[leaf.slice]].sum() for leaf in tree.leaves]
+    assert(max(cost) - min(cost) <= 6.0)
+    assert_raises(ValueError, sfc.PySFCTree, pts3, left_edge3, right_edge3,
+                  curve='invalid')
+    assert_raises(ValueError, sfc.PySFCTree, pts3, left_edge3, right_edge3,
+                  weights=np.ones(N + 1))
+    for method in ['hilbert', 'morton']:
+        tree = domain_decomp.tree(method, pts3, left_edge3, right_edge3,
+                                  False, leafsize=leafsize)
+        assert(tree.curve == method)
@@ -288,6 +288,16 @@ if _use_multiprocessing:
                         os.remove(ffinal)
 
 
+def test_get_ParallelDelaunay():
+    # Build the extension used by the C++ MPI path in this process, so a
+    # failed compile is reported here rather than inside an MPI job
+    for ndim in [2, 3]:
+        for bit64 in [False, True]:
+            cls = delaunay._get_Delaunay(ndim, parallel=True, bit64=bit64)
+            assert(cls.__name__ == delaunay._delaunay_filename(
+                'pyclass', ndim, parallel=True, bit64=bit64))
+
+
 class TestParallelDelaunay(MyTestCase):
 
     def setup_param(self):
@@ -306,10 +316,24 @@ class TestParallelDelaunay(MyTestCase):
                 # ((1e5, ndim, 8), {'nleaves': 8}),
                 # ((1e7, ndim, 10), {'nleaves': 10}),
                 ]
+            for method in ['hilbert', 'morton']:
+                param_test += [
+                    ((100, ndim, 4), {'nleaves': 4, 'method': method}),
+                    ((100, ndim, 4), {'nleaves': 8, 'method': method}),
+                    ((100, ndim, 4), {'nleaves': 8, 'method': method,
+                                      'periodic': True}),
+                    ]
         self.param_returns = []
         for args, kwargs in param_test:
             pts, tree = make_test(args[0], args[1], **kwargs)
-            ans = delaunay.Delaunay(pts)
+            if kwargs.get('periodic', False):
+                # Periodic results are checked against a serial
+                # triangulation of the points and their periodic images
+                ans = delaunay.Delaunay(pts, periodic='ghost',
+                                        left_edge=tree.left_edge,
+                                        right_edge=tree.right_edge)
+            else:
+                ans = delaunay.Delaunay(pts)
             read_lines = lines_load_test(args[0], args[1])
             for limit_mem in [False, True]:
                 if _use_multiprocessing:
@@ -331,33 +355,88 @@ class TestParallelDelaunay(MyTestCase):
                         #      {'use_mpi': True, 'limit_mem': limit_mem,
                         #       'profile': profile, 'use_python':False})
                         ]
+        # Options that only apply when communications are done in C++
+        c_options = [{'reorder_pts': True},
+                     # Splits every leaf after the initial decomposition
+                     {'rebalance': 0.5}]
+        self._tree_file_uses = {}
+        for ndim in ndim_list:
+            pts, tree = make_test(100, ndim, nleaves=4)
+            ans = delaunay.Delaunay(pts)
+            for opt in c_options:
+                kwargs = {'use_mpi': True, 'use_python': False}
+                kwargs.update(opt)
+                self.param_returns.append((ans, (pts, tree, 4), kwargs))
+            # Single precision points are compared with the serial
+            # triangulation of the same points after widening
+            pts32 = pts.astype('float32')
+            self.param_returns.append(
+                (delaunay.Delaunay(pts32.astype('float64')),
+                 (pts32, tree, 4), {'use_mpi': True, 'use_python': False}))
+            # The first run saves the tree, the second loads it, and the
+            # third has different points so the tree is rebuilt
+            ftree = 'test_ParallelDelaunay{}D.tree'.format(ndim)
+            if os.path.isfile(ftree):
+                os.remove(ftree)
+            kwargs = {'use_mpi': True, 'use_python': False,
+                      'tree_file': ftree}
+            pts2, tree2 = make_test(50, ndim, nleaves=4)
+            ans2 = delaunay.Delaunay(pts2)
+            self.param_returns += [
+                (ans, (pts, tree, 4), kwargs),
+                (ans, (pts, tree, 4), kwargs),
+                (ans2, (pts2, tree2, 4), kwargs),
+                ]
+            self._tree_file_uses[ftree] = 3
 
     def check_returns(self, result, args, kwargs):
+        ftree = kwargs.get('tree_file', None)
+        if ftree is not None:
+            assert(os.path.isfile(ftree) ==
+                   (self._tree_file_uses[ftree] < 3))
         T_seri = result
         T_para = self.func(*args, **kwargs)
         ndim = args[0].shape[1]
-        c_seri, n_seri, inf_seri = T_seri.serialize(sort=True)
-        c_para, n_para, inf_para = T_para.serialize(sort=True)
-        try:
+        if isinstance(T_seri, delaunay.GhostPeriodicDelaunay):
+            # Cells around the original points, in terms of the original
+            # points, are the cells of the periodic triangulation
+            c_seri, n_seri, inf_seri = T_seri.T.serialize()
+            c_seri = c_seri[np.any(c_seri < T_seri.n, axis=1)]
+            c_seri = np.unique(np.sort(T_seri.source(c_seri), axis=1), axis=0)
+            c_para, n_para, inf_para = T_para.serialize()
+            c_para = c_para[np.all(c_para != inf_para, axis=1)]
+            c_para = np.unique(np.sort(c_para.astype('int64'), axis=1),
+                               axis=0)
+            assert(np.all(c_seri.shape == c_para.shape))
             assert(np.all(c_seri == c_para))
-            assert(np.all(n_seri == n_para))
-            assert(T_para.is_equivalent(T_seri))
-        except:
-            for name, T in zip(['Parallel','Serial'],[T_para, T_seri]):
-                print(name)
-                print('\t verts: {}, {}, {}'.format(
-                    T.num_verts, T.num_finite_verts, T.num_infinite_verts))
-                print('\t cells: {}, {}, {}'.format(
-                    T.num_cells, T.num_finite_cells, T.num_infinite_cells))
-                print('\t edges: {}, {}, {}'.format(
-                    T.num_edges, T.num_finite_edges, T.num_infinite_edges))
-                if ndim == 3:
-                    print('\t facets: {}, {}, {}'.format(
-                        T.num_facets, T.num_finite_facets,
-                        T.num_infinite_facets))
-            raise
+        else:
+            c_seri, n_seri, inf_seri = T_seri.serialize(sort=True)
+            c_para, n_para, inf_para = T_para.serialize(sort=True)
+            try:
+                assert(np.all(c_seri == c_para))
+                assert(np.all(n_seri == n_para))
+                assert(T_para.is_equivalent(T_seri))
+            except:
+                for name, T in zip(['Parallel','Serial'],[T_para, T_seri]):
+                    print(name)
+                    print('\t verts: {}, {}, {}'.format(
+                        T.num_verts, T.num_finite_verts, T.num_infinite_verts))
+                    print('\t cells: {}, {}, {}'.format(
+                        T.num_cells, T.num_finite_cells, T.num_infinite_cells))
+                    print('\t edges: {}, {}, {}'.format(
+                        T.num_edges, T.num_finite_edges, T.num_infinite_edges))
+                    if ndim == 3:
+                        print('\t facets: {}, {}, {}'.format(
+                            T.num_facets, T.num_finite_facets,
+                            T.num_infinite_facets))
+                raise
         if os.path.isfile(self._fprof):
             os.remove(self._fprof)
+        if ftree is not None:
+            assert(os.path.isfile(ftree))
+            self._tree_file_uses[ftree] -= 1
+            if self._tree_file_uses[ftree] == 0:
+                os.remove(ftree)
 
 
 class TestParallelVoronoiVolumes(MyTestCase):
@@ -696,4 +696,20 @@ def test_voronoi_volumes():
     v = T.voronoi_volumes()
     assert(v.shape[0] == T.num_finite_verts)
     assert(np.all(v > 0))
-    # TODO: answer testing
+    assert(np.isclose(v.sum(), np.prod(right_edge - left_edge)))
+    # Enough points for a 1-sheeted covering
+    np.random.seed(0)
+    pts_big = np.random.uniform(-2, 2, (1000, 2))
+    T = Delaunay2(left_edge, right_edge)
+    T.insert(pts_big)
+    v = T.voronoi_volumes()
+    assert(np.all(v > 0))
+    assert(np.isclose(v.sum(), np.prod(right_edge - left_edge)))
+    assert(np.allclose(T.voronoi_volumes(nthreads=2), v))
+    # Volumes stay indexed by info after a vertex is removed
+    T.remove(T.get_vertex(0))
+    v = T.voronoi_volumes()
+    assert(v.shape[0] == pts_big.shape[0])
+    assert(v[0] == 0)
+    assert(np.all(v[1:] > 0))
+    assert(np.isclose(v.sum(), np.prod(right_edge - left_edge)))
@@ -8,6 +8,7 @@ r"""Testing for the 3D Periodic Delaunay extension.
 """
 import numpy as np
 import os
+from nose.tools import assert_raises
 from cgal4py.delaunay import PeriodicDelaunay3 as Delaunay3
 
 
@@ -54,6 +55,29 @@ def test_insert():
     assert(T.is_valid())
 
 
+def test_insert_batch():
+    # Enough points to use the spatially sorted range insert
+    np.random.seed(0)
+    pts_big = np.random.uniform(-2, 2, (2000, 3))
+    T1 = Delaunay3(left_edge, right_edge)
+    T1.insert(pts_big)
+    assert(T1.is_valid())
+    assert(T1.num_finite_verts == pts_big.shape[0])
+    assert(np.allclose(T1.vertices, pts_big))
+    # Same points inserted one at a time
+    T2 = Delaunay3(left_edge, right_edge)
+    for i in range(0, pts_big.shape[0], 500):
+        T2.insert(pts_big[i:(i+500)])
+    assert(T1.is_equivalent(T2))
+    # Later batch with a duplicate of an existing point
+    T1.insert(np.concatenate([np.random.uniform(-2, 2, (999, 3)),
+                              pts_big[:1]]))
+    assert(T1.is_valid())
+    assert(T1.num_finite_verts == pts_big.shape[0] + 999)
+    assert(np.allclose(T1.get_vertex(pts_big.shape[0] + 999).periodic_point,
+                       pts_big[0]))
+
+
 def test_equal():
     T1 = Delaunay3(left_edge, right_edge)
     T1.insert(pts)
@@ -494,6 +518,33 @@ def test_move():
     assert(T.num_verts == (nverts-1))
 
 
+def test_vertex_index():
+    idx = np.arange(nverts_fin)[::-1]
+    for use_index in [True, False]:
+        T = Delaunay3(left_edge, right_edge)
+        T.set_vertex_index(use_index)
+        T.insert(pts)
+        vs = T.get_vertices(idx)
+        for i, v in zip(idx, vs):
+            assert(np.allclose(v.periodic_point, pts[i, :]))
+            assert(v == T.get_vertex(i))
+        # Moving a vertex onto another removes it and leaves the other's
+        # index alone
+        v = T.move(T.get_vertex(1), pts[0, :])
+        assert(v == T.get_vertex(0))
+        assert(T.num_verts == (nverts-1))
+        for i in range(2, nverts_fin):
+            assert(np.allclose(T.get_vertex(i).periodic_point, pts[i, :]))
+        # Vertices inserted once the index is filled are added to it, and a
+        # point that is already a vertex takes the new index
+        new = np.array([[0.5, 0.5, 0.5], pts[2, :]])
+        T.insert(new)
+        assert(T.num_verts == nverts)
+        assert(np.allclose(T.get_vertex(nverts_fin).periodic_point, new[0]))
+        assert(np.allclose(T.get_vertex(nverts_fin+1).periodic_point,
+                           pts[2, :]))
+
+
 def test_move_if_no_collision():
     T = Delaunay3(left_edge, right_edge)
     T.insert(pts)
@@ -815,3 +866,69 @@ def test_edges():
     e = T.edges
     assert(e.shape[0] == T.num_finite_edges)
     assert(e.shape[1] == 2)
+
+
+def test_voronoi_volumes():
+    T = Delaunay3(left_edge, right_edge)
+    T.insert(pts)
+    v = T.voronoi_volumes()
+    assert(v.shape[0] == T.num_finite_verts)
+    assert(np.all(v > 0))
+    assert(np.isclose(v.sum(), np.prod(right_edge - left_edge)))
+    # Enough points for a 1-sheeted covering
+    np.random.seed(0)
+    pts_big = np.random.uniform(-2, 2, (1000, 3))
+    T = Delaunay3(left_edge, right_edge)
+    T.insert(pts_big)
+    v = T.voronoi_volumes()
+    assert(np.all(v > 0))
+    assert(np.isclose(v.sum(), np.prod(right_edge - left_edge)))
+    assert(np.allclose(T.voronoi_volumes(nthreads=2), v))
+    # Volumes stay indexed by info after a vertex is removed
+    T.remove(T.get_vertex(0))
+    v = T.voronoi_volumes()
+    assert(v.shape[0] == pts_big.shape[0])
+    assert(v[0] == 0)
+    assert(np.all(v[1:] > 0))
+    assert(np.isclose(v.sum(), np.prod(right_edge - left_edge)))
+
+
+def test_move_many():
+    np.random.seed(1)
+    width = right_edge - left_edge
+    pts_big = np.random.uniform(-2, 2, (2000, 3))
+    T = Delaunay3(left_edge, right_edge)
+    T.insert(pts_big)
+
+    def check(idx, dx):
+        new = left_edge + np.mod(pts_big[idx] + dx - left_edge, width)
+        T.move_many(idx, new)
+        pts_big[idx] = new
+        assert(T.is_valid())
+        assert(T.num_finite_verts == pts_big.shape[0])
+        assert(np.allclose(T.vertices, pts_big))
+        T2 = Delaunay3(left_edge, right_edge)
+        T2.insert(pts_big)
+        assert(T.is_equivalent(T2))
+    # Small displacements that are moved in place
+    idx = np.arange(0, pts_big.shape[0], 2)
+    check(idx, np.random.uniform(-1e-4, 1e-4, (len(idx), 3)))
+    # Large displacements of a few vertices, removed and reinserted
+    idx = np.arange(0, pts_big.shape[0], 50)
+    check(idx, np.random.uniform(-1, 1, (len(idx), 3)))
+    # Large displacements of all vertices, rebuilt
+    idx = np.arange(pts_big.shape[0])
+    check(idx, np.random.uniform(-1, 1, (len(idx), 3)))
+    # Repeated indices use the last position
+    idx = np.array([5, 7, 5, 9, 5])
+    dx = np.random.uniform(-1, 1, (len(idx), 3))
+    new = left_edge + np.mod(pts_big[idx] + dx - left_edge, width)
+    T.move_many(idx, new)
+    pts_big[idx] = new
+    assert(np.allclose(pts_big[5], new[-1]))
+    assert(T.is_valid())
+    assert(T.num_finite_verts == pts_big.shape[0])
+    assert(np.allclose(T.vertices, pts_big))
+    assert_raises(ValueError, T.move_many, idx[:2], pts_big[:3])
+    assert_raises(ValueError, T.move_many, [pts_big.shape[0]],
+                  pts_big[:1])
@@ -46,6 +46,9 @@ else:
         include_dirs.append("/usr/include/boost")
     else:
         raise Exception("Install boost")
+# TBB is optional and allows 3D triangulations to insert points on multiple
+# threads
+use_tbb = ("tbb" in include_files) or os.path.isdir("/usr/include/tbb")
 
 # Needed for line_profiler - disable for production code
 if not RTDFLAG and not release and use_cython:
@@ -76,6 +79,15 @@ cykdtree_cpp = None
 cykdtree_parallel_cpp = None
 cykdtree_parallel_hpp = None
 cykdtree_utils_cpp = None
+try:
+    import cykdtree
+
+    cykdtree_cpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_kdtree.cpp")
+    cykdtree_parallel_cpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_parallel_kdtree.cpp")
+    cykdtree_parallel_hpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_parallel_kdtree.hpp")
+    cykdtree_utils_cpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_utils.cpp")
+except ImportError:
+    pass
 if RTDFLAG:
     ext_options["extra_compile_args"].append("-DREADTHEDOCS")
     ext_options_cgal = copy.deepcopy(ext_options)
@@ -85,17 +97,17 @@ else:
     ext_options_cgal = copy.deepcopy(ext_options)
     ext_options_cgal["libraries"] += ["gmp", "CGAL"]
     ext_options_cgal["extra_link_args"] += ["-lgmp"]
+    if use_tbb:
+        ext_options_cgal["libraries"] += ["tbb"]
+        ext_options_cgal["define_macros"].append(("CGAL_LINKED_WITH_TBB", "1"))
     # Check that there is a version of MPI available
     ext_options_mpicgal = copy.deepcopy(ext_options_cgal)
     compile_parallel = True
     try:
         import mpi4py
-        import cykdtree
 
-        cykdtree_cpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_kdtree.cpp")
-        cykdtree_parallel_cpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_parallel_kdtree.cpp")
-        cykdtree_parallel_hpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_parallel_kdtree.hpp")
-        cykdtree_utils_cpp = os.path.join(os.path.dirname(cykdtree.__file__), "c_utils.cpp")
+        if cykdtree_utils_cpp is None:
+            raise Exception
 
         # Use OpenMPI
         mpi_compile_args = os.popen("mpic++ --showme:compile").read().strip().split(" ")
@@ -104,7 +116,10 @@ else:
             raise Exception
         ext_options_mpicgal["extra_compile_args"] += mpi_compile_args
         ext_options_mpicgal["extra_link_args"] += mpi_link_args
+        ext_options_mpicgal["extra_compile_args"].append("-pthread")
+        ext_options_mpicgal["extra_link_args"].append("-pthread")
         ext_options_mpicgal["include_dirs"].append(os.path.dirname(cykdtree.__file__))
+        ext_options_mpicgal["include_dirs"].append(os.path.join("cgal4py", "domain_decomp"))
     except:
         compile_parallel = False
 
@@ -189,6 +204,36 @@ ext_modules += [
     Extension("cgal4py.delaunay.tools", sources=["cgal4py/delaunay/tools.pyx"], **ext_options),
 ]
 src_include += ["cgal4py/delaunay/tools.pyx", "cgal4py/delaunay/tools.pxd", "cgal4py/delaunay/c_tools.hpp"]
+src_include += ["cgal4py/delaunay/c_vertex_index.hpp", "cgal4py/delaunay/c_box_index.hpp",
+                "cgal4py/delaunay/c_container_index.hpp",
+                "cgal4py/delaunay/c_dual_volume.hpp"]
+
+# Add domain decomposition extensions (c_utils.hpp is provided by cykdtree)
+dd_include = ["kdtree.pyx", "kdtree.pxd", "c_kdtree.hpp", "c_kdtree_file.hpp",
+              "c_kdtree_route.hpp"]
+if cykdtree_utils_cpp is not None:
+    ext_options_kdtree = copy.deepcopy(ext_options)
+    ext_options_kdtree["include_dirs"].append(os.path.dirname(cykdtree_utils_cpp))
+    ext_options_kdtree["extra_compile_args"].append("-pthread")
+    ext_options_kdtree["extra_link_args"].append("-pthread")
+    ext_modules.append(
+        Extension(
+            "cgal4py.domain_decomp.kdtree",
+            sources=["cgal4py/domain_decomp/kdtree.pyx", "cgal4py/domain_decomp/c_kdtree.cpp", cykdtree_utils_cpp],
+            **ext_options_kdtree
+        )
+    )
+dd_include += ["sfc.pyx", "sfc.pxd", "c_sfc.hpp"]
+ext_options_sfc = copy.deepcopy(ext_options)
+ext_options_sfc["extra_compile_args"].append("-pthread")
+ext_options_sfc["extra_link_args"].append("-pthread")
+ext_modules.append(
+    Extension(
+        "cgal4py.domain_decomp.sfc",
+        sources=["cgal4py/domain_decomp/sfc.pyx", "cgal4py/domain_decomp/c_sfc.cpp"],
+        **ext_options_sfc
+    )
+)
 
 
 if use_cython:
@@ -201,7 +246,11 @@ setup(
     name="cgal4py",
     packages=["cgal4py", "cgal4py.delaunay", "cgal4py.domain_decomp", "cgal4py.tests"],
     # package_dir = {'cgal4py':'cgal4py'}, # maybe comment this out
-    package_data={"cgal4py": ["README.md", "README.rst"], "cgal4py.delaunay": src_include},
+    package_data={
+        "cgal4py": ["README.md", "README.rst"],
+        "cgal4py.delaunay": src_include,
+        "cgal4py.domain_decomp": dd_include,
+    },
     version="0.2.1",
     description="Python interface for CGAL Triangulations",
     long_description=long_description,